@@ -161,6 +161,28 @@ Q3DSViewerSettings::ScaleMode Q3DSViewerSettings::scaleMode() const
     return d->scaleMode;
 }
 
+/*!
+    \property Q3DSViewerSettings::textureMemoryBudget
+    \since Qt 3D Studio 2.1
+
+    Specifies the maximum amount of memory, in bytes, that textures loaded
+    from image files should occupy. When loading an image would exceed the
+    budget, the top mip levels are skipped for images that provide a mipmap
+    chain (for example, in KTX files), while other uncompressed images are
+    downscaled. Images are never reduced below 64x64, and light probes are
+    always loaded at full resolution.
+
+    A value of \c 0 disables the budget. The default value is \c -1, meaning
+    the budget is taken from the \c Q3DS_TEXTURE_BUDGET_MB environment
+    variable, or there is no limit when that is not set.
+
+    \note Changing the value affects images loaded afterwards only.
+ */
+qint64 Q3DSViewerSettings::textureMemoryBudget() const
+{
+    Q_D(const Q3DSViewerSettings);
+    return d->textureMemoryBudget;
+}
 
 void Q3DSViewerSettings::setMatteEnabled(bool isEnabled)
 {
@@ -208,6 +230,15 @@ void Q3DSViewerSettings::setScaleMode(Q3DSViewerSettings::ScaleMode mode)
     }
 }
 
+void Q3DSViewerSettings::setTextureMemoryBudget(qint64 bytes)
+{
+    Q_D(Q3DSViewerSettings);
+    if (d->textureMemoryBudget != bytes) {
+        d->textureMemoryBudget = bytes;
+        emit textureMemoryBudgetChanged();
+    }
+}
+
 /*!
     Persistently saves the viewer \l{QSettings}{settings} using \a group, \a organization and
     \a application.
@@ -260,6 +291,10 @@ Q3DSViewportSettings *Q3DSViewerSettingsPrivate::createViewportSettingsProxy()
     QObject::connect(q, &Q3DSViewerSettings::matteColorChanged, q, [vp, q] {
         vp->setMatteColor(q->matteColor());
     });
+    vp->setTextureMemoryBudget(q->textureMemoryBudget());
+    QObject::connect(q, &Q3DSViewerSettings::textureMemoryBudgetChanged, q, [vp, q] {
+        vp->setTextureMemoryBudget(q->textureMemoryBudget());
+    });
     return vp;
 }
 
@@ -303,6 +338,19 @@ Q3DSViewportSettings *Q3DSViewerSettingsPrivate::createViewportSettingsProxy()
     Specifies the matte color.
  */
 
+/*!
+    \qmlproperty int64 ViewerSettings::textureMemoryBudget
+    \since Qt 3D Studio 2.1
+
+    Specifies the maximum amount of memory, in bytes, that textures loaded
+    from image files should occupy. When loading an image would exceed the
+    budget, the top mip levels are skipped or the image is downscaled.
+
+    A value of \c 0 disables the budget. The default value is \c -1, meaning
+    the budget is taken from the \c Q3DS_TEXTURE_BUDGET_MB environment
+    variable, or there is no limit when that is not set.
+*/
+
 /*!
     \qmlproperty enumeration ViewerSettings::scaleMode
 
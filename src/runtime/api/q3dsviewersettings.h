@@ -51,6 +51,7 @@ class Q3DSV_EXPORT Q3DSViewerSettings : public QObject
     Q_PROPERTY(bool showRenderStats READ isShowingRenderStats WRITE setShowRenderStats NOTIFY showRenderStatsChanged)
     Q_PROPERTY(ShadeMode shadeMode READ shadeMode WRITE setShadeMode NOTIFY shadeModeChanged)
     Q_PROPERTY(ScaleMode scaleMode READ scaleMode WRITE setScaleMode NOTIFY scaleModeChanged)
+    Q_PROPERTY(qint64 textureMemoryBudget READ textureMemoryBudget WRITE setTextureMemoryBudget NOTIFY textureMemoryBudgetChanged)
 
 public:
     enum ShadeMode {
@@ -74,6 +75,7 @@ public:
     bool isShowingRenderStats() const;
     ShadeMode shadeMode() const;
     ScaleMode scaleMode() const;
+    qint64 textureMemoryBudget() const;
 
     Q_INVOKABLE void save(const QString &group,
                           const QString &organization = QString(),
@@ -88,6 +90,7 @@ public Q_SLOTS:
     void setShowRenderStats(bool show);
     void setShadeMode(ShadeMode mode);
     void setScaleMode(ScaleMode mode);
+    void setTextureMemoryBudget(qint64 bytes);
 
 Q_SIGNALS:
     void matteEnabledChanged();
@@ -95,6 +98,7 @@ Q_SIGNALS:
     void showRenderStatsChanged();
     void shadeModeChanged();
     void scaleModeChanged();
+    void textureMemoryBudgetChanged();
 
 protected:
     Q3DSViewerSettings(Q3DSViewerSettingsPrivate &dd, QObject *parent);
@@ -62,6 +62,7 @@ public:
     bool showRenderStats = false;
     Q3DSViewerSettings::ShadeMode shadeMode = Q3DSViewerSettings::ShadeModeShaded;
     Q3DSViewerSettings::ScaleMode scaleMode = Q3DSViewerSettings::ScaleModeFill;
+    qint64 textureMemoryBudget = -1;
 };
 
 QT_END_NAMESPACE
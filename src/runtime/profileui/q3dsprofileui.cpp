@@ -282,6 +282,27 @@ void Q3DSProfileView::frame()
         ImGui::Text("  of which image file I/O: %u ms\n  IBL mipmap gen: %u ms",
                     (uint) Q3DSImageManager::instance().ioTimeMsecs(),
                     (uint) Q3DSImageManager::instance().iblTimeMsecs());
+        const Q3DSImageManager &imageManager(Q3DSImageManager::instance());
+        const int imageLookups = imageManager.imageCacheHits() + imageManager.imageCacheMisses();
+        ImGui::Text("  Image cache: %d images, %.2f MB (limit: %s), hit ratio %.1f%%",
+                    imageManager.imageCacheEntryCount(),
+                    imageManager.imageCacheBytes() / (1024.0 * 1024.0),
+                    imageManager.imageCacheLimit() > 0
+                        ? qPrintable(QString::number(imageManager.imageCacheLimit() / (1024.0 * 1024.0), 'f', 2) + QLatin1String(" MB"))
+                        : "unlimited",
+                    imageLookups ? 100.0 * imageManager.imageCacheHits() / imageLookups : 0.0);
+        const Q3DSTexturePool::Stats poolStats = m_profiler->texturePoolStats();
+        ImGui::Text("  Render target pool: %d created, %d reused, %d destroyed, %d unused",
+                    poolStats.created, poolStats.reused, poolStats.destroyed, poolStats.freeCount);
+        Q3DSProfiler::ShaderStats shaderStats = m_profiler->shaderStats();
+        for (Q3DSProfiler *subPresProfiler : *m_profiler->subPresentationProfilers()) {
+            shaderStats.generateTimeMs += subPresProfiler->shaderStats().generateTimeMs;
+            shaderStats.generatedCount += subPresProfiler->shaderStats().generatedCount;
+        }
+        ImGui::Text("  Material shaders: %d generated in %u ms, %d program nodes created in %.2f ms",
+                    shaderStats.generatedCount, (uint) shaderStats.generateTimeMs,
+                    shaderStats.createdCount, shaderStats.createTimeNs / 1000000.0);
+        addTip("Shader generation runs in parallel before building the materials, the nodes are created on the main thread");
         ImGui::Text("  Active behavior QML comp.: %d, total load time %u ms",
                     m_profiler->behaviorActiveCount(), (uint) m_profiler->behaviorLoadTime());
         ImGui::Separator();
@@ -291,6 +312,9 @@ void Q3DSProfileView::frame()
         uint frameNo = lastFrameData ? lastFrameData->globalFrameCounter : 0;
         ImGui::Text("Frame %u", frameNo);
         ImGui::Text("Scene dirty: %s", lastFrameData ? (lastFrameData->wasDirty ? "true" : "false") : "unknown");
+        ImGui::Text("Effect parameter updates: %d (skipped unchanged: %d)",
+                    lastFrameData ? lastFrameData->effectParamUpdates : 0,
+                    lastFrameData ? lastFrameData->effectParamUpdatesSkipped : 0);
     }
 
     if (ImGui::CollapsingHeader("Scene info")) {
@@ -410,8 +434,12 @@ void Q3DSProfileView::addQt3DObjectsWindow()
 
     auto tex2d = objs->values(Q3DSProfiler::Texture2DObject);
     ImGui::Text("2D textures: %d", tex2d.count());
+    const qint64 texBudget = Q3DSImageManager::instance().textureMemoryBudget();
+    ImGui::Text("Image texture data: %.2f MB (budget: %s)",
+                Q3DSImageManager::instance().residentTextureBytes() / (1024.0 * 1024.0),
+                texBudget > 0 ? qPrintable(QString::number(texBudget / (1024.0 * 1024.0), 'f', 2) + QLatin1String(" MB")) : "unlimited");
     if (ImGui::TreeNodeEx("2D texture details", tex2d.isEmpty() ? 0 : ImGuiTreeNodeFlags_DefaultOpen)) {
-        ImGui::Columns(6, "tex2dcols");
+        ImGui::Columns(7, "tex2dcols");
         ImGui::Separator();
         ImGui::Text("Index"); ImGui::SetColumnWidth(-1, 50); ImGui::NextColumn();
         ImGui::Text("Description"); ImGui::NextColumn();
@@ -423,6 +451,10 @@ void Q3DSProfileView::addQt3DObjectsWindow()
                "This can also mean that there is only one underlying OpenGL texture, but note that that is "
                "only possible when all texture (Image) parameters (like wrap mode) match.");
         ImGui::NextColumn();
+        ImGui::Text("Image data (KB)");
+        addTip("Size of the image data for textures sourced from image files. "
+               "The number of skipped mip levels is shown when the texture memory budget was exceeded.");
+        ImGui::NextColumn();
         ImGui::Separator();
         int idx = 0;
         for (const Q3DSProfiler::ObjectData &objd : tex2d) {
@@ -446,6 +478,7 @@ void Q3DSProfileView::addQt3DObjectsWindow()
                         ImGui::NextColumn();
                         ImGui::Text("no");
                         ImGui::NextColumn();
+                        ImGui::NextColumn();
                         useTexture = false;
                     }
                 }
@@ -463,12 +496,20 @@ void Q3DSProfileView::addQt3DObjectsWindow()
                     ImGui::NextColumn();
                     ImGui::Text("%s", wasCached ? "yes" : "no");
                     ImGui::NextColumn();
+                    const qint64 residentBytes = Q3DSImageManager::instance().residentBytes(t);
+                    const int skippedMipLevels = Q3DSImageManager::instance().skippedMipLevels(t);
+                    if (skippedMipLevels)
+                        ImGui::Text("%u (-%d)", uint(residentBytes / 1024), skippedMipLevels);
+                    else
+                        ImGui::Text("%u", uint(residentBytes / 1024));
+                    ImGui::NextColumn();
                 }
             } else {
                 ImGui::NextColumn();
                 ImGui::NextColumn();
                 ImGui::NextColumn();
                 ImGui::NextColumn();
+                ImGui::NextColumn();
             }
         }
         ImGui::Columns(1);
@@ -0,0 +1,196 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of Qt 3D Studio.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "q3dsassetcache_p.h"
+#include "q3dslogging_p.h"
+#include <QFileInfo>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    The cache is keyed on the absolute file path (plus the part id for
+    meshes). What is stored are plain values: parsed metadata and
+    deserialized mesh data. Nothing in here is tied to a Qt 3D scene, so the
+    same entry can serve any number of engines. The per-engine objects (the
+    scene graph built by Q3DSUipParser, the Qt 3D nodes) are still created by
+    each engine on its own.
+ */
+
+Q3DSAssetCache &Q3DSAssetCache::instance()
+{
+    static Q3DSAssetCache cache;
+    return cache;
+}
+
+template<typename T>
+bool Q3DSAssetCache::lookup(const QString &fileName, const QString &entryKey, T Entry::*member,
+                            const std::function<bool(T *)> &load, T *result, QString *key)
+{
+    const QDateTime lastModified = QFileInfo(fileName).lastModified();
+
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_entries.find(entryKey);
+    if (it != m_entries.end() && it->lastModified == lastModified) {
+        ++m_stats.hits;
+        *result = (*it).*member;
+        if (key) {
+            ++it->refCount;
+            *key = entryKey;
+        }
+        return true;
+    }
+
+    ++m_stats.misses;
+
+    // Parsing (meshes especially) can take a while, do not block lookups of
+    // other files meanwhile. Two threads missing on the same file both load
+    // it, the second one to finish refreshes the entry.
+    lock.unlock();
+    T value;
+    if (!load(&value))
+        return false;
+    lock.relock();
+
+    *result = value;
+    it = m_entries.find(entryKey);
+    if (it != m_entries.end()) {
+        // the file has changed, refresh the entry; presentations holding a
+        // reference keep their own (shared) copy of the old data
+        qCDebug(lcPerf, "Reloading %s in asset cache", qPrintable(entryKey));
+        it->fileName = fileName;
+        it->lastModified = lastModified;
+        (*it).*member = value;
+        if (key) {
+            ++it->refCount;
+            *key = entryKey;
+        }
+    } else if (key) {
+        Entry e;
+        e.refCount = 1;
+        e.fileName = fileName;
+        e.lastModified = lastModified;
+        e.*member = value;
+        m_entries.insert(entryKey, e);
+        *key = entryKey;
+    }
+    return true;
+}
+
+bool Q3DSAssetCache::customMaterial(const QString &fileName, Q3DSCustomMaterial *material, QString *key)
+{
+    return lookup<Q3DSCustomMaterial>(fileName, QFileInfo(fileName).absoluteFilePath(), &Entry::customMaterial,
+                                      [fileName](Q3DSCustomMaterial *m) {
+        Q3DSCustomMaterialParser p;
+        bool ok = false;
+        *m = p.parse(fileName, &ok);
+        return ok;
+    }, material, key);
+}
+
+bool Q3DSAssetCache::effect(const QString &fileName, Q3DSEffect *effect, QString *key)
+{
+    return lookup<Q3DSEffect>(fileName, QFileInfo(fileName).absoluteFilePath(), &Entry::effect,
+                              [fileName](Q3DSEffect *e) {
+        Q3DSEffectParser p;
+        bool ok = false;
+        *e = p.parse(fileName, &ok);
+        return ok;
+    }, effect, key);
+}
+
+bool Q3DSAssetCache::behavior(const QString &fileName, Q3DSBehavior *behavior, QString *key)
+{
+    return lookup<Q3DSBehavior>(fileName, QFileInfo(fileName).absoluteFilePath(), &Entry::behavior,
+                                [fileName](Q3DSBehavior *b) {
+        Q3DSBehaviorParser p;
+        bool ok = false;
+        *b = p.parse(fileName, &ok);
+        return ok;
+    }, behavior, key);
+}
+
+bool Q3DSAssetCache::meshFile(const QString &fileName, int part, const MeshFileLoader &load,
+                              Q3DSMeshFileData *data, QString *key)
+{
+    const QString entryKey = QFileInfo(fileName).absoluteFilePath() + QLatin1Char('#') + QString::number(part);
+    return lookup<Q3DSMeshFileData>(fileName, entryKey, &Entry::meshFile, load, data, key);
+}
+
+void Q3DSAssetCache::release(const QString &key)
+{
+    if (key.isEmpty())
+        return;
+
+    QMutexLocker lock(&m_mutex);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end() && --it->refCount <= 0)
+        m_entries.erase(it);
+}
+
+void Q3DSAssetCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_entries.clear();
+    m_stats = Stats();
+}
+
+QStringList Q3DSAssetCache::modifiedFiles(const QVector<QString> &keys) const
+{
+    QStringList result;
+    QMutexLocker lock(&m_mutex);
+    for (const QString &key : keys) {
+        auto it = m_entries.constFind(key);
+        if (it != m_entries.cend() && !result.contains(QFileInfo(it->fileName).absoluteFilePath())
+                && QFileInfo(it->fileName).lastModified() != it->lastModified)
+        {
+            result.append(QFileInfo(it->fileName).absoluteFilePath());
+        }
+    }
+    return result;
+}
+
+void Q3DSAssetCache::invalidate(const QStringList &fileNames)
+{
+    QMutexLocker lock(&m_mutex);
+    for (Entry &e : m_entries) {
+        if (fileNames.contains(QFileInfo(e.fileName).absoluteFilePath()))
+            e.lastModified = QDateTime();
+    }
+}
+
+Q3DSAssetCache::Stats Q3DSAssetCache::stats() const
+{
+    QMutexLocker lock(&m_mutex);
+    Stats s = m_stats;
+    s.entries = m_entries.count();
+    return s;
+}
+
+QT_END_NAMESPACE
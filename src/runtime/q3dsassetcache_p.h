@@ -0,0 +1,142 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of Qt 3D Studio.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef Q3DSASSETCACHE_P_H
+#define Q3DSASSETCACHE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "q3dsruntimeglobal_p.h"
+#include "q3dscustommaterial_p.h"
+#include "q3dseffect_p.h"
+#include "q3dsbehavior_p.h"
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+
+// One mesh from a .mesh file, deserialized. The offsets in data are fixed up
+// already, meaning it must not be deserialized again. The vertex and index
+// data is not copied out: the Qt3DRender::QBuffers created from it all share
+// this (implicitly shared) QByteArray and address into it with offsets.
+struct Q3DSMeshFileData
+{
+    QByteArray data;
+
+    bool isNull() const { return data.isEmpty(); }
+};
+
+// Process-wide cache for the immutable, parsed parts of presentations:
+// custom material, effect and behavior definitions and mesh data. Engines
+// showing the same presentation (multiple windows, Studio3D items) get copies
+// of the cached values instead of reading and parsing the files again. The
+// values are implicitly shared, so a copy costs next to nothing and any
+// per-instance modification detaches only that instance.
+//
+// Lookups that pass a non-null key take a reference on the entry, which must
+// be dropped via release() when the presentation goes away. Entries without
+// references are removed. Entries are reloaded when the file's timestamp
+// changes.
+//
+// The .uip scene and slide graph is not in here: each engine still parses
+// its own. Graph objects are mutable (properties, slides, animations) and
+// have no copy-on-write, so sharing them would need a cloneable template
+// first.
+class Q3DSV_PRIVATE_EXPORT Q3DSAssetCache
+{
+public:
+    struct Stats {
+        int entries = 0;
+        int hits = 0;
+        int misses = 0;
+    };
+
+    static Q3DSAssetCache &instance();
+
+    bool customMaterial(const QString &fileName, Q3DSCustomMaterial *material, QString *key = nullptr);
+    bool effect(const QString &fileName, Q3DSEffect *effect, QString *key = nullptr);
+    bool behavior(const QString &fileName, Q3DSBehavior *behavior, QString *key = nullptr);
+
+    typedef std::function<bool(Q3DSMeshFileData *)> MeshFileLoader;
+    bool meshFile(const QString &fileName, int part, const MeshFileLoader &load,
+                  Q3DSMeshFileData *data, QString *key = nullptr);
+
+    void release(const QString &key);
+    void clear();
+
+    // The files, out of the entries with the given keys, that changed on
+    // disk since they were cached.
+    QStringList modifiedFiles(const QVector<QString> &keys) const;
+    // Treats the given files as modified even when their timestamp is the
+    // same, for when the caller knows better (e.g. a file was replaced within
+    // the timestamp resolution).
+    void invalidate(const QStringList &fileNames);
+
+    Stats stats() const;
+
+private:
+    Q3DSAssetCache() = default;
+    Q_DISABLE_COPY(Q3DSAssetCache)
+
+    struct Entry {
+        int refCount = 0;
+        QString fileName;
+        QDateTime lastModified;
+        Q3DSCustomMaterial customMaterial;
+        Q3DSEffect effect;
+        Q3DSBehavior behavior;
+        Q3DSMeshFileData meshFile;
+    };
+
+    template<typename T>
+    bool lookup(const QString &fileName, const QString &entryKey, T Entry::*member,
+                const std::function<bool(T *)> &load, T *result, QString *key);
+
+    mutable QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+    Stats m_stats;
+};
+
+QT_END_NAMESPACE
+
+#endif // Q3DSASSETCACHE_P_H
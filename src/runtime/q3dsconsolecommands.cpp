@@ -268,8 +268,8 @@ void Q3DSConsoleCommands::setupConsole(Q3DSConsole *console)
                             const Q3DSLightSource &lightSource(lightSources.at(i));
                             m_console->addMessageFmt(longResponseColor, "  %d:\n    global position %s\n    global direction %s\n",
                                                      i,
-                                                     qPrintable(Q3DS::convertFromVariant(lightSource.positionParam->value())),
-                                                     qPrintable(Q3DS::convertFromVariant(lightSource.directionParam->value())));
+                                                     qPrintable(Q3DS::convertFromVariant(QVariant::fromValue(lightSource.data->m_position))),
+                                                     qPrintable(Q3DS::convertFromVariant(QVariant::fromValue(lightSource.data->m_direction.toVector3D()))));
                         }
                     };
                     m_console->addMessageFmt(longResponseColor, "%d lights for this subtree\nNon-area lights:\n",
@@ -48,7 +48,7 @@
 
 QT_BEGIN_NAMESPACE
 
-Qt3DRender::QMaterial *Q3DSCustomMaterialGenerator::generateMaterial(Q3DSCustomMaterialInstance *customMaterial, Q3DSReferencedMaterial *referencedMaterial, const QVector<Qt3DRender::QParameter *> &params, const QVector<Q3DSLightNode *> &lights, Q3DSLayerNode *layer3DS, const Q3DSMaterial::Pass &pass)
+Qt3DRender::QMaterial *Q3DSCustomMaterialGenerator::generateMaterial(Q3DSShaderProgramCache *programs, Q3DSCustomMaterialInstance *customMaterial, Q3DSReferencedMaterial *referencedMaterial, const QVector<Qt3DRender::QParameter *> &params, const QVector<Q3DSLightNode *> &lights, Q3DSLayerNode *layer3DS, const Q3DSMaterial::Pass &pass)
 {
     Qt3DRender::QMaterial *material = new Qt3DRender::QMaterial;
     Qt3DRender::QEffect *effect = new Qt3DRender::QEffect;
@@ -61,7 +61,8 @@ Qt3DRender::QMaterial *Q3DSCustomMaterialGenerator::generateMaterial(Q3DSCustomM
     Q3DSShaderFeatureSet features;
     fillFeatureSet(&features, layer3DS, customMaterial, referencedMaterial);
 
-    Qt3DRender::QShaderProgram *shaderProgram = Q3DSShaderManager::instance().generateShaderProgram(*customMaterial,
+    Qt3DRender::QShaderProgram *shaderProgram = Q3DSShaderManager::instance().generateShaderProgram(programs,
+                                                                                                    *customMaterial,
                                                                                                     referencedMaterial,
                                                                                                     lights,
                                                                                                     false,
@@ -72,7 +73,8 @@ Qt3DRender::QMaterial *Q3DSCustomMaterialGenerator::generateMaterial(Q3DSCustomM
     // to the QMaterial by parenting it to something else now.
     shaderProgram->setParent(layerData->entity);
     // ### TODO This is does not take into consideration anything specified by the custom material pass
-    for (Qt3DRender::QRenderPass *pass : Q3DSSceneManager::standardRenderPasses(shaderProgram,
+    for (Qt3DRender::QRenderPass *pass : Q3DSSceneManager::standardRenderPasses(programs,
+                                                                                shaderProgram,
                                                                                 layer3DS,
                                                                                 Q3DSDefaultMaterial::Normal,
                                                                                 customMaterial->material()->shaderIsDisplaced()))
@@ -84,7 +86,7 @@ Qt3DRender::QMaterial *Q3DSCustomMaterialGenerator::generateMaterial(Q3DSCustomM
     effect->addTechnique(technique);
 
     if (Q3DSDefaultMaterialGenerator::hasCompute()) {
-        for (Qt3DRender::QTechnique *computeTechnique : Q3DSSceneManager::computeTechniques(layer3DS))
+        for (Qt3DRender::QTechnique *computeTechnique : Q3DSSceneManager::computeTechniques(programs, layer3DS))
             effect->addTechnique(computeTechnique);
     }
 
@@ -106,31 +108,11 @@ void Q3DSCustomMaterialGenerator::fillFeatureSet(Q3DSShaderFeatureSet *features,
     Q3DSLayerAttached *layerData = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
     Q_ASSERT(layerData);
 
-    // Figure out if IBL data has been set
-    bool enableLightProbe = false;
-    bool enableLightProbe2 = false;
-    bool enableIblFov = false;
-
-    // Check Layer
-    if (layer3DS->lightProbe())
-        enableLightProbe = true;
-    if (layer3DS->lightProbe2())
-        enableLightProbe2 = true;
-
-    if (layer3DS->probeFov() < 180.0f && enableLightProbe)
-        enableIblFov = true;
-
-    // Check for Override in material or referenced material
-    if (material->lightProbe() || (referencedMaterial && referencedMaterial->lightProbe()))
-        enableLightProbe = true;
-
-    features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_CG_LIGHTING"), true));
-    features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_IBL_FOV"), enableIblFov));
-    features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_LIGHT_PROBE"), enableLightProbe));
-    features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_LIGHT_PROBE_2"), enableLightProbe2));
-    features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_SSDO"), false));
-    features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_SSM"), !layerData->shadowMapData.shadowCasters.isEmpty()));
-    features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_SSAO"), layerData->ssaoTextureData.enabled));
+    // Same as for the default material.
+    Q3DSDefaultMaterialGenerator::fillFeatureSet(features, layer3DS,
+                                                 material->lightProbe() || (referencedMaterial && referencedMaterial->lightProbe()),
+                                                 !layerData->shadowMapData.shadowCasters.isEmpty(),
+                                                 layerData->ssaoTextureData.enabled);
 }
 
 QT_END_NAMESPACE
@@ -54,7 +54,8 @@ class QMaterial;
 class Q3DSCustomMaterialGenerator
 {
 public:
-    Qt3DRender::QMaterial *generateMaterial(Q3DSCustomMaterialInstance *customMaterial,
+    Qt3DRender::QMaterial *generateMaterial(Q3DSShaderProgramCache *programs,
+                                            Q3DSCustomMaterialInstance *customMaterial,
                                             Q3DSReferencedMaterial *referencedMaterial,
                                             const QVector<Qt3DRender::QParameter *> &params,
                                             const QVector<Q3DSLightNode *> &lights,
@@ -86,17 +86,16 @@ QT_BEGIN_NAMESPACE
 // vec3 attr_norm;
 // vec2 attr_uv0
 
-// Caller takes ownership everything generated in the method
-Qt3DRender::QMaterial *Q3DSDefaultMaterialGenerator::generateMaterial(Q3DSDefaultMaterial *defaultMaterial,
+// Caller takes ownership of the returned QMaterial. The effect it references is
+// owned by the layer and may be shared with other materials.
+Qt3DRender::QMaterial *Q3DSDefaultMaterialGenerator::generateMaterial(Q3DSShaderProgramCache *programs,
+                                                                      Q3DSDefaultMaterial *defaultMaterial,
                                                                       Q3DSReferencedMaterial *referencedMaterial,
                                                                       const QVector<Qt3DRender::QParameter *> &params,
                                                                       const QVector<Q3DSLightNode*> &lights,
                                                                       Q3DSLayerNode *layer3DS)
 {
     Qt3DRender::QMaterial *material = new Qt3DRender::QMaterial;
-    Qt3DRender::QEffect *effect = new Qt3DRender::QEffect;
-    Qt3DRender::QTechnique *technique = new Qt3DRender::QTechnique;
-    Q3DSSceneManager::markAsMainTechnique(technique);
 
     Q3DSLayerAttached *layerData = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
     Q_ASSERT(layerData);
@@ -104,7 +103,8 @@ Qt3DRender::QMaterial *Q3DSDefaultMaterialGenerator::generateMaterial(Q3DSDefaul
     Q3DSShaderFeatureSet features;
     fillFeatureSet(&features, layer3DS, defaultMaterial, referencedMaterial);
 
-    Qt3DRender::QShaderProgram *shaderProgram = Q3DSShaderManager::instance().generateShaderProgram(*defaultMaterial,
+    Qt3DRender::QShaderProgram *shaderProgram = Q3DSShaderManager::instance().generateShaderProgram(programs,
+                                                                                                    *defaultMaterial,
                                                                                                     referencedMaterial,
                                                                                                     lights,
                                                                                                     false,
@@ -114,27 +114,47 @@ Qt3DRender::QMaterial *Q3DSDefaultMaterialGenerator::generateMaterial(Q3DSDefaul
     // to the QMaterial by parenting it to something else now.
     shaderProgram->setParent(layerData->entity);
 
-    for (Qt3DRender::QRenderPass *pass : Q3DSSceneManager::standardRenderPasses(shaderProgram,
-                                                                                layer3DS,
-                                                                                defaultMaterial->blendMode(),
-                                                                                defaultMaterial->displacementMap() != nullptr))
-    {
-        technique->addRenderPass(pass);
-    }
-
-    addDefaultApiFilter(technique);
-    effect->addTechnique(technique);
-
-    if (hasCompute()) {
-        for (Qt3DRender::QTechnique *computeTechnique : Q3DSSceneManager::computeTechniques(layer3DS))
-            effect->addTechnique(computeTechnique);
+    // Everything below the QEffect depends only on the program and a few
+    // layer and material flags, so when the same program is generated for
+    // many models (repeated meshes with identical materials, typically) the
+    // effect is shared. The parameters are per model and go to the QMaterial.
+    const bool hasDisplacement = defaultMaterial->displacementMap() != nullptr;
+    const int passConfig = int(defaultMaterial->blendMode())
+            | (hasDisplacement ? 0x100 : 0)
+            | (layer3DS->layerFlags().testFlag(Q3DSLayerNode::DisableDepthTest) ? 0x200 : 0)
+            | (layer3DS->layerFlags().testFlag(Q3DSLayerNode::DisableDepthPrePass) ? 0x400 : 0);
+    const auto effectKey = qMakePair(shaderProgram, passConfig);
+    Qt3DRender::QEffect *effect = layerData->defaultMaterialEffects.value(effectKey);
+    if (!effect) {
+        effect = new Qt3DRender::QEffect(layerData->entity);
+        Qt3DRender::QTechnique *technique = new Qt3DRender::QTechnique;
+        Q3DSSceneManager::markAsMainTechnique(technique);
+
+        for (Qt3DRender::QRenderPass *pass : Q3DSSceneManager::standardRenderPasses(programs,
+                                                                                    shaderProgram,
+                                                                                    layer3DS,
+                                                                                    defaultMaterial->blendMode(),
+                                                                                    hasDisplacement))
+        {
+            technique->addRenderPass(pass);
+        }
+
+        addDefaultApiFilter(technique);
+        effect->addTechnique(technique);
+
+        if (hasCompute()) {
+            for (Qt3DRender::QTechnique *computeTechnique : Q3DSSceneManager::computeTechniques(programs, layer3DS))
+                effect->addTechnique(computeTechnique);
+        }
+
+        layerData->defaultMaterialEffects.insert(effectKey, effect);
     }
 
     static const bool paramDebug = qEnvironmentVariableIntValue("Q3DS_DEBUG") >= 2;
     if (paramDebug)
-        qCDebug(lcScene) << effect << "for default material" << defaultMaterial->id() << "has parameters:";
+        qCDebug(lcScene) << material << "with" << effect << "for default material" << defaultMaterial->id() << "has parameters:";
     for (Qt3DRender::QParameter *param : params) {
-        effect->addParameter(param);
+        material->addParameter(param);
         if (paramDebug)
             qCDebug(lcScene) << "  " << param << param->name() << param->value();
     }
@@ -177,6 +197,18 @@ void Q3DSDefaultMaterialGenerator::fillFeatureSet(Q3DSShaderFeatureSet *features
     Q3DSLayerAttached *layerData = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
     Q_ASSERT(layerData);
 
+    fillFeatureSet(features, layer3DS,
+                   material->lightProbe() || (referencedMaterial && referencedMaterial->lightProbe()),
+                   !layerData->shadowMapData.shadowCasters.isEmpty(),
+                   layerData->ssaoTextureData.enabled);
+}
+
+void Q3DSDefaultMaterialGenerator::fillFeatureSet(Q3DSShaderFeatureSet *features,
+                                                  Q3DSLayerNode *layer3DS,
+                                                  bool materialLightProbe,
+                                                  bool shadowMaps,
+                                                  bool ssao)
+{
     // Figure out if IBL data has been set
     bool enableLightProbe = false;
     bool enableLightProbe2 = false;
@@ -191,7 +223,7 @@ void Q3DSDefaultMaterialGenerator::fillFeatureSet(Q3DSShaderFeatureSet *features
         enableIblFov = true;
 
     // Check for Override in material or referenced material
-    if (material->lightProbe() || (referencedMaterial && referencedMaterial->lightProbe()))
+    if (materialLightProbe)
         enableLightProbe = true;
 
     features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_CG_LIGHTING"), true));
@@ -199,8 +231,8 @@ void Q3DSDefaultMaterialGenerator::fillFeatureSet(Q3DSShaderFeatureSet *features
     features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_LIGHT_PROBE"), enableLightProbe));
     features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_LIGHT_PROBE_2"), enableLightProbe2));
     features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_SSDO"), false));
-    features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_SSM"), !layerData->shadowMapData.shadowCasters.isEmpty()));
-    features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_SSAO"), layerData->ssaoTextureData.enabled));
+    features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_SSM"), shadowMaps));
+    features->append(Q3DSShaderPreprocessorFeature(QLatin1String("QT3DS_ENABLE_SSAO"), ssao));
 }
 
 QT_END_NAMESPACE
@@ -52,10 +52,11 @@ class QMaterial;
 class QTechnique;
 }
 
-class Q3DSDefaultMaterialGenerator
+class Q3DSV_PRIVATE_EXPORT Q3DSDefaultMaterialGenerator
 {
 public:
-    Qt3DRender::QMaterial *generateMaterial(Q3DSDefaultMaterial *defaultMaterial,
+    Qt3DRender::QMaterial *generateMaterial(Q3DSShaderProgramCache *programs,
+                                            Q3DSDefaultMaterial *defaultMaterial,
                                             Q3DSReferencedMaterial *referencedMaterial,
                                             const QVector<Qt3DRender::QParameter *> &params,
                                             const QVector<Q3DSLightNode *> &lights,
@@ -67,6 +68,12 @@ public:
                                Q3DSLayerNode *layer3DS,
                                Q3DSDefaultMaterial *material = nullptr,
                                Q3DSReferencedMaterial *referencedMaterial = nullptr);
+    // Does not need the layer's Qt 3D side, for generating shaders offline.
+    static void fillFeatureSet(Q3DSShaderFeatureSet *features,
+                               Q3DSLayerNode *layer3DS,
+                               bool materialLightProbe,
+                               bool shadowMaps,
+                               bool ssao);
 };
 
 QT_END_NAMESPACE
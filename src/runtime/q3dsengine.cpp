@@ -35,12 +35,19 @@
 #include "q3dsinputmanager_p.h"
 #include "q3dsinlineqmlsubpresentation_p.h"
 #include "q3dsviewportsettings_p.h"
+#include "q3dsimagemanager_p.h"
+#include "q3dspresentationdiff_p.h"
+#include "q3dsassetcache_p.h"
+#include "q3dsslideplayer_p.h"
+#include "shadergenerator/q3dsshadermanager_p.h"
 
 #include <QLoggingCategory>
 #include <QKeyEvent>
 #include <QMouseEvent>
 #include <QtQml/qqmlengine.h>
 #include <QtQml/qqmlcontext.h>
+#include <QtQuick/QQuickWindow>
+#include <QImageReader>
 #include <QtMath>
 
 #include <QOpenGLContext>
@@ -163,6 +170,9 @@ Q3DSEngine::Q3DSEngine()
         const_cast<QLoggingCategory &>(lcInput()).setEnabled(QtDebugMsg, logValueChanges);
     }
     setViewportSettings(new Q3DSViewportSettings(this));
+    m_shaderPrograms.reset(new Q3DSShaderProgramCache);
+
+    m_autoIdleRendering = qEnvironmentVariableIntValue("Q3DS_AUTO_IDLE_RENDERING");
 }
 
 Q3DSEngine::~Q3DSEngine()
@@ -364,6 +374,16 @@ void adoptSurfaceFormat(const QSurfaceFormat &format)
     }
 }
 
+void setGraphicsLimits(const Q3DSGraphicsLimits &limits)
+{
+    // there may never be an engine, but the shader libraries are needed
+    initResources();
+
+    gfxLimits = limits;
+    adoptedSurfaceFormat = limits.format;
+    surfaceFormatAdopted = true;
+}
+
 QSurfaceFormat surfaceFormat()
 {
     return surfaceFormatAdopted ? adoptedSurfaceFormat : idealSurfaceFormat();
@@ -477,6 +497,19 @@ bool Q3DSEngine::setSource(const QString &uipOrUiaFileName,
         }
     }
 
+    if (!uia.isEmpty()) {
+        m_uiaFileName = uia;
+        m_uiaLastModified = QFileInfo(uia).lastModified();
+    }
+
+    // Material shaders generated ahead of time by q3dsshaderbundler, either
+    // next to the presentation or given explicitly.
+    QString shaderBundle = QFile::decodeName(qgetenv("Q3DS_SHADER_BUNDLE"));
+    if (shaderBundle.isEmpty())
+        shaderBundle = sourcePrefix + QFileInfo(uia.isEmpty() ? m_source : uia).completeBaseName() + QLatin1String(".shaderbundle");
+    if (QFile::exists(shaderBundle))
+        Q3DSShaderManager::instance().loadShaderBundle(shaderBundle);
+
     if (uia.isEmpty()) {
         UipPresentation pres;
         pres.uipDocument = new Q3DSUipDocument;
@@ -519,6 +552,203 @@ bool Q3DSEngine::setSource(const QString &uipOrUiaFileName,
     return loadPresentations();
 }
 
+// Picks up the changes made to the .uip files and the meshes, images and
+// custom materials they reference. Property changes and added or removed
+// objects are applied to the existing scenes, keeping the slide and animation
+// state. Everything else (.uia, effects, behaviors, slides, animations,
+// actions, moved objects) leads to a full reload.
+bool Q3DSEngine::reload(const QStringList &changedFiles, QString *error)
+{
+    if (reloadIncrementally(changedFiles))
+        return true;
+
+    const InlineSubPresList inlineQmlPresentations = m_inlineQmlPresentations;
+    return setSource(m_source, error, inlineQmlPresentations);
+}
+
+static bool isImageFile(const QString &suffix)
+{
+    static const QList<QByteArray> formats = QImageReader::supportedImageFormats();
+    return suffix == QLatin1String("hdr") || suffix == QLatin1String("pkm")
+            || suffix == QLatin1String("dds") || suffix == QLatin1String("ktx")
+            || formats.contains(suffix.toLatin1());
+}
+
+bool Q3DSEngine::reloadIncrementally(const QStringList &changedFiles)
+{
+    if (m_source.isEmpty() || m_uipPresentations.isEmpty())
+        return false;
+
+    if (!m_uiaFileName.isEmpty() && QFileInfo(m_uiaFileName).lastModified() != m_uiaLastModified) {
+        qCDebug(lcUip, "%s changed, doing a full reload", qPrintable(m_uiaFileName));
+        return false;
+    }
+
+    // The .uip files are compared by contents anyway. Known changes to
+    // anything else than meshes, images and custom materials need a full
+    // reload.
+    QStringList changedMeshes;
+    QStringList changedMaterials;
+    QStringList changedImages;
+    for (const QString &fn : changedFiles) {
+        const QFileInfo fi(fn);
+        const QString suffix = fi.suffix().toLower();
+        if (suffix == QLatin1String("uip"))
+            continue;
+        if (suffix == QLatin1String("mesh")) {
+            changedMeshes.append(fi.absoluteFilePath());
+        } else if (suffix == QLatin1String("material") || suffix == QLatin1String("shader")) {
+            changedMaterials.append(fi.absoluteFilePath());
+        } else if (isImageFile(suffix)) {
+            changedImages.append(fi.absoluteFilePath());
+        } else {
+            qCDebug(lcUip, "%s changed, doing a full reload", qPrintable(fn));
+            return false;
+        }
+    }
+    if (!changedMeshes.isEmpty() || !changedMaterials.isEmpty())
+        Q3DSAssetCache::instance().invalidate(changedMeshes + changedMaterials);
+
+    QElapsedTimer t;
+    t.start();
+
+    struct Change {
+        UipPresentation *pres = nullptr;
+        QByteArray data;
+        Q3DSUipPresentation *before = nullptr;
+        Q3DSUipPresentation *after = nullptr;
+        Q3DSPresentationDiff diff;
+        QStringList modifiedMeshes;
+        QStringList modifiedMaterials;
+    };
+    QVector<Change> changes;
+    changes.reserve(m_uipPresentations.count());
+
+    // Nothing is applied until all presentations are known to be fine.
+    bool ok = true;
+    for (UipPresentation &pres : m_uipPresentations) {
+        const QString source = pres.uipDocument->source();
+        if (source.isEmpty() || pres.sourceData.isEmpty() || !pres.presentation || !pres.sceneManager) {
+            ok = false;
+            break;
+        }
+
+        changes.append(Change());
+        Change &change(changes.last());
+        change.pres = &pres;
+
+        // Meshes, images and custom materials can be swapped in the live
+        // scene, effects and behaviors cannot. Must be checked for all
+        // presentations before parsing any since that refreshes the asset
+        // cache.
+        const QStringList modifiedAssets = pres.presentation->modifiedAssetFiles();
+        const QStringList materialFiles = pres.presentation->customMaterialFiles();
+        for (const QString &fn : modifiedAssets) {
+            if (fn.endsWith(QLatin1String(".mesh"), Qt::CaseInsensitive)) {
+                change.modifiedMeshes.append(fn);
+            } else if (materialFiles.contains(fn)) {
+                change.modifiedMaterials.append(fn);
+            } else {
+                qCDebug(lcUip, "%s changed, doing a full reload", qPrintable(fn));
+                ok = false;
+                break;
+            }
+        }
+        if (!ok)
+            break;
+    }
+
+    for (int i = 0; ok && i < changes.count(); ++i) {
+        Change &change(changes[i]);
+        UipPresentation &pres(*change.pres);
+        const QString source = pres.uipDocument->source();
+
+        QFile f(source);
+        if (!f.open(QIODevice::ReadOnly)) {
+            ok = false;
+            break;
+        }
+        change.data = f.readAll();
+        if (change.data == pres.sourceData)
+            continue;
+
+        Q3DSUipParser beforeParser;
+        change.before = beforeParser.parseData(pres.sourceData, pres.uipDocument->id(), source);
+        Q3DSUipParser afterParser;
+        change.after = afterParser.parseData(change.data, pres.uipDocument->id(), source);
+        if (!change.before || !change.after || !change.diff.compute(change.before, change.after)) {
+            qCDebug(lcUip, "%s cannot be reloaded incrementally: %s",
+                    qPrintable(source), qPrintable(change.diff.failureReason()));
+            ok = false;
+            break;
+        }
+    }
+
+    int changedCount = 0;
+    int addedCount = 0;
+    int removedCount = 0;
+    int meshCount = 0;
+    int materialCount = 0;
+    if (ok) {
+        for (Change &change : changes) {
+            Q3DSUipPresentation *live = change.pres->presentation;
+            live->invalidateMeshes(change.modifiedMeshes);
+            meshCount += change.modifiedMeshes.count();
+
+            if (change.after) {
+                Q3DSSlideDeck *slideDeck = change.pres->sceneManager->slidePlayer()->slideDeck();
+                change.diff.apply(live, change.after, slideDeck ? slideDeck->currentSlide() : nullptr);
+                changedCount += change.diff.changedProperties().count();
+                addedCount += change.diff.addedCount();
+                removedCount += change.diff.removedCount();
+            }
+
+            if (!change.modifiedMeshes.isEmpty()) {
+                Q3DSUipPresentation::forAllModels(live->scene(), [live, &change](Q3DSModelNode *model) {
+                    if (model->sourcePath().isEmpty() || model->sourcePath().startsWith(QLatin1Char('#')))
+                        return;
+                    int part = 1;
+                    const QString fn = QFileInfo(live->assetFileName(model->sourcePath(), &part)).absoluteFilePath();
+                    if (change.modifiedMeshes.contains(fn)) {
+                        model->resolveReferences(*live);
+                        model->notifyPropertyChanges({ Q3DSPropertyChange(QLatin1String("sourcepath")) });
+                    }
+                }, true);
+            }
+
+            if (!change.modifiedMaterials.isEmpty()) {
+                const QVector<Q3DSCustomMaterialInstance *> instances = live->reloadCustomMaterials(change.modifiedMaterials);
+                for (Q3DSCustomMaterialInstance *instance : instances)
+                    instance->notifyPropertyChanges({ Q3DSPropertyChange(QLatin1String("class")) });
+                materialCount += instances.count();
+            }
+
+            change.pres->sourceData = change.data;
+        }
+    }
+
+    for (Change &change : changes) {
+        for (Q3DSUipPresentation *p : { change.before, change.after }) {
+            if (p) {
+                p->deleteMeshes();
+                delete p;
+            }
+        }
+    }
+
+    if (!ok)
+        return false;
+
+    const int imageCount = Q3DSImageManager::instance().reloadModifiedImages(changedImages);
+
+    qCDebug(lcPerf, "Incremental reload took %lld ms (%d changed, %d added, %d removed objects, %d meshes, %d materials, %d images)",
+            t.elapsed(), changedCount, addedCount, removedCount, meshCount, materialCount, imageCount);
+
+    leaveIdleState();
+
+    return true;
+}
+
 // setDocument allows constructing presentation(s) from in-memory data
 // (provided the uips do not reference any actual files) and is used by srbench
 // for example. May need to be revised later.
@@ -686,8 +916,13 @@ void Q3DSEngine::finalizePresentations()
     else
         m_aspectEngine->setRootEntity(Qt3DCore::QEntityPtr(m_uipPresentations[0].q3dscene.rootEntity));
 
-    m_uipPresentations[0].q3dscene.renderSettings->setRenderPolicy(m_onDemandRendering ?
-        Qt3DRender::QRenderSettings::OnDemand : Qt3DRender::QRenderSettings::Always);
+    m_idle = false;
+    m_idleFrameCount = 0;
+    m_qualityGovernor.restartWindow();
+    m_skipFrameTime = true;
+    applyRenderPolicy();
+    if (m_qualityGovernor.level() != 0)
+        applyQuality();
 
     if (m_autoStart) {
         for (const UipPresentation &pres : m_uipPresentations)
@@ -773,9 +1008,16 @@ bool Q3DSEngine::buildUipPresentationScene(UipPresentation *pres)
     pres->sceneManager->setMatteEnabled(m_viewportSettings->matteEnabled());
     pres->sceneManager->setMatteColor(m_viewportSettings->matteColor());
 
-    // Expose update signal
-    connect(pres->q3dscene.frameAction, &Qt3DLogic::QFrameAction::triggered, this, [this](float dt) {
+    // Expose update signal. The per-frame engine work (behaviors, idle
+    // tracking, frame time sampling) runs from the main presentation's frame
+    // action only, the subpresentations' frame actions tick in the same
+    // frame and must not advance the counters again.
+    disconnect(m_frameActionConnection);
+    m_frameActionConnection = connect(pres->q3dscene.frameAction, &Qt3DLogic::QFrameAction::triggered, this, [this](float dt) {
         behaviorFrameUpdate(dt);
+        updateIdleState();
+        if (m_qualityGovernorEnabled && !m_frameTimesInjected)
+            sampleFrameTime(dt * 1000.0f);
         emit nextFrameStarting();
     });
 
@@ -868,6 +1110,8 @@ bool Q3DSEngine::buildSubUipPresentationScene(UipPresentation *pres)
 
     rtSel->setTarget(rt);
     params.frameGraphRoot = rtSel;
+    pres->subPres.frameGraph = rtSel;
+    pres->subPres.presentationSize = params.outputSize;
 
     QScopedPointer<Q3DSSceneManager> sceneManager(new Q3DSSceneManager);
     pres->q3dscene = sceneManager->buildScene(pres->presentation, params);
@@ -883,6 +1127,34 @@ bool Q3DSEngine::buildSubUipPresentationScene(UipPresentation *pres)
     return true;
 }
 
+// Scene2D renders the Qt Quick scene only when something in it requested an
+// update, in which case the offscreen window goes through the polish/animate
+// step first. Counting afterAnimating emissions tells the scene manager if the
+// content of a QML subpresentation may have changed.
+// windowChanged may be emitted more than once for the same window, so the
+// current connection is tracked and replaced only when the window changes.
+struct QmlSubPresChangeTracker
+{
+    QPointer<QQuickWindow> window;
+    QMetaObject::Connection connection;
+};
+
+static void trackQmlSubPresentationChanges(QQuickItem *item, const QSharedPointer<int> &changeCount)
+{
+    QSharedPointer<QmlSubPresChangeTracker> tracker(new QmlSubPresChangeTracker);
+    auto connectWindow = [changeCount, tracker](QQuickWindow *window) {
+        if (tracker->window == window)
+            return;
+        QObject::disconnect(tracker->connection);
+        tracker->window = window;
+        if (window)
+            tracker->connection = QObject::connect(window, &QQuickWindow::afterAnimating, window, [changeCount] { ++*changeCount; });
+    };
+    QObject::connect(item, &QQuickItem::windowChanged, item, connectWindow);
+    connectWindow(item->window());
+    ++*changeCount;
+}
+
 bool Q3DSEngine::loadSubQmlPresentation(QmlPresentation *pres)
 {
     Q_ASSERT(pres);
@@ -914,6 +1186,7 @@ bool Q3DSEngine::loadSubQmlPresentation(QmlPresentation *pres)
     }
 
     Qt3DCore::QNode *entityParent = m_uipPresentations[0].q3dscene.rootEntity;
+    pres->subPres.qmlContentChangeCount.reset(new int(0));
     auto createColorBuffer = [pres, entityParent] {
         Qt3DRender::QRenderTargetOutput *color = new Qt3DRender::QRenderTargetOutput(pres->scene2d);
         color->setAttachmentPoint(Qt3DRender::QRenderTargetOutput::Color0);
@@ -957,9 +1230,11 @@ bool Q3DSEngine::loadSubQmlPresentation(QmlPresentation *pres)
 
         pres->scene2d = new Qt3DRender::Quick::QScene2D(entityParent);
         pres->scene2d->setOutput(createColorBuffer());
+        pres->subPres.scene2d = pres->scene2d;
 
         ensureItemSize(item);
         pres->scene2d->setItem(item);
+        trackQmlSubPresentationChanges(item, pres->subPres.qmlContentChangeCount);
 
         pres->subPres.colorTex->setWidth(int(item->width()));
         pres->subPres.colorTex->setHeight(int(item->height()));
@@ -969,6 +1244,7 @@ bool Q3DSEngine::loadSubQmlPresentation(QmlPresentation *pres)
         /* Must create these already here in order to link the texture to wherever it is used */
         pres->scene2d = new Qt3DRender::Quick::QScene2D(entityParent);
         pres->scene2d->setOutput(createColorBuffer());
+        pres->subPres.scene2d = pres->scene2d;
 
         pres->subPres.colorTex->setWidth(128);
         pres->subPres.colorTex->setHeight(128);
@@ -980,6 +1256,7 @@ bool Q3DSEngine::loadSubQmlPresentation(QmlPresentation *pres)
                 if (item) {
                     ensureItemSize(item);
                     pres->scene2d->setItem(item);
+                    trackQmlSubPresentationChanges(item, pres->subPres.qmlContentChangeCount);
                     pres->subPres.colorTex->setWidth(int(item->width()));
                     pres->subPres.colorTex->setHeight(int(item->height()));
                 } else {
@@ -1011,10 +1288,19 @@ bool Q3DSEngine::parseUipDocument(UipPresentation *pres)
     }
 
     Q3DSUipParser parser;
-    if (!pres->uipDocument->source().isEmpty())
-        pres->presentation = parser.parse(pres->uipDocument->source(), pres->uipDocument->id());
-    else if (!pres->uipDocument->sourceData().isEmpty())
+    if (!pres->uipDocument->source().isEmpty()) {
+        // Keep the document so that reload() can tell what changed.
+        QFile f(pres->uipDocument->source());
+        if (f.open(QIODevice::ReadOnly)) {
+            pres->sourceData = f.readAll();
+            pres->presentation = parser.parseData(pres->sourceData, pres->uipDocument->id(),
+                                                  pres->uipDocument->source());
+        } else {
+            pres->presentation = parser.parse(pres->uipDocument->source(), pres->uipDocument->id());
+        }
+    } else if (!pres->uipDocument->sourceData().isEmpty()) {
         pres->presentation = parser.parseData(pres->uipDocument->sourceData(), pres->uipDocument->id());
+    }
 
     // Expose the data input metadata to the presentation.
     if (pres->presentation)
@@ -1110,6 +1396,9 @@ void Q3DSEngine::destroy()
 
 void Q3DSEngine::prepareForReload()
 {
+    m_uiaFileName.clear();
+    m_uiaLastModified = QDateTime();
+
     for (const auto &h : m_behaviorHandles)
         destroyBehaviorHandle(h);
     m_behaviorHandles.clear();
@@ -1120,7 +1409,7 @@ void Q3DSEngine::prepareForReload()
                 pres.sceneManager->prepareEngineReset();
         }
 
-        Q3DSSceneManager::prepareEngineResetGlobal();
+        m_shaderPrograms->clear(); // per engine, see shaderProgramCache()
         Qt3DCore::QAspectEnginePrivate::get(m_aspectEngine.data())->exitSimulationLoop();
         createAspectEngine();
 
@@ -1130,8 +1419,6 @@ void Q3DSEngine::prepareForReload()
         for (QmlPresentation &pres : m_qmlPresentations)
             delete pres.qmlDocument;
         m_qmlPresentations.clear();
-    } else {
-        Q3DSSceneManager::prepareEngineResetGlobal();
     }
 }
 
@@ -1211,6 +1498,11 @@ void Q3DSEngine::setViewportSettings(Q3DSViewportSettings *viewportSettings)
             m_uipPresentations[0].sceneManager->setMatteColor(m_viewportSettings->matteColor());
         }
     });
+    // the image manager is global, the most recently set value wins
+    Q3DSImageManager::instance().setTextureMemoryBudget(m_viewportSettings->textureMemoryBudget());
+    connect(m_viewportSettings, &Q3DSViewportSettings::textureMemoryBudgetChanged, [this] {
+        Q3DSImageManager::instance().setTextureMemoryBudget(m_viewportSettings->textureMemoryBudget());
+    });
 }
 
 void Q3DSEngine::setOnDemandRendering(bool enabled)
@@ -1218,10 +1510,153 @@ void Q3DSEngine::setOnDemandRendering(bool enabled)
     if (m_onDemandRendering == enabled)
         return;
     m_onDemandRendering = enabled;
-    m_uipPresentations[0].q3dscene.renderSettings->setRenderPolicy(enabled ?
+    applyRenderPolicy();
+}
+
+void Q3DSEngine::setAutoIdleRendering(bool enabled)
+{
+    if (m_autoIdleRendering == enabled)
+        return;
+    m_autoIdleRendering = enabled;
+    applyRenderPolicy();
+}
+
+void Q3DSEngine::applyRenderPolicy()
+{
+    if (m_uipPresentations.isEmpty() || !m_uipPresentations[0].q3dscene.renderSettings)
+        return;
+
+    const bool onDemand = m_onDemandRendering || (m_autoIdleRendering && m_idle);
+    m_uipPresentations[0].q3dscene.renderSettings->setRenderPolicy(onDemand ?
         Qt3DRender::QRenderSettings::OnDemand : Qt3DRender::QRenderSettings::Always);
 }
 
+// Called once per frame from the main presentation's frame action, after its
+// scenemanager has processed the frame (subpresentations are looked at as of
+// their last frame action). The frame actions keep ticking with the OnDemand
+// policy too (only frame submission is skipped when there are no changes) so
+// this is also what notices that the presentation needs to be rendered
+// continuously again.
+void Q3DSEngine::updateIdleState()
+{
+    // Require a few idle frames in a row so that layer caching, progressive AA
+    // and friends get to settle before suspending.
+    static const int IDLE_FRAME_THRESHOLD = 8;
+
+    // Suspended subpresentations are not shown anywhere, whatever they do
+    // does not need a new frame.
+    bool frameIdle = !isProfileUiVisible();
+    for (const UipPresentation &pres : qAsConst(m_uipPresentations)) {
+        if (pres.sceneManager && !pres.sceneManager->isSuspended() && !pres.sceneManager->isIdle())
+            frameIdle = false;
+    }
+
+    qint64 qmlContentChanges = 0;
+    for (const QmlPresentation &pres : qAsConst(m_qmlPresentations)) {
+        if (pres.subPres.qmlContentChangeCount)
+            qmlContentChanges += *pres.subPres.qmlContentChangeCount;
+    }
+    if (qmlContentChanges != m_lastQmlContentChanges) {
+        m_lastQmlContentChanges = qmlContentChanges;
+        frameIdle = false;
+    }
+
+    if (!frameIdle) {
+        leaveIdleState();
+        return;
+    }
+
+    if (++m_idleFrameCount >= IDLE_FRAME_THRESHOLD)
+        setIdle(true);
+}
+
+void Q3DSEngine::leaveIdleState()
+{
+    m_idleFrameCount = 0;
+    setIdle(false);
+}
+
+void Q3DSEngine::setQualityGovernorEnabled(bool enabled)
+{
+    if (m_qualityGovernorEnabled == enabled)
+        return;
+
+    m_qualityGovernorEnabled = enabled;
+    qCDebug(lcPerf, "Quality governor enabled = %d, target frame time %.2f ms",
+            enabled, m_qualityGovernor.targetFrameTime());
+    if (!enabled)
+        setQualityLevel(0);
+}
+
+void Q3DSEngine::setTargetFrameTime(float ms)
+{
+    m_qualityGovernor.setTargetFrameTime(ms);
+}
+
+void Q3DSEngine::setQualityLevel(int level)
+{
+    const int oldLevel = m_qualityGovernor.level();
+    m_qualityGovernor.setLevel(level);
+    if (m_qualityGovernor.level() != oldLevel) {
+        applyQuality();
+        emit qualityLevelChanged(m_qualityGovernor.level());
+    }
+}
+
+void Q3DSEngine::injectFrameTime(float ms)
+{
+    m_frameTimesInjected = true;
+    if (m_qualityGovernorEnabled)
+        addFrameTime(ms);
+}
+
+// The frame actions tick with the OnDemand policy too, those deltas say
+// nothing about the rendering cost. Neither does the first one after
+// continuous rendering resumes.
+void Q3DSEngine::sampleFrameTime(float ms)
+{
+    if (m_onDemandRendering || (m_autoIdleRendering && m_idle)) {
+        m_skipFrameTime = true;
+        return;
+    }
+    if (m_skipFrameTime) {
+        m_skipFrameTime = false;
+        return;
+    }
+    addFrameTime(ms);
+}
+
+void Q3DSEngine::addFrameTime(float ms)
+{
+    if (m_qualityGovernor.addFrameTime(ms)) {
+        qCDebug(lcPerf, "Frame time budget: switching to quality level %d", m_qualityGovernor.level());
+        applyQuality();
+        emit qualityLevelChanged(m_qualityGovernor.level());
+    }
+}
+
+void Q3DSEngine::applyQuality()
+{
+    const Q3DSQualityGovernor::Quality quality = m_qualityGovernor.quality();
+    for (const UipPresentation &pres : qAsConst(m_uipPresentations)) {
+        if (pres.sceneManager)
+            pres.sceneManager->setQuality(quality);
+    }
+}
+
+void Q3DSEngine::setIdle(bool idle)
+{
+    if (m_idle == idle)
+        return;
+
+    m_idle = idle;
+    qCDebug(lcPerf, "Presentation became %s", idle ? "idle" : "active");
+    // frame times from before and after are not comparable
+    m_qualityGovernor.restartWindow();
+    applyRenderPolicy();
+    emit idleChanged(idle);
+}
+
 QSize Q3DSEngine::implicitSize() const
 {
     return m_implicitSize;
@@ -1251,6 +1686,7 @@ bool Q3DSEngine::start()
 
 void Q3DSEngine::resize(const QSize &size, qreal dpr, bool forceSynchronous)
 {
+    leaveIdleState();
     m_size = size;
     m_dpr = dpr;
     if (!isProfileUiVisible())
@@ -1277,6 +1713,7 @@ bool Q3DSEngine::isProfileUiVisible() const
 
 void Q3DSEngine::handleKeyPressEvent(QKeyEvent *e)
 {
+    leaveIdleState();
     bool forwardEvent = isProfileUiVisible();
 
     if (m_autoToggleProfileUi) {
@@ -1322,12 +1759,14 @@ void Q3DSEngine::handleKeyPressEvent(QKeyEvent *e)
 
 void Q3DSEngine::handleKeyReleaseEvent(QKeyEvent *e)
 {
+    leaveIdleState();
     if (isProfileUiVisible())
         QCoreApplication::sendEvent(&m_profileUiEventSource, e);
 }
 
 void Q3DSEngine::handleMousePressEvent(QMouseEvent *e)
 {
+    leaveIdleState();
     if (isProfileUiVisible()) {
         QCoreApplication::sendEvent(&m_profileUiEventSource, e);
         return;
@@ -1342,6 +1781,7 @@ void Q3DSEngine::handleMousePressEvent(QMouseEvent *e)
 
 void Q3DSEngine::handleMouseMoveEvent(QMouseEvent *e)
 {
+    leaveIdleState();
     if (isProfileUiVisible()) {
         QCoreApplication::sendEvent(&m_profileUiEventSource, e);
         return;
@@ -1356,6 +1796,7 @@ void Q3DSEngine::handleMouseMoveEvent(QMouseEvent *e)
 
 void Q3DSEngine::handleMouseReleaseEvent(QMouseEvent *e)
 {
+    leaveIdleState();
     if (isProfileUiVisible()) {
         QCoreApplication::sendEvent(&m_profileUiEventSource, e);
         return;
@@ -1370,6 +1811,7 @@ void Q3DSEngine::handleMouseReleaseEvent(QMouseEvent *e)
 
 void Q3DSEngine::handleMouseDoubleClickEvent(QMouseEvent *e)
 {
+    leaveIdleState();
     if (isProfileUiVisible())
         QCoreApplication::sendEvent(&m_profileUiEventSource, e);
 
@@ -1400,6 +1842,7 @@ void Q3DSEngine::handleMouseDoubleClickEvent(QMouseEvent *e)
 #if QT_CONFIG(wheelevent)
 void Q3DSEngine::handleWheelEvent(QWheelEvent *e)
 {
+    leaveIdleState();
     if (isProfileUiVisible())
         QCoreApplication::sendEvent(&m_profileUiEventSource, e);
 }
@@ -1453,6 +1896,7 @@ void Q3DSEngine::configureProfileUi(float scale)
 
 void Q3DSEngine::setDataInputValue(const QString &name, const QVariant &value)
 {
+    leaveIdleState();
     for (const UipPresentation &pres : qAsConst(m_uipPresentations)) {
         if (pres.sceneManager)
             pres.sceneManager->setDataInputValue(name, value);
@@ -1461,6 +1905,7 @@ void Q3DSEngine::setDataInputValue(const QString &name, const QVariant &value)
 
 void Q3DSEngine::fireEvent(Q3DSGraphObject *target, Q3DSUipPresentation *presentation, const QString &event)
 {
+    leaveIdleState();
     for (const UipPresentation &pres : qAsConst(m_uipPresentations)) {
         if (pres.presentation == presentation) {
             if (pres.sceneManager)
@@ -1472,6 +1917,7 @@ void Q3DSEngine::fireEvent(Q3DSGraphObject *target, Q3DSUipPresentation *present
 
 void Q3DSEngine::goToTime(Q3DSGraphObject *context, Q3DSUipPresentation *presentation, float milliseconds)
 {
+    leaveIdleState();
     for (const UipPresentation &pres : qAsConst(m_uipPresentations)) {
         if (pres.presentation == presentation) {
             if (pres.sceneManager)
@@ -1483,6 +1929,7 @@ void Q3DSEngine::goToTime(Q3DSGraphObject *context, Q3DSUipPresentation *present
 
 void Q3DSEngine::goToSlideByName(Q3DSGraphObject *context, Q3DSUipPresentation *presentation, const QString &name)
 {
+    leaveIdleState();
     for (const UipPresentation &pres : qAsConst(m_uipPresentations)) {
         if (pres.presentation == presentation) {
             if (pres.sceneManager)
@@ -1494,6 +1941,7 @@ void Q3DSEngine::goToSlideByName(Q3DSGraphObject *context, Q3DSUipPresentation *
 
 void Q3DSEngine::goToSlideByIndex(Q3DSGraphObject *context, Q3DSUipPresentation *presentation, int index)
 {
+    leaveIdleState();
     for (const UipPresentation &pres : qAsConst(m_uipPresentations)) {
         if (pres.presentation == presentation) {
             if (pres.sceneManager)
@@ -1505,6 +1953,7 @@ void Q3DSEngine::goToSlideByIndex(Q3DSGraphObject *context, Q3DSUipPresentation
 
 void Q3DSEngine::goToSlideByDirection(Q3DSGraphObject *context, Q3DSUipPresentation *presentation, bool next, bool wrap)
 {
+    leaveIdleState();
     for (const UipPresentation &pres : qAsConst(m_uipPresentations)) {
         if (pres.presentation == presentation) {
             if (pres.sceneManager)
@@ -1647,16 +2096,61 @@ void Q3DSEngine::loadBehaviors()
     }
 }
 
-void Q3DSBehaviorHandle::updateProperties() const
-{
-    // Push all custom property values from the behavior instance to the
-    // QObject (and so to QML).
-    const QVariantMap props = behaviorInstance->dynamicProperties();
-    for (auto it = props.cbegin(), itEnd = props.cend(); it != itEnd; ++it) {
-        const QByteArray name = it.key().toUtf8();
-        const QVariant value = it.value();
-        object->setProperty(name.constData(), value);
+void Q3DSBehaviorHandle::updateProperties()
+{
+    // Push the custom property values from the behavior instance to the
+    // QObject (and so to QML). This runs every frame for every behavior.
+    // Writing the same value again would still trigger binding evaluation on
+    // the QML side, so a value is written only when the instance's value
+    // changed or when the object no longer holds what was pushed last, for
+    // example because the behavior assigned to its own property. The latter
+    // gets overwritten on the next frame, like when all values were written
+    // every frame.
+    const quint32 generation = behaviorInstance->dynamicPropertiesGeneration();
+    const bool instanceChanged = !propertiesPushed || generation != pushedGeneration;
+    QVector<QVariant> values = pushedValues;
+
+    if (instanceChanged) {
+        const QVector<QByteArray> names = behaviorInstance->dynamicPropertyNames();
+        values = behaviorInstance->dynamicPropertyValues();
+        // cheap when the names have not changed since the vectors are shared
+        if (!propertiesPushed || names != propertyNames) {
+            propertyNames = names;
+            metaProperties.clear();
+            metaProperties.reserve(names.count());
+            const QMetaObject *mo = object->metaObject();
+            for (const QByteArray &name : names) {
+                const int idx = mo->indexOfProperty(name.constData());
+                metaProperties.append(idx >= 0 ? mo->property(idx) : QMetaProperty());
+            }
+            pushedValues.clear();
+            objectValues.clear();
+        }
+        values.resize(qMin(names.count(), values.count()));
     }
+
+    auto readValue = [this](int i) {
+        const QMetaProperty &prop(metaProperties.at(i));
+        return prop.isValid() ? prop.read(object) : object->property(propertyNames.at(i).constData());
+    };
+
+    objectValues.resize(values.count());
+    for (int i = 0; i < values.count(); ++i) {
+        const QVariant &value(values.at(i));
+        if (i < pushedValues.count() && pushedValues.at(i) == value && readValue(i) == objectValues.at(i))
+            continue;
+        const QMetaProperty &prop(metaProperties.at(i));
+        if (prop.isValid())
+            prop.write(object, value);
+        else
+            object->setProperty(propertyNames.at(i).constData(), value); // becomes a dynamic QObject property
+        // what the object made of it, the type may differ from the value's
+        objectValues[i] = readValue(i);
+    }
+
+    pushedValues = values;
+    pushedGeneration = generation;
+    propertiesPushed = true;
 }
 
 void Q3DSEngine::behaviorFrameUpdate(float dt)
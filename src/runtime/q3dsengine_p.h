@@ -43,6 +43,7 @@
 
 #include <QObject>
 #include <QElapsedTimer>
+#include <QDateTime>
 #include <QSurfaceFormat>
 #include <Qt3DCore/QAspectEngine>
 #include "q3dsuipdocument_p.h"
@@ -62,6 +63,7 @@ class QQmlEngine;
 class QQmlComponent;
 class Q3DSInlineQmlSubPresentation;
 class Q3DSViewportSettings;
+class Q3DSShaderProgramCache;
 
 namespace Qt3DRender {
 class QRenderCapture;
@@ -80,7 +82,18 @@ struct Q3DSV_PRIVATE_EXPORT Q3DSBehaviorHandle
     bool initialized = false;
     bool active = false;
 
-    void updateProperties() const;
+    // What updateProperties() last pushed to the object, and what the object
+    // held right after that. The meta properties are resolved once per set of
+    // dynamic property names; an invalid entry means the QML object does not
+    // declare that property.
+    QVector<QByteArray> propertyNames;
+    QVector<QMetaProperty> metaProperties;
+    QVector<QVariant> pushedValues;
+    QVector<QVariant> objectValues;
+    quint32 pushedGeneration = 0;
+    bool propertiesPushed = false;
+
+    void updateProperties();
 };
 
 class Q3DSV_PRIVATE_EXPORT Q3DSEngine : public QObject
@@ -112,6 +125,10 @@ public:
                    QString *error = nullptr,
                    const InlineSubPresList &inlineQmlSubPresentations = InlineSubPresList());
     QString source() const;
+    // Load the current source again. Applies the changes to the existing
+    // scene when possible, falls back to setSource() otherwise. changedFiles
+    // can list files known to be modified regardless of their timestamps.
+    bool reload(const QStringList &changedFiles = QStringList(), QString *error = nullptr);
 
     // Load presentation from a uip document object.
     bool setDocument(const Q3DSUipDocument &uipDocument, QString *error = nullptr);
@@ -135,12 +152,32 @@ public:
 
     Qt3DCore::QAspectEngine *aspectEngine() const;
     Qt3DCore::QEntity *rootEntity() const;
+    // The shader program nodes of this engine, for all its presentations.
+    Q3DSShaderProgramCache *shaderProgramCache() const { return m_shaderPrograms.data(); }
 
     Q3DSViewportSettings *viewportSettings() const;
     void setViewportSettings(Q3DSViewportSettings *viewportSettings);
 
     void setOnDemandRendering(bool enabled);
 
+    // When enabled, switches to on-demand rendering while the presentation is
+    // idle and back to continuous rendering as soon as something changes.
+    void setAutoIdleRendering(bool enabled);
+    bool autoIdleRendering() const { return m_autoIdleRendering; }
+    bool isIdle() const { return m_idle; }
+
+    // Lowers and raises the quality (layer render scale, progressive AA
+    // passes, shadow map resolution) based on the frame time.
+    void setQualityGovernorEnabled(bool enabled);
+    bool isQualityGovernorEnabled() const { return m_qualityGovernorEnabled; }
+    void setTargetFrameTime(float ms);
+    float targetFrameTime() const { return m_qualityGovernor.targetFrameTime(); }
+    int qualityLevel() const { return m_qualityGovernor.level(); }
+    void setQualityLevel(int level);
+    // Feeds a frame time to the governor instead of the measured ones. Once
+    // called, measured frame times are ignored. Meant for testing.
+    void injectFrameTime(float ms);
+
     QSize implicitSize() const;
 
     void setSurface(QObject *surface);
@@ -207,6 +244,8 @@ Q_SIGNALS:
     void customSignalEmitted(Q3DSGraphObject *obj, const QString &name);
     void slideEntered(Q3DSGraphObject *context, int index, const QString &name);
     void slideExited(Q3DSGraphObject *context, int index, const QString &name);
+    void idleChanged(bool idle);
+    void qualityLevelChanged(int level);
 
 private:
     Q_DISABLE_COPY(Q3DSEngine)
@@ -220,6 +259,7 @@ private:
         Q3DSSceneManager::Scene q3dscene;
         Q3DSSceneManager *sceneManager = nullptr;
         Q3DSUipPresentation *presentation = nullptr;
+        QByteArray sourceData; // contents of the .uip file the presentation was parsed from
     };
 
     struct QmlPresentation : Presentation {
@@ -245,10 +285,18 @@ private:
 
     void destroy();
     void prepareForReload();
+    bool reloadIncrementally(const QStringList &changedFiles);
 
     void loadBehaviors();
     void destroyBehaviorHandle(const Q3DSBehaviorHandle &h);
     void behaviorFrameUpdate(float dt);
+    void updateIdleState();
+    void setIdle(bool idle);
+    void leaveIdleState();
+    void applyRenderPolicy();
+    void sampleFrameTime(float ms);
+    void addFrameTime(float ms);
+    void applyQuality();
     QRect calculateViewport(const QSize &surfaceSize, const QSize &presentationSize) const;
 
     QObject *m_surface = nullptr;
@@ -257,6 +305,8 @@ private:
     qreal m_dpr = 1;
     Flags m_flags;
     QString m_source; // uip or uia file
+    QString m_uiaFileName;
+    QDateTime m_uiaLastModified;
     QVector<UipPresentation> m_uipPresentations;
     QVector<QmlPresentation> m_qmlPresentations;
     QVector<Q3DSInlineQmlSubPresentation *> m_inlineQmlPresentations;
@@ -265,6 +315,7 @@ private:
     QQmlEngine *m_qmlSubPresentationEngine = nullptr;
     bool m_ownsQmlSubPresentationEngine = false;
     QScopedPointer<Qt3DCore::QAspectEngine> m_aspectEngine;
+    QScopedPointer<Q3DSShaderProgramCache> m_shaderPrograms;
 
     qint64 m_loadTime = 0;
     qint64 m_behaviorLoadTime = 0;
@@ -274,6 +325,7 @@ private:
 
     Qt3DRender::QRenderCapture *m_capture = nullptr;
     QHash<Qt3DRender::QRenderCaptureReply*, QMetaObject::Connection> m_captureConnections;
+    QMetaObject::Connection m_frameActionConnection;
 
     QObject m_profileUiEventSource;
     bool m_autoStart = true;
@@ -285,6 +337,14 @@ private:
     BehaviorMap m_behaviorHandles;
 
     bool m_onDemandRendering = false;
+    bool m_autoIdleRendering = false;
+    bool m_idle = false;
+    int m_idleFrameCount = 0;
+    qint64 m_lastQmlContentChanges = 0;
+    Q3DSQualityGovernor m_qualityGovernor;
+    bool m_qualityGovernorEnabled = false;
+    bool m_frameTimesInjected = false;
+    bool m_skipFrameTime = false;
     Q3DSViewportSettings *m_viewportSettings = nullptr;
 };
 
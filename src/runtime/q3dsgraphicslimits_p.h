@@ -68,6 +68,9 @@ Q_DECLARE_TYPEINFO(Q3DSGraphicsLimits, Q_MOVABLE_TYPE);
 
 namespace Q3DS {
 Q3DSV_PRIVATE_EXPORT Q3DSGraphicsLimits graphicsLimits();
+// Overrides the limits without querying an OpenGL context. Only for tools that
+// generate shaders offline, for a given target.
+Q3DSV_PRIVATE_EXPORT void setGraphicsLimits(const Q3DSGraphicsLimits &limits);
 }
 
 QT_END_NAMESPACE
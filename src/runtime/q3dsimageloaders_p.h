@@ -42,16 +42,91 @@
 //
 
 #include <QIODevice>
+#include <QVector>
 #include <Qt3DRender/QTextureImageData>
 #include <Qt3DRender/QAbstractTextureImage>
 #include <qmath.h>
 #include <qendian.h>
+#include <cstring>
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
 
 QT_BEGIN_NAMESPACE
 
+// Round to nearest even, handles denormals, infinities and NaNs.
+inline quint16 q3ds_floatToHalf(float f)
+{
+    quint32 x;
+    memcpy(&x, &f, 4);
+    const quint32 sign = (x >> 16) & 0x8000;
+    x &= 0x7fffffff;
+    if (x >= 0x47800000) // too large, inf or nan
+        return quint16(sign | (x > 0x7f800000 ? 0x7e00 : 0x7c00));
+    if (x < 0x38800000) { // denormal (or zero) as half
+        if (x < 0x33000000)
+            return quint16(sign);
+        const quint32 e = x >> 23;
+        const quint32 m = (x & 0x7fffff) | 0x800000;
+        const quint32 shift = 126 - e;
+        return quint16(sign | ((m + (1 << (shift - 1)) - 1 + ((m >> shift) & 1)) >> shift));
+    }
+    return quint16(sign | ((x - 0x38000000 + 0xfff + ((x >> 13) & 1)) >> 13));
+}
+
+inline void q3ds_floatToHalf(const float *src, quint16 *dst, int count)
+{
+    int i = 0;
+#if defined(__F16C__)
+    for (; i + 4 <= count; i += 4) {
+        const __m128i h = _mm_cvtps_ph(_mm_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), h);
+    }
+#endif
+    for (; i < count; ++i)
+        dst[i] = q3ds_floatToHalf(src[i]);
+}
+
+// Shared exponent packing as per EXT_texture_shared_exponent.
+inline quint32 q3ds_floatToRgb9e5(float r, float g, float b)
+{
+    const int N = 9; // mantissa bits
+    const int B = 15; // exponent bias
+    const float maxValue = float(511.0 / 512.0 * 65536.0);
+    r = qBound(0.0f, r, maxValue);
+    g = qBound(0.0f, g, maxValue);
+    b = qBound(0.0f, b, maxValue);
+    const float maxRgb = qMax(r, qMax(g, b));
+    if (maxRgb <= 0.0f)
+        return 0;
+    int e = 0;
+    frexpf(maxRgb, &e); // maxRgb = f * 2^e, 0.5 <= f < 1, so floor(log2(maxRgb)) = e - 1
+    int expShared = qMax(-B - 1, e - 1) + 1 + B;
+    float scale = ldexpf(1.0f, expShared - B - N);
+    if (int(maxRgb / scale + 0.5f) == (1 << N)) {
+        ++expShared;
+        scale *= 2.0f;
+    }
+    const quint32 rs = quint32(r / scale + 0.5f);
+    const quint32 gs = quint32(g / scale + 0.5f);
+    const quint32 bs = quint32(b / scale + 0.5f);
+    return rs | (gs << 9) | (bs << 18) | (quint32(expShared) << 27);
+}
+
+inline void q3ds_rgb9e5ToFloat(quint32 v, float *rgb)
+{
+    const float scale = ldexpf(1.0f, int(v >> 27) - 15 - 9);
+    rgb[0] = float(v & 0x1ff) * scale;
+    rgb[1] = float((v >> 9) & 0x1ff) * scale;
+    rgb[2] = float((v >> 18) & 0x1ff) * scale;
+}
+
 // These should ideally be shared via QtGui. For now just have them here.
 
-inline Qt3DRender::QTextureImageDataPtr q3ds_loadHdr(QIODevice *source)
+// textureFormat can be RGBA32F (the default), RGBA16F or RGB9E5. The latter
+// two use a half and a quarter of the memory, respectively.
+inline Qt3DRender::QTextureImageDataPtr q3ds_loadHdr(QIODevice *source,
+                                                     QOpenGLTexture::TextureFormat textureFormat = QOpenGLTexture::RGBA32F)
 {
     Qt3DRender::QTextureImageDataPtr imageData;
     char sig[256];
@@ -110,15 +185,30 @@ inline Qt3DRender::QTextureImageDataPtr q3ds_loadHdr(QIODevice *source)
         return imageData;
     }
 
-    const QOpenGLTexture::TextureFormat textureFormat = QOpenGLTexture::RGBA32F;
-    const QOpenGLTexture::PixelFormat pixelFormat = QOpenGLTexture::RGBA;
-    const QOpenGLTexture::PixelType pixelType = QOpenGLTexture::Float32;
-    const int blockSize = 4 * sizeof(float);
+    QOpenGLTexture::PixelFormat pixelFormat = QOpenGLTexture::RGBA;
+    QOpenGLTexture::PixelType pixelType = QOpenGLTexture::Float32;
+    int blockSize = 4 * sizeof(float);
+    switch (textureFormat) {
+    case QOpenGLTexture::RGBA16F:
+        pixelType = QOpenGLTexture::Float16;
+        blockSize = 4 * sizeof(quint16);
+        break;
+    case QOpenGLTexture::RGB9E5:
+        pixelFormat = QOpenGLTexture::RGB;
+        pixelType = QOpenGLTexture::UInt32_RGB9_E5;
+        blockSize = sizeof(quint32);
+        break;
+    default:
+        textureFormat = QOpenGLTexture::RGBA32F;
+        break;
+    }
     QByteArray data;
     data.resize(w * h * blockSize);
 
     typedef unsigned char RGBE[4];
     RGBE *scanline = new RGBE[w];
+    // one row of RGBA32F, converted to the final format afterwards
+    QVector<float> floatRow(textureFormat == QOpenGLTexture::RGBA32F ? 0 : w * 4);
 
     for (int y = 0; y < h; ++y) {
         if (pEnd - p < 4) {
@@ -176,7 +266,8 @@ inline Qt3DRender::QTextureImageDataPtr q3ds_loadHdr(QIODevice *source)
         }
 
         // adjust for -Y orientation
-        float *fp = reinterpret_cast<float *>(data.data() + (h - 1 - y) * blockSize * w);
+        char *dst = data.data() + (h - 1 - y) * blockSize * w;
+        float *fp = floatRow.isEmpty() ? reinterpret_cast<float *>(dst) : floatRow.data();
         for (int x = 0; x < w; ++x) {
             float d = qPow(2.0f, float(scanline[x][3]) - 128.0f);
             // r, g, b, a
@@ -185,6 +276,20 @@ inline Qt3DRender::QTextureImageDataPtr q3ds_loadHdr(QIODevice *source)
             *fp++ = scanline[x][2] / 256.0f * d;
             *fp++ = 1.0f;
         }
+
+        if (textureFormat == QOpenGLTexture::RGBA16F) {
+            // RGBE goes far beyond half float range, saturate to the largest
+            // finite half instead of turning bright texels into infinity
+            const float maxHalf = 65504.0f;
+            for (float &f : floatRow)
+                f = qMin(f, maxHalf);
+            q3ds_floatToHalf(floatRow.constData(), reinterpret_cast<quint16 *>(dst), w * 4);
+        } else if (textureFormat == QOpenGLTexture::RGB9E5) {
+            const float *src = floatRow.constData();
+            quint32 *dst32 = reinterpret_cast<quint32 *>(dst);
+            for (int x = 0; x < w; ++x, src += 4)
+                *dst32++ = q3ds_floatToRgb9e5(src[0], src[1], src[2]);
+        }
     }
 
     delete[] scanline;
@@ -920,12 +1025,13 @@ inline QVector<Qt3DRender::QTextureImageDataPtr> q3ds_loadKtx(QIODevice *source)
     const int level0Height = decode(header.pixelHeight);
     int faceCount = decode(header.numberOfFaces);
     const int mipMapLevels = decode(header.numberOfMipmapLevels);
-    auto createImageData = [=](const QByteArray &compressedData) {
+    auto createImageData = [=](const QByteArray &compressedData, int mip) {
         Qt3DRender::QTextureImageDataPtr imageData = Qt3DRender::QTextureImageDataPtr::create();
         imageData->setTarget(faceCount == 6 ? QOpenGLTexture::TargetCubeMap : QOpenGLTexture::Target2D);
         imageData->setFormat(QOpenGLTexture::TextureFormat(decode(header.glInternalFormat)));
-        imageData->setWidth(level0Width);
-        imageData->setHeight(level0Height);
+        // the size of this level, the top levels may get dropped later on
+        imageData->setWidth(qMax(1, level0Width >> mip));
+        imageData->setHeight(qMax(1, level0Height >> mip));
         imageData->setLayers(1);
         imageData->setDepth(1);
         // separate textureimage per face and per mipmap
@@ -947,7 +1053,7 @@ inline QVector<Qt3DRender::QTextureImageDataPtr> q3ds_loadKtx(QIODevice *source)
         int imageSize = *reinterpret_cast<const quint32 *>(p);
         p += 4;
         for (int face = 0; face < faceCount; ++face) {
-            result << createImageData(QByteArray(p, imageSize));
+            result << createImageData(QByteArray(p, imageSize), mip);
             p = basep + q3ds_alignedOffset(p + imageSize - basep, 4);
         }
     }
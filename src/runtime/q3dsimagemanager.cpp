@@ -33,26 +33,224 @@
 #include "q3dslogging_p.h"
 #include <qmath.h>
 #include <QFileInfo>
+#include <QSet>
 #include <QElapsedTimer>
 #include <QLoggingCategory>
+#include <algorithm>
 #include <Qt3DCore/QEntity>
 #include <Qt3DRender/QTextureImageDataGenerator>
 #include <Qt3DRender/QTexture>
 
 QT_BEGIN_NAMESPACE
 
+// Textures are not scaled down below this when trying to stay within the budget
+static const int MIN_BUDGETED_TEXTURE_SIZE = 64;
+
+static qint64 defaultTextureMemoryBudget()
+{
+    return qint64(qEnvironmentVariableIntValue("Q3DS_TEXTURE_BUDGET_MB")) * 1024 * 1024;
+}
+
+static qint64 imageDataBytes(const QVector<Qt3DRender::QTextureImageDataPtr> &imageData, int firstLevel = 0)
+{
+    qint64 bytes = 0;
+    for (int i = firstLevel; i < imageData.count(); ++i)
+        bytes += imageData[i]->data().size();
+    return bytes;
+}
+
+// Decoded data outlives the engines, so the cache is bounded unless asked
+// otherwise. Q3DS_IMAGE_CACHE_LIMIT_MB=0 disables the limit.
+static const int DEFAULT_IMAGE_CACHE_LIMIT_MB = 256;
+
+static qint64 defaultImageCacheLimit()
+{
+    bool ok = false;
+    int mb = qEnvironmentVariableIntValue("Q3DS_IMAGE_CACHE_LIMIT_MB", &ok);
+    if (!ok || mb < 0)
+        mb = DEFAULT_IMAGE_CACHE_LIMIT_MB;
+    return qint64(mb) * 1024 * 1024;
+}
+
+Q3DSImageManager::Q3DSImageManager()
+    : m_textureMemoryBudget(defaultTextureMemoryBudget()),
+      m_cacheLimit(defaultImageCacheLimit())
+{
+    const QByteArray hdrFormat = qgetenv("Q3DS_HDR_FORMAT").toLower();
+    if (hdrFormat == QByteArrayLiteral("rgba16f"))
+        m_hdrStorageFormat = HdrStorageFloat16;
+    else if (hdrFormat == QByteArrayLiteral("rgb9e5"))
+        m_hdrStorageFormat = HdrStorageRGB9E5;
+
+    const QByteArray lightProbeHdrFormat = qgetenv("Q3DS_LIGHTPROBE_HDR_FORMAT").toLower();
+    if (lightProbeHdrFormat == QByteArrayLiteral("rgba32f"))
+        setLightProbeHdrStorageFormat(HdrStorageFloat32);
+    else if (lightProbeHdrFormat == QByteArrayLiteral("rgba16f"))
+        setLightProbeHdrStorageFormat(HdrStorageFloat16);
+    else if (lightProbeHdrFormat == QByteArrayLiteral("rgb9e5"))
+        setLightProbeHdrStorageFormat(HdrStorageRGB9E5);
+}
+
 Q3DSImageManager &Q3DSImageManager::instance()
 {
     static Q3DSImageManager mgr;
     return mgr;
 }
 
+Q3DSImageManager::HdrStorageFormat Q3DSImageManager::hdrStorageFormat(ImageFlags flags) const
+{
+    if (flags.testFlag(HdrFloat32))
+        return HdrStorageFloat32;
+    if (flags.testFlag(HdrFloat16))
+        return HdrStorageFloat16;
+    if (flags.testFlag(HdrRGB9E5))
+        return HdrStorageRGB9E5;
+    return m_hdrStorageFormat;
+}
+
+void Q3DSImageManager::setLightProbeHdrStorageFormat(HdrStorageFormat format)
+{
+    static const ImageFlag formatFlags[] = { HdrFloat32, HdrFloat16, HdrRGB9E5 };
+    m_lightProbeFlags = GenerateMipMapsForIBL | formatFlags[format];
+}
+
 void Q3DSImageManager::invalidate()
 {
+    // The textures belong to the aspect engine that is going away. The decoded
+    // data does not, so keep it for the next engine (typically opening another
+    // presentation, which often shares images with the previous one). Entries
+    // for files that changed on disk in the meantime are reloaded on lookup.
     m_metadata.clear();
-    m_cache.clear();
+    for (CacheEntry &e : m_cache)
+        e.refCount = 0;
+    evictUnusedImages();
+
     m_ioTime = 0;
     m_iblTime = 0;
+    m_residentBytes = 0;
+    m_cacheHits = 0;
+    m_cacheMisses = 0;
+}
+
+void Q3DSImageManager::releaseTextures(Qt3DCore::QEntity *parent)
+{
+    // The textures belong to an aspect engine that is going away, while other
+    // engines may well be using the same images. Drop only the references
+    // held by this engine's textures, like their destruction would.
+    QStringList cacheKeys;
+    for (auto it = m_metadata.begin(); it != m_metadata.end(); ) {
+        if (it->parent == parent) {
+            m_residentBytes -= it->residentBytes;
+            cacheKeys.append(it->cacheKey);
+            it = m_metadata.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (const QString &cacheKey : qAsConst(cacheKeys))
+        releaseCacheRef(cacheKey);
+}
+
+void Q3DSImageManager::setTextureMemoryBudget(qint64 bytes)
+{
+    // Affects images loaded afterwards, existing textures are left as-is.
+    m_textureMemoryBudget = bytes >= 0 ? bytes : defaultTextureMemoryBudget();
+}
+
+void Q3DSImageManager::trackTextureDestruction(Qt3DRender::QAbstractTexture *tex)
+{
+    QObject::connect(tex, &QObject::destroyed, [this, tex] {
+        auto it = m_metadata.find(tex);
+        if (it == m_metadata.end()) // invalidated already
+            return;
+        m_residentBytes -= it->residentBytes;
+        const QString cacheKey = it->cacheKey;
+        m_metadata.erase(it);
+        releaseCacheRef(cacheKey);
+    });
+}
+
+void Q3DSImageManager::setImageCacheLimit(qint64 bytes)
+{
+    m_cacheLimit = qMax<qint64>(0, bytes);
+    evictUnusedImages();
+}
+
+void Q3DSImageManager::addCacheRef(const QString &cacheKey)
+{
+    auto it = m_cache.find(cacheKey);
+    if (it != m_cache.end())
+        ++it->refCount;
+}
+
+void Q3DSImageManager::releaseCacheRef(const QString &cacheKey)
+{
+    if (cacheKey.isEmpty())
+        return;
+    auto it = m_cache.find(cacheKey);
+    if (it != m_cache.end() && it->refCount > 0) {
+        --it->refCount;
+        if (!it->refCount)
+            evictUnusedImages();
+    }
+}
+
+int Q3DSImageManager::reloadModifiedImages(const QStringList &changedFiles)
+{
+    QSet<QString> staleKeys;
+    for (auto it = m_cache.cbegin(), itEnd = m_cache.cend(); it != itEnd; ++it) {
+        const QFileInfo fi(it->fileName);
+        if (fi.lastModified() != it->lastModified || changedFiles.contains(fi.absoluteFilePath()))
+            staleKeys.insert(it.key());
+    }
+    if (staleKeys.isEmpty())
+        return 0;
+
+    for (const QString &key : qAsConst(staleKeys)) {
+        qCDebug(lcScene, "Image %s changed on disk", qPrintable(key));
+        m_cacheBytes -= m_cache.take(key).bytes;
+    }
+
+    // Make setSource() load the data again. The textures' references to the
+    // old entries are gone with the entries themselves.
+    QVector<Qt3DRender::QAbstractTexture *> textures;
+    for (auto it = m_metadata.begin(), itEnd = m_metadata.end(); it != itEnd; ++it) {
+        if (staleKeys.contains(it->cacheKey)) {
+            it->cacheKey.clear();
+            textures.append(it.key());
+        }
+    }
+    for (Qt3DRender::QAbstractTexture *tex : qAsConst(textures)) {
+        auto it = m_metadata.find(tex);
+        const QUrl source = it->source;
+        it->source = QUrl();
+        setSource(tex, source);
+    }
+
+    return textures.count();
+}
+
+void Q3DSImageManager::evictUnusedImages(const QString &keepKey)
+{
+    if (m_cacheLimit <= 0 || m_cacheBytes <= m_cacheLimit)
+        return;
+
+    // Data referenced by a texture cannot be freed anyway since the texture
+    // images hold on to it, so only consider the unreferenced entries.
+    QVector<QPair<quint64, QString>> candidates;
+    for (auto it = m_cache.cbegin(), itEnd = m_cache.cend(); it != itEnd; ++it) {
+        if (!it->refCount && it.key() != keepKey)
+            candidates.append(qMakePair(it->lastUse, it.key()));
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (const auto &c : qAsConst(candidates)) {
+        if (m_cacheBytes <= m_cacheLimit)
+            break;
+        const CacheEntry e = m_cache.take(c.second);
+        m_cacheBytes -= e.bytes;
+        qCDebug(lcPerf, "Evicted image %s (%lld KB) from the image cache", qPrintable(c.second), e.bytes / 1024);
+    }
 }
 
 Qt3DRender::QAbstractTexture *Q3DSImageManager::newTextureForImage(Qt3DCore::QEntity *parent,
@@ -62,8 +260,10 @@ Qt3DRender::QAbstractTexture *Q3DSImageManager::newTextureForImage(Qt3DCore::QEn
     auto tex = new Qt3DRender::QTexture2D(parent);
 
     TextureInfo info;
+    info.parent = parent;
     info.flags = flags;
     m_metadata.insert(tex, info);
+    trackTextureDestruction(tex);
 
     if (profiler && profDesc) {
         va_list ap;
@@ -78,9 +278,9 @@ Qt3DRender::QAbstractTexture *Q3DSImageManager::newTextureForImage(Qt3DCore::QEn
 class Q3DSTextureImageDataGen : public Qt3DRender::QTextureImageDataGenerator
 {
 public:
-    Q3DSTextureImageDataGen(const QUrl &source, int mipLevel, const Qt3DRender::QTextureImageDataPtr &data)
+    Q3DSTextureImageDataGen(const QUrl &source, int sourceMipLevel, const Qt3DRender::QTextureImageDataPtr &data)
         : m_source(source),
-          m_mipLevel(mipLevel),
+          m_mipLevel(sourceMipLevel),
           m_data(data)
     { }
 
@@ -99,17 +299,17 @@ public:
 
 private:
     QUrl m_source;
-    int m_mipLevel;
+    int m_mipLevel; // level in the source, differs from the texture's when top levels are skipped
     Qt3DRender::QTextureImageDataPtr m_data;
 };
 
 class TextureImage : public Qt3DRender::QAbstractTextureImage
 {
 public:
-    TextureImage(const QUrl &source, int mipLevel, const Qt3DRender::QTextureImageDataPtr &data)
+    TextureImage(const QUrl &source, int mipLevel, const Qt3DRender::QTextureImageDataPtr &data, int skippedMipLevels = 0)
     {
         setMipLevel(mipLevel);
-        m_gen = QSharedPointer<Q3DSTextureImageDataGen>::create(source, mipLevel, data);
+        m_gen = QSharedPointer<Q3DSTextureImageDataGen>::create(source, mipLevel + skippedMipLevels, data);
     }
 
 private:
@@ -118,16 +318,40 @@ private:
     Qt3DRender::QTextureImageDataGeneratorPtr m_gen;
 };
 
-QVector<Qt3DRender::QTextureImageDataPtr> Q3DSImageManager::load(const QUrl &source, ImageFlags flags, bool *wasCached)
+QVector<Qt3DRender::QTextureImageDataPtr> Q3DSImageManager::load(const QUrl &source, ImageFlags flags,
+                                                                 bool *wasCached, QString *cacheKey)
 {
     const QString sourceStr = source.toLocalFile();
-    auto it = m_cache.constFind(sourceStr);
-    if (it != m_cache.constEnd()) {
+    const QString suffix = QFileInfo(sourceStr).suffix().toLower();
+    const bool isHdr = suffix == QStringLiteral("hdr");
+    const HdrStorageFormat hdrFormat = isHdr ? hdrStorageFormat(flags) : HdrStorageFloat32;
+
+    // the same file may be loaded with different, data altering flags
+    *cacheKey = sourceStr;
+    if (flags.testFlag(GenerateMipMapsForIBL))
+        *cacheKey += QLatin1String("#ibl");
+    if (hdrFormat != HdrStorageFloat32)
+        *cacheKey += hdrFormat == HdrStorageFloat16 ? QLatin1String("#rgba16f") : QLatin1String("#rgb9e5");
+
+    auto it = m_cache.find(*cacheKey);
+    if (it != m_cache.end() && !it->refCount && QFileInfo(it->fileName).lastModified() != it->lastModified) {
+        // An unused entry, possibly left from a previous engine, for a file
+        // that has changed since. Entries in use are handled by
+        // reloadModifiedImages() instead.
+        qCDebug(lcScene, "Image %s changed on disk", qPrintable(*cacheKey));
+        m_cacheBytes -= it->bytes;
+        m_cache.erase(it);
+        it = m_cache.end();
+    }
+    if (it != m_cache.end()) {
         *wasCached = true;
-        return *it;
+        it->lastUse = ++m_cacheUseCounter;
+        ++m_cacheHits;
+        return it->imageData;
     }
 
     *wasCached = false;
+    ++m_cacheMisses;
 
     QElapsedTimer t;
     t.start();
@@ -140,11 +364,15 @@ QVector<Qt3DRender::QTextureImageDataPtr> Q3DSImageManager::load(const QUrl &sou
     // the public API so are stuck with individual textureimages.
     QVector<Qt3DRender::QTextureImageDataPtr> result;
 
-    const QString suffix = QFileInfo(sourceStr).suffix().toLower();
-    if (suffix == QStringLiteral("hdr")) {
+    if (isHdr) {
         QFile f(sourceStr);
         if (f.open(QIODevice::ReadOnly)) {
-            Qt3DRender::QTextureImageDataPtr data = q3ds_loadHdr(&f);
+            QOpenGLTexture::TextureFormat format = QOpenGLTexture::RGBA32F;
+            if (hdrFormat == HdrStorageFloat16)
+                format = QOpenGLTexture::RGBA16F;
+            else if (hdrFormat == HdrStorageRGB9E5)
+                format = QOpenGLTexture::RGB9E5;
+            Qt3DRender::QTextureImageDataPtr data = q3ds_loadHdr(&f, format);
             result << data;
             f.close();
         }
@@ -234,7 +462,17 @@ QVector<Qt3DRender::QTextureImageDataPtr> Q3DSImageManager::load(const QUrl &sou
             qCDebug(lcPerf, "Generated %d IBL mip levels in %lld ms", maxMipLevel, t.elapsed());
         }
 
-        m_cache.insert(sourceStr, result);
+        CacheEntry e;
+        e.imageData = result;
+        e.bytes = imageDataBytes(result);
+        e.lastUse = ++m_cacheUseCounter;
+        e.fileName = sourceStr;
+        e.lastModified = QFileInfo(sourceStr).lastModified();
+        m_cache.insert(*cacheKey, e);
+        m_cacheBytes += e.bytes;
+        // The new entry gets its reference only in setSource(), do not let
+        // it be the first one to go.
+        evictUnusedImages(*cacheKey);
     } else {
         qCDebug(lcScene, "Failed to load image");
     }
@@ -242,6 +480,97 @@ QVector<Qt3DRender::QTextureImageDataPtr> Q3DSImageManager::load(const QUrl &sou
     return result;
 }
 
+static bool canDownscale(QOpenGLTexture::TextureFormat format)
+{
+    // only 8 bit RGBA (i.e. everything that comes from QImage) is downscaled
+    // on the CPU. Its rows are tightly packed, whereas 3 byte formats may come
+    // with padded rows (e.g. from .dds). Compressed and floating point data is
+    // left alone unless it comes with its own mip chain.
+    switch (format) {
+    case QOpenGLTexture::RGBA8_UNorm:
+    case QOpenGLTexture::SRGB8_Alpha8:
+        return true;
+    default:
+        break;
+    }
+    return false;
+}
+
+static Qt3DRender::QTextureImageDataPtr downscaledImageData(const Qt3DRender::QTextureImageDataPtr &src, int levels)
+{
+    Q_ASSERT(canDownscale(src->format()));
+    const int bpp = 4;
+    QByteArray prevData = src->data();
+    int w = src->width();
+    int h = src->height();
+    for (int level = 0; level < levels; ++level) {
+        const int prevW = w;
+        w = qMax(1, w >> 1);
+        h = qMax(1, h >> 1);
+        QByteArray data(w * h * bpp, Qt::Uninitialized);
+        const uchar *s = reinterpret_cast<const uchar *>(prevData.constData());
+        uchar *d = reinterpret_cast<uchar *>(data.data());
+        // 2x2 box filter
+        for (int y = 0; y < h; ++y) {
+            const uchar *row0 = s + (2 * y) * prevW * bpp;
+            const uchar *row1 = row0 + prevW * bpp;
+            for (int x = 0; x < w; ++x) {
+                for (int c = 0; c < bpp; ++c) {
+                    const int o = 2 * x * bpp + c;
+                    *d++ = uchar((row0[o] + row0[o + bpp] + row1[o] + row1[o + bpp] + 2) / 4);
+                }
+            }
+        }
+        prevData = data;
+    }
+
+    auto result = Qt3DRender::QTextureImageDataPtr::create();
+    result->setTarget(QOpenGLTexture::Target2D);
+    result->setFormat(src->format());
+    result->setWidth(w);
+    result->setHeight(h);
+    result->setLayers(1);
+    result->setDepth(1);
+    result->setFaces(1);
+    result->setMipLevels(1);
+    result->setPixelFormat(src->pixelFormat());
+    result->setPixelType(src->pixelType());
+    result->setData(prevData, bpp, false);
+    return result;
+}
+
+// Returns how many of the top mip levels to drop in order to stay within the
+// texture memory budget. bytesToReplace is what the texture uses currently
+// (if any), since that is going to be released.
+int Q3DSImageManager::mipLevelsToSkip(const QVector<Qt3DRender::QTextureImageDataPtr> &imageData,
+                                      ImageFlags flags,
+                                      qint64 bytesToReplace) const
+{
+    // IBL probes rely on their (generated) mip chain, never touch those
+    if (m_textureMemoryBudget <= 0 || imageData.isEmpty() || flags.testFlag(GenerateMipMapsForIBL))
+        return 0;
+
+    const qint64 available = m_textureMemoryBudget - (m_residentBytes - bytesToReplace);
+    const bool hasMipChain = imageData.count() > 1;
+    if (!hasMipChain && !canDownscale(imageData[0]->format()))
+        return 0;
+
+    const int w = imageData[0]->width();
+    const int h = imageData[0]->height();
+    const qint64 fullBytes = imageDataBytes(imageData);
+    int skip = 0;
+    for (; ; ++skip) {
+        const qint64 bytes = hasMipChain ? imageDataBytes(imageData, skip) : (fullBytes >> (2 * skip));
+        if (bytes <= available)
+            break;
+        if (hasMipChain && skip + 1 >= imageData.count())
+            break;
+        if ((w >> (skip + 1)) < MIN_BUDGETED_TEXTURE_SIZE || (h >> (skip + 1)) < MIN_BUDGETED_TEXTURE_SIZE)
+            break;
+    }
+    return skip;
+}
+
 void Q3DSImageManager::setSource(Qt3DRender::QAbstractTexture *tex, const QUrl &source)
 {
     TextureInfo info;
@@ -257,13 +586,35 @@ void Q3DSImageManager::setSource(Qt3DRender::QAbstractTexture *tex, const QUrl &
     // yes, it's all synchronous and this is intentional. The generator
     // (invoked from some Qt3D job thread later on) will just return the already
     // loaded data.
-    QVector<Qt3DRender::QTextureImageDataPtr> imageData = load(source, info.flags, &info.wasCached);
+    const QString oldCacheKey = info.cacheKey;
+    QVector<Qt3DRender::QTextureImageDataPtr> imageData = load(source, info.flags, &info.wasCached, &info.cacheKey);
+
+    // Take the new reference first so that the new data cannot get evicted
+    // when the old source happens to be released.
+    addCacheRef(info.cacheKey);
+    releaseCacheRef(oldCacheKey);
 
     for (Qt3DRender::QAbstractTextureImage *oldImage : tex->textureImages()) {
         tex->removeTextureImage(oldImage);
         delete oldImage;
     }
 
+    // The cache keeps the full resolution data, the reduction applies only
+    // to what gets uploaded for this particular texture.
+    info.skippedMipLevels = mipLevelsToSkip(imageData, info.flags, info.residentBytes);
+    if (info.skippedMipLevels) {
+        qCDebug(lcPerf, "Texture memory budget exceeded, dropping %d mip levels of %s",
+                info.skippedMipLevels, qPrintable(source.toLocalFile()));
+        if (imageData.count() > 1)
+            imageData.remove(0, info.skippedMipLevels);
+        else
+            imageData[0] = downscaledImageData(imageData[0], info.skippedMipLevels);
+    }
+
+    m_residentBytes -= info.residentBytes;
+    info.residentBytes = imageDataBytes(imageData);
+    m_residentBytes += info.residentBytes;
+
     if (!imageData.isEmpty()) {
         info.size = QSize(imageData[0]->width(), imageData[0]->height());
         info.format = Qt3DRender::QAbstractTexture::TextureFormat(imageData[0]->format());
@@ -287,18 +638,20 @@ void Q3DSImageManager::setSource(Qt3DRender::QAbstractTexture *tex, const QUrl &
         }
 
         for (int i = 0; i < imageData.count(); ++i)
-            tex->addTextureImage(new TextureImage(source, i, imageData[i]));
+            tex->addTextureImage(new TextureImage(source, i, imageData[i], info.skippedMipLevels));
     } else {
         // Provide a dummy image when failing to load since we want to see
         // something that makes it obvious a texture source file was missing.
         info.size = QSize(64, 64);
         info.format = Qt3DRender::QAbstractTexture::RGBA8_UNorm;
-        m_metadata.insert(tex, info);
 
         QImage dummy(info.size, QImage::Format_ARGB32);
         dummy.fill(Qt::magenta);
         auto dummyData = Qt3DRender::QTextureImageDataPtr::create();
         dummyData->setImage(dummy);
+        info.residentBytes = dummyData->data().size();
+        m_residentBytes += info.residentBytes;
+        m_metadata.insert(tex, info);
 
         tex->addTextureImage(new TextureImage(source, 0, dummyData));
         qWarning("Using placeholder texture in place of %s", qPrintable(source.toLocalFile()));
@@ -332,10 +685,16 @@ void Q3DSImageManager::setSource(Qt3DRender::QAbstractTexture *tex, const QImage
 
     Q_ASSERT(!info.flags.testFlag(GenerateMipMapsForIBL)); // not supported atm
 
+    releaseCacheRef(info.cacheKey);
+    info.cacheKey.clear();
     info.source = dummySource;
     info.size = image.size();
     info.format = Qt3DRender::QAbstractTexture::RGBA8_UNorm; // ### not always true
 
+    m_residentBytes -= info.residentBytes;
+    info.residentBytes = data->data().size();
+    m_residentBytes += info.residentBytes;
+
     m_metadata.insert(tex, info);
 }
 
@@ -371,6 +730,24 @@ bool Q3DSImageManager::wasCached(Qt3DRender::QAbstractTexture *tex) const
     return false;
 }
 
+qint64 Q3DSImageManager::residentBytes(Qt3DRender::QAbstractTexture *tex) const
+{
+    auto it = m_metadata.constFind(tex);
+    if (it != m_metadata.cend())
+        return it->residentBytes;
+
+    return 0;
+}
+
+int Q3DSImageManager::skippedMipLevels(Qt3DRender::QAbstractTexture *tex) const
+{
+    auto it = m_metadata.constFind(tex);
+    if (it != m_metadata.cend())
+        return it->skippedMipLevels;
+
+    return 0;
+}
+
 // IBL mipmap generation (BSDF prefiltering), adapted from 3DS1
 
 int Q3DSImageManager::blockSizeForFormat(QOpenGLTexture::TextureFormat format)
@@ -517,6 +894,11 @@ static inline void decodeToFloat(const void *inPtr, int byteOfs, float *outPtr,
         }
         break;
 
+    case QOpenGLTexture::RGB9E5:
+        q3ds_rgb9e5ToFloat(reinterpret_cast<const quint32 *>(src + byteOfs)[0], outPtr);
+        outPtr[3] = 1.0f;
+        break;
+
     case QOpenGLTexture::RG11B10F:
         // place holder
         Q_UNREACHABLE();
@@ -580,25 +962,15 @@ static inline void encodeToPixel(float *inPtr, void *outPtr, int byteOfs,
     case QOpenGLTexture::RG16F:
     case QOpenGLTexture::RGBA16F:
         for (int i = 0; i < (blockSize >> 1); ++i) {
-            // NOTE : This also has the limitation of not handling  infs, NaNs and
-            // denormals, but it should be
-            // sufficient for our purposes.
-            if (inPtr[i] > 65519.0f)
-                inPtr[i] = 65519.0f;
-            if (qAbs(inPtr[i]) < 6.10352E-5f)
-                inPtr[i] = 0.0f;
-            quint32 f = reinterpret_cast<quint32 *>(inPtr)[i];
-            quint32 sign = (f & 0x80000000) >> 16;
-            qint32 exponent = (f & 0x7f800000) >> 23;
-            quint32 mantissa = (f >> 13) & 0x3ff;
-            exponent = exponent - 112;
-            if (exponent > 31)
-                exponent = 31;
-            if (exponent < 0)
-                exponent = 0;
-            exponent = exponent << 10;
-            reinterpret_cast<quint16 *>(dest + byteOfs)[i] = quint16(sign | exponent | mantissa);
+            // clamp to the largest finite half instead of producing infs
+            if (inPtr[i] > 65504.0f)
+                inPtr[i] = 65504.0f;
         }
+        q3ds_floatToHalf(inPtr, reinterpret_cast<quint16 *>(dest + byteOfs), blockSize >> 1);
+        break;
+
+    case QOpenGLTexture::RGB9E5:
+        reinterpret_cast<quint32 *>(dest + byteOfs)[0] = q3ds_floatToRgb9e5(inPtr[0], inPtr[1], inPtr[2]);
         break;
 
     case QOpenGLTexture::RG11B10F:
@@ -622,6 +994,7 @@ QByteArray Q3DSImageManager::generateIblMip(int w, int h, int prevW, int prevH,
     QByteArray data;
     data.resize(w * h * blockSize);
     char *p = data.data();
+    const bool isHdr = blockSize >= 8 || format == QOpenGLTexture::RGB9E5;
 
     for (int y = 0; y < h; ++y) {
         for (int x = 0; x < w; ++x) {
@@ -645,7 +1018,7 @@ QByteArray Q3DSImageManager::generateIblMip(int w, int h, int prevW, int prevH,
                     // whereas with LDR formats, the fear with a continuous normalization factor is
                     // that we'd lose
                     // intensity and saturation as well.
-                    filterPdf /= (blockSize >= 8)
+                    filterPdf /= isHdr
                             ? 4.71238898f
                             : 4.5403446f;
                     // filterPdf /= 4.5403446f; // Discrete normalization factor
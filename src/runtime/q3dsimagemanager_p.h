@@ -43,6 +43,8 @@
 
 #include "q3dsruntimeglobal_p.h"
 #include <QHash>
+#include <QDateTime>
+#include <QStringList>
 #include <QUrl>
 #include <QImage>
 #include <Qt3DRender/QAbstractTexture>
@@ -60,12 +62,28 @@ class Q3DSImageManager
 {
 public:
     enum ImageFlag {
-        GenerateMipMapsForIBL = 0x01
+        GenerateMipMapsForIBL = 0x01,
+        // Storage of .hdr images for this texture only, overriding
+        // hdrStorageFormat(). Other image types ignore these.
+        HdrFloat32 = 0x02,
+        HdrFloat16 = 0x04,
+        HdrRGB9E5 = 0x08
     };
     Q_DECLARE_FLAGS(ImageFlags, ImageFlag)
 
+    enum HdrStorageFormat {
+        HdrStorageFloat32, // RGBA32F, 16 bytes per pixel
+        HdrStorageFloat16, // RGBA16F, 8 bytes per pixel
+        HdrStorageRGB9E5 // RGB9E5, 4 bytes per pixel
+    };
+
     static Q3DSImageManager &instance();
+    // Forgets all textures. Decoded image data is kept (subject to the image
+    // cache limit) and reused by the textures created afterwards.
     void invalidate();
+    // Forgets the textures created with the given parent only. The manager is
+    // shared by all engines, the textures of the others stay tracked.
+    void releaseTextures(Qt3DCore::QEntity *parent);
 
     Qt3DRender::QAbstractTexture *newTextureForImage(Qt3DCore::QEntity *parent,
                                                      ImageFlags flags,
@@ -76,29 +94,96 @@ public:
     QSize size(Qt3DRender::QAbstractTexture *tex) const;
     Qt3DRender::QAbstractTexture::TextureFormat format(Qt3DRender::QAbstractTexture *tex) const;
     bool wasCached(Qt3DRender::QAbstractTexture *tex) const;
+    qint64 residentBytes(Qt3DRender::QAbstractTexture *tex) const;
+    int skippedMipLevels(Qt3DRender::QAbstractTexture *tex) const;
+
+    // 0 means no limit, a negative value restores the default which comes
+    // from Q3DS_TEXTURE_BUDGET_MB
+    void setTextureMemoryBudget(qint64 bytes);
+    qint64 textureMemoryBudget() const { return m_textureMemoryBudget; }
+    qint64 residentTextureBytes() const { return m_residentBytes; }
+
+    // Applies to .hdr images loaded afterwards. The default is
+    // HdrStorageFloat32, unless Q3DS_HDR_FORMAT is set to rgba16f or rgb9e5.
+    void setHdrStorageFormat(HdrStorageFormat format) { m_hdrStorageFormat = format; }
+    HdrStorageFormat hdrStorageFormat() const { return m_hdrStorageFormat; }
+    HdrStorageFormat hdrStorageFormat(ImageFlags flags) const;
+
+    // Light probes are prefiltered for IBL from the full image, so they may
+    // need more precision (or less memory) than the other .hdr images. By
+    // default they follow hdrStorageFormat(), unless
+    // Q3DS_LIGHTPROBE_HDR_FORMAT is set to rgba32f, rgba16f or rgb9e5.
+    void setLightProbeHdrStorageFormat(HdrStorageFormat format);
+    void resetLightProbeHdrStorageFormat() { m_lightProbeFlags = GenerateMipMapsForIBL; }
+    // the flags to create light probe textures with
+    ImageFlags lightProbeImageFlags() const { return m_lightProbeFlags; }
+
+    // Decoded image data not used by any texture is evicted, least recently
+    // used first, when the cache grows beyond the limit. 0 means no limit.
+    // The default is 256 MB, or Q3DS_IMAGE_CACHE_LIMIT_MB when set.
+    void setImageCacheLimit(qint64 bytes);
+    qint64 imageCacheLimit() const { return m_cacheLimit; }
+    qint64 imageCacheBytes() const { return m_cacheBytes; }
+    int imageCacheEntryCount() const { return m_cache.count(); }
+    int imageCacheHits() const { return m_cacheHits; }
+    int imageCacheMisses() const { return m_cacheMisses; }
+
+    // Reloads the images whose files changed since they were loaded, or are
+    // listed in changedFiles, and updates all textures using them. Returns the
+    // number of textures updated.
+    int reloadModifiedImages(const QStringList &changedFiles = QStringList());
 
     qint64 ioTimeMsecs() const { return m_ioTime; }
     qint64 iblTimeMsecs() const { return m_iblTime; }
 
 private:
-    QVector<Qt3DRender::QTextureImageDataPtr> load(const QUrl &source, ImageFlags flags, bool *wasCached);
+    Q3DSImageManager();
+    QVector<Qt3DRender::QTextureImageDataPtr> load(const QUrl &source, ImageFlags flags, bool *wasCached, QString *cacheKey);
     int blockSizeForFormat(QOpenGLTexture::TextureFormat format);
     QByteArray generateIblMip(int w, int h, int prevW, int prevH,
                               QOpenGLTexture::TextureFormat format,
                               int blockSize, const QByteArray &prevLevelData);
+    int mipLevelsToSkip(const QVector<Qt3DRender::QTextureImageDataPtr> &imageData, ImageFlags flags,
+                        qint64 bytesToReplace) const;
+    void trackTextureDestruction(Qt3DRender::QAbstractTexture *tex);
+    void addCacheRef(const QString &cacheKey);
+    void releaseCacheRef(const QString &cacheKey);
+    void evictUnusedImages(const QString &keepKey = QString());
 
     struct TextureInfo {
+        Qt3DCore::QEntity *parent = nullptr; // as passed to newTextureForImage()
         ImageFlags flags;
         QUrl source;
+        QString cacheKey;
         QSize size;
         Qt3DRender::QAbstractTexture::TextureFormat format = Qt3DRender::QAbstractTexture::NoFormat;
         bool wasCached = false;
+        qint64 residentBytes = 0; // what the texture images added to the texture use
+        int skippedMipLevels = 0; // due to the texture memory budget
+    };
+
+    struct CacheEntry {
+        QVector<Qt3DRender::QTextureImageDataPtr> imageData;
+        qint64 bytes = 0;
+        int refCount = 0; // number of textures in m_metadata using this source
+        quint64 lastUse = 0;
+        QString fileName;
+        QDateTime lastModified;
     };
 
     QHash<Qt3DRender::QAbstractTexture *, TextureInfo> m_metadata;
-    QHash<QString, QVector<Qt3DRender::QTextureImageDataPtr> > m_cache;
+    QHash<QString, CacheEntry> m_cache;
     qint64 m_ioTime = 0;
     qint64 m_iblTime = 0;
+    qint64 m_textureMemoryBudget = 0;
+    qint64 m_residentBytes = 0;
+    HdrStorageFormat m_hdrStorageFormat = HdrStorageFloat32;
+    ImageFlags m_lightProbeFlags = GenerateMipMapsForIBL;
+    qint64 m_cacheLimit = 0;
+    qint64 m_cacheBytes = 0;
+    quint64 m_cacheUseCounter = 0;
+    int m_cacheHits = 0;
+    int m_cacheMisses = 0;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(Q3DSImageManager::ImageFlags)
@@ -42,4 +42,11 @@ Q3DSMesh::~Q3DSMesh()
 {
 }
 
+void Q3DSMesh::setBounds(const QVector3D &minimum, const QVector3D &maximum)
+{
+    m_minimum = minimum;
+    m_maximum = maximum;
+    m_hasBounds = true;
+}
+
 QT_END_NAMESPACE
@@ -42,6 +42,7 @@
 //
 
 #include <Qt3DRender/QGeometryRenderer>
+#include <QVector3D>
 
 QT_BEGIN_NAMESPACE
 
@@ -52,6 +53,17 @@ class Q3DSMesh : public Qt3DRender::QGeometryRenderer
 public:
     Q3DSMesh(Qt3DCore::QNode *parent = nullptr);
     ~Q3DSMesh();
+
+    // Object space bounds, when known (mesh files store them per subset).
+    bool hasBounds() const { return m_hasBounds; }
+    QVector3D minimumBounds() const { return m_minimum; }
+    QVector3D maximumBounds() const { return m_maximum; }
+    void setBounds(const QVector3D &minimum, const QVector3D &maximum);
+
+private:
+    QVector3D m_minimum;
+    QVector3D m_maximum;
+    bool m_hasBounds = false;
 };
 
 QT_END_NAMESPACE
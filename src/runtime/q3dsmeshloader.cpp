@@ -45,6 +45,7 @@
 #include <Qt3DRender/QAttribute>
 
 #include "q3dsutils_p.h"
+#include "q3dsassetcache_p.h"
 
 QT_BEGIN_NAMESPACE
 
@@ -597,7 +598,7 @@ using namespace Q3DSMeshUtils;
 
 namespace {
 
-MeshList loadMeshData(const QByteArray &meshData, quint32 flags, bool useQt3DAttributes)
+bool deserializeMeshData(QByteArray meshData, quint32 flags, Q3DSMeshFileData *fileData)
 {
     Q_UNUSED(flags)
 
@@ -608,12 +609,27 @@ MeshList loadMeshData(const QByteArray &meshData, quint32 flags, bool useQt3DAtt
     Serialize(serializer, *mesh);
 
     if (serializer.m_Failure)
-        return MeshList();
+        return false;
+
+    fileData->data = meshData;
+    return true;
+}
 
-    // Vertex Buffer
+MeshList createMeshList(const Q3DSMeshFileData &fileData, bool useQt3DAttributes)
+{
+    // The data is deserialized already (and may be shared with other
+    // presentations), only read from it from here on.
+    quint8 *dataStart = (quint8*)fileData.data.constData();
+    Mesh *mesh = (Mesh *)dataStart;
+
+    // One buffer with the whole deserialized data for both vertices and
+    // indices, so that the mesh is not copied for each presentation. The
+    // attributes address into it with offsets.
     auto vertexBuffer = new Qt3DRender::QBuffer;
-    vertexBuffer->setData(QByteArray((char *)mesh->m_VertexBuffer.m_Data.begin(dataStart), mesh->m_VertexBuffer.m_Data.size()));
+    vertexBuffer->setData(fileData.data);
     vertexBuffer->setUsage(Qt3DRender::QBuffer::StaticDraw);
+    const quint32 vertexOffset = mesh->m_VertexBuffer.m_Data.m_Offset;
+    const quint32 indexOffset = mesh->m_IndexBuffer.m_Data.m_Offset;
 
     // Iterate through the Vertex Buffer Entries and create QAttributes to associate with the buffer
     QMap<QString, MeshVertexBufferEntry> entryBufferMap;
@@ -637,7 +653,7 @@ MeshList loadMeshData(const QByteArray &meshData, quint32 flags, bool useQt3DAtt
                                                         convertRenderComponentToVertexBaseType(entry.m_ComponentType),
                                                         entry.m_NumComponents,
                                                         vertexCount,
-                                                        entry.m_FirstItemOffset,
+                                                        vertexOffset + entry.m_FirstItemOffset,
                                                         stride);
             attributes.append(attribute);
         }
@@ -651,7 +667,7 @@ MeshList loadMeshData(const QByteArray &meshData, quint32 flags, bool useQt3DAtt
                                                                 convertRenderComponentToVertexBaseType(vertexPostionEntry.m_ComponentType),
                                                                 vertexPostionEntry.m_NumComponents,
                                                                 vertexCount,
-                                                                vertexPostionEntry.m_FirstItemOffset,
+                                                                vertexOffset + vertexPostionEntry.m_FirstItemOffset,
                                                                 stride);
             attributes.append(positionAttribute);
         }
@@ -664,7 +680,7 @@ MeshList loadMeshData(const QByteArray &meshData, quint32 flags, bool useQt3DAtt
                                                               convertRenderComponentToVertexBaseType(vertexNormalEntry.m_ComponentType),
                                                               vertexNormalEntry.m_NumComponents,
                                                               vertexCount,
-                                                              vertexNormalEntry.m_FirstItemOffset,
+                                                              vertexOffset + vertexNormalEntry.m_FirstItemOffset,
                                                               stride);
             attributes.append(normalAttribute);
         }
@@ -677,7 +693,7 @@ MeshList loadMeshData(const QByteArray &meshData, quint32 flags, bool useQt3DAtt
                                                                  convertRenderComponentToVertexBaseType(vertexTextureUVEntry.m_ComponentType),
                                                                  vertexTextureUVEntry.m_NumComponents,
                                                                  vertexCount,
-                                                                 vertexTextureUVEntry.m_FirstItemOffset,
+                                                                 vertexOffset + vertexTextureUVEntry.m_FirstItemOffset,
                                                                  stride);
             attributes.append(texutreUVAttribute);
         }
@@ -690,7 +706,7 @@ MeshList loadMeshData(const QByteArray &meshData, quint32 flags, bool useQt3DAtt
                                                                 convertRenderComponentToVertexBaseType(tangentEntry.m_ComponentType),
                                                                 tangentEntry.m_NumComponents,
                                                                 vertexCount,
-                                                                tangentEntry.m_FirstItemOffset,
+                                                                vertexOffset + tangentEntry.m_FirstItemOffset,
                                                                 stride);
             attributes.append(tangentsAttribute);
         }
@@ -703,16 +719,11 @@ MeshList loadMeshData(const QByteArray &meshData, quint32 flags, bool useQt3DAtt
                                                              convertRenderComponentToVertexBaseType(vertexColorEntry.m_ComponentType),
                                                              vertexColorEntry.m_NumComponents,
                                                              vertexCount,
-                                                             vertexColorEntry.m_FirstItemOffset,
+                                                             vertexOffset + vertexColorEntry.m_FirstItemOffset,
                                                              stride);
             attributes.append(colorAttribute);
         }
     }
-    // Index Buffer
-    auto indexBuffer = new Qt3DRender::QBuffer;
-    indexBuffer->setData(QByteArray((char *)mesh->m_IndexBuffer.m_Data.begin(dataStart), mesh->m_IndexBuffer.m_Data.size()));
-    indexBuffer->setUsage(Qt3DRender::QBuffer::StaticDraw);
-
     // Mesh Sub-sets
     MeshList subsets;
     for (quint32 subsetId = 0, subSetEnd = mesh->m_Subsets.size(); subsetId < subSetEnd; ++subsetId) {
@@ -728,31 +739,36 @@ MeshList loadMeshData(const QByteArray &meshData, quint32 flags, bool useQt3DAtt
         }
         // Index Buffer (with offset)
         Qt3DRender::QAttribute::VertexBaseType type = convertRenderComponentToVertexBaseType(mesh->m_IndexBuffer.m_ComponentType);
-        auto indexAttribute = new Qt3DRender::QAttribute(indexBuffer,
+        auto indexAttribute = new Qt3DRender::QAttribute(vertexBuffer,
                                                          type,
                                                          1,
                                                          source.m_Count, // this count is ignored by Qt3D, the geomrenderer's (subMesh) vertexCount is used instead
-                                                         source.m_Offset * static_cast<uint>(RenderComponentTypes::getSizeOf(mesh->m_IndexBuffer.m_ComponentType)));
+                                                         indexOffset + source.m_Offset * static_cast<uint>(RenderComponentTypes::getSizeOf(mesh->m_IndexBuffer.m_ComponentType)));
         indexAttribute->setAttributeType(Qt3DRender::QAttribute::IndexAttribute);
         geometry->addAttribute(indexAttribute);
         subMesh->setGeometry(geometry);
         subMesh->setObjectName(subsetName);
         subMesh->setVertexCount(source.m_Count); // this is the element count passed to the draw call
         subMesh->setPrimitiveType(convertRenderDrawModeToPrimitiveType(mesh->m_DrawMode));
+        const Bounds3 &bounds(source.m_Bounds);
+        if (bounds.minimum.x <= bounds.maximum.x) {
+            subMesh->setBounds(QVector3D(bounds.minimum.x, bounds.minimum.y, bounds.minimum.z),
+                               QVector3D(bounds.maximum.x, bounds.maximum.y, bounds.maximum.z));
+        }
         subsets.append(subMesh);
     }
 
     return subsets;
 }
 
-MeshList loadMeshDataFromMulti(const QString &path, int id, bool useQt3DAttributes)
+bool loadMeshDataFromMulti(const QString &path, int id, Q3DSMeshFileData *fileData)
 {
     // This method takes a *.mesh file generated by Qt3D Studio
     // Load mesh file
     QFile meshFile(path);
     if (!meshFile.open(QIODevice::ReadOnly)) {
         qWarning() << "Could not open mesh file at: " << path;
-        return MeshList();
+        return false;
     }
 
     QDataStream meshFileStream(&meshFile);
@@ -768,7 +784,7 @@ MeshList loadMeshDataFromMulti(const QString &path, int id, bool useQt3DAttribut
     if (header.m_FileId != MeshMultiHeader::GetMultiStaticFileId() || header.m_Version != MeshMultiHeader::GetMultiStaticVersion()) {
         qWarning() << "Mesh file does not contain valid mesh data: " << path;
         meshFile.close();
-        return MeshList();
+        return false;
     }
     quint32 offset;
     quint32 size;
@@ -794,7 +810,7 @@ MeshList loadMeshDataFromMulti(const QString &path, int id, bool useQt3DAttribut
         id = int(lastEntry);
 
     // Load mesh data
-    MeshList meshList;
+    bool loaded = false;
     if (entries.contains(id)) {
         meshFile.seek(entries[id].m_MeshOffset);
         // Read MeshDataHeader
@@ -818,13 +834,13 @@ MeshList loadMeshDataFromMulti(const QString &path, int id, bool useQt3DAttribut
             int amountRead = meshFileStream.readRawData(meshData.data(), meshDataHeader.m_SizeInBytes);
             if (quint32(amountRead) == meshDataHeader.m_SizeInBytes) {
                 // We only support Meshes version 3 and higher
-                meshList = loadMeshData(meshData, meshDataHeader.m_HeaderFlags, useQt3DAttributes);
+                loaded = deserializeMeshData(meshData, meshDataHeader.m_HeaderFlags, fileData);
             }
         }
     }
 
     meshFile.close();
-    return meshList;
+    return loaded;
 }
 
 int componentByteSize(Q3DSGeometry::Attribute::ComponentType type)
@@ -938,7 +954,7 @@ Q3DSMesh *loadMeshDataFromCustomGeometry(const Q3DSGeometry &geom, Q3DSMeshLoade
 
 } // end anonymous namespace
 
-MeshList Q3DSMeshLoader::loadMesh(const QString &meshPath, int partId, bool useQt3DAttributes)
+MeshList Q3DSMeshLoader::loadMesh(const QString &meshPath, int partId, bool useQt3DAttributes, QString *cacheKey)
 {
     static QMap<QString, QString> primitiveMap = {{"#Rectangle", "res/primitives/Rectangle.mesh"},
                                                   {"#Sphere", "res/primitives/Sphere.mesh"},
@@ -957,7 +973,16 @@ MeshList Q3DSMeshLoader::loadMesh(const QString &meshPath, int partId, bool useQ
         resolvedPath.prepend(Q3DSUtils::resourcePrefix());
     }
 
-    return loadMeshDataFromMulti(resolvedPath, id, useQt3DAttributes);
+    // The file contents are shared between all presentations (and engines)
+    // loading the same mesh, only the Qt 3D nodes are created per call.
+    Q3DSMeshFileData fileData;
+    auto loader = [resolvedPath, id](Q3DSMeshFileData *d) {
+        return loadMeshDataFromMulti(resolvedPath, id, d);
+    };
+    if (!Q3DSAssetCache::instance().meshFile(resolvedPath, id, loader, &fileData, cacheKey))
+        return MeshList();
+
+    return createMeshList(fileData, useQt3DAttributes);
 }
 
 MeshList Q3DSMeshLoader::loadMesh(const Q3DSGeometry &geom, MeshMapping *mapping)
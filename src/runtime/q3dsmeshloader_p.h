@@ -140,7 +140,10 @@ private:
 };
 
 namespace Q3DSMeshLoader {
-    Q3DSV_PRIVATE_EXPORT MeshList loadMesh(const QString &meshPath, int partId = 0, bool useQt3DAttributes = false);
+    // When cacheKey is not null, a reference to the shared mesh data is kept
+    // in Q3DSAssetCache and the key for releasing it is returned.
+    Q3DSV_PRIVATE_EXPORT MeshList loadMesh(const QString &meshPath, int partId = 0, bool useQt3DAttributes = false,
+                                           QString *cacheKey = nullptr);
 
     struct MeshMapping
     {
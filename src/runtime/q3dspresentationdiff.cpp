@@ -0,0 +1,442 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of Qt 3D Studio.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "q3dspresentationdiff_p.h"
+#include "q3dsuippresentation_p.h"
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+
+// Like forAllObjectsInSubTree() but f can stop the descent into the children
+// by returning false.
+static void walkTree(Q3DSGraphObject *root, const std::function<bool(Q3DSGraphObject *)> &f)
+{
+    if (!f(root))
+        return;
+    for (Q3DSGraphObject *obj = root->firstChild(); obj; obj = obj->nextSibling())
+        walkTree(obj, f);
+}
+
+static bool hasUnsupportedObjects(Q3DSGraphObject *root)
+{
+    bool result = false;
+    Q3DSUipPresentation::forAllObjectsInSubTree(root, [&result](Q3DSGraphObject *obj) {
+        // Components come with their own slide decks, behaviors with scripts
+        // the engine only loads at build time, effects are tied to the layer
+        // setup and custom materials may use classes the live presentation
+        // does not know.
+        if (obj->type() == Q3DSGraphObject::Component
+                || obj->type() == Q3DSGraphObject::Behavior
+                || obj->type() == Q3DSGraphObject::Effect
+                || obj->type() == Q3DSGraphObject::CustomMaterial)
+            result = true;
+    });
+    return result;
+}
+
+static Q3DSGraphObject *objectRef(const QVariant &v, bool *isRef)
+{
+    if (v.userType() == qMetaTypeId<Q3DSImage *>()) {
+        *isRef = true;
+        return v.value<Q3DSImage *>();
+    }
+    if (v.userType() == qMetaTypeId<Q3DSGraphObject *>()) {
+        *isRef = true;
+        return v.value<Q3DSGraphObject *>();
+    }
+    *isRef = false;
+    return nullptr;
+}
+
+// Object references point into different presentations, compare them by id.
+static bool sameValue(const QVariant &a, const QVariant &b)
+{
+    bool aIsRef = false;
+    bool bIsRef = false;
+    Q3DSGraphObject *aRef = objectRef(a, &aIsRef);
+    Q3DSGraphObject *bRef = objectRef(b, &bIsRef);
+    if (aIsRef || bIsRef) {
+        if (aIsRef != bIsRef)
+            return false;
+        return (aRef ? aRef->id() : QByteArray()) == (bRef ? bRef->id() : QByteArray());
+    }
+    return a == b;
+}
+
+bool Q3DSPresentationDiff::fail(const QString &reason)
+{
+    m_failureReason = reason;
+    return false;
+}
+
+bool Q3DSPresentationDiff::compute(Q3DSUipPresentation *before, Q3DSUipPresentation *after)
+{
+    m_changedProperties.clear();
+    m_added.clear();
+    m_removed.clear();
+    m_addedIds.clear();
+    m_removedIds.clear();
+    m_slideIds.clear();
+    m_failureReason.clear();
+
+    if (!before->scene() || !after->scene() || !before->masterSlide() || !after->masterSlide())
+        return fail(QLatin1String("No scene or master slide"));
+
+    if (before->presentationWidth() != after->presentationWidth()
+            || before->presentationHeight() != after->presentationHeight()
+            || before->presentationRotation() != after->presentationRotation()
+            || before->maintainAspectRatio() != after->maintainAspectRatio())
+    {
+        return fail(QLatin1String("Presentation settings changed"));
+    }
+
+    bool ok = true;
+
+    // Objects only present in before. Only the roots of the removed subtrees
+    // are recorded.
+    walkTree(before->scene(), [&](Q3DSGraphObject *obj) {
+        if (!ok || after->object(obj->id()))
+            return ok;
+        if (hasUnsupportedObjects(obj)) {
+            ok = fail(QString(QLatin1String("Removed %1 contains unsupported objects")).arg(QString::fromUtf8(obj->id())));
+            return false;
+        }
+        m_removed.append(obj->id());
+        Q3DSUipPresentation::forAllObjectsInSubTree(obj, [this](Q3DSGraphObject *objOrChild) {
+            m_removedIds.insert(objOrChild->id());
+        });
+        return false;
+    });
+    if (!ok)
+        return false;
+
+    // Objects only present in after, and the changes to the common ones.
+    walkTree(after->scene(), [&](Q3DSGraphObject *obj) {
+        if (!ok)
+            return false;
+        Q3DSGraphObject *beforeObj = before->object(obj->id());
+        if (beforeObj) {
+            ok = compareObject(beforeObj, obj, before, after);
+            return ok;
+        }
+        if (hasUnsupportedObjects(obj)) {
+            ok = fail(QString(QLatin1String("Added %1 contains unsupported objects")).arg(QString::fromUtf8(obj->id())));
+            return false;
+        }
+        Addition addition;
+        addition.id = obj->id();
+        addition.parentId = obj->parent()->id();
+        if (obj->previousSibling())
+            addition.previousSiblingId = obj->previousSibling()->id();
+        m_added.append(addition);
+        Q3DSUipPresentation::forAllObjectsInSubTree(obj, [this](Q3DSGraphObject *objOrChild) {
+            m_addedIds.insert(objOrChild->id());
+        });
+        return false;
+    });
+    if (!ok)
+        return false;
+
+    // The slide graphs must be identical apart from the membership and
+    // property changes of the added and removed objects.
+    if (!compareSlides(before->masterSlide(), after->masterSlide()))
+        return false;
+
+    Q3DSUipPresentation::forAllObjectsOfType(after->scene(), Q3DSGraphObject::Component, [&](Q3DSGraphObject *obj) {
+        if (!ok)
+            return;
+        Q3DSComponentNode *afterComp = static_cast<Q3DSComponentNode *>(obj);
+        Q3DSComponentNode *beforeComp = before->object<Q3DSComponentNode>(obj->id());
+        ok = compareSlides(beforeComp->masterSlide(), afterComp->masterSlide());
+    });
+
+    return ok;
+}
+
+bool Q3DSPresentationDiff::compareObject(Q3DSGraphObject *before, Q3DSGraphObject *after,
+                                         Q3DSUipPresentation *beforePres, Q3DSUipPresentation *afterPres)
+{
+    const QString id = QString::fromUtf8(after->id());
+
+    if (before->type() != after->type())
+        return fail(QString(QLatin1String("Type of %1 changed")).arg(id));
+
+    const QByteArray beforeParent = before->parent() ? before->parent()->id() : QByteArray();
+    const QByteArray afterParent = after->parent() ? after->parent()->id() : QByteArray();
+    if (beforeParent != afterParent)
+        return fail(QString(QLatin1String("%1 was moved")).arg(id));
+
+    // Added and removed children are fine, reordering is not.
+    QVector<QByteArray> beforeChildren;
+    for (Q3DSGraphObject *obj = before->firstChild(); obj; obj = obj->nextSibling()) {
+        if (afterPres->object(obj->id()))
+            beforeChildren.append(obj->id());
+    }
+    QVector<QByteArray> afterChildren;
+    for (Q3DSGraphObject *obj = after->firstChild(); obj; obj = obj->nextSibling()) {
+        if (beforePres->object(obj->id()))
+            afterChildren.append(obj->id());
+    }
+    if (beforeChildren != afterChildren)
+        return fail(QString(QLatin1String("Children of %1 were reordered")).arg(id));
+
+    const QVector<QByteArray> beforeNames = before->propertyNames();
+    const QVector<QVariant> beforeValues = before->propertyValues();
+    const QVector<QByteArray> afterNames = after->propertyNames();
+    const QVector<QVariant> afterValues = after->propertyValues();
+    QVector<QByteArray> changed;
+    for (int i = 0; i < afterNames.count(); ++i) {
+        const QByteArray &name(afterNames[i]);
+        if (name == QByteArrayLiteral("id"))
+            continue;
+        const int beforeIdx = beforeNames.indexOf(name);
+        if (beforeIdx < 0 || !sameValue(beforeValues[beforeIdx], afterValues[i]))
+            changed.append(name);
+    }
+    if (!changed.isEmpty())
+        m_changedProperties.insert(after->id(), changed);
+
+    return true;
+}
+
+bool Q3DSPresentationDiff::compareSlides(Q3DSSlide *before, Q3DSSlide *after)
+{
+    if (!before || !after)
+        return fail(QLatin1String("Missing slide"));
+
+    if (before->id() != after->id() || slideSignature(before) != slideSignature(after))
+        return fail(QString(QLatin1String("Slide %1 changed")).arg(QString::fromUtf8(after->id())));
+
+    m_slideIds.append(after->id());
+
+    Q3DSGraphObject *b = before->firstChild();
+    Q3DSGraphObject *a = after->firstChild();
+    for ( ; b && a; b = b->nextSibling(), a = a->nextSibling()) {
+        if (!compareSlides(static_cast<Q3DSSlide *>(b), static_cast<Q3DSSlide *>(a)))
+            return false;
+    }
+    if (b || a)
+        return fail(QString(QLatin1String("Slides added to or removed from %1")).arg(QString::fromUtf8(after->id())));
+
+    return true;
+}
+
+QString Q3DSPresentationDiff::slideSignature(Q3DSSlide *slide) const
+{
+    auto ignored = [this](Q3DSGraphObject *obj) {
+        return m_addedIds.contains(obj->id()) || m_removedIds.contains(obj->id());
+    };
+    auto num = [](float f) { return QString::number(f, 'g', 9); };
+
+    QStringList sig;
+
+    const QVector<QByteArray> names = slide->propertyNames();
+    const QVector<QVariant> values = slide->propertyValues();
+    for (int i = 0; i < names.count(); ++i) {
+        // enums may not convert to a string
+        const QString value = values[i].toString();
+        sig.append(QString::fromUtf8(names[i]) + QLatin1Char('=')
+                   + (value.isEmpty() && values[i].canConvert<int>() ? QString::number(values[i].toInt()) : value));
+    }
+
+    QStringList objects;
+    for (Q3DSGraphObject *obj : slide->objects()) {
+        if (!ignored(obj))
+            objects.append(QString::fromUtf8(obj->id()));
+    }
+    objects.sort();
+    sig.append(objects.join(QLatin1Char(',')));
+
+    QStringList changes;
+    for (auto it = slide->propertyChanges().cbegin(), itEnd = slide->propertyChanges().cend(); it != itEnd; ++it) {
+        if (ignored(it.key()))
+            continue;
+        QString s = QString::fromUtf8(it.key()->id()) + QLatin1Char(':');
+        for (const Q3DSPropertyChange &change : *it.value())
+            s += change.nameStr() + QLatin1Char('=') + (change.hasValue() ? change.valueStr() : QString()) + QLatin1Char(';');
+        changes.append(s);
+    }
+    changes.sort();
+    sig.append(changes);
+
+    // Animations are not adjusted incrementally at all, not even the ones on
+    // added or removed objects.
+    for (const Q3DSAnimationTrack &track : slide->animations()) {
+        QString s = QString::fromUtf8(track.target() ? track.target()->id() : QByteArray())
+                + QLatin1Char('.') + track.property()
+                + QLatin1Char(':') + QString::number(track.type())
+                + QLatin1Char(':') + QString::number(track.isDynamic());
+        for (const Q3DSAnimationTrack::KeyFrame &kf : track.keyFrames()) {
+            s += QLatin1Char(' ') + num(kf.time) + QLatin1Char('/') + num(kf.value);
+            if (track.type() == Q3DSAnimationTrack::EaseInOut)
+                s += QLatin1Char('/') + num(kf.easeIn) + QLatin1Char('/') + num(kf.easeOut);
+            else if (track.type() == Q3DSAnimationTrack::Bezier)
+                s += QLatin1Char('/') + num(kf.c2time) + QLatin1Char('/') + num(kf.c2value)
+                        + QLatin1Char('/') + num(kf.c1time) + QLatin1Char('/') + num(kf.c1value);
+        }
+        sig.append(s);
+    }
+
+    for (const Q3DSAction &action : slide->actions()) {
+        QString s = QString::fromUtf8(action.id)
+                + QLatin1Char(':') + QString::number(action.eyeball)
+                + QLatin1Char(':') + action.triggerObject_unresolved
+                + QLatin1Char(':') + action.event
+                + QLatin1Char(':') + action.targetObject_unresolved
+                + QLatin1Char(':') + QString::number(action.handler)
+                + QLatin1Char(':') + action.behaviorHandler;
+        for (const Q3DSAction::HandlerArgument &arg : action.handlerArgs)
+            s += QLatin1Char(':') + arg.name + QLatin1Char('=') + arg.value;
+        sig.append(s);
+    }
+
+    return sig.join(QLatin1Char('\n'));
+}
+
+QSet<QByteArray> Q3DSPresentationDiff::apply(Q3DSUipPresentation *live, Q3DSUipPresentation *after, Q3DSSlide *currentSlide)
+{
+    QSet<QByteArray> touched;
+
+    QVector<Q3DSSlide *> liveSlides;
+    for (const QByteArray &id : qAsConst(m_slideIds)) {
+        if (Q3DSSlide *slide = live->object<Q3DSSlide>(id))
+            liveSlides.append(slide);
+    }
+
+    // Additions first since the changed properties may refer to the new
+    // objects. The subtrees are moved over from after.
+    for (const Addition &addition : qAsConst(m_added)) {
+        Q3DSGraphObject *obj = after->object(addition.id);
+        Q3DSGraphObject *parent = live->object(addition.parentId);
+        if (!obj || !parent)
+            continue;
+        Q3DSGraphObject *previous = addition.previousSiblingId.isEmpty()
+                ? nullptr : live->object(addition.previousSiblingId);
+
+        after->unlinkObject(obj);
+        Q3DSUipPresentation::forAllObjectsInSubTree(obj, [live, &touched](Q3DSGraphObject *objOrChild) {
+            live->registerObject(objOrChild->id(), objOrChild);
+            touched.insert(objOrChild->id());
+        });
+        // References (images, meshes) resolve against live from now on.
+        Q3DSUipPresentation::forAllObjectsInSubTree(obj, [live](Q3DSGraphObject *objOrChild) {
+            objOrChild->resolveReferences(*live);
+        });
+
+        if (previous)
+            parent->insertChildNodeAfter(obj, previous);
+        else
+            parent->prependChildNode(obj);
+    }
+
+    if (!m_added.isEmpty()) {
+        for (Q3DSSlide *liveSlide : qAsConst(liveSlides)) {
+            Q3DSSlide *afterSlide = after->object<Q3DSSlide>(liveSlide->id());
+            if (!afterSlide)
+                continue;
+            // Objects on the master slide can have property changes on the
+            // child slides without being in their object list.
+            const Q3DSSlide::PropertyChanges changes = afterSlide->propertyChanges();
+            for (auto it = changes.cbegin(), itEnd = changes.cend(); it != itEnd; ++it) {
+                if (m_addedIds.contains(it.key()->id()))
+                    liveSlide->addPropertyChanges(it.key(), afterSlide->takePropertyChanges(it.key()));
+            }
+            const QSet<Q3DSGraphObject *> objects = afterSlide->objects();
+            for (Q3DSGraphObject *obj : objects) {
+                if (m_addedIds.contains(obj->id())) {
+                    afterSlide->removeObject(obj);
+                    liveSlide->addObject(obj);
+                }
+            }
+        }
+    }
+
+    for (auto it = m_changedProperties.cbegin(), itEnd = m_changedProperties.cend(); it != itEnd; ++it) {
+        Q3DSGraphObject *liveObj = live->object(it.key());
+        Q3DSGraphObject *afterObj = after->object(it.key());
+        if (!liveObj || !afterObj)
+            continue;
+        Q3DSPropertyChangeList changeList;
+        for (const QByteArray &name : it.value()) {
+            QVariant v = afterObj->property(name.constData());
+            bool isRef = false;
+            Q3DSGraphObject *ref = objectRef(v, &isRef);
+            if (isRef) {
+                Q3DSGraphObject *liveRef = ref ? live->object(ref->id()) : nullptr;
+                if (v.userType() == qMetaTypeId<Q3DSImage *>())
+                    v = QVariant::fromValue(static_cast<Q3DSImage *>(liveRef));
+                else
+                    v = QVariant::fromValue(liveRef);
+            }
+            if (liveObj->setProperty(name.constData(), v))
+                changeList.append(Q3DSPropertyChange(QString::fromUtf8(name)));
+        }
+        // e.g. a changed sourcepath of a model needs the mesh loaded
+        liveObj->resolveReferences(*live);
+        liveObj->notifyPropertyChanges(changeList);
+        touched.insert(it.key());
+    }
+
+    for (const QByteArray &id : qAsConst(m_removed)) {
+        Q3DSGraphObject *obj = live->object(id);
+        if (!obj)
+            continue;
+        Q3DSUipPresentation::forAllObjectsInSubTree(obj, [&liveSlides](Q3DSGraphObject *objOrChild) {
+            for (Q3DSSlide *slide : qAsConst(liveSlides)) {
+                slide->removePropertyChanges(objOrChild);
+                slide->removeObject(objOrChild);
+            }
+        });
+        live->unlinkObject(obj);
+        delete obj;
+    }
+
+    // The new base values of the touched objects must not override what the
+    // active slides set.
+    QVector<Q3DSSlide *> activeSlides { live->masterSlide(), currentSlide };
+    Q3DSUipPresentation::forAllObjectsOfType(live->scene(), Q3DSGraphObject::Component, [&activeSlides](Q3DSGraphObject *obj) {
+        Q3DSComponentNode *comp = static_cast<Q3DSComponentNode *>(obj);
+        activeSlides.append(comp->masterSlide());
+        activeSlides.append(comp->currentSlide());
+    });
+    for (Q3DSSlide *slide : qAsConst(activeSlides)) {
+        if (!slide)
+            continue;
+        for (auto it = slide->propertyChanges().cbegin(), itEnd = slide->propertyChanges().cend(); it != itEnd; ++it) {
+            if (touched.contains(it.key()->id())) {
+                it.key()->applyPropertyChanges(*it.value());
+                it.key()->notifyPropertyChanges(*it.value());
+            }
+        }
+    }
+
+    return touched;
+}
+
+QT_END_NAMESPACE
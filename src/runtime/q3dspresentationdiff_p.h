@@ -0,0 +1,109 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of Qt 3D Studio.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef Q3DSPRESENTATIONDIFF_P_H
+#define Q3DSPRESENTATIONDIFF_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "q3dsruntimeglobal_p.h"
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+
+class Q3DSUipPresentation;
+class Q3DSGraphObject;
+class Q3DSSlide;
+
+// The difference between two parsed versions of the same .uip document,
+// applied to the live presentation (the one a scene manager was built from)
+// when reloading incrementally. Changed properties and added or removed
+// scene objects go through the regular dynamic scene paths (property change
+// notifications, child node and slide object additions and removals), so the
+// scene manager updates only what is affected and the slide and animation
+// state is kept.
+//
+// Changes that cannot be applied this way (slide settings, animations,
+// actions, moved or reordered objects, added or removed components and
+// behaviors) make compute() return false. The caller is expected to do a full
+// reload then.
+class Q3DSV_PRIVATE_EXPORT Q3DSPresentationDiff
+{
+public:
+    bool compute(Q3DSUipPresentation *before, Q3DSUipPresentation *after);
+
+    // Moves added objects from after to live and applies the property
+    // changes. currentSlide is the active slide of the main slide deck.
+    // Returns the ids of all objects that were touched.
+    QSet<QByteArray> apply(Q3DSUipPresentation *live, Q3DSUipPresentation *after, Q3DSSlide *currentSlide);
+
+    bool isEmpty() const { return m_changedProperties.isEmpty() && m_added.isEmpty() && m_removed.isEmpty(); }
+    QString failureReason() const { return m_failureReason; }
+
+    const QHash<QByteArray, QVector<QByteArray> > &changedProperties() const { return m_changedProperties; }
+    int addedCount() const { return m_added.count(); }
+    int removedCount() const { return m_removed.count(); }
+
+private:
+    struct Addition {
+        QByteArray id;
+        QByteArray parentId;
+        QByteArray previousSiblingId;
+    };
+
+    bool fail(const QString &reason);
+    bool compareObject(Q3DSGraphObject *before, Q3DSGraphObject *after,
+                       Q3DSUipPresentation *beforePres, Q3DSUipPresentation *afterPres);
+    bool compareSlides(Q3DSSlide *before, Q3DSSlide *after);
+    QString slideSignature(Q3DSSlide *slide) const;
+
+    QHash<QByteArray, QVector<QByteArray> > m_changedProperties;
+    QVector<Addition> m_added;
+    QVector<QByteArray> m_removed;
+    QSet<QByteArray> m_addedIds; // all objects in the added subtrees
+    QSet<QByteArray> m_removedIds; // all objects in the removed subtrees
+    QVector<QByteArray> m_slideIds;
+    QString m_failureReason;
+};
+
+QT_END_NAMESPACE
+
+#endif // Q3DSPRESENTATIONDIFF_P_H
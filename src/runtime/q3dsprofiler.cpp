@@ -65,6 +65,7 @@ void Q3DSProfiler::resetForNewScene(Q3DSSceneManager *sceneManager)
     m_frameData.clear();
     m_objectData.clear();
     m_objectDestroyConnections.clear();
+    m_shaderStats = ShaderStats();
 
     m_sceneManager = sceneManager;
     m_presentation = m_sceneManager->m_presentation;
@@ -101,6 +102,17 @@ void Q3DSProfiler::updateFrameStats(qint64 globalFrameCounter)
     d.wasDirty = m_sceneManager->m_wasDirty;
 }
 
+void Q3DSProfiler::reportEffectParamUpdates(int updated, int skipped)
+{
+    // effects get updated also outside the frame action upon activation
+    if (!m_enabled || m_frameData.isEmpty())
+        return;
+
+    FrameData &d(m_frameData.last());
+    d.effectParamUpdates += updated;
+    d.effectParamUpdatesSkipped += skipped;
+}
+
 void Q3DSProfiler::trackNewObject(QObject *obj, ObjectType type, const char *info, ...)
 {
     if (!m_enabled)
@@ -152,6 +164,18 @@ void Q3DSProfiler::reportBehaviorStats(qint64 loadTimeMs, int activeCount)
     m_behaviorActiveCount = activeCount;
 }
 
+void Q3DSProfiler::reportShaderGeneration(qint64 ms, int count)
+{
+    m_shaderStats.generateTimeMs += ms;
+    m_shaderStats.generatedCount += count;
+}
+
+void Q3DSProfiler::reportShaderProgramCreation(qint64 ns)
+{
+    m_shaderStats.createTimeNs += ns;
+    ++m_shaderStats.createdCount;
+}
+
 void Q3DSProfiler::reportTimeAfterBuildUntilFirstFrameAction(qint64 ms)
 {
     m_firstFrameActionTime = ms;
@@ -223,6 +247,11 @@ void Q3DSProfiler::setLayerCaching(bool enabled)
         subPresProfiler->m_sceneManager->setLayerCaching(enabled);
 }
 
+Q3DSTexturePool::Stats Q3DSProfiler::texturePoolStats() const
+{
+    return m_sceneManager ? m_sceneManager->m_texturePool.stats() : Q3DSTexturePool::Stats();
+}
+
 float Q3DSProfiler::cpuLoadForCurrentProcess()
 {
     if (!m_cpuLoadTimer.isValid()) {
@@ -41,6 +41,7 @@
 // We mean it.
 //
 
+#include "q3dstexturepool_p.h"
 #include <QVector>
 #include <QElapsedTimer>
 #include <QMultiMap>
@@ -91,6 +92,8 @@ public:
         float deltaMs = 0;
         qint64 globalFrameCounter = 0;
         bool wasDirty = false;
+        int effectParamUpdates = 0;
+        int effectParamUpdatesSkipped = 0;
     };
 
     const QVector<FrameData> *frameData() const { return &m_frameData; }
@@ -112,9 +115,20 @@ public:
     void reportBehaviorStats(qint64 loadTimeMs, int loadCount);
     qint64 behaviorLoadTime() const { return m_behaviorLoadTime; }
     int behaviorActiveCount() const { return m_behaviorActiveCount; }
+    void reportEffectParamUpdates(int updated, int skipped);
     void reportTimeAfterBuildUntilFirstFrameAction(qint64 ms);
     qint64 timeAfterBuildUntilFirstFrameAction() const { return m_firstFrameActionTime; }
 
+    struct ShaderStats {
+        qint64 generateTimeMs = 0; // pregenerating the material shaders, wall clock
+        int generatedCount = 0;
+        qint64 createTimeNs = 0; // creating the QShaderProgram nodes, main thread
+        int createdCount = 0;
+    };
+    void reportShaderGeneration(qint64 ms, int count);
+    void reportShaderProgramCreation(qint64 ns);
+    ShaderStats shaderStats() const { return m_shaderStats; }
+
     struct SubMeshData {
         bool needsBlending = false;
     };
@@ -146,6 +160,7 @@ public:
 
     void sendDataInputValueChange(const QString &dataInputName, const QVariant &value);
     void setLayerCaching(bool enabled);
+    Q3DSTexturePool::Stats texturePoolStats() const;
 
     float cpuLoadForCurrentProcess();
     QPair<qint64, qint64> memUsageForCurrentProcess();
@@ -162,6 +177,7 @@ private:
     qint64 m_behaviorLoadTime = 0;
     int m_behaviorActiveCount = 0;
     qint64 m_firstFrameActionTime = 0;
+    ShaderStats m_shaderStats;
     QHash<Q3DSMesh *, SubMeshData> m_subMeshData;
     QVector<Q3DSProfiler *> m_subPresProfilers;
     QStringList m_log;
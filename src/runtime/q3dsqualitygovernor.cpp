@@ -0,0 +1,149 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of Qt 3D Studio.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "q3dsqualitygovernor_p.h"
+
+QT_BEGIN_NAMESPACE
+
+// Over budget means being more than 20% above the target, within budget means
+// at most 5% above it. (frame times cannot really go below the target with
+// vsync, hence the probing for raising the level)
+static const float OVER_BUDGET_FACTOR = 1.2f;
+static const float WITHIN_BUDGET_FACTOR = 1.05f;
+static const int LOWER_AFTER_WINDOWS = 2;
+static const int RAISE_AFTER_WINDOWS = 4;
+static const int MAX_RAISE_AFTER_WINDOWS = 64;
+
+Q3DSQualityGovernor::Quality Q3DSQualityGovernor::qualityForLevel(int level)
+{
+    Quality q;
+    switch (qBound(0, level, LEVEL_COUNT - 1)) {
+    case 0:
+        break;
+    case 1:
+        q.maxProgressiveAAPasses = 4;
+        break;
+    case 2:
+        q.maxProgressiveAAPasses = 2;
+        q.shadowMapResolutionShift = 1;
+        break;
+    case 3:
+        q.layerRenderScale = 0.75f;
+        q.maxProgressiveAAPasses = 2;
+        q.shadowMapResolutionShift = 1;
+        break;
+    default:
+        q.layerRenderScale = 0.5f;
+        q.maxProgressiveAAPasses = 2;
+        q.shadowMapResolutionShift = 2;
+        break;
+    }
+    return q;
+}
+
+void Q3DSQualityGovernor::setTargetFrameTime(float ms)
+{
+    if (ms > 0)
+        m_targetFrameTime = ms;
+}
+
+void Q3DSQualityGovernor::setWindowSize(int frames)
+{
+    m_windowSize = qMax(1, frames);
+}
+
+void Q3DSQualityGovernor::setLevel(int level)
+{
+    m_level = qBound(0, level, LEVEL_COUNT - 1);
+    m_windowFrameCount = 0;
+    m_windowTimeSum = 0;
+    m_overBudgetWindows = 0;
+    m_withinBudgetWindows = 0;
+    m_windowsSinceRaise = -1;
+}
+
+void Q3DSQualityGovernor::reset()
+{
+    setLevel(0);
+    m_raiseAfterWindows = RAISE_AFTER_WINDOWS;
+}
+
+void Q3DSQualityGovernor::restartWindow()
+{
+    m_windowFrameCount = 0;
+    m_windowTimeSum = 0;
+    m_overBudgetWindows = 0;
+    m_withinBudgetWindows = 0;
+}
+
+bool Q3DSQualityGovernor::addFrameTime(float ms)
+{
+    m_windowTimeSum += ms;
+    if (++m_windowFrameCount < m_windowSize)
+        return false;
+
+    const float avg = m_windowTimeSum / m_windowFrameCount;
+    m_windowFrameCount = 0;
+    m_windowTimeSum = 0;
+    if (m_windowsSinceRaise >= 0)
+        ++m_windowsSinceRaise;
+
+    if (avg > m_targetFrameTime * OVER_BUDGET_FACTOR) {
+        m_withinBudgetWindows = 0;
+        if (++m_overBudgetWindows >= LOWER_AFTER_WINDOWS && m_level < LEVEL_COUNT - 1) {
+            // A raise that did not hold up makes the next attempt wait longer.
+            if (m_windowsSinceRaise >= 0 && m_windowsSinceRaise <= LOWER_AFTER_WINDOWS + 1)
+                m_raiseAfterWindows = qMin(m_raiseAfterWindows * 2, MAX_RAISE_AFTER_WINDOWS);
+            m_windowsSinceRaise = -1;
+            m_overBudgetWindows = 0;
+            ++m_level;
+            return true;
+        }
+    } else if (avg <= m_targetFrameTime * WITHIN_BUDGET_FACTOR) {
+        m_overBudgetWindows = 0;
+        if (++m_withinBudgetWindows >= m_raiseAfterWindows && m_level > 0) {
+            m_withinBudgetWindows = 0;
+            m_windowsSinceRaise = 0;
+            --m_level;
+            return true;
+        }
+        // Stayed within budget long enough after a raise, back to the normal pace.
+        if (m_windowsSinceRaise > LOWER_AFTER_WINDOWS + 1) {
+            m_windowsSinceRaise = -1;
+            m_raiseAfterWindows = RAISE_AFTER_WINDOWS;
+        }
+    } else {
+        m_overBudgetWindows = 0;
+        m_withinBudgetWindows = 0;
+    }
+
+    return false;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,97 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of Qt 3D Studio.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef Q3DSQUALITYGOVERNOR_P_H
+#define Q3DSQUALITYGOVERNOR_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "q3dsruntimeglobal_p.h"
+
+QT_BEGIN_NAMESPACE
+
+// Picks a quality level based on the frame times reported to it. Frame times
+// are averaged over a window of frames. The level is lowered after two
+// consecutive windows over budget and raised again after the average has
+// stayed within budget for a while. Raising the level is a probe: if it leads
+// to going over budget right away, the next probe is delayed twice as long.
+class Q3DSV_PRIVATE_EXPORT Q3DSQualityGovernor
+{
+public:
+    struct Quality {
+        float layerRenderScale = 1.0f;
+        int maxProgressiveAAPasses = 8;
+        int shadowMapResolutionShift = 0;
+    };
+
+    static const int LEVEL_COUNT = 5;
+    static Quality qualityForLevel(int level);
+
+    float targetFrameTime() const { return m_targetFrameTime; }
+    void setTargetFrameTime(float ms);
+
+    int windowSize() const { return m_windowSize; }
+    void setWindowSize(int frames);
+
+    int level() const { return m_level; }
+    void setLevel(int level);
+    Quality quality() const { return qualityForLevel(m_level); }
+
+    // Returns true when the level changed as a result.
+    bool addFrameTime(float ms);
+
+    void reset();
+    // Drops the frames collected so far without changing the level, for when
+    // the next frame times are not comparable with the previous ones.
+    void restartWindow();
+
+private:
+    float m_targetFrameTime = 1000.0f / 60.0f;
+    int m_windowSize = 30;
+    int m_level = 0;
+    int m_windowFrameCount = 0;
+    float m_windowTimeSum = 0;
+    int m_overBudgetWindows = 0;
+    int m_withinBudgetWindows = 0;
+    int m_raiseAfterWindows = 4;
+    int m_windowsSinceRaise = -1;
+};
+
+QT_END_NAMESPACE
+
+#endif // Q3DSQUALITYGOVERNOR_P_H
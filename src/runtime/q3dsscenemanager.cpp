@@ -85,6 +85,9 @@
 #include <Qt3DRender/QColorMask>
 #include <Qt3DRender/QShaderProgram>
 #include <Qt3DRender/QBuffer>
+#include <Qt3DRender/QGeometry>
+#include <Qt3DRender/QGeometryRenderer>
+#include <Qt3DRender/QAttribute>
 #include <Qt3DRender/QBlitFramebuffer>
 #include <Qt3DRender/QStencilTest>
 #include <Qt3DRender/QStencilTestArguments>
@@ -448,6 +451,13 @@ Q3DSSceneManager::Q3DSSceneManager()
     const QString fontDir = Q3DSUtils::resourcePrefix() + QLatin1String("res/Font");
     m_textRenderer->registerFonts({ fontDir });
 
+    // Instanced drawing of models needs per-instance vertex attributes.
+    const QSurfaceFormat &format(m_gfxLimits.format);
+    if (format.renderableType() == QSurfaceFormat::OpenGLES)
+        m_modelInstancing = !m_gfxLimits.useGles2Path && format.majorVersion() >= 3;
+    else
+        m_modelInstancing = format.version() >= qMakePair(3, 3);
+
     qRegisterMetaType<Qt3DRender::QRenderTarget *>("Qt3DRender::QRenderTarget*"); // wtf??
 }
 
@@ -466,6 +476,8 @@ Q3DSSceneManager::~Q3DSSceneManager()
     delete m_textMatGen;
     delete m_matGen;
     delete m_frameUpdater;
+    if (m_shaderPrograms && m_shaderPrograms->profiler() == m_profiler)
+        m_shaderPrograms->setProfiler(nullptr);
     delete m_profiler;
     delete m_inputManager;
 
@@ -586,6 +598,38 @@ void Q3DSSceneManager::setLayerCaching(bool enabled)
     m_layerUncachePending = !m_layerCaching;
 }
 
+void Q3DSSceneManager::setQuality(const Q3DSQualityGovernor::Quality &quality)
+{
+    const bool renderScaleChanged = !qFuzzyCompare(quality.layerRenderScale, m_quality.layerRenderScale);
+    const bool shadowMapResChanged = quality.shadowMapResolutionShift != m_quality.shadowMapResolutionShift;
+    m_quality = quality;
+
+    qCDebug(lcPerf, "Quality for %s: layer render scale %.2f, max progressive AA passes %d, shadow map resolution shift %d",
+            qPrintable(m_profiler->presentationName()), quality.layerRenderScale,
+            quality.maxProgressiveAAPasses, quality.shadowMapResolutionShift);
+
+    if (!m_scene)
+        return;
+
+    // The progressive AA limit is picked up in updateProgressiveAA(). Layer
+    // textures follow the render scale via the usual size-managed texture
+    // route, while shadow maps get recreated with the new size.
+    Q3DSUipPresentation::forAllLayers(m_scene, [=](Q3DSLayerNode *layer3DS) {
+        Q3DSLayerAttached *data = layer3DS->attached<Q3DSLayerAttached>();
+        if (!data || !data->layerFgRoot) // layers with a subpresentation won't have this
+            return;
+        if (renderScaleChanged) {
+            data->renderScale = quality.layerRenderScale;
+            setLayerSizeProperties(layer3DS);
+        }
+        if (shadowMapResChanged && !data->shadowMapData.shadowCasters.isEmpty())
+            updateShadowMapStatus(layer3DS);
+    });
+
+    // cached layers must be rendered again
+    m_layerUncachePending = true;
+}
+
 void Q3DSSceneManager::prepareAnimators()
 {
     m_slidePlayer->sceneReady();
@@ -607,6 +651,13 @@ void Q3DSSceneManager::prepareEngineReset()
 
     delete m_slidePlayer;
     m_slidePlayer = nullptr;
+    m_suspendedPlayers.clear();
+
+    // Drops the references to Qt 3D objects only. Decoded image data is kept
+    // for the next aspect engine. The image manager is shared with the other
+    // engines, so release this presentation's textures only.
+    if (m_rootEntity)
+        Q3DSImageManager::instance().releaseTextures(m_rootEntity);
 
 #if QT_CONFIG(q3ds_profileui)
     if (m_profileUi)
@@ -614,14 +665,6 @@ void Q3DSSceneManager::prepareEngineReset()
 #endif
 }
 
-void Q3DSSceneManager::prepareEngineResetGlobal()
-{
-    qCDebug(lcScene, "prepareEngineResetGlobal");
-
-    Q3DSImageManager::instance().invalidate();
-    Q3DSShaderManager::instance().invalidate();
-}
-
 /*
     Builds and "runs" a Qt 3D scene. To be called once per SceneManager instance.
 
@@ -657,6 +700,7 @@ Q3DSSceneManager::Scene Q3DSSceneManager::buildScene(Q3DSUipPresentation *presen
 
     m_engine = params.engine;
     m_flags = params.flags;
+    m_shaderPrograms = m_engine->shaderProgramCache();
 
     m_presentation = presentation;
     m_presentationSize = QSize(m_presentation->presentationWidth(), m_presentation->presentationHeight());
@@ -667,6 +711,11 @@ Q3DSSceneManager::Scene Q3DSSceneManager::buildScene(Q3DSUipPresentation *presen
     m_pendingSubPresLayers.clear();
     m_pendingSubPresImages.clear();
     m_subPresentations.clear();
+    m_subPresImages.clear();
+    m_qmlSubPresChangeCounts.clear();
+    m_inactiveSubPresentations.clear();
+    m_suspended = false;
+    m_suspendedPlayers.clear();
     m_profiler->resetForNewScene(this);
 
     m_profiler->setEnabled(m_flags.testFlag(EnableProfiling));
@@ -674,7 +723,7 @@ Q3DSSceneManager::Scene Q3DSSceneManager::buildScene(Q3DSUipPresentation *presen
     // All shader program info goes to the main presentation's profiler,
     // including programs from subpresentations.
     if (!m_flags.testFlag(SubPresentation))
-        Q3DSShaderManager::instance().setProfiler(m_profiler);
+        m_shaderPrograms->setProfiler(m_profiler);
 
     if (!m_scene) {
         qWarning("Q3DSSceneManager: No scene?");
@@ -693,6 +742,7 @@ Q3DSSceneManager::Scene Q3DSSceneManager::buildScene(Q3DSUipPresentation *presen
     m_rootEntity = new Qt3DCore::QEntity;
     m_rootEntity->setObjectName(QString(QLatin1String("non-layer root for presentation %1")).arg(m_presentation->name()));
     m_profiler->reportQt3DSceneGraphRoot(m_rootEntity);
+    m_texturePool.setParentNode(m_rootEntity);
 
     static const auto createSlideAttached = [](Q3DSSlide *slide, Qt3DCore::QEntity *entity) {
         if (!slide->attached()) {
@@ -702,15 +752,19 @@ Q3DSSceneManager::Scene Q3DSSceneManager::buildScene(Q3DSUipPresentation *presen
         }
     };
 
-    // Create the attached data object(s) and register for change notifications
+    // Create the attached data object(s), register for change notifications
+    // and compile the slide actions. (component slides get their actions
+    // compiled when they first see an event)
     createSlideAttached(m_masterSlide, m_rootEntity);
     m_masterSlide->attached<Q3DSSlideAttached>()->slideObjectChangeObserverIndex = m_masterSlide->addSlideObjectChangeObserver(
                 std::bind(&Q3DSSceneManager::handleSlideObjectChange, this, std::placeholders::_1, std::placeholders::_2));
+    actionDispatchTable(m_masterSlide);
     Q3DSSlide *subslide = static_cast<Q3DSSlide *>(m_masterSlide->firstChild());
     while (subslide) {
         createSlideAttached(subslide, m_rootEntity);
         subslide->attached<Q3DSSlideAttached>()->slideObjectChangeObserverIndex = subslide->addSlideObjectChangeObserver(
                     std::bind(&Q3DSSceneManager::handleSlideObjectChange, this, std::placeholders::_1, std::placeholders::_2));
+        actionDispatchTable(subslide);
         subslide = static_cast<Q3DSSlide *>(subslide->nextSibling());
     }
 
@@ -793,15 +847,15 @@ Q3DSSceneManager::Scene Q3DSSceneManager::buildScene(Q3DSUipPresentation *presen
     // Fullscreen quad for bluring the shadow map/cubemap
     Q3DSShaderManager &sm(Q3DSShaderManager::instance());
     QStringList fsQuadPassNames { QLatin1String("shadowOrthoBlurX"), QLatin1String("shadowOrthoBlurY") };
-    QVector<Qt3DRender::QShaderProgram *> fsQuadPassProgs { sm.getOrthoShadowBlurXShader(m_rootEntity), sm.getOrthoShadowBlurYShader(m_rootEntity) };
+    QVector<Qt3DRender::QShaderProgram *> fsQuadPassProgs { sm.getOrthoShadowBlurXShader(m_shaderPrograms, m_rootEntity), sm.getOrthoShadowBlurYShader(m_shaderPrograms, m_rootEntity) };
 
     if (!m_gfxLimits.useGles2Path) {
         if (m_gfxLimits.maxDrawBuffers >= 6) { // ###
             fsQuadPassNames << QLatin1String("shadowCubeBlurX") << QLatin1String("shadowCubeBlurY");
-            fsQuadPassProgs << sm.getCubeShadowBlurXShader(m_rootEntity, m_gfxLimits) << sm.getCubeShadowBlurYShader(m_rootEntity, m_gfxLimits);
+            fsQuadPassProgs << sm.getCubeShadowBlurXShader(m_shaderPrograms, m_rootEntity, m_gfxLimits) << sm.getCubeShadowBlurYShader(m_shaderPrograms, m_rootEntity, m_gfxLimits);
         }
         fsQuadPassNames << QLatin1String("ssao") << QLatin1String("progaa");
-        fsQuadPassProgs << sm.getSsaoTextureShader(m_rootEntity) << sm.getProgAABlendShader(m_rootEntity);
+        fsQuadPassProgs << sm.getSsaoTextureShader(m_shaderPrograms, m_rootEntity) << sm.getProgAABlendShader(m_shaderPrograms, m_rootEntity);
     }
     FsQuadParams quadInfo;
     quadInfo.parentEntity = m_rootEntity;
@@ -916,24 +970,17 @@ static Qt3DRender::QSortPolicy *transparentPassSortPolicy(Qt3DCore::QNode *paren
     return sortPolicy;
 }
 
-static Qt3DRender::QAbstractTexture *newColorBuffer(const QSize &layerPixelSize, int msaaSampleCount)
+static Q3DSTexturePool::Key colorBufferKey(const QSize &layerPixelSize, int msaaSampleCount)
 {
-    Qt3DRender::QAbstractTexture *colorTex;
-    if (msaaSampleCount > 1) {
-        colorTex = new Qt3DRender::QTexture2DMultisample;
-        colorTex->setSamples(msaaSampleCount);
-    } else {
-        colorTex = new Qt3DRender::QTexture2D;
-    }
-    colorTex->setFormat(Qt3DRender::QAbstractTexture::RGBA8_UNorm);
-    colorTex->setWidth(layerPixelSize.width());
-    colorTex->setHeight(layerPixelSize.height());
-    colorTex->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
-    colorTex->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
-    return colorTex;
+    return Q3DSTexturePool::Key(msaaSampleCount > 1 ? Qt3DRender::QAbstractTexture::Target2DMultisample
+                                                    : Qt3DRender::QAbstractTexture::Target2D,
+                                Qt3DRender::QAbstractTexture::RGBA8_UNorm,
+                                layerPixelSize,
+                                msaaSampleCount > 1 ? msaaSampleCount : 0);
 }
 
-static Qt3DRender::QAbstractTexture *newDepthStencilBuffer(const QSize &layerPixelSize, int msaaSampleCount, Qt3DRender::QAbstractTexture::TextureFormat format)
+static Q3DSTexturePool::Key depthStencilBufferKey(const QSize &layerPixelSize, int msaaSampleCount,
+                                                  Qt3DRender::QAbstractTexture::TextureFormat format)
 {
     // GLES <= 3.1 does not have glFramebufferTexture and support for combined
     // depth-stencil textures. Here we rely on the fact the Qt3D will
@@ -948,40 +995,71 @@ static Qt3DRender::QAbstractTexture *newDepthStencilBuffer(const QSize &layerPix
     // Therefore, on GLES 2.0, 3.0 and 3.1 we expect to get called with D16 (or
     // D24 or D32) and no stencil. (whereas GLES 3.2 or desktop GL will use D24S8)
 
-    Qt3DRender::QAbstractTexture *dsTexOrRb;
-    if (msaaSampleCount > 1) {
-        dsTexOrRb = new Qt3DRender::QTexture2DMultisample;
-        dsTexOrRb->setSamples(msaaSampleCount);
-    } else {
-        dsTexOrRb = new Qt3DRender::QTexture2D;
+    return Q3DSTexturePool::Key(msaaSampleCount > 1 ? Qt3DRender::QAbstractTexture::Target2DMultisample
+                                                    : Qt3DRender::QAbstractTexture::Target2D,
+                                format,
+                                layerPixelSize,
+                                msaaSampleCount > 1 ? msaaSampleCount : 0);
+}
+
+static Q3DSProfiler::ObjectType profilerObjectType(Qt3DRender::QAbstractTexture *texture)
+{
+    return texture->target() == Qt3DRender::QAbstractTexture::TargetCubeMap ? Q3DSProfiler::TextureCubeObject
+                                                                           : Q3DSProfiler::Texture2DObject;
+}
+
+// Render target textures are taken from the pool, where they may be recycled
+// from an earlier user with an identical target, format, size and sample count.
+Qt3DRender::QAbstractTexture *Q3DSSceneManager::acquireTexture(const Q3DSTexturePool::Key &key, const char *info, ...)
+{
+    bool reused = false;
+    Qt3DRender::QAbstractTexture *texture = m_texturePool.acquire(key, &reused);
+
+    if (m_profiler->isEnabled()) {
+        va_list ap;
+        va_start(ap, info);
+        const QString s = QString::vasprintf(info, ap);
+        va_end(ap);
+        if (reused)
+            m_profiler->updateObjectInfo(texture, profilerObjectType(texture), "%s", qPrintable(s));
+        else
+            m_profiler->trackNewObject(texture, profilerObjectType(texture), "%s", qPrintable(s));
     }
-    dsTexOrRb->setFormat(format);
-    dsTexOrRb->setWidth(layerPixelSize.width());
-    dsTexOrRb->setHeight(layerPixelSize.height());
-    dsTexOrRb->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
-    dsTexOrRb->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
-    return dsTexOrRb;
+
+    if (reused)
+        qCDebug(lcPerf, "Reusing pooled texture %p (%dx%d)", texture, key.size.width(), key.size.height());
+
+    return texture;
+}
+
+void Q3DSSceneManager::releaseTexture(Qt3DRender::QAbstractTexture *texture)
+{
+    if (!texture)
+        return;
+
+    m_profiler->updateObjectInfo(texture, profilerObjectType(texture), "Unused pooled texture");
+    m_texturePool.release(texture);
 }
 
 Qt3DRender::QRenderTarget *Q3DSSceneManager::newLayerRenderTarget(const QSize &layerPixelSize, int msaaSampleCount,
                                                                   Qt3DRender::QAbstractTexture **colorTex, Qt3DRender::QAbstractTexture **dsTexOrRb,
-                                                                  Qt3DCore::QNode *textureParentNode, Q3DSLayerNode *layer3DS,
+                                                                  Q3DSLayerNode *layer3DS,
                                                                   Qt3DRender::QAbstractTexture *existingDS)
 {
     Qt3DRender::QRenderTarget *rt = new Qt3DRender::QRenderTarget;
 
     Qt3DRender::QRenderTargetOutput *color = new Qt3DRender::QRenderTargetOutput;
     color->setAttachmentPoint(Qt3DRender::QRenderTargetOutput::Color0);
-    *colorTex = newColorBuffer(layerPixelSize, msaaSampleCount);
-    m_profiler->trackNewObject(*colorTex, Q3DSProfiler::Texture2DObject,
+    *colorTex = acquireTexture(colorBufferKey(layerPixelSize, msaaSampleCount),
                                "Color buffer for layer %s", layer3DS->id().constData());
-    (*colorTex)->setParent(textureParentNode);
+    (*colorTex)->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
+    (*colorTex)->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
     color->setTexture(*colorTex);
     rt->addOutput(color);
 
     Qt3DRender::QRenderTargetOutput *ds = new Qt3DRender::QRenderTargetOutput;
     bool noStencil = !m_gfxLimits.packedDepthStencilBufferSupported; // GLES 2.0
-    // see newDepthStencilBuffer for a detailed description of this mess
+    // see depthStencilBufferKey for a detailed description of this mess
     noStencil |= m_gfxLimits.format.renderableType() == QSurfaceFormat::OpenGLES
             && Q3DS::graphicsLimits().format.version() <= qMakePair(3, 1);
     Qt3DRender::QAbstractTexture::TextureFormat textureFormat =
@@ -993,10 +1071,10 @@ Qt3DRender::QRenderTarget *Q3DSSceneManager::newLayerRenderTarget(const QSize &l
             qCDebug(lcScene, "Render target depth-stencil attachment uses D16 (no stencil)");
         else
             qCDebug(lcScene, "Render target depth-stencil attachment uses D24S8");
-        *dsTexOrRb = newDepthStencilBuffer(layerPixelSize, msaaSampleCount, textureFormat);
-        m_profiler->trackNewObject(*dsTexOrRb, Q3DSProfiler::Texture2DObject,
-                                   "Depth-stencil buffer for layer %s", layer3DS->id().constData());
-        (*dsTexOrRb)->setParent(textureParentNode);
+        *dsTexOrRb = acquireTexture(depthStencilBufferKey(layerPixelSize, msaaSampleCount, textureFormat),
+                                    "Depth-stencil buffer for layer %s", layer3DS->id().constData());
+        (*dsTexOrRb)->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
+        (*dsTexOrRb)->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
     } else {
         *dsTexOrRb = existingDS;
     }
@@ -1008,7 +1086,7 @@ Qt3DRender::QRenderTarget *Q3DSSceneManager::newLayerRenderTarget(const QSize &l
     return rt;
 }
 
-static QSize safeLayerPixelSize(const QSize &layerSize, int scaleFactor)
+static QSize safeLayerPixelSize(const QSize &layerSize, float scaleFactor)
 {
     const QSize layerPixelSize = layerSize * scaleFactor;
     return QSize(layerPixelSize.width() > 0 ? layerPixelSize.width() : 32,
@@ -1017,7 +1095,13 @@ static QSize safeLayerPixelSize(const QSize &layerSize, int scaleFactor)
 
 static QSize safeLayerPixelSize(Q3DSLayerAttached *data)
 {
-    return safeLayerPixelSize(data->layerSize, data->ssaaScaleFactor);
+    return safeLayerPixelSize(data->layerSize, data->ssaaScaleFactor * data->renderScale);
+}
+
+// for when SSAA is to be ignored (but the render scale is not)
+static QSize safeResolvedLayerPixelSize(Q3DSLayerAttached *data)
+{
+    return safeLayerPixelSize(data->layerSize, data->renderScale);
 }
 
 void Q3DSSceneManager::prepareLayerContent(Q3DSGraphObject *subTreeRoot)
@@ -1076,12 +1160,13 @@ void Q3DSSceneManager::buildLayer(Q3DSLayerNode *layer3DS,
 
     // parentSize could well be (0, 0) at this stage still, nevermind that
     const QSize layerSize = calculateLayerSize(layer3DS, parentSize);
-    const QSize layerPixelSize = safeLayerPixelSize(layerSize, ssaaScaleFactor);
+    const float renderScale = m_quality.layerRenderScale;
+    const QSize layerPixelSize = safeLayerPixelSize(layerSize, ssaaScaleFactor * renderScale);
 
     // Create color and depth-stencil buffers for this layer
     Qt3DRender::QAbstractTexture *colorTex;
     Qt3DRender::QAbstractTexture *dsTexOrRb;
-    Qt3DRender::QRenderTarget *rt = newLayerRenderTarget(layerPixelSize, msaaSampleCount, &colorTex, &dsTexOrRb, layerFgRoot, layer3DS);
+    Qt3DRender::QRenderTarget *rt = newLayerRenderTarget(layerPixelSize, msaaSampleCount, &colorTex, &dsTexOrRb, layer3DS);
     m_profiler->trackNewObject(rt, Q3DSProfiler::RenderTargetObject,
                                "RT for layer %s", layer3DS->id().constData());
     rtSelector->setTarget(rt);
@@ -1100,6 +1185,10 @@ void Q3DSSceneManager::buildLayer(Q3DSLayerNode *layer3DS,
     opaqueTag->setObjectName(QLatin1String("Opaque pass"));
     Qt3DRender::QLayer *transparentTag = new Qt3DRender::QLayer(m_rootEntity);
     transparentTag->setObjectName(QLatin1String("Transparent pass"));
+    Qt3DRender::QLayer *instancedOpaqueTag = new Qt3DRender::QLayer(m_rootEntity);
+    instancedOpaqueTag->setObjectName(QLatin1String("Opaque pass (instanced)"));
+    Qt3DRender::QLayer *instancedTransparentTag = new Qt3DRender::QLayer(m_rootEntity);
+    instancedTransparentTag->setObjectName(QLatin1String("Transparent pass (instanced)"));
 
     // Depth texture pass, optional, with its own rendertarget and clear. Just
     // a placeholder for now since it is disabled by default.
@@ -1133,8 +1222,11 @@ void Q3DSSceneManager::buildLayer(Q3DSLayerNode *layer3DS,
     Qt3DRender::QLayerFilter *depthPreLayerFilter = new Qt3DRender::QLayerFilter(depthPreSortPolicy);
     const bool depthPrePassEnabled = !layer3DS->layerFlags().testFlag(Q3DSLayerNode::DisableDepthPrePass)
             && !layer3DS->layerFlags().testFlag(Q3DSLayerNode::DisableDepthTest);
-    if (depthPrePassEnabled)
-        depthPreLayerFilter->addLayer(opaqueTag); // opaque only, transparent objects must not be present
+    if (depthPrePassEnabled) {
+        // opaque only, transparent objects must not be present
+        depthPreLayerFilter->addLayer(opaqueTag);
+        depthPreLayerFilter->addLayer(instancedOpaqueTag);
+    }
 
     const bool transparentPassOnly = layer3DS->layerFlags().testFlag(Q3DSLayerNode::DisableDepthTest);
 
@@ -1148,6 +1240,7 @@ void Q3DSSceneManager::buildLayer(Q3DSLayerNode *layer3DS,
         Qt3DRender::QSortPolicy *opaqueSortPolicy = opaquePassSortPolicy(opaqueFilter);
         Qt3DRender::QLayerFilter *opaqueLayerFilter = new Qt3DRender::QLayerFilter(opaqueSortPolicy);
         opaqueLayerFilter->addLayer(opaqueTag);
+        opaqueLayerFilter->addLayer(instancedOpaqueTag);
     }
 
     // Transparent pass, sort back to front
@@ -1159,8 +1252,11 @@ void Q3DSSceneManager::buildLayer(Q3DSLayerNode *layer3DS,
     Qt3DRender::QSortPolicy *transSortPolicy = transparentPassSortPolicy(transFilter);
     Qt3DRender::QLayerFilter *transLayerFilter = new Qt3DRender::QLayerFilter(transSortPolicy);
     transLayerFilter->addLayer(transparentTag);
-    if (transparentPassOnly)
+    transLayerFilter->addLayer(instancedTransparentTag);
+    if (transparentPassOnly) {
         transLayerFilter->addLayer(opaqueTag);
+        transLayerFilter->addLayer(instancedOpaqueTag);
+    }
 
     // Post-processing effect passes
     Qt3DRender::QFrameGraphNode *effectRoot = new Qt3DRender::QFrameGraphNode(mainTechniqueSelector);
@@ -1192,8 +1288,11 @@ void Q3DSSceneManager::buildLayer(Q3DSLayerNode *layer3DS,
     layerData->parentSize = parentSize;
     layerData->msaaSampleCount = msaaSampleCount;
     layerData->ssaaScaleFactor = ssaaScaleFactor;
+    layerData->renderScale = renderScale;
     layerData->opaqueTag = opaqueTag;
     layerData->transparentTag = transparentTag;
+    layerData->instancedOpaqueTag = instancedOpaqueTag;
+    layerData->instancedTransparentTag = instancedTransparentTag;
     layerData->cameraPropertiesParam = new Qt3DRender::QParameter(QLatin1String("camera_properties"), QVector2D(10, 5000), m_rootEntity);
     layerData->depthTextureData.rtSelector = depthRtSelector;
     layerData->ssaoTextureData.rtSelector = ssaoRtSelector;
@@ -1250,6 +1349,10 @@ void Q3DSSceneManager::buildLayer(Q3DSLayerNode *layer3DS,
     // before generating materials below.
     updateSsaoStatus(layer3DS);
 
+    // Generate the material shaders for the whole layer up front, in
+    // parallel. Must be done after the lights, shadow and SSAO status.
+    pregenerateMaterialShaders(layer3DS);
+
     // Generate Qt3D material components.
     Q3DSUipPresentation::forAllModels(layer3DS->firstChild(),
                                       [this](Q3DSModelNode *model3DS) { buildModelMaterial(model3DS); },
@@ -1371,7 +1474,8 @@ static void setMaterialBlending(Qt3DRender::QBlendEquation *blendFunc,
     }
 }
 
-QVector<Qt3DRender::QRenderPass *> Q3DSSceneManager::standardRenderPasses(Qt3DRender::QShaderProgram *program,
+QVector<Qt3DRender::QRenderPass *> Q3DSSceneManager::standardRenderPasses(Q3DSShaderProgramCache *programs,
+                                                                          Qt3DRender::QShaderProgram *program,
                                                                           Q3DSLayerNode *layer3DS,
                                                                           Q3DSDefaultMaterial::BlendMode blendMode,
                                                                           bool hasDisplacement)
@@ -1442,16 +1546,17 @@ QVector<Qt3DRender::QRenderPass *> Q3DSSceneManager::standardRenderPasses(Qt3DRe
     Q3DSLayerAttached *layerData = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
     Q_ASSERT(layerData && layerData->entity);
 
-    shadowOrthoPass->setShaderProgram(Q3DSShaderManager::instance().getOrthographicDepthNoTessShader(layerData->entity));
-    shadowCubePass->setShaderProgram(Q3DSShaderManager::instance().getCubeDepthNoTessShader(layerData->entity));
-    depthPass->setShaderProgram(Q3DSShaderManager::instance().getDepthPrepassShader(layerData->entity, hasDisplacement));
+    Q3DSShaderManager &sm(Q3DSShaderManager::instance());
+    shadowOrthoPass->setShaderProgram(sm.getOrthographicDepthNoTessShader(programs, layerData->entity));
+    shadowCubePass->setShaderProgram(sm.getCubeDepthNoTessShader(programs, layerData->entity));
+    depthPass->setShaderProgram(sm.getDepthPrepassShader(programs, layerData->entity, hasDisplacement));
     opaquePass->setShaderProgram(program);
     transPass->setShaderProgram(program);
 
     return { shadowOrthoPass, shadowCubePass, depthPass, opaquePass, transPass };
 }
 
-QVector<Qt3DRender::QTechnique *> Q3DSSceneManager::computeTechniques(Q3DSLayerNode *layer3DS)
+QVector<Qt3DRender::QTechnique *> Q3DSSceneManager::computeTechniques(Q3DSShaderProgramCache *programs, Q3DSLayerNode *layer3DS)
 {
 #if 0
     Qt3DRender::QTechnique *bsdfPrefilter = new Qt3DRender::QTechnique;
@@ -1466,11 +1571,12 @@ QVector<Qt3DRender::QTechnique *> Q3DSSceneManager::computeTechniques(Q3DSLayerN
     Qt3DRender::QRenderPass *bsdfComputePass = new Qt3DRender::QRenderPass;
     Q3DSLayerAttached *layerData = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
     Q_ASSERT(layerData && layerData->entity);
-    bsdfComputePass->setShaderProgram(Q3DSShaderManager::instance().getBsdfMipPreFilterShader(layerData->entity));
+    bsdfComputePass->setShaderProgram(Q3DSShaderManager::instance().getBsdfMipPreFilterShader(programs, layerData->entity));
     bsdfPrefilter->addRenderPass(bsdfComputePass);
 
     return { bsdfPrefilter };
 #endif
+    Q_UNUSED(programs);
     Q_UNUSED(layer3DS);
     return {};
 }
@@ -1674,7 +1780,7 @@ void Q3DSSceneManager::setLayerSizeProperties(Q3DSLayerNode *layer3DS)
 {
     Q3DSLayerAttached *data = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
     const QSize layerPixelSize = safeLayerPixelSize(data);
-    const QSize layerSize = safeLayerPixelSize(data->layerSize, 1); // for when SSAA is to be ignored
+    const QSize layerSize = safeResolvedLayerPixelSize(data);
     for (const Q3DSLayerAttached::SizeManagedTexture &t : data->sizeManagedTextures) {
         if (!t.flags.testFlag(Q3DSLayerAttached::SizeManagedTexture::CustomSizeCalculation)) {
             if (!t.flags.testFlag(Q3DSLayerAttached::SizeManagedTexture::IgnoreSSAA)) {
@@ -1753,7 +1859,7 @@ void Q3DSSceneManager::setLayerProperties(Q3DSLayerNode *layer3DS)
         // initialize light probe parameters if necessary
         if (!data->iblProbeData.lightProbeTexture) {
             data->iblProbeData.lightProbeTexture = Q3DSImageManager::instance().newTextureForImage(
-                        m_rootEntity, Q3DSImageManager::GenerateMipMapsForIBL,
+                        m_rootEntity, Q3DSImageManager::instance().lightProbeImageFlags(),
                         m_profiler, "iblProbe texture for image %s", layer3DS->lightProbe()->id().constData());
         }
         if (!data->iblProbeData.lightProbeSampler) {
@@ -1813,7 +1919,7 @@ void Q3DSSceneManager::setLayerProperties(Q3DSLayerNode *layer3DS)
             // Initialize light probe 2 parameters
             if (!data->iblProbeData.lightProbe2Texture) {
                 data->iblProbeData.lightProbe2Texture = Q3DSImageManager::instance().newTextureForImage(
-                            m_rootEntity, Q3DSImageManager::GenerateMipMapsForIBL,
+                            m_rootEntity, Q3DSImageManager::instance().lightProbeImageFlags(),
                             m_profiler, "iblProbe2 texture for image %s", layer3DS->lightProbe2()->id().constData());
             }
 
@@ -2007,8 +2113,8 @@ static void prepareSizeDependentTexture(Qt3DRender::QAbstractTexture *texture,
 {
     Q3DSLayerAttached *data = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
 
-    const int scale = !flags.testFlag(Q3DSLayerAttached::SizeManagedTexture::IgnoreSSAA) ? data->ssaaScaleFactor : 1;
-    const QSize layerPixelSize = safeLayerPixelSize(data->layerSize, scale);
+    const QSize layerPixelSize = !flags.testFlag(Q3DSLayerAttached::SizeManagedTexture::IgnoreSSAA)
+            ? safeLayerPixelSize(data) : safeResolvedLayerPixelSize(data);
     texture->setWidth(layerPixelSize.width());
     texture->setHeight(layerPixelSize.height());
 
@@ -2027,10 +2133,10 @@ void Q3DSSceneManager::setDepthTextureEnabled(Q3DSLayerNode *layer3DS, bool enab
     qCDebug(lcPerf, "Depth texture enabled for layer %s is now %d", layer3DS->id().constData(), enabled);
     if (enabled) {
         if (!data->depthTextureData.depthTexture) {
-            Qt3DRender::QTexture2D *depthTex = new Qt3DRender::QTexture2D;
-            m_profiler->trackNewObject(depthTex, Q3DSProfiler::Texture2DObject,
-                                       "Depth texture for layer %s", layer3DS->id().constData());
-            depthTex->setFormat(Qt3DRender::QAbstractTexture::DepthFormat);
+            Qt3DRender::QAbstractTexture *depthTex = acquireTexture(Q3DSTexturePool::Key(Qt3DRender::QAbstractTexture::Target2D,
+                                                                                         Qt3DRender::QAbstractTexture::DepthFormat,
+                                                                                         safeLayerPixelSize(data)),
+                                                                    "Depth texture for layer %s", layer3DS->id().constData());
             depthTex->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
             depthTex->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
             prepareSizeDependentTexture(depthTex, layer3DS);
@@ -2065,11 +2171,15 @@ void Q3DSSceneManager::setDepthTextureEnabled(Q3DSLayerNode *layer3DS, bool enab
 
         data->depthTextureData.clearBuffers->setEnabled(true);
         data->depthTextureData.layerFilterOpaque->addLayer(data->opaqueTag);
+        data->depthTextureData.layerFilterOpaque->addLayer(data->instancedOpaqueTag);
         data->depthTextureData.layerFilterTransparent->addLayer(data->transparentTag);
+        data->depthTextureData.layerFilterTransparent->addLayer(data->instancedTransparentTag);
     } else if (data->depthTextureData.depthTexture) {
         data->depthTextureData.clearBuffers->setEnabled(false);
         data->depthTextureData.layerFilterOpaque->removeLayer(data->opaqueTag);
+        data->depthTextureData.layerFilterOpaque->removeLayer(data->instancedOpaqueTag);
         data->depthTextureData.layerFilterTransparent->removeLayer(data->transparentTag);
+        data->depthTextureData.layerFilterTransparent->removeLayer(data->instancedTransparentTag);
     }
 }
 
@@ -2087,10 +2197,8 @@ void Q3DSSceneManager::setSsaoTextureEnabled(Q3DSLayerNode *layer3DS, bool enabl
         setDepthTextureEnabled(layer3DS, true);
 
         if (!data->ssaoTextureData.ssaoTexture) {
-            Qt3DRender::QTexture2D *ssaoTex = new Qt3DRender::QTexture2D;
-            m_profiler->trackNewObject(ssaoTex, Q3DSProfiler::Texture2DObject,
-                                       "SSAO texture for layer %s", layer3DS->id().constData());
-            ssaoTex->setFormat(Qt3DRender::QAbstractTexture::RGBA8_UNorm);
+            Qt3DRender::QAbstractTexture *ssaoTex = acquireTexture(colorBufferKey(safeLayerPixelSize(data), 0),
+                                                                   "SSAO texture for layer %s", layer3DS->id().constData());
             ssaoTex->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
             ssaoTex->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
             // it's not just the texture that needs dynamic resizing, but values
@@ -2494,10 +2602,22 @@ void Q3DSSceneManager::genOrthoBlurPassFg(Q3DSLayerAttached::PerLightShadowMapDa
     filter->addParameter(d->shadowCamPropsParam);
 }
 
+void Q3DSSceneManager::setLightShadowIdx(Q3DSLightNode *light3DS, qint32 idx)
+{
+    Q3DSLightAttached *data = light3DS->attached<Q3DSLightAttached>();
+    data->lightSourceData.m_shadowIdx = idx;
+    if (data->lightSource.shadowIdxParam)
+        data->lightSource.shadowIdxParam->setValue(idx);
+}
+
+static const qint32 MIN_SHADOW_MAP_SIZE = 64;
+
 void Q3DSSceneManager::updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDidChange)
 {
     Q3DSLayerAttached *layerData = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
     Q_ASSERT(layerData);
+    // light, camera and layer changes all end up here
+    layerData->shadowMapData.dirty = true;
     const int oldShadowCasterCount = layerData->shadowMapData.shadowCasters.count();
     int lightIdx = 0;
     int orthoCasterIdx = 0;
@@ -2531,7 +2651,7 @@ void Q3DSSceneManager::updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDi
             }
             d->active = true;
 
-            const qint32 size = 1 << light3DS->shadowMapRes();
+            const qint32 size = qMax(MIN_SHADOW_MAP_SIZE, (1 << light3DS->shadowMapRes()) >> m_quality.shadowMapResolutionShift);
             bool needsNewTextures = false;
             if (d->shadowDS) {
                 const QSize currentSize(d->shadowDS->width(), d->shadowDS->height());
@@ -2545,8 +2665,7 @@ void Q3DSSceneManager::updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDi
             }
             if (needsNewTextures) {
                 qCDebug(lcPerf, "Slow path! Recreating shadow map textures for light %s", light3DS->id().constData());
-                d->shadowDS = nullptr;
-                d->shadowMapTexture = nullptr;
+                releaseShadowMapTextures(layerData, d);
                 // Regenerate the whole framegraph. A change in shadow map resolution
                 // is not something that should happen frequently (or at all).
                 delete d->subTreeRoot;
@@ -2560,14 +2679,12 @@ void Q3DSSceneManager::updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDi
                 needsFramegraph = true;
             }
 
-            Qt3DCore::QNode *texParent = d->subTreeRoot;
             if (!d->shadowDS) {
                 auto createDepthStencil = [size, this]() {
-                    Qt3DRender::QTexture2D *dsTexOrRb = new Qt3DRender::QTexture2D;
-                    m_profiler->trackNewObject(dsTexOrRb, Q3DSProfiler::Texture2DObject, "Shadow map depth");
-                    dsTexOrRb->setFormat(Qt3DRender::QAbstractTexture::D16);
-                    dsTexOrRb->setWidth(size);
-                    dsTexOrRb->setHeight(size);
+                    Qt3DRender::QAbstractTexture *dsTexOrRb = acquireTexture(Q3DSTexturePool::Key(Qt3DRender::QAbstractTexture::Target2D,
+                                                                                                  Qt3DRender::QAbstractTexture::D16,
+                                                                                                  QSize(size, size)),
+                                                                             "Shadow map depth");
                     dsTexOrRb->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
                     dsTexOrRb->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
                     return dsTexOrRb;
@@ -2582,14 +2699,12 @@ void Q3DSSceneManager::updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDi
                     if (availSize == QSize(size, size)) {
                         d->shadowDS = layerData->shadowMapData.defaultShadowDS;
                     } else {
+                        // returned to the pool when this framegraph subtree goes away
                         d->shadowDS = createDepthStencil();
-                        // owned by this framegraph subtree
-                        d->shadowDS->setParent(texParent);
                     }
                 } else {
+                    // kept for the lifetime of the layer
                     layerData->shadowMapData.defaultShadowDS = createDepthStencil();
-                    // parent it so that it outlives this framegraph subtree
-                    layerData->shadowMapData.defaultShadowDS->setParent(layerData->entity);
                     d->shadowDS = layerData->shadowMapData.defaultShadowDS;
                 }
             }
@@ -2598,22 +2713,6 @@ void Q3DSSceneManager::updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDi
             const bool isCube = light3DS->lightType() != Q3DSLightNode::Directional;
 
             if (!d->shadowMapTexture) {
-                if (isCube) {
-                    d->shadowMapTexture = new Qt3DRender::QTextureCubeMap(texParent);
-                    m_profiler->trackNewObject(d->shadowMapTexture, Q3DSProfiler::TextureCubeObject,
-                                               "Shadow map for light %s", light3DS->id().constData());
-                    d->shadowMapTextureTemp = new Qt3DRender::QTextureCubeMap(texParent);
-                    m_profiler->trackNewObject(d->shadowMapTexture, Q3DSProfiler::TextureCubeObject,
-                                               "Shadow map temp buffer for light %s", light3DS->id().constData());
-                } else {
-                    d->shadowMapTexture = new Qt3DRender::QTexture2D(texParent);
-                    m_profiler->trackNewObject(d->shadowMapTexture, Q3DSProfiler::Texture2DObject,
-                                               "Shadow map for light %s", light3DS->id().constData());
-                    d->shadowMapTextureTemp = new Qt3DRender::QTexture2D(texParent);
-                    m_profiler->trackNewObject(d->shadowMapTexture, Q3DSProfiler::Texture2DObject,
-                                               "Shadow map temp buffer for light %s", light3DS->id().constData());
-                }
-
                 Qt3DRender::QAbstractTexture::TextureFormat format = Qt3DRender::QAbstractTexture::R16_UNorm;
                 // GL_R16 does not seem to exist in OpenGL ES unless GL_EXT_texture_norm16
                 // is present.  Fall back to the GL_R8 when not supported (but this leads
@@ -2621,8 +2720,11 @@ void Q3DSSceneManager::updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDi
                 if (!m_gfxLimits.norm16TexturesSupported)
                     format = Qt3DRender::QAbstractTexture::R8_UNorm;
 
-                d->shadowMapTexture->setFormat(format);
-                d->shadowMapTextureTemp->setFormat(format);
+                const Q3DSTexturePool::Key key(isCube ? Qt3DRender::QAbstractTexture::TargetCubeMap
+                                                      : Qt3DRender::QAbstractTexture::Target2D,
+                                               format, QSize(size, size));
+                d->shadowMapTexture = acquireTexture(key, "Shadow map for light %s", light3DS->id().constData());
+                d->shadowMapTextureTemp = acquireTexture(key, "Shadow map temp buffer for light %s", light3DS->id().constData());
 
                 d->shadowMapTexture->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
                 d->shadowMapTextureTemp->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
@@ -2631,8 +2733,6 @@ void Q3DSSceneManager::updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDi
 
                 qCDebug(lcScene, "Shadow cube map size for light %s is %d", light3DS->id().constData(), size);
                 // do not add to layerData->sizeManagedTextures since the shadow map size is fixed
-                d->shadowMapTexture->setSize(size, size, 1);
-                d->shadowMapTextureTemp->setSize(size, size, 1);
             }
 
             // now the framegraph subtree
@@ -2720,6 +2820,7 @@ void Q3DSSceneManager::updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDi
                         Qt3DRender::QSortPolicy *sortPolicyOpaque = opaquePassSortPolicy(shadowFilter);
                         Qt3DRender::QLayerFilter *layerFilterOpaque = new Qt3DRender::QLayerFilter(sortPolicyOpaque);
                         layerFilterOpaque->addLayer(layerData->opaqueTag);
+                        layerFilterOpaque->addLayer(layerData->instancedOpaqueTag);
                         shadowFilter->addParameter(d->cameraPositionParam);
                         shadowFilter->addParameter(layerData->cameraPropertiesParam);
 
@@ -2728,6 +2829,7 @@ void Q3DSSceneManager::updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDi
                         Qt3DRender::QSortPolicy *sortPolicyTransparent = transparentPassSortPolicy(shadowFilter);
                         Qt3DRender::QLayerFilter *layerFilterTransparent = new Qt3DRender::QLayerFilter(sortPolicyTransparent);
                         layerFilterTransparent->addLayer(layerData->transparentTag);
+                        layerFilterTransparent->addLayer(layerData->instancedTransparentTag);
                         shadowFilter->addParameter(d->cameraPositionParam);
                         shadowFilter->addParameter(layerData->cameraPropertiesParam);
                     }
@@ -2781,12 +2883,14 @@ void Q3DSSceneManager::updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDi
                     Qt3DRender::QSortPolicy *sortPolicyOpaque = opaquePassSortPolicy(shadowFilter);
                     Qt3DRender::QLayerFilter *layerFilterOpaque = new Qt3DRender::QLayerFilter(sortPolicyOpaque);
                     layerFilterOpaque->addLayer(layerData->opaqueTag);
+                    layerFilterOpaque->addLayer(layerData->instancedOpaqueTag);
 
                     shadowFilter = new Qt3DRender::QRenderPassFilter(camSel);
                     shadowFilter->addMatch(shadowFilterKey);
                     Qt3DRender::QSortPolicy *sortPolicyTransparent = transparentPassSortPolicy(shadowFilter);
                     Qt3DRender::QLayerFilter *layerFilterTransparent = new Qt3DRender::QLayerFilter(sortPolicyTransparent);
                     layerFilterTransparent->addLayer(layerData->transparentTag);
+                    layerFilterTransparent->addLayer(layerData->instancedTransparentTag);
 
                     // 2 blur passes
                     genOrthoBlurPassFg(d, d->shadowMapTexture, d->shadowMapTextureTemp, QLatin1String("shadowOrthoBlurX"), light3DS);
@@ -2812,17 +2916,17 @@ void Q3DSSceneManager::updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDi
             }
 
             if (isCube) {
-                light3DS->attached<Q3DSLightAttached>()->lightSource.shadowIdxParam->setValue(cubeCasterIdx);
+                setLightShadowIdx(light3DS, cubeCasterIdx);
                 ++cubeCasterIdx;
                 Q_ASSERT(custMatCubeShadowMaps.count() == cubeCasterIdx);
             } else {
-                light3DS->attached<Q3DSLightAttached>()->lightSource.shadowIdxParam->setValue(orthoCasterIdx);
+                setLightShadowIdx(light3DS, orthoCasterIdx);
                 ++orthoCasterIdx;
                 Q_ASSERT(custMatOrthoShadowMaps.count() == orthoCasterIdx);
             }
         } else {
             // non-shadow-casting light
-            light3DS->attached<Q3DSLightAttached>()->lightSource.shadowIdxParam->setValue(-1);
+            setLightShadowIdx(light3DS, -1);
         }
     }
 
@@ -2841,7 +2945,8 @@ void Q3DSSceneManager::updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDi
         auto &sc = layerData->shadowMapData.shadowCasters[i];
         if (!sc.active) {
             qCDebug(lcScene, "Shadow casting light %s is gone", sc.lightNode->id().constData());
-            delete sc.subTreeRoot; // bye bye framegraph and shadow map textures
+            releaseShadowMapTextures(layerData, &sc);
+            delete sc.subTreeRoot; // bye bye framegraph
             layerData->shadowMapData.shadowCasters.remove(i--);
         }
     }
@@ -2854,6 +2959,94 @@ void Q3DSSceneManager::updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDi
         qCDebug(lcPerf, "Layer %s has %d shadow casting lights", layer3DS->id().constData(), layerData->shadowMapData.shadowCasters.count());
 }
 
+void Q3DSSceneManager::releaseShadowMapTextures(Q3DSLayerAttached *layerData, Q3DSLayerAttached::PerLightShadowMapData *d)
+{
+    // The default depth-stencil buffer is shared between lights, leave it be.
+    if (d->shadowDS != layerData->shadowMapData.defaultShadowDS)
+        releaseTexture(d->shadowDS);
+    releaseTexture(d->shadowMapTexture);
+    releaseTexture(d->shadowMapTextureTemp);
+    d->shadowDS = nullptr;
+    d->shadowMapTexture = nullptr;
+    d->shadowMapTextureTemp = nullptr;
+}
+
+// Called when the layer is gone for good, after its framegraph subtree (and so
+// the render targets referencing the textures) has been destroyed. Layers
+// showing a subpresentation have no pooled textures at all.
+void Q3DSSceneManager::releaseLayerTextures(Q3DSLayerAttached *layerData)
+{
+    // The same texture can be referenced from multiple places, e.g. the
+    // progressive AA buffers are size-managed too.
+    QSet<Qt3DRender::QAbstractTexture *> textures;
+    for (const Q3DSLayerAttached::SizeManagedTexture &t : qAsConst(layerData->sizeManagedTextures))
+        textures.insert(t.texture);
+    textures << layerData->progAA.stolenColorBuf << layerData->progAA.extraColorBuf
+             << layerData->tempAA.stolenColorBuf << layerData->tempAA.extraColorBuf
+             << layerData->shadowMapData.defaultShadowDS;
+    for (Q3DSLayerAttached::PerLightShadowMapData &d : layerData->shadowMapData.shadowCasters)
+        textures << d.shadowDS << d.shadowMapTexture << d.shadowMapTextureTemp;
+    textures.remove(nullptr);
+
+    for (Qt3DRender::QAbstractTexture *texture : qAsConst(textures))
+        releaseTexture(texture);
+
+    layerData->sizeManagedTextures.clear();
+    layerData->shadowMapData.shadowCasters.clear();
+    layerData->shadowMapData.defaultShadowDS = nullptr;
+    layerData->layerTexture = layerData->layerDS = layerData->effLayerTexture = nullptr;
+    layerData->progAA.stolenColorBuf = layerData->progAA.extraColorBuf = nullptr;
+    layerData->tempAA.stolenColorBuf = layerData->tempAA.extraColorBuf = nullptr;
+}
+
+static void markShadowMapsDirty(Q3DSLayerNode *layer3DS)
+{
+    Q3DSLayerAttached *layerData = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
+    if (layerData)
+        layerData->shadowMapData.dirty = true;
+}
+
+// Shadow maps are cached the same way as layers: when nothing that could
+// affect them (lights, the camera, the transform, mesh or visibility of any
+// model in the layer) changed for a number of frames, the per-light shadow
+// framegraph subtrees are moved out of the framegraph and the shadow map
+// textures keep their previous contents.
+void Q3DSSceneManager::updateShadowMapCaching(Q3DSLayerNode *layer3DS)
+{
+    Q3DSLayerAttached *layerData = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
+    Q3DSLayerAttached::ShadowMapData &smData(layerData->shadowMapData);
+    if (!smData.shadowRoot || smData.shadowCasters.isEmpty())
+        return;
+
+    static const bool layerCacheDebug = qEnvironmentVariableIntValue("Q3DS_DEBUG") >= 2;
+    if (!smData.dirty && !m_layerUncachePending) {
+        ++smData.nonDirtyRenderCount;
+        if (smData.nonDirtyRenderCount > LAYER_CACHING_THRESHOLD) {
+            smData.nonDirtyRenderCount = 0;
+            if (m_layerCaching) {
+                for (const Q3DSLayerAttached::PerLightShadowMapData &d : qAsConst(smData.shadowCasters)) {
+                    if (d.subTreeRoot && d.subTreeRoot->parentNode() != layerData->layerFgDummyParent) {
+                        if (layerCacheDebug)
+                            qCDebug(lcScene, "Switching shadow map for light %s to cached", d.lightNode->id().constData());
+                        d.subTreeRoot->setParent(layerData->layerFgDummyParent);
+                    }
+                }
+            }
+        }
+    } else {
+        smData.nonDirtyRenderCount = 0;
+        for (const Q3DSLayerAttached::PerLightShadowMapData &d : qAsConst(smData.shadowCasters)) {
+            if (d.subTreeRoot && d.subTreeRoot->parentNode() != smData.shadowRoot) {
+                if (layerCacheDebug)
+                    qCDebug(lcScene, "Switching shadow map for light %s to non-cached", d.lightNode->id().constData());
+                d.subTreeRoot->setParent(smData.shadowRoot);
+            }
+        }
+    }
+
+    smData.dirty = false;
+}
+
 static Qt3DRender::QRenderTargetSelector *createProgressiveTemporalAAFramegraph(Qt3DCore::QNode *parent,
                                                                                 Qt3DRender::QRenderTarget *rt,
                                                                                 Qt3DRender::QLayer *tag,
@@ -2905,20 +3098,21 @@ void Q3DSSceneManager::stealLayerRenderTarget(Qt3DRender::QAbstractTexture **sto
 {
     Q3DSLayerAttached *data = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
     if (*stolenColorBuf) {
-        // the previous stolen color buffer it not needed anymore
+        // The previous stolen color buffer is not needed anymore. Give it
+        // back to the pool, it will likely become the new color buffer below.
         data->sizeManagedTextures.removeOne(*stolenColorBuf);
-        delete *stolenColorBuf;
+        releaseTexture(*stolenColorBuf);
     }
+    // The stolen buffer stays size-managed, it must follow the layer's size
+    // like the new color buffer below.
     *stolenColorBuf = data->effectActive ? data->effLayerTexture : data->layerTexture;
     // create a whole new render target for the layer
-    data->sizeManagedTextures.removeOne(*stolenColorBuf);
     const QSize layerPixelSize = safeLayerPixelSize(data);
     const int msaaSampleCount = 0;
     Qt3DRender::QAbstractTexture *colorTex;
     Qt3DRender::QAbstractTexture *dsTexOrRb;
     Qt3DRender::QRenderTarget *rt = newLayerRenderTarget(layerPixelSize, msaaSampleCount,
                                                          &colorTex, &dsTexOrRb,
-                                                         data->layerFgRoot,
                                                          layer3DS,
                                                          data->layerDS); // keep using the existing depth-stencil buffer
     Qt3DRender::QRenderTarget *oldRt = data->rtSelector->target();
@@ -2940,10 +3134,8 @@ void Q3DSSceneManager::stealLayerRenderTarget(Qt3DRender::QAbstractTexture **sto
 Qt3DRender::QAbstractTexture *Q3DSSceneManager::createProgressiveTemporalAAExtraBuffer(Q3DSLayerNode *layer3DS)
 {
     Q3DSLayerAttached *data = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
-    Qt3DRender::QAbstractTexture *tex = new Qt3DRender::QTexture2D(data->layerFgRoot);
-    m_profiler->trackNewObject(tex, Q3DSProfiler::Texture2DObject,
-                               "PAA/TAA work buffer for layer %s", layer3DS->id().constData());
-    tex->setFormat(Qt3DRender::QAbstractTexture::RGBA8_UNorm);
+    Qt3DRender::QAbstractTexture *tex = acquireTexture(colorBufferKey(safeLayerPixelSize(data), 0),
+                                                       "PAA/TAA work buffer for layer %s", layer3DS->id().constData());
     tex->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
     tex->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
     prepareSizeDependentTexture(tex, layer3DS);
@@ -3008,6 +3200,7 @@ bool Q3DSSceneManager::updateProgressiveAA(Q3DSLayerNode *layer3DS)
         Q_UNREACHABLE();
         break;
     }
+    maxPass = qMin(maxPass, m_quality.maxProgressiveAAPasses + PROGAA_FRAME_DELAY);
 
     if (data->progAA.pass > maxPass) {
         // State is Idle. Keep displaying the output in currentOutputTexture until
@@ -3579,10 +3772,8 @@ void Q3DSSceneManager::rebuildCompositorLayerChain()
                 data->usesDefaultCompositorProgram = false;
 
                 if (!data->advBlend.tempTexture) {
-                    data->advBlend.tempTexture = new Qt3DRender::QTexture2D(data->entity);
-                    m_profiler->trackNewObject(data->advBlend.tempTexture, Q3DSProfiler::Texture2DObject,
-                                               "Advanced blend texture for layer %s", layer3DS->id().constData());
-                    data->advBlend.tempTexture->setFormat(Qt3DRender::QAbstractTexture::RGBA8_UNorm);
+                    data->advBlend.tempTexture = acquireTexture(colorBufferKey(safeResolvedLayerPixelSize(data), 0),
+                                                                "Advanced blend texture for layer %s", layer3DS->id().constData());
                     data->advBlend.tempTexture->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
                     data->advBlend.tempTexture->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
                     // must track layer size, but without the SSAA scale
@@ -3617,7 +3808,8 @@ void Q3DSSceneManager::rebuildCompositorLayerChain()
                     // this assumes QTBUG-65123 is fixed
                     QRectF srcRect(pos, data->layerSize);
                     bgBlit->setSourceRect(srcRect);
-                    QRectF dstRect(QPointF(0, 0), data->layerSize);
+                    // the texture follows the render scale, the backbuffer does not
+                    QRectF dstRect(QPointF(0, 0), safeResolvedLayerPixelSize(data));
                     bgBlit->setDestinationRect(dstRect);
                 };
                 data->layerSizeChangeCallbacks.append(setSizeDependentValues);
@@ -3637,13 +3829,13 @@ void Q3DSSceneManager::rebuildCompositorLayerChain()
 
                 switch (layer3DS->blendType()) {
                 case Q3DSLayerNode::Overlay:
-                    renderPass->setShaderProgram(Q3DSShaderManager::instance().getBlendOverlayShader(data->entity, data->msaaSampleCount));
+                    renderPass->setShaderProgram(Q3DSShaderManager::instance().getBlendOverlayShader(m_shaderPrograms, data->entity, data->msaaSampleCount));
                     break;
                 case Q3DSLayerNode::ColorBurn:
-                    renderPass->setShaderProgram(Q3DSShaderManager::instance().getBlendColorBurnShader(data->entity, data->msaaSampleCount));
+                    renderPass->setShaderProgram(Q3DSShaderManager::instance().getBlendColorBurnShader(m_shaderPrograms, data->entity, data->msaaSampleCount));
                     break;
                 case Q3DSLayerNode::ColorDodge:
-                    renderPass->setShaderProgram(Q3DSShaderManager::instance().getBlendColorDodgeShader(data->entity, data->msaaSampleCount));
+                    renderPass->setShaderProgram(Q3DSShaderManager::instance().getBlendColorDodgeShader(m_shaderPrograms, data->entity, data->msaaSampleCount));
                     break;
                 default:
                     Q_UNREACHABLE();
@@ -4302,7 +4494,7 @@ Qt3DCore::QEntity *Q3DSSceneManager::buildLight(Q3DSLightNode *light3DS, Q3DSLay
 
 void Q3DSSceneManager::setLightProperties(Q3DSLightNode *light3DS, bool forceUpdate)
 {
-    // only parameter setup, the uniform buffer is handled separately elsewhere
+    // only fills out the light data, the uniform buffer is handled separately elsewhere
 
     Q3DSLightAttached *data = static_cast<Q3DSLightAttached *>(light3DS->attached());
     Q_ASSERT(data);
@@ -4310,133 +4502,63 @@ void Q3DSSceneManager::setLightProperties(Q3DSLightNode *light3DS, bool forceUpd
     // Instead of generating Qt3D light objects, do lighting on our own. The
     // two worlds (Qt3D / 3DS) are just not compatible.
     Q3DSLightSource *ls = &data->lightSource;
+    Q3DSLightSourceData *ld = &data->lightSourceData;
+    ls->data = ld;
     const bool leftHanded = light3DS->orientation() == Q3DSNode::LeftHanded;
+    const bool isArea = light3DS->lightType() == Q3DSLightNode::Area;
 
     if (forceUpdate || data->frameDirty.testFlag(Q3DSGraphObjectAttached::GlobalTransformDirty)) {
-        if (!ls->positionParam) {
-            ls->positionParam = new Qt3DRender::QParameter;
-            ls->positionParam->setName(QLatin1String("position"));
-        }
-
         if (light3DS->lightType() == Q3DSLightNode::Directional) {
             // directional lights have a w value of 0 in position
             // position is used for direction in the custom material shader
             // custom material shader also wants the inverse handedness
-            ls->positionParam->setValue(QVector4D(directionFromTransform(data->globalTransform, !leftHanded), 0.0f));
+            ld->m_position = QVector4D(directionFromTransform(data->globalTransform, !leftHanded), 0.0f);
         } else {
             // point and area lights have w value of not-zero in position
-            ls->positionParam->setValue(QVector4D(data->globalTransform.column(3).toVector3D(), 1.0f));
-        }
-
-        if (!ls->directionParam) {
-            ls->directionParam = new Qt3DRender::QParameter;
-            ls->directionParam->setName(QLatin1String("direction"));
+            ld->m_position = QVector4D(data->globalTransform.column(3).toVector3D(), 1.0f);
         }
-        ls->directionParam->setValue(directionFromTransform(data->globalTransform, leftHanded));
+        ld->m_direction = QVector4D(directionFromTransform(data->globalTransform, leftHanded), 0.0f);
     }
 
-    if (!ls->upParam) {
-        ls->upParam = new Qt3DRender::QParameter;
-        ls->upParam->setName(QLatin1String("up"));
-    }
-    if (!ls->rightParam) {
-        ls->rightParam = new Qt3DRender::QParameter;
-        ls->rightParam->setName(QLatin1String("right"));
-    }
-    if (light3DS->lightType() == Q3DSLightNode::Area) {
+    if (isArea) {
         QVector4D v = data->globalTransform * QVector4D(0, 1, 0, 0);
         v.setW(light3DS->areaHeight());
-        ls->upParam->setValue(v);
+        ld->m_up = v;
         v = data->globalTransform * QVector4D(1, 0, 0, 0);
         v.setW(light3DS->areaWidth());
-        ls->rightParam->setValue(v);
+        ld->m_right = v;
     } else {
-        ls->upParam->setValue(QVector4D());
-        ls->rightParam->setValue(QVector4D());
+        ld->m_up = QVector4D();
+        ld->m_right = QVector4D();
     }
 
     const float normalizedBrightness = light3DS->brightness() / 100.0f;
 
-    if (!ls->diffuseParam) {
-        ls->diffuseParam = new Qt3DRender::QParameter;
-        ls->diffuseParam->setName(QLatin1String("diffuse"));
-    }
-    auto diffuseColor = QVector4D(float(light3DS->diffuse().redF()) * normalizedBrightness,
-                                  float(light3DS->diffuse().greenF()) * normalizedBrightness,
-                                  float(light3DS->diffuse().blueF()) * normalizedBrightness,
-                                  float(light3DS->diffuse().alphaF()));
-    ls->diffuseParam->setValue(diffuseColor);
-
-    if (!ls->ambientParam) {
-        ls->ambientParam = new Qt3DRender::QParameter;
-        ls->ambientParam->setName(QLatin1String("ambient"));
-    }
-    auto ambientColor = QVector4D(float(light3DS->ambient().redF()),
-                                  float(light3DS->ambient().greenF()),
-                                  float(light3DS->ambient().blueF()),
-                                  float(light3DS->ambient().alphaF()));
-    ls->ambientParam->setValue(ambientColor);
-
-    if (!ls->specularParam) {
-        ls->specularParam = new Qt3DRender::QParameter;
-        ls->specularParam->setName(QLatin1String("specular"));
-    }
-    auto specularColor = QVector4D(float(light3DS->specular().redF()) * normalizedBrightness,
-                                   float(light3DS->specular().greenF()) * normalizedBrightness,
-                                   float(light3DS->specular().blueF()) * normalizedBrightness,
-                                   float(light3DS->specular().alphaF()));
-    ls->specularParam->setValue(specularColor);
-
-/*
-    if (!ls->spotExponentParam) {
-        ls->spotExponentParam = new Qt3DRender::QParameter;
-        ls->spotExponentParam->setName(QLatin1String("spotExponent"));
-    }
-    ls->spotExponentParam->setValue(1.0f);
-
-    if (!ls->spotCutoffParam) {
-        ls->spotCutoffParam = new Qt3DRender::QParameter;
-        ls->spotCutoffParam->setName(QLatin1String("spotCutoff"));
-    }
-    ls->spotCutoffParam->setValue(180.0f);
-*/
-    if (!ls->constantAttenuationParam) {
-        ls->constantAttenuationParam = new Qt3DRender::QParameter;
-        ls->constantAttenuationParam->setName(QLatin1String("constantAttenuation"));
-    }
-    ls->constantAttenuationParam->setValue(1.0f);
-
-    if (!ls->linearAttenuationParam) {
-        ls->linearAttenuationParam = new Qt3DRender::QParameter;
-        ls->linearAttenuationParam->setName(QLatin1String("linearAttenuation"));
-    }
-    ls->linearAttenuationParam->setValue(qBound(0.0f, light3DS->linearFade(), 1000.0f) * 0.0001f);
-
-    if (!ls->quadraticAttenuationParam) {
-        ls->quadraticAttenuationParam = new Qt3DRender::QParameter;
-        ls->quadraticAttenuationParam->setName(QLatin1String("quadraticAttenuation"));
-    }
-    ls->quadraticAttenuationParam->setValue(qBound(0.0f, light3DS->expFade(), 1000.0f) * 0.0000001f);
+    // Normally this is where the materials diffuse color would be mixed with
+    // the light diffuse color, but since we can't update the uniformbuffer
+    // between draw calls yet this is done in the shader instead.
+    ld->m_diffuse = QVector4D(float(light3DS->diffuse().redF()) * normalizedBrightness,
+                              float(light3DS->diffuse().greenF()) * normalizedBrightness,
+                              float(light3DS->diffuse().blueF()) * normalizedBrightness,
+                              float(light3DS->diffuse().alphaF()));
+    ld->m_ambient = QVector4D(float(light3DS->ambient().redF()),
+                              float(light3DS->ambient().greenF()),
+                              float(light3DS->ambient().blueF()),
+                              float(light3DS->ambient().alphaF()));
+    ld->m_specular = QVector4D(float(light3DS->specular().redF()) * normalizedBrightness,
+                               float(light3DS->specular().greenF()) * normalizedBrightness,
+                               float(light3DS->specular().blueF()) * normalizedBrightness,
+                               float(light3DS->specular().alphaF()));
+
+    // spotExponent, spotCutoff, range: not used
+    ld->m_constantAttenuation = 1.0f;
+    ld->m_linearAttenuation = qBound(0.0f, light3DS->linearFade(), 1000.0f) * 0.0001f;
+    ld->m_quadraticAttenuation = qBound(0.0f, light3DS->expFade(), 1000.0f) * 0.0000001f;
 
     // having non-zero values in either width or hight properties
     // determines that this is an area light in shader logic
-    if (!ls->widthParam) {
-        ls->widthParam = new Qt3DRender::QParameter;
-        ls->widthParam->setName(QLatin1String("width"));
-    }
-    if (light3DS->lightType() == Q3DSLightNode::Area)
-        ls->widthParam->setValue(light3DS->areaWidth());
-    else
-        ls->widthParam->setValue(0.0f);
-
-    if (!ls->heightParam) {
-        ls->heightParam = new Qt3DRender::QParameter;
-        ls->heightParam->setName(QLatin1String("height"));
-    }
-    if (light3DS->lightType() == Q3DSLightNode::Area)
-        ls->heightParam->setValue(light3DS->areaHeight());
-    else
-        ls->heightParam->setValue(0.0f);
+    ld->m_width = isArea ? light3DS->areaWidth() : 0.0f;
+    ld->m_height = isArea ? light3DS->areaHeight() : 0.0f;
 
     // For custom materials. The default material does not use these as it
     // generates the shader code dynamically and can therefore rely on uniforms
@@ -4444,26 +4566,49 @@ void Q3DSSceneManager::setLightProperties(Q3DSLightNode *light3DS, bool forceUpd
     // materials cannot do this and will instead use the shadow control and
     // matrix from the lights array and use shadowIdx to index the array
     // uniforms for the samplers.
-    if (!ls->shadowControlsParam) {
-        ls->shadowControlsParam = new Qt3DRender::QParameter;
-        ls->shadowControlsParam->setName(QLatin1String("shadowControls"));
-    }
-    ls->shadowControlsParam->setValue(QVector4D(light3DS->shadowBias(), light3DS->shadowFactor(), light3DS->shadowMapFar(), 0));
-
-    if (!ls->shadowViewParam) {
-        ls->shadowViewParam = new Qt3DRender::QParameter;
-        ls->shadowViewParam->setName(QLatin1String("shadowView"));
-    }
+    ld->m_shadowControls = QVector4D(light3DS->shadowBias(), light3DS->shadowFactor(), light3DS->shadowMapFar(), 0);
     if (light3DS->lightType() == Q3DSLightNode::Point)
-        ls->shadowViewParam->setValue(QMatrix4x4());
+        memcpy(ld->m_shadowView, QMatrix4x4().constData(), 16 * sizeof(float));
     else
-        ls->shadowViewParam->setValue(data->globalTransform);
+        memcpy(ld->m_shadowView, data->globalTransform.constData(), 16 * sizeof(float));
 
-    if (!ls->shadowIdxParam) {
-        ls->shadowIdxParam = new Qt3DRender::QParameter;
-        ls->shadowIdxParam->setName(QLatin1String("shadowIdx"));
-        ls->shadowIdxParam->setValue(-1); // must be -1 for non-shadow-casting lights
-    }
+    // must be -1 for non-shadow-casting lights, updateShadowMapStatus() takes care of the rest
+    if (forceUpdate)
+        ld->m_shadowIdx = -1;
+
+    if (m_gfxLimits.useGles2Path)
+        updateLightSourceParams(ls);
+}
+
+// With uniform buffers the QParameters are not used by any shader. Therefore
+// only the GLES 2 path, where each light member is a separate uniform, pays
+// for the QVariant-based updates.
+void Q3DSSceneManager::updateLightSourceParams(Q3DSLightSource *ls)
+{
+    auto param = [](Qt3DRender::QParameter **p, const char *name) {
+        if (!*p) {
+            *p = new Qt3DRender::QParameter;
+            (*p)->setName(QLatin1String(name));
+        }
+        return *p;
+    };
+
+    const Q3DSLightSourceData *ld = ls->data;
+    param(&ls->positionParam, "position")->setValue(ld->m_position);
+    param(&ls->directionParam, "direction")->setValue(ld->m_direction.toVector3D());
+    param(&ls->upParam, "up")->setValue(ld->m_up);
+    param(&ls->rightParam, "right")->setValue(ld->m_right);
+    param(&ls->diffuseParam, "diffuse")->setValue(ld->m_diffuse);
+    param(&ls->ambientParam, "ambient")->setValue(ld->m_ambient);
+    param(&ls->specularParam, "specular")->setValue(ld->m_specular);
+    param(&ls->constantAttenuationParam, "constantAttenuation")->setValue(ld->m_constantAttenuation);
+    param(&ls->linearAttenuationParam, "linearAttenuation")->setValue(ld->m_linearAttenuation);
+    param(&ls->quadraticAttenuationParam, "quadraticAttenuation")->setValue(ld->m_quadraticAttenuation);
+    param(&ls->widthParam, "width")->setValue(ld->m_width);
+    param(&ls->heightParam, "height")->setValue(ld->m_height);
+    param(&ls->shadowControlsParam, "shadowControls")->setValue(ld->m_shadowControls);
+    param(&ls->shadowViewParam, "shadowView")->setValue(QMatrix4x4(ld->m_shadowView).transposed()); // column-major -> row-major
+    param(&ls->shadowIdxParam, "shadowIdx")->setValue(ld->m_shadowIdx);
 }
 
 Qt3DCore::QEntity *Q3DSSceneManager::buildModel(Q3DSModelNode *model3DS, Q3DSLayerNode *layer3DS, Qt3DCore::QEntity *parent)
@@ -4493,6 +4638,7 @@ void Q3DSSceneManager::rebuildModelSubMeshes(Q3DSModelNode *model3DS)
     Q3DSModelAttached *modelData = static_cast<Q3DSModelAttached *>(model3DS->attached());
 
     if (!modelData->subMeshes.isEmpty()) {
+        leaveInstanceGroup(model3DS);
         for (const Q3DSModelAttached::SubMesh &sm : modelData->subMeshes)
             delete sm.entity;
         modelData->subMeshes.clear();
@@ -4585,6 +4731,58 @@ static void addShadowSsaoParams(Q3DSLayerAttached *layerData, QVector<Qt3DRender
     }
 }
 
+void Q3DSSceneManager::pregenerateMaterialShaders(Q3DSLayerNode *layer3DS)
+{
+    // Collect the programs buildModelMaterial() is going to ask for, so that
+    // generating them (the expensive part) does not happen one by one on the
+    // main thread. Creating the program nodes is left to buildModelMaterial().
+    QVector<Q3DSShaderManager::MaterialVariant> variants;
+    Q3DSUipPresentation::forAllModels(layer3DS->firstChild(), [this, layer3DS, &variants](Q3DSModelNode *model3DS) {
+        Q3DSModelAttached *modelData = static_cast<Q3DSModelAttached *>(model3DS->attached());
+        if (!modelData)
+            return;
+
+        QVector<Q3DSLightNode *> lightNodes;
+        for (auto light : getLightsDataForNode(model3DS))
+            lightNodes.append(light->lightNodes);
+        if (lightNodes.count() > m_gfxLimits.maxLightsPerLayer)
+            lightNodes.resize(m_gfxLimits.maxLightsPerLayer);
+
+        for (const Q3DSModelAttached::SubMesh &sm : qAsConst(modelData->subMeshes)) {
+            if (!sm.resolvedMaterial || sm.materialComponent)
+                continue;
+            Q3DSShaderManager::MaterialVariant variant;
+            variant.material = sm.resolvedMaterial;
+            variant.referencedMaterial = sm.referencingMaterial;
+            variant.lights = lightNodes;
+            if (sm.resolvedMaterial->type() == Q3DSGraphObject::DefaultMaterial) {
+                Q3DSDefaultMaterialGenerator::fillFeatureSet(&variant.featureSet, layer3DS,
+                                                             static_cast<Q3DSDefaultMaterial *>(sm.resolvedMaterial),
+                                                             sm.referencingMaterial);
+            } else if (sm.resolvedMaterial->type() == Q3DSGraphObject::CustomMaterial) {
+                Q3DSCustomMaterialInstance *customMaterial = static_cast<Q3DSCustomMaterialInstance *>(sm.resolvedMaterial);
+                const QVector<Q3DSMaterial::Pass> &passes(customMaterial->material()->passes());
+                if (passes.isEmpty())
+                    continue;
+                Q3DSCustomMaterialGenerator::fillFeatureSet(&variant.featureSet, layer3DS, customMaterial, sm.referencingMaterial);
+                variant.shaderName = passes.first().shaderName;
+            } else {
+                continue;
+            }
+            variants.append(variant);
+        }
+    }, true); // include hidden ones too
+
+    if (variants.isEmpty())
+        return;
+
+    QElapsedTimer generateTime;
+    generateTime.start();
+    const int count = Q3DSShaderManager::instance().pregenerateShaderPrograms(variants);
+    if (count)
+        m_profiler->reportShaderGeneration(generateTime.elapsed(), count);
+}
+
 void Q3DSSceneManager::buildModelMaterial(Q3DSModelNode *model3DS)
 {
     // Scene building phase 2: all lights are known -> generate actual Qt3D materials
@@ -4647,11 +4845,10 @@ void Q3DSSceneManager::buildModelMaterial(Q3DSModelNode *model3DS)
                         if (!lightsData->allLightsConstantBuffer) {
                             lightsData->allLightsConstantBuffer = new Qt3DRender::QBuffer(layerData->entity);
                             lightsData->allLightsConstantBuffer->setObjectName(QLatin1String("all lights constant buffer"));
+                            lightsData->allLightsBufferData.clear();
                             // make sure we pick up all inherited lights in scope
-                            QVector<Q3DSLightSource> allLights;
-                            for (auto light : lights)
-                                allLights.append(light->allLights);
-                            updateLightsBuffer(allLights, lightsData->allLightsConstantBuffer);
+                            updateLightsBuffer(lights, &Q3DSNodeAttached::LightsData::allLights,
+                                               lightsData->allLightsConstantBuffer, &lightsData->allLightsBufferData);
                         }
                         if (!lightsData->allLightsParam)
                             lightsData->allLightsParam = new Qt3DRender::QParameter;
@@ -4698,7 +4895,7 @@ void Q3DSSceneManager::buildModelMaterial(Q3DSModelNode *model3DS)
                     param->setParent(layerData->entity);
                 }
 
-                sm.materialComponent = m_matGen->generateMaterial(defaultMaterial, sm.referencingMaterial, params, lightNodes, modelData->layer3DS);
+                sm.materialComponent = m_matGen->generateMaterial(m_shaderPrograms, defaultMaterial, sm.referencingMaterial, params, lightNodes, modelData->layer3DS);
                 sm.entity->addComponent(sm.materialComponent);
             } else if (sm.resolvedMaterial->type() == Q3DSGraphObject::CustomMaterial) {
                 Q3DSCustomMaterialInstance *customMaterial = static_cast<Q3DSCustomMaterialInstance *>(sm.resolvedMaterial);
@@ -4713,10 +4910,9 @@ void Q3DSSceneManager::buildModelMaterial(Q3DSModelNode *model3DS)
                         if (!lightsData->nonAreaLightsConstantBuffer) {
                             lightsData->nonAreaLightsConstantBuffer = new Qt3DRender::QBuffer(layerData->entity);
                             lightsData->nonAreaLightsConstantBuffer->setObjectName(QLatin1String("non-area lights constant buffer"));
-                            QVector<Q3DSLightSource> nonAreaLights;
-                            for (auto light : lights)
-                                nonAreaLights.append(light->nonAreaLights);
-                            updateLightsBuffer(nonAreaLights, lightsData->nonAreaLightsConstantBuffer);
+                            lightsData->nonAreaLightsBufferData.clear();
+                            updateLightsBuffer(lights, &Q3DSNodeAttached::LightsData::nonAreaLights,
+                                               lightsData->nonAreaLightsConstantBuffer, &lightsData->nonAreaLightsBufferData);
                         }
                         if (!lightsData->nonAreaLightsParam)
                             lightsData->nonAreaLightsParam = new Qt3DRender::QParameter;
@@ -4727,10 +4923,9 @@ void Q3DSSceneManager::buildModelMaterial(Q3DSModelNode *model3DS)
                         if (!lightsData->areaLightsConstantBuffer) {
                             lightsData->areaLightsConstantBuffer = new Qt3DRender::QBuffer(layerData->entity);
                             lightsData->areaLightsConstantBuffer->setObjectName(QLatin1String("area lights constant buffer"));
-                            QVector<Q3DSLightSource> areaLights;
-                            for (auto light : lights)
-                                areaLights.append(light->areaLights);
-                            updateLightsBuffer(areaLights, lightsData->areaLightsConstantBuffer);
+                            lightsData->areaLightsBufferData.clear();
+                            updateLightsBuffer(lights, &Q3DSNodeAttached::LightsData::areaLights,
+                                               lightsData->areaLightsConstantBuffer, &lightsData->areaLightsBufferData);
                         }
                         if (!lightsData->areaLightsParam)
                             lightsData->areaLightsParam = new Qt3DRender::QParameter;
@@ -4779,7 +4974,7 @@ void Q3DSSceneManager::buildModelMaterial(Q3DSModelNode *model3DS)
                 if (!passes.isEmpty()) {
                     // ### TODO support more than one pass
                     auto pass = passes.first();
-                    sm.materialComponent = m_customMaterialGen->generateMaterial(customMaterial, sm.referencingMaterial, params, lightNodes, modelData->layer3DS, pass);
+                    sm.materialComponent = m_customMaterialGen->generateMaterial(m_shaderPrograms, customMaterial, sm.referencingMaterial, params, lightNodes, modelData->layer3DS, pass);
                 } else {
                     qCDebug(lcScene, "Custom material %s has no passes. Using dummy material. Object %s will not show.",
                             customMaterial->id().constData(), model3DS->id().constData());
@@ -4789,6 +4984,8 @@ void Q3DSSceneManager::buildModelMaterial(Q3DSModelNode *model3DS)
             }
         }
     }
+
+    markInstancingDirty(model3DS);
 }
 
 void Q3DSSceneManager::rebuildModelMaterial(Q3DSModelNode *model3DS)
@@ -4800,6 +4997,8 @@ void Q3DSSceneManager::rebuildModelMaterial(Q3DSModelNode *model3DS)
     if (!modelData)
         return;
 
+    leaveInstanceGroup(model3DS);
+
     for (Q3DSModelAttached::SubMesh &sm : modelData->subMeshes) {
         if (sm.resolvedMaterial && sm.materialComponent) {
             qCDebug(lcPerf, "Rebuilding material for %s (entity %p)", model3DS->id().constData(), sm.entity);
@@ -4861,121 +5060,536 @@ void Q3DSSceneManager::retagSubMeshes(Q3DSModelNode *model3DS)
         profData.needsBlending = sm.hasTransparency;
         m_profiler->reportSubMeshData(sm.mesh, profData);
     }
+
+    if (data->instanceGroup && data->instanceGroup->hasTransparency != data->subMeshes.first().hasTransparency)
+        markInstancingDirty(model3DS);
 }
 
-void Q3DSSceneManager::prepareTextureParameters(Q3DSTextureParameters &textureParameters, const QString &name, Q3DSImage *image3DS)
+// The material of a model that can be drawn as an instance: its only submesh
+// uses a default material without displacement, and it is not tessellated.
+// diffuseParam is set to the model's material_diffuse parameter.
+static Qt3DRender::QMaterial *instanceableMaterial(Q3DSModelNode *model3DS, Qt3DRender::QParameter **diffuseParam)
 {
-    if (!image3DS->attached()) {
-        qCDebug(lcScene, "Image %s is not initialized, is it added to the scene? Expect bad things to happen.",
-                image3DS->id().constData());
-    }
-
-    textureParameters.sampler = new Qt3DRender::QParameter;
-    textureParameters.sampler->setName(name + QLatin1String("_sampler"));
+    Q3DSModelAttached *data = model3DS->attached<Q3DSModelAttached>();
+    if (!data || data->subMeshes.count() != 1 || model3DS->tessellation() != Q3DSModelNode::None)
+        return nullptr;
 
-    textureParameters.offsets = new Qt3DRender::QParameter;
-    textureParameters.offsets->setName(name + QLatin1String("_offsets"));
+    const Q3DSModelAttached::SubMesh &sm(data->subMeshes.first());
+    if (!sm.materialComponent || !sm.materialComponent->effect() || !sm.resolvedMaterial
+            || sm.resolvedMaterial->type() != Q3DSGraphObject::DefaultMaterial)
+    {
+        return nullptr;
+    }
 
-    textureParameters.rotations = new Qt3DRender::QParameter;
-    textureParameters.rotations->setName(name + QLatin1String("_rotations"));
+    Q3DSDefaultMaterial *mat3DS = static_cast<Q3DSDefaultMaterial *>(sm.resolvedMaterial);
+    Q3DSDefaultMaterialAttached *matData = mat3DS->attached<Q3DSDefaultMaterialAttached>();
+    if (mat3DS->displacementMap() || !matData)
+        return nullptr;
 
-    textureParameters.size = new Qt3DRender::QParameter;
-    textureParameters.size->setName(name + QLatin1String("_size"));
+    auto it = matData->perModelData.constFind(model3DS);
+    if (it == matData->perModelData.cend() || !it->materialDiffuseParam)
+        return nullptr;
 
-    textureParameters.texture = Q3DSImageManager::instance().newTextureForImage(
-                m_rootEntity, 0, m_profiler, "Texture for image %s", image3DS->id().constData());
+    *diffuseParam = it->materialDiffuseParam;
+    return sm.materialComponent;
 }
 
-void Q3DSSceneManager::updateTextureParameters(Q3DSTextureParameters &textureParameters, Q3DSImage *image)
+static QVector<Q3DSLayerAttached::InstanceGroup::Param> instanceParameters(Qt3DRender::QMaterial *material,
+                                                                          Qt3DRender::QParameter *diffuseParam)
 {
-    // note that this function is called frequently (whenever any Image parameter changes)
-
-    if (!image->subPresentation().isEmpty()) {
-        if (textureParameters.subPresId != image->subPresentation()) {
-            textureParameters.subPresId = image->subPresentation();
-            // won't yet have the subpresentations if this is still during the building of the main one
-            if (m_subPresentations.isEmpty()) {
-                textureParameters.sampler->setValue(QVariant::fromValue(dummyTexture()));
-                m_pendingSubPresImages.append(qMakePair(textureParameters.sampler, image));
-            } else {
-                setImageTextureFromSubPresentation(textureParameters.sampler, image);
-            }
+    QVector<Q3DSLayerAttached::InstanceGroup::Param> result;
+    const auto params = material->parameters();
+    result.reserve(params.count());
+    for (Qt3DRender::QParameter *param : params) {
+        QVariant value = param->value();
+        if (param == diffuseParam) {
+            QVector4D diffuse = value.value<QVector4D>();
+            diffuse.setW(1.0f);
+            value = diffuse;
         }
-    } else if (!image->sourcePath().isEmpty()) {
-        Q3DSImageManager::instance().setSource(textureParameters.texture, QUrl::fromLocalFile(image->sourcePath()));
-        textureParameters.sampler->setValue(QVariant::fromValue(textureParameters.texture));
-    } else if (!image->customImage().isNull()) {
-        Q3DSImageManager::instance().setSource(textureParameters.texture, image->customImage());
-        textureParameters.sampler->setValue(QVariant::fromValue(textureParameters.texture));
-    } else {
-        textureParameters.sampler->setValue(QVariant::fromValue(dummyTexture()));
+        result.append({ param, param->name(), value });
     }
+    return result;
+}
 
-    Qt3DRender::QTextureWrapMode wrapMode;
-    switch (image->horizontalTiling()) {
-    case Q3DSImage::Tiled:
-        wrapMode.setX(Qt3DRender::QTextureWrapMode::Repeat);
-        break;
-    case Q3DSImage::Mirrored:
-        wrapMode.setX(Qt3DRender::QTextureWrapMode::MirroredRepeat);
-        break;
-    default:
-        wrapMode.setX(Qt3DRender::QTextureWrapMode::ClampToEdge);
-        break;
-    }
-    switch (image->verticalTiling()) {
-    case Q3DSImage::Tiled:
-        wrapMode.setY(Qt3DRender::QTextureWrapMode::Repeat);
-        break;
-    case Q3DSImage::Mirrored:
-        wrapMode.setY(Qt3DRender::QTextureWrapMode::MirroredRepeat);
-        break;
-    default:
-        wrapMode.setY(Qt3DRender::QTextureWrapMode::ClampToEdge);
-        break;
-    }
+static bool sameInstanceParameters(const QVector<Q3DSLayerAttached::InstanceGroup::Param> &a,
+                                   const QVector<Q3DSLayerAttached::InstanceGroup::Param> &b)
+{
+    if (a.count() != b.count())
+        return false;
 
-    Qt3DRender::QAbstractTexture *texture = textureParameters.sampler->value().value<Qt3DRender::QAbstractTexture *>();
-    Q_ASSERT(texture);
-    texture->setWrapMode(wrapMode);
-    // min/mag are already set at this point
+    for (int i = 0, ie = a.count(); i != ie; ++i) {
+        if (a[i].param == b[i].param)
+            continue;
+        if (a[i].name != b[i].name || a[i].value != b[i].value)
+            return false;
+    }
+    return true;
+}
 
-    const QMatrix4x4 &textureTransform = image->textureTransform();
-    const float *m = textureTransform.constData();
+static bool fitsInstanceGroup(Q3DSLayerAttached::InstanceGroup *group, Q3DSModelNode *model3DS)
+{
+    Qt3DRender::QParameter *diffuseParam = nullptr;
+    Qt3DRender::QMaterial *material = instanceableMaterial(model3DS, &diffuseParam);
+    if (!material)
+        return false;
 
-    QVector3D offsets(m[12], m[13], image->hasPremultipliedAlpha() ? 1 : 0);
-    textureParameters.offsets->setValue(offsets);
+    const Q3DSModelAttached::SubMesh &sm(model3DS->attached<Q3DSModelAttached>()->subMeshes.first());
+    return sm.mesh == group->mesh
+            && sm.hasTransparency == group->hasTransparency
+            && material->effect() == group->effect
+            && sameInstanceParameters(instanceParameters(material, diffuseParam), group->params);
+}
 
-    QVector4D rotations(m[0], m[4], m[1], m[5]);
-    textureParameters.rotations->setValue(rotations);
+void Q3DSSceneManager::markInstancingDirty(Q3DSModelNode *model3DS)
+{
+    Q3DSModelAttached *data = model3DS->attached<Q3DSModelAttached>();
+    if (!m_modelInstancing || !data || !data->layer3DS)
+        return;
 
-    textureParameters.size->setValue(QVector2D(texture->width(), texture->height()));
+    if (Q3DSLayerAttached *layerData = data->layer3DS->attached<Q3DSLayerAttached>())
+        layerData->instancingDirtyModels.insert(model3DS);
 }
 
-void Q3DSSceneManager::setImageTextureFromSubPresentation(Qt3DRender::QParameter *sampler, Q3DSImage *image)
+void Q3DSSceneManager::leaveInstanceGroup(Q3DSModelNode *model3DS)
 {
-    auto it = std::find_if(m_subPresentations.cbegin(), m_subPresentations.cend(),
-                           [image](const Q3DSSubPresentation &sp) { return sp.id == image->subPresentation(); });
-    if (it != m_subPresentations.cend()) {
-        qCDebug(lcScene, "Directing subpresentation %s to image %s",
-                qPrintable(image->subPresentation()), image->id().constData());
-        sampler->setValue(QVariant::fromValue(it->colorTex));
-        qCDebug(lcPerf, "Using a subpresentation as texture map (not as layer) makes layer caching in main presentation less efficient");
-        // QML subpresentations will not have a scenemanager
-        if (it->sceneManager)
-            m_layerCacheDeps.insert(it->sceneManager);
-        else
-            m_hasQmlSubPresAsTextureMap = true;
-    } else {
-        qCDebug(lcScene, "Subpresentation %s for image %s not found",
-                qPrintable(image->subPresentation()), image->id().constData());
-        sampler->setValue(QVariant::fromValue(dummyTexture()));
+    Q3DSModelAttached *data = model3DS->attached<Q3DSModelAttached>();
+    Q3DSLayerAttached::InstanceGroup *group = data ? data->instanceGroup : nullptr;
+    if (!group)
+        return;
+
+    data->instanceGroup = nullptr;
+    group->models.removeOne(model3DS);
+    group->membersDirty = true;
+
+    // draw on its own again
+    for (const Q3DSModelAttached::SubMesh &sm : qAsConst(data->subMeshes)) {
+        if (sm.materialComponent)
+            sm.entity->addComponent(sm.materialComponent);
+    }
+
+    if (group->models.isEmpty()) {
+        Q3DSLayerAttached *layerData = data->layer3DS->attached<Q3DSLayerAttached>();
+        layerData->instanceGroups.removeOne(group);
+        delete group->entity;
+        delete group;
     }
 }
 
-QVector<Qt3DRender::QParameter *> Q3DSSceneManager::prepareDefaultMaterial(Q3DSDefaultMaterial *m, Q3DSReferencedMaterial *rm, Q3DSModelNode *model3DS)
+bool Q3DSSceneManager::joinInstanceGroup(Q3DSModelNode *model3DS)
 {
-    // This function can be called more than once for the same 'm' (with a
+    Q3DSModelAttached *data = model3DS->attached<Q3DSModelAttached>();
+    Q3DSLayerAttached *layerData = data->layer3DS->attached<Q3DSLayerAttached>();
+    Q_ASSERT(!data->instanceGroup);
+
+    Qt3DRender::QParameter *diffuseParam = nullptr;
+    Qt3DRender::QMaterial *material = instanceableMaterial(model3DS, &diffuseParam);
+    if (!material || !layerData->opaqueTag || !instancedEffect(data->layer3DS, material->effect()))
+        return false;
+
+    const Q3DSModelAttached::SubMesh &sm(data->subMeshes.first());
+    const auto params = instanceParameters(material, diffuseParam);
+    Q3DSLayerAttached::InstanceGroup *group = nullptr;
+    for (Q3DSLayerAttached::InstanceGroup *g : qAsConst(layerData->instanceGroups)) {
+        if (g->mesh == sm.mesh && g->hasTransparency == sm.hasTransparency && g->effect == material->effect()
+                && sameInstanceParameters(params, g->params))
+        {
+            group = g;
+            break;
+        }
+    }
+
+    if (!group) {
+        group = new Q3DSLayerAttached::InstanceGroup;
+        group->mesh = sm.mesh;
+        group->effect = material->effect();
+        group->hasTransparency = sm.hasTransparency;
+        group->params = params;
+        layerData->instanceGroups.append(group);
+    }
+
+    group->models.append(model3DS);
+    group->membersDirty = true;
+    data->instanceGroup = group;
+    return true;
+}
+
+Qt3DRender::QEffect *Q3DSSceneManager::instancedEffect(Q3DSLayerNode *layer3DS, Qt3DRender::QEffect *effect)
+{
+    Q3DSLayerAttached *layerData = layer3DS->attached<Q3DSLayerAttached>();
+    auto it = layerData->instancedEffects.constFind(effect);
+    if (it != layerData->instancedEffects.cend())
+        return it.value();
+
+    Qt3DRender::QEffect *result = nullptr;
+    if (std::find(layerData->defaultMaterialEffects.cbegin(), layerData->defaultMaterialEffects.cend(), effect)
+            != layerData->defaultMaterialEffects.cend())
+    {
+        // Same techniques and passes, only the programs differ. Compute
+        // techniques have nothing to do with the models and are shared.
+        Q3DSShaderManager &sm(Q3DSShaderManager::instance());
+        result = new Qt3DRender::QEffect(layerData->entity);
+        const auto techniques = effect->techniques();
+        for (Qt3DRender::QTechnique *technique : techniques) {
+            const auto passes = technique->renderPasses();
+            const bool compute = std::all_of(passes.cbegin(), passes.cend(), [](Qt3DRender::QRenderPass *pass) {
+                return !pass->shaderProgram() || pass->shaderProgram()->vertexShaderCode().isEmpty();
+            });
+            if (compute) {
+                result->addTechnique(technique);
+                continue;
+            }
+
+            Qt3DRender::QTechnique *instancedTechnique = new Qt3DRender::QTechnique;
+            for (Qt3DRender::QFilterKey *key : technique->filterKeys())
+                instancedTechnique->addFilterKey(key);
+            for (Qt3DRender::QParameter *param : technique->parameters())
+                instancedTechnique->addParameter(param);
+            const Qt3DRender::QGraphicsApiFilter *apiFilter = technique->graphicsApiFilter();
+            instancedTechnique->graphicsApiFilter()->setApi(apiFilter->api());
+            instancedTechnique->graphicsApiFilter()->setProfile(apiFilter->profile());
+            instancedTechnique->graphicsApiFilter()->setMajorVersion(apiFilter->majorVersion());
+            instancedTechnique->graphicsApiFilter()->setMinorVersion(apiFilter->minorVersion());
+            instancedTechnique->graphicsApiFilter()->setExtensions(apiFilter->extensions());
+            instancedTechnique->graphicsApiFilter()->setVendor(apiFilter->vendor());
+
+            for (Qt3DRender::QRenderPass *pass : passes) {
+                Qt3DRender::QShaderProgram *program = pass->shaderProgram()
+                        ? sm.getInstancedShader(m_shaderPrograms, layerData->entity, pass->shaderProgram())
+                        : nullptr;
+                if (!program) {
+                    delete instancedTechnique;
+                    delete result;
+                    result = nullptr;
+                    break;
+                }
+                Qt3DRender::QRenderPass *instancedPass = new Qt3DRender::QRenderPass;
+                for (Qt3DRender::QFilterKey *key : pass->filterKeys())
+                    instancedPass->addFilterKey(key);
+                for (Qt3DRender::QRenderState *state : pass->renderStates())
+                    instancedPass->addRenderState(state);
+                for (Qt3DRender::QParameter *param : pass->parameters())
+                    instancedPass->addParameter(param);
+                instancedPass->setShaderProgram(program);
+                instancedTechnique->addRenderPass(instancedPass);
+            }
+            if (!result)
+                break;
+            result->addTechnique(instancedTechnique);
+        }
+    }
+
+    if (!result)
+        qCDebug(lcPerf, "Effect %p cannot be used for instanced drawing", effect);
+    layerData->instancedEffects.insert(effect, result);
+    return result;
+}
+
+// per instance: model matrix, normal matrix, opacity
+static const int INSTANCE_FLOATS = 16 + 9 + 1;
+
+static void buildInstanceGroupEntity(Q3DSLayerAttached *layerData, Q3DSLayerAttached::InstanceGroup *group)
+{
+    if (!group->entity) {
+        group->entity = new Qt3DCore::QEntity(layerData->layerSceneRootEntity);
+        group->entity->setObjectName(QObject::tr("instance group of %1").arg(QString::fromUtf8(group->models.first()->id())));
+
+        Qt3DRender::QGeometry *meshGeometry = group->mesh->geometry();
+        Qt3DRender::QGeometry *geometry = new Qt3DRender::QGeometry(group->entity);
+        for (Qt3DRender::QAttribute *attribute : meshGeometry->attributes())
+            geometry->addAttribute(attribute);
+        geometry->setBoundingVolumePositionAttribute(meshGeometry->boundingVolumePositionAttribute());
+
+        group->instanceBuffer = new Qt3DRender::QBuffer(geometry);
+        uint offset = 0;
+        auto addInstanceAttribute = [group, geometry, &offset](const char *name, uint vertexSize) {
+            Qt3DRender::QAttribute *attribute = new Qt3DRender::QAttribute(group->instanceBuffer, QLatin1String(name),
+                                                                           Qt3DRender::QAttribute::Float, vertexSize,
+                                                                           0, offset, INSTANCE_FLOATS * sizeof(float));
+            attribute->setDivisor(1);
+            geometry->addAttribute(attribute);
+            group->instanceAttributes.append(attribute);
+            offset += vertexSize * sizeof(float);
+        };
+        for (const char *name : Q3DSShaderManager::instanceModelAttributeNames)
+            addInstanceAttribute(name, 4);
+        for (const char *name : Q3DSShaderManager::instanceNormalAttributeNames)
+            addInstanceAttribute(name, 3);
+        addInstanceAttribute(Q3DSShaderManager::instanceOpacityAttributeName, 1);
+
+        group->renderer = new Qt3DRender::QGeometryRenderer;
+        group->renderer->setPrimitiveType(group->mesh->primitiveType());
+        group->renderer->setVertexCount(group->mesh->vertexCount());
+        group->renderer->setIndexOffset(group->mesh->indexOffset());
+        group->renderer->setFirstVertex(group->mesh->firstVertex());
+        group->renderer->setRestartIndexValue(group->mesh->restartIndexValue());
+        group->renderer->setPrimitiveRestartEnabled(group->mesh->primitiveRestartEnabled());
+        group->renderer->setVerticesPerPatch(group->mesh->verticesPerPatch());
+        group->renderer->setGeometry(geometry);
+
+        group->material = new Qt3DRender::QMaterial;
+        group->material->setEffect(layerData->instancedEffects.value(group->effect));
+        group->diffuseParam = new Qt3DRender::QParameter(group->material);
+
+        group->entity->addComponent(group->renderer);
+        group->entity->addComponent(group->material);
+        group->entity->addComponent(group->hasTransparency ? layerData->instancedTransparentTag
+                                                           : layerData->instancedOpaqueTag);
+    }
+
+    // The members keep their entities, tags and geometry for picking, but
+    // without the material they are not drawn on their own anymore.
+    for (Q3DSModelNode *model3DS : qAsConst(group->models)) {
+        const Q3DSModelAttached::SubMesh &sm(model3DS->attached<Q3DSModelAttached>()->subMeshes.first());
+        if (sm.entity->components().contains(sm.materialComponent))
+            sm.entity->removeComponent(sm.materialComponent);
+    }
+
+    // The parameters of the first member, except for material_diffuse since
+    // its alpha is per instance.
+    Qt3DRender::QParameter *diffuseParam = nullptr;
+    Qt3DRender::QMaterial *material = instanceableMaterial(group->models.first(), &diffuseParam);
+    Q_ASSERT(material);
+    for (Qt3DRender::QParameter *param : group->material->parameters())
+        group->material->removeParameter(param);
+    for (Qt3DRender::QParameter *param : material->parameters())
+        group->material->addParameter(param == diffuseParam ? group->diffuseParam : param);
+    group->diffuseParam->setName(diffuseParam->name());
+
+    group->bufferDirty = true;
+}
+
+static void destroyInstanceGroupEntity(Q3DSLayerAttached::InstanceGroup *group)
+{
+    if (!group->entity)
+        return;
+
+    for (Q3DSModelNode *model3DS : qAsConst(group->models)) {
+        const Q3DSModelAttached::SubMesh &sm(model3DS->attached<Q3DSModelAttached>()->subMeshes.first());
+        sm.entity->addComponent(sm.materialComponent);
+    }
+
+    delete group->entity;
+    group->entity = nullptr;
+    group->renderer = nullptr;
+    group->instanceBuffer = nullptr;
+    group->instanceAttributes.clear();
+    group->material = nullptr;
+    group->diffuseParam = nullptr;
+}
+
+static void updateInstanceBuffer(Q3DSLayerAttached::InstanceGroup *group)
+{
+    const int count = group->models.count();
+    QByteArray data(count * INSTANCE_FLOATS * int(sizeof(float)), Qt::Uninitialized);
+    float *p = reinterpret_cast<float *>(data.data());
+    for (Q3DSModelNode *model3DS : qAsConst(group->models)) {
+        Q3DSModelAttached *modelData = model3DS->attached<Q3DSModelAttached>();
+        Qt3DRender::QParameter *diffuseParam = nullptr;
+        // Hidden members get a zero scale, the draw call is the same.
+        if (modelData->globalEffectiveVisibility && instanceableMaterial(model3DS, &diffuseParam)) {
+            memcpy(p, modelData->globalTransform.constData(), 16 * sizeof(float));
+            memcpy(p + 16, modelData->globalTransform.normalMatrix().constData(), 9 * sizeof(float));
+            p[25] = diffuseParam->value().value<QVector4D>().w();
+        } else {
+            std::fill(p, p + INSTANCE_FLOATS, 0.0f);
+        }
+        p += INSTANCE_FLOATS;
+    }
+
+    group->instanceBuffer->setData(data);
+    for (Qt3DRender::QAttribute *attribute : qAsConst(group->instanceAttributes))
+        attribute->setCount(count);
+    group->renderer->setInstanceCount(count);
+
+    Qt3DRender::QParameter *diffuseParam = nullptr;
+    if (instanceableMaterial(group->models.first(), &diffuseParam)) {
+        QVector4D diffuse = diffuseParam->value().value<QVector4D>();
+        diffuse.setW(1.0f);
+        group->diffuseParam->setValue(diffuse);
+    }
+}
+
+void Q3DSSceneManager::updateInstanceGroups(Q3DSLayerNode *layer3DS)
+{
+    Q3DSLayerAttached *layerData = layer3DS->attached<Q3DSLayerAttached>();
+    if (!layerData)
+        return;
+
+    if (!layerData->instancingDirtyModels.isEmpty()) {
+        QSet<Q3DSModelNode *> dirtyModels;
+        dirtyModels.swap(layerData->instancingDirtyModels);
+
+        // When all members changed the same way (a referenced material, or
+        // an animation applied to all of them) the group stays, with the new
+        // parameters.
+        for (Q3DSLayerAttached::InstanceGroup *group : qAsConst(layerData->instanceGroups)) {
+            const bool allDirty = std::all_of(group->models.cbegin(), group->models.cend(),
+                                              [&dirtyModels](Q3DSModelNode *model3DS) { return dirtyModels.contains(model3DS); });
+            Qt3DRender::QParameter *diffuseParam = nullptr;
+            Qt3DRender::QMaterial *material = allDirty ? instanceableMaterial(group->models.first(), &diffuseParam) : nullptr;
+            if (!material || material->effect() != group->effect)
+                continue;
+            const auto prevParams = group->params;
+            group->params = instanceParameters(material, diffuseParam);
+            if (std::all_of(group->models.cbegin(), group->models.cend(),
+                            [group](Q3DSModelNode *model3DS) { return fitsInstanceGroup(group, model3DS); }))
+            {
+                for (Q3DSModelNode *model3DS : qAsConst(group->models))
+                    dirtyModels.remove(model3DS);
+                group->membersDirty = true;
+            } else {
+                group->params = prevParams;
+            }
+        }
+
+        for (Q3DSModelNode *model3DS : qAsConst(dirtyModels)) {
+            Q3DSModelAttached *data = model3DS->attached<Q3DSModelAttached>();
+            if (!data || !data->layer3DS)
+                continue;
+            if (data->instanceGroup && fitsInstanceGroup(data->instanceGroup, model3DS)) {
+                data->instanceGroup->bufferDirty = true;
+                continue;
+            }
+            leaveInstanceGroup(model3DS);
+            joinInstanceGroup(model3DS);
+        }
+    }
+
+    for (Q3DSLayerAttached::InstanceGroup *group : qAsConst(layerData->instanceGroups)) {
+        if (group->membersDirty) {
+            group->membersDirty = false;
+            if (group->models.count() >= 2)
+                buildInstanceGroupEntity(layerData, group);
+            else
+                destroyInstanceGroupEntity(group);
+        }
+        if (group->bufferDirty) {
+            group->bufferDirty = false;
+            if (group->entity)
+                updateInstanceBuffer(group);
+        }
+    }
+}
+
+void Q3DSSceneManager::prepareTextureParameters(Q3DSTextureParameters &textureParameters, const QString &name, Q3DSImage *image3DS)
+{
+    if (!image3DS->attached()) {
+        qCDebug(lcScene, "Image %s is not initialized, is it added to the scene? Expect bad things to happen.",
+                image3DS->id().constData());
+    }
+
+    textureParameters.sampler = new Qt3DRender::QParameter;
+    textureParameters.sampler->setName(name + QLatin1String("_sampler"));
+
+    textureParameters.offsets = new Qt3DRender::QParameter;
+    textureParameters.offsets->setName(name + QLatin1String("_offsets"));
+
+    textureParameters.rotations = new Qt3DRender::QParameter;
+    textureParameters.rotations->setName(name + QLatin1String("_rotations"));
+
+    textureParameters.size = new Qt3DRender::QParameter;
+    textureParameters.size->setName(name + QLatin1String("_size"));
+
+    textureParameters.texture = Q3DSImageManager::instance().newTextureForImage(
+                m_rootEntity, 0, m_profiler, "Texture for image %s", image3DS->id().constData());
+}
+
+void Q3DSSceneManager::updateTextureParameters(Q3DSTextureParameters &textureParameters, Q3DSImage *image)
+{
+    // note that this function is called frequently (whenever any Image parameter changes)
+
+    if (!image->subPresentation().isEmpty()) {
+        if (textureParameters.subPresId != image->subPresentation()) {
+            textureParameters.subPresId = image->subPresentation();
+            // won't yet have the subpresentations if this is still during the building of the main one
+            if (m_subPresentations.isEmpty()) {
+                textureParameters.sampler->setValue(QVariant::fromValue(dummyTexture()));
+                m_pendingSubPresImages.append(qMakePair(textureParameters.sampler, image));
+            } else {
+                setImageTextureFromSubPresentation(textureParameters.sampler, image);
+            }
+        }
+    } else if (!image->sourcePath().isEmpty()) {
+        textureParameters.subPresId.clear();
+        m_subPresImages.remove(image);
+        Q3DSImageManager::instance().setSource(textureParameters.texture, QUrl::fromLocalFile(image->sourcePath()));
+        textureParameters.sampler->setValue(QVariant::fromValue(textureParameters.texture));
+    } else if (!image->customImage().isNull()) {
+        textureParameters.subPresId.clear();
+        m_subPresImages.remove(image);
+        Q3DSImageManager::instance().setSource(textureParameters.texture, image->customImage());
+        textureParameters.sampler->setValue(QVariant::fromValue(textureParameters.texture));
+    } else {
+        textureParameters.subPresId.clear();
+        m_subPresImages.remove(image);
+        textureParameters.sampler->setValue(QVariant::fromValue(dummyTexture()));
+    }
+
+    Qt3DRender::QTextureWrapMode wrapMode;
+    switch (image->horizontalTiling()) {
+    case Q3DSImage::Tiled:
+        wrapMode.setX(Qt3DRender::QTextureWrapMode::Repeat);
+        break;
+    case Q3DSImage::Mirrored:
+        wrapMode.setX(Qt3DRender::QTextureWrapMode::MirroredRepeat);
+        break;
+    default:
+        wrapMode.setX(Qt3DRender::QTextureWrapMode::ClampToEdge);
+        break;
+    }
+    switch (image->verticalTiling()) {
+    case Q3DSImage::Tiled:
+        wrapMode.setY(Qt3DRender::QTextureWrapMode::Repeat);
+        break;
+    case Q3DSImage::Mirrored:
+        wrapMode.setY(Qt3DRender::QTextureWrapMode::MirroredRepeat);
+        break;
+    default:
+        wrapMode.setY(Qt3DRender::QTextureWrapMode::ClampToEdge);
+        break;
+    }
+
+    Qt3DRender::QAbstractTexture *texture = textureParameters.sampler->value().value<Qt3DRender::QAbstractTexture *>();
+    Q_ASSERT(texture);
+    texture->setWrapMode(wrapMode);
+    // min/mag are already set at this point
+
+    const QMatrix4x4 &textureTransform = image->textureTransform();
+    const float *m = textureTransform.constData();
+
+    QVector3D offsets(m[12], m[13], image->hasPremultipliedAlpha() ? 1 : 0);
+    textureParameters.offsets->setValue(offsets);
+
+    QVector4D rotations(m[0], m[4], m[1], m[5]);
+    textureParameters.rotations->setValue(rotations);
+
+    textureParameters.size->setValue(QVector2D(texture->width(), texture->height()));
+}
+
+void Q3DSSceneManager::setImageTextureFromSubPresentation(Qt3DRender::QParameter *sampler, Q3DSImage *image)
+{
+    auto it = std::find_if(m_subPresentations.cbegin(), m_subPresentations.cend(),
+                           [image](const Q3DSSubPresentation &sp) { return sp.id == image->subPresentation(); });
+    if (it != m_subPresentations.cend()) {
+        qCDebug(lcScene, "Directing subpresentation %s to image %s",
+                qPrintable(image->subPresentation()), image->id().constData());
+        sampler->setValue(QVariant::fromValue(it->colorTex));
+        // Layers using the image are invalidated in
+        // markSubPresentationDependentLayersDirty() whenever the
+        // subpresentation's content changes.
+        m_subPresImages.insert(image, it->id);
+    } else {
+        qCDebug(lcScene, "Subpresentation %s for image %s not found",
+                qPrintable(image->subPresentation()), image->id().constData());
+        sampler->setValue(QVariant::fromValue(dummyTexture()));
+        m_subPresImages.remove(image);
+    }
+}
+
+QVector<Qt3DRender::QParameter *> Q3DSSceneManager::prepareDefaultMaterial(Q3DSDefaultMaterial *m, Q3DSReferencedMaterial *rm, Q3DSModelNode *model3DS)
+{
+    // This function can be called more than once for the same 'm' (with a
     // different 'model3DS' each time). The returned QParameter list must be
     // complete in any case, but returning QParameters that were returned
     // before for a different model3DS is fine.
@@ -5202,7 +5816,7 @@ QVector<Qt3DRender::QParameter *> Q3DSSceneManager::prepareDefaultMaterial(Q3DSD
     if (iblOverrideImage) {
         if (!data->lightProbeOverrideTexture) {
             data->lightProbeOverrideTexture = Q3DSImageManager::instance().newTextureForImage(
-                        m_rootEntity, Q3DSImageManager::GenerateMipMapsForIBL,
+                        m_rootEntity, Q3DSImageManager::instance().lightProbeImageFlags(),
                         m_profiler, "Texture for image %s", iblOverrideImage->id().constData());
             data->lightProbeSampler = new Qt3DRender::QParameter;
             data->lightProbeSampler->setName(QLatin1String("light_probe"));
@@ -5379,6 +5993,8 @@ void Q3DSSceneManager::updateDefaultMaterial(Q3DSDefaultMaterial *m, Q3DSReferen
         QVector4D rotations(m[0], m[4], m[1], m[5]);
         data->lightProbeRotation->setValue(rotations);
     }
+
+    markInstancingDirty(model3DS);
 }
 
 typedef std::function<void(const QString &, const QVariant &, const Q3DSMaterial::PropertyElement &)> CustomPropertyCallback;
@@ -5561,7 +6177,7 @@ QVector<Qt3DRender::QParameter *> Q3DSSceneManager::prepareCustomMaterial(Q3DSCu
     if (iblOverrideImage) {
         if (!data->lightProbeOverrideTexture) {
             data->lightProbeOverrideTexture = Q3DSImageManager::instance().newTextureForImage(
-                        m_rootEntity, Q3DSImageManager::GenerateMipMapsForIBL,
+                        m_rootEntity, Q3DSImageManager::instance().lightProbeImageFlags(),
                         m_profiler, "Texture for image %s", iblOverrideImage->id().constData());
             data->lightProbeSampler = new Qt3DRender::QParameter;
             data->lightProbeSampler->setName(QLatin1String("light_probe"));
@@ -5708,10 +6324,10 @@ void Q3DSSceneManager::initEffect(Q3DSEffectInstance *eff3DS, Q3DSLayerNode *lay
         // step will be applied via BlitFramebuffer. From that point on
         // everything behaves like non-MSAA.
         const QSize sz = safeLayerPixelSize(layerData);
-        layerData->effLayerTexture = newColorBuffer(sz, 1);
-        layerData->effLayerTexture->setParent(layerData->entity);
-        m_profiler->trackNewObject(layerData->effLayerTexture, Q3DSProfiler::Texture2DObject,
-                                   "Effect buffer for layer %s", layer3DS->id().constData());
+        layerData->effLayerTexture = acquireTexture(colorBufferKey(sz, 1),
+                                                    "Effect buffer for layer %s", layer3DS->id().constData());
+        layerData->effLayerTexture->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
+        layerData->effLayerTexture->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
         layerData->sizeManagedTextures.append(layerData->effLayerTexture);
     }
 
@@ -5720,13 +6336,19 @@ void Q3DSSceneManager::initEffect(Q3DSEffectInstance *eff3DS, Q3DSLayerNode *lay
     effData->eventObserverIndex = eff3DS->addEventHandler(QString(), std::bind(&Q3DSSceneManager::handleEvent, this, std::placeholders::_1));
 }
 
-static inline void setTextureInfoUniform(Qt3DRender::QParameter *param, Qt3DRender::QAbstractTexture *texture)
+static inline void setTextureInfoUniform(Qt3DRender::QParameter *param, const QSize &size)
 {
-    const QSize size = Q3DSImageManager::instance().size(texture);
     const bool isPremultiplied = false;
     param->setValue(QVector4D(size.width(), size.height(), isPremultiplied ? 1 : 0, 0));
 }
 
+static inline QSize setTextureInfoUniform(Qt3DRender::QParameter *param, Qt3DRender::QAbstractTexture *texture)
+{
+    const QSize size = Q3DSImageManager::instance().size(texture);
+    setTextureInfoUniform(param, size);
+    return size;
+}
+
 static inline Qt3DRender::QParameter *makePropertyUniform(const QString &name, const QString &value, const Q3DSMaterial::PropertyElement &propMeta)
 {
     QScopedPointer<Qt3DRender::QParameter> param(new Qt3DRender::QParameter);
@@ -5936,10 +6558,8 @@ void Q3DSSceneManager::ensureEffectSource(Q3DSLayerNode *layer3DS)
     // work with non-MSAA (and 1:1 sized) textures as input.
     const bool needsResolve = layerData->msaaSampleCount > 1 || layerData->ssaaScaleFactor > 1;
     if (needsResolve) {
-        layerData->effectData.sourceTexture = new Qt3DRender::QTexture2D(m_rootEntity);
-        m_profiler->trackNewObject(layerData->effectData.sourceTexture, Q3DSProfiler::Texture2DObject,
-                                   "Resolve buffer for effects");
-        layerData->effectData.sourceTexture->setFormat(Qt3DRender::QAbstractTexture::RGBA8_UNorm);
+        layerData->effectData.sourceTexture = acquireTexture(colorBufferKey(safeResolvedLayerPixelSize(layerData), 0),
+                                                             "Resolve buffer for effects");
         layerData->effectData.sourceTexture->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
         layerData->effectData.sourceTexture->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
         layerData->effectData.ownsSourceTexture = true;
@@ -5967,8 +6587,8 @@ void Q3DSSceneManager::ensureEffectSource(Q3DSLayerNode *layer3DS)
         resolve->setDestination(rtDst);
 
         auto blitResizer = [resolve, layerData](Q3DSLayerNode *) {
-            resolve->setSourceRect(QRectF(QPointF(0, 0), layerData->layerSize * layerData->ssaaScaleFactor));
-            resolve->setDestinationRect(QRectF(QPointF(0, 0), layerData->layerSize));
+            resolve->setSourceRect(QRectF(QPointF(0, 0), safeLayerPixelSize(layerData)));
+            resolve->setDestinationRect(QRectF(QPointF(0, 0), safeResolvedLayerPixelSize(layerData)));
         };
 
         // must track layer size, but without the SSAA scale
@@ -5991,7 +6611,7 @@ void Q3DSSceneManager::cleanupEffectSource(Q3DSLayerNode *layer3DS)
     if (layerData->effectData.ownsSourceTexture) {
         layerData->effectData.ownsSourceTexture = false;
         layerData->sizeManagedTextures.removeOne(layerData->effectData.sourceTexture);
-        delete layerData->effectData.sourceTexture;
+        releaseTexture(layerData->effectData.sourceTexture);
     }
 }
 
@@ -6022,6 +6642,7 @@ void Q3DSSceneManager::activateEffect(Q3DSEffectInstance *eff3DS,
 
     effData->fpsParam = new Qt3DRender::QParameter;
     effData->fpsParam->setName(QLatin1String("FPS"));
+    effData->fpsParam->setValue(60.0f); // heh
     commonParamList.append(effData->fpsParam);
 
     effData->cameraClipRangeParam = new Qt3DRender::QParameter;
@@ -6078,10 +6699,8 @@ void Q3DSSceneManager::activateEffect(Q3DSEffectInstance *eff3DS,
         effData->outputTexture = layerData->effLayerTexture;
         effData->ownsOutputTexture = false;
     } else {
-        effData->outputTexture = new Qt3DRender::QTexture2D(m_rootEntity);
-        m_profiler->trackNewObject(effData->outputTexture, Q3DSProfiler::Texture2DObject,
-                                   "Output texture for effect %s", eff3DS->id().constData());
-        effData->outputTexture->setFormat(Qt3DRender::QAbstractTexture::RGBA8_UNorm);
+        effData->outputTexture = acquireTexture(colorBufferKey(safeLayerPixelSize(layerData), 0),
+                                                "Output texture for effect %s", eff3DS->id().constData());
         effData->outputTexture->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
         effData->outputTexture->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
         prepareSizeDependentTexture(effData->outputTexture, layer3DS);
@@ -6143,8 +6762,11 @@ void Q3DSSceneManager::activateEffect(Q3DSEffectInstance *eff3DS,
                     paramList.append(texParam);
                     Qt3DRender::QParameter *texInfoParam = new Qt3DRender::QParameter;
                     texInfoParam->setName(cmd.data()->param + QLatin1String("Info"));
-                    setTextureInfoUniform(texInfoParam, effData->sourceTexture);
-                    effData->sourceDepTextureInfoParams.append(qMakePair(texInfoParam, effData->sourceTexture));
+                    Q3DSEffectAttached::TextureInfoParam sourceDepParam;
+                    sourceDepParam.param = texInfoParam;
+                    sourceDepParam.texture = effData->sourceTexture;
+                    sourceDepParam.lastSize = setTextureInfoUniform(texInfoParam, effData->sourceTexture);
+                    effData->sourceDepTextureInfoParams.append(sourceDepParam);
                     paramList.append(texInfoParam);
                 } else if (effData->textureBuffers.contains(bufferName)) {
                     Q3DSEffectAttached::TextureBuffer &tb(effData->textureBuffers[bufferName]);
@@ -6154,7 +6776,7 @@ void Q3DSSceneManager::activateEffect(Q3DSEffectInstance *eff3DS,
                     paramList.append(texParam);
                     Qt3DRender::QParameter *texInfoParam = new Qt3DRender::QParameter;
                     texInfoParam->setName(cmd.data()->param + QLatin1String("Info"));
-                    setTextureInfoUniform(texInfoParam, tb.texture);
+                    tb.lastTextureInfoSize = setTextureInfoUniform(texInfoParam, tb.texture);
                     tb.textureInfoParams.append(texInfoParam);
                     paramList.append(texInfoParam);
                 } else {
@@ -6187,8 +6809,11 @@ void Q3DSSceneManager::activateEffect(Q3DSEffectInstance *eff3DS,
                     // sizes must match. This is very handy esp. with
                     // sourceDepTextureInfoParams since we get size updates
                     // via the same code path.
-                    setTextureInfoUniform(texInfoParam, effData->sourceTexture);
-                    effData->sourceDepTextureInfoParams.append(qMakePair(texInfoParam, effData->sourceTexture));
+                    Q3DSEffectAttached::TextureInfoParam sourceDepParam;
+                    sourceDepParam.param = texInfoParam;
+                    sourceDepParam.texture = effData->sourceTexture;
+                    sourceDepParam.lastSize = setTextureInfoUniform(texInfoParam, effData->sourceTexture);
+                    effData->sourceDepTextureInfoParams.append(sourceDepParam);
                     paramList.append(texInfoParam);
                 } else {
                     qWarning("Effect %s: Unknown depth texture sampler %s",
@@ -6372,7 +6997,7 @@ void Q3DSSceneManager::activateEffect(Q3DSEffectInstance *eff3DS,
         const QString decoratedShaderName = QString::fromUtf8(eff3DS->id()) + QLatin1Char('_') + pass.shaderName;
         const QString decoratedVertexShader = effDesc->addPropertyUniforms(shaderProgram.vertexShader);
         const QString decoratedFragmentShader = effDesc->addPropertyUniforms(shaderProgram.fragmentShader);
-        Qt3DRender::QShaderProgram *prog = Q3DSShaderManager::instance().getEffectShader(m_rootEntity,
+        Qt3DRender::QShaderProgram *prog = Q3DSShaderManager::instance().getEffectShader(m_shaderPrograms, m_rootEntity,
                                                                                          decoratedShaderName,
                                                                                          decoratedVertexShader,
                                                                                          decoratedFragmentShader);
@@ -6462,12 +7087,12 @@ void Q3DSSceneManager::deactivateEffect(Q3DSEffectInstance *eff3DS, Q3DSLayerNod
     Q3DSLayerAttached *layerData = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
     for (const Q3DSEffectAttached::TextureBuffer &tb : effData->textureBuffers) {
         layerData->sizeManagedTextures.removeOne(tb.texture);
-        delete tb.texture;
+        releaseTexture(tb.texture);
     }
 
     if (effData->ownsOutputTexture) {
         layerData->sizeManagedTextures.removeOne(effData->outputTexture);
-        delete effData->outputTexture;
+        releaseTexture(effData->outputTexture);
     }
 
     effData->reset();
@@ -6482,6 +7107,7 @@ void Q3DSEffectAttached::reset()
     quadEntityTag = nullptr;
     params.clear();
     appFrameParam = fpsParam = cameraClipRangeParam = nullptr;
+    lastCameraClipRange = QVector2D(-1, -1);
     textureBuffers.clear();
     passData.clear();
     sourceDepTextureInfoParams.clear();
@@ -6494,83 +7120,89 @@ void Q3DSSceneManager::setupEffectTextureBuffer(Q3DSEffectAttached::TextureBuffe
                                                 const Q3DSMaterial::PassBuffer &bufDesc,
                                                 Q3DSLayerNode *layer3DS)
 {
-    Qt3DRender::QAbstractTexture *texture = new Qt3DRender::QTexture2D(m_rootEntity);
-    m_profiler->trackNewObject(texture, Q3DSProfiler::Texture2DObject,
-                               "Effect buffer %s", qPrintable(bufDesc.name()));
-    tb->texture = texture;
-
-    switch (bufDesc.filter()) {
-    case Q3DSMaterial::Nearest:
-        texture->setMinificationFilter(Qt3DRender::QAbstractTexture::Nearest);
-        texture->setMagnificationFilter(Qt3DRender::QAbstractTexture::Nearest);
-        break;
-    default:
-        texture->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
-        texture->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
-        break;
-    }
-
-    Qt3DRender::QTextureWrapMode wrapMode;
-    switch (bufDesc.wrap()) {
-    case Q3DSMaterial::Repeat:
-        wrapMode.setX(Qt3DRender::QTextureWrapMode::Repeat);
-        wrapMode.setY(Qt3DRender::QTextureWrapMode::Repeat);
-        break;
-    default:
-        wrapMode.setX(Qt3DRender::QTextureWrapMode::ClampToEdge);
-        wrapMode.setY(Qt3DRender::QTextureWrapMode::ClampToEdge);
-        break;
-    }
-    texture->setWrapMode(wrapMode);
-
+    Qt3DRender::QAbstractTexture::TextureFormat format;
     switch (bufDesc.textureFormat()) {
     case Q3DSMaterial::Depth24Stencil8:
-        texture->setFormat(Qt3DRender::QAbstractTexture::D24S8);
+        format = Qt3DRender::QAbstractTexture::D24S8;
         break;
     case Q3DSMaterial::RGB8:
-        texture->setFormat(Qt3DRender::QAbstractTexture::RGB8_UNorm);
+        format = Qt3DRender::QAbstractTexture::RGB8_UNorm;
         break;
     case Q3DSMaterial::Alpha8:
-        texture->setFormat(Qt3DRender::QAbstractTexture::AlphaFormat);
+        format = Qt3DRender::QAbstractTexture::AlphaFormat;
         break;
     case Q3DSMaterial::Luminance8:
-        texture->setFormat(Qt3DRender::QAbstractTexture::LuminanceFormat);
+        format = Qt3DRender::QAbstractTexture::LuminanceFormat;
         break;
     case Q3DSMaterial::LuminanceAlpha8:
-        texture->setFormat(Qt3DRender::QAbstractTexture::LuminanceAlphaFormat);
+        format = Qt3DRender::QAbstractTexture::LuminanceAlphaFormat;
         break;
     case Q3DSMaterial::RG8:
-        texture->setFormat(Qt3DRender::QAbstractTexture::RG8_UNorm);
+        format = Qt3DRender::QAbstractTexture::RG8_UNorm;
         break;
     case Q3DSMaterial::RGB565:
-        texture->setFormat(Qt3DRender::QAbstractTexture::R5G6B5);
+        format = Qt3DRender::QAbstractTexture::R5G6B5;
         break;
     case Q3DSMaterial::RGBA5551:
-        texture->setFormat(Qt3DRender::QAbstractTexture::RGB5A1);
+        format = Qt3DRender::QAbstractTexture::RGB5A1;
         break;
     case Q3DSMaterial::RGBA16F:
-        texture->setFormat(Qt3DRender::QAbstractTexture::RGBA16F);
+        format = Qt3DRender::QAbstractTexture::RGBA16F;
         break;
     case Q3DSMaterial::RG16F:
-        texture->setFormat(Qt3DRender::QAbstractTexture::RG16F);
+        format = Qt3DRender::QAbstractTexture::RG16F;
         break;
     case Q3DSMaterial::RGBA32F:
-        texture->setFormat(Qt3DRender::QAbstractTexture::RGBA32F);
+        format = Qt3DRender::QAbstractTexture::RGBA32F;
         break;
     case Q3DSMaterial::RG32F:
-        texture->setFormat(Qt3DRender::QAbstractTexture::RG32F);
+        format = Qt3DRender::QAbstractTexture::RG32F;
         break;
     default: // incl. Unknown that is set for "source"
-        texture->setFormat(Qt3DRender::QAbstractTexture::RGBA8_UNorm);
+        format = Qt3DRender::QAbstractTexture::RGBA8_UNorm;
         break;
     }
 
     Q3DSLayerAttached *layerData = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
     float sizeMultiplier = bufDesc.size();
-    auto sizeCalc = [texture, layerData, sizeMultiplier](Q3DSLayerNode*) {
-        const QSize sz = safeLayerPixelSize(layerData->layerSize, 1); // SSAA scale factor no longer plays a role
-        texture->setWidth(int(sz.width() * sizeMultiplier));
-        texture->setHeight(int(sz.height() * sizeMultiplier));
+    auto bufferSize = [layerData, sizeMultiplier]() {
+        const QSize sz = safeResolvedLayerPixelSize(layerData); // SSAA scale factor no longer plays a role
+        return QSize(int(sz.width() * sizeMultiplier), int(sz.height() * sizeMultiplier));
+    };
+
+    Qt3DRender::QAbstractTexture *texture = acquireTexture(Q3DSTexturePool::Key(Qt3DRender::QAbstractTexture::Target2D,
+                                                                                format, bufferSize()),
+                                                           "Effect buffer %s", qPrintable(bufDesc.name()));
+    tb->texture = texture;
+
+    switch (bufDesc.filter()) {
+    case Q3DSMaterial::Nearest:
+        texture->setMinificationFilter(Qt3DRender::QAbstractTexture::Nearest);
+        texture->setMagnificationFilter(Qt3DRender::QAbstractTexture::Nearest);
+        break;
+    default:
+        texture->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
+        texture->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
+        break;
+    }
+
+    Qt3DRender::QTextureWrapMode wrapMode;
+    switch (bufDesc.wrap()) {
+    case Q3DSMaterial::Repeat:
+        wrapMode.setX(Qt3DRender::QTextureWrapMode::Repeat);
+        wrapMode.setY(Qt3DRender::QTextureWrapMode::Repeat);
+        break;
+    default:
+        wrapMode.setX(Qt3DRender::QTextureWrapMode::ClampToEdge);
+        wrapMode.setY(Qt3DRender::QTextureWrapMode::ClampToEdge);
+        break;
+    }
+    texture->setWrapMode(wrapMode);
+
+    auto sizeCalc = [texture, bufferSize](Q3DSLayerNode*) {
+        const QSize sz = bufferSize();
+        texture->setWidth(sz.width());
+        texture->setHeight(sz.height());
     };
     prepareSizeDependentTexture(texture, layer3DS, sizeCalc, Q3DSLayerAttached::SizeManagedTexture::CustomSizeCalculation);
     sizeCalc(layer3DS);
@@ -6606,22 +7238,34 @@ void Q3DSSceneManager::updateEffect(Q3DSEffectInstance *eff3DS)
 
     Q3DSLayerAttached *layerData = static_cast<Q3DSLayerAttached *>(effData->layer3DS->attached());
 
+    int updated = 0;
+    int skipped = 0;
+
     QVector2D cameraClipRange(0, 5000);
     if (layerData->cam3DS) {
         cameraClipRange.setX(layerData->cam3DS->clipNear());
         cameraClipRange.setY(layerData->cam3DS->clipFar());
     }
-    effData->cameraClipRangeParam->setValue(cameraClipRange);
+    if (cameraClipRange != effData->lastCameraClipRange) {
+        effData->cameraClipRangeParam->setValue(cameraClipRange);
+        effData->lastCameraClipRange = cameraClipRange;
+        ++updated;
+    } else {
+        ++skipped;
+    }
 
-    forAllCustomProperties(eff3DS, [effData, this](const QString &propKey, const QVariant &propValue, const Q3DSMaterial::PropertyElement &) {
+    forAllCustomProperties(eff3DS, [effData, &updated, &skipped, this](const QString &propKey, const QVariant &propValue, const Q3DSMaterial::PropertyElement &) {
         if (!effData->params.contains(propKey))
             return;
 
         Q3DSCustomPropertyParameter &p(effData->params[propKey]);
-        if (propValue == p.inputValue)
+        if (propValue == p.inputValue) {
+            ++skipped;
             return;
+        }
 
         p.inputValue = propValue;
+        ++updated;
 
         switch (p.meta.type) {
         case Q3DS::Texture:
@@ -6640,6 +7284,8 @@ void Q3DSSceneManager::updateEffect(Q3DSEffectInstance *eff3DS)
             break;
         }
     });
+
+    m_profiler->reportEffectParamUpdates(updated, skipped);
 }
 
 // called after each frame
@@ -6649,22 +7295,62 @@ void Q3DSSceneManager::updateEffectForNextFrame(Q3DSEffectInstance *eff3DS, qint
     if (!effData->active)
         return;
 
-    effData->appFrameParam->setValue(float(nextFrameNo));
-    effData->fpsParam->setValue(60.0f); // heh
-    for (const auto &pd : effData->passData) {
-        const bool isPremultiplied = false;
-        pd.texture0InfoParam->setValue(QVector4D(pd.passInput->width(),
-                                                 pd.passInput->height(),
-                                                 isPremultiplied ? 1 : 0,
-                                                 0));
-        pd.destSizeParam->setValue(QVector2D(pd.passOutput->width(), pd.passOutput->height()));
+    // Only touch the parameters whose value actually changed. Apart from
+    // AppFrame (which is only relevant when the shaders use it) these are all
+    // size-dependent and so change only when the layer gets resized.
+    int updated = 0;
+    int skipped = 0;
+
+    if (eff3DS->effect()->flags().testFlag(Q3DSEffect::ReliesOnTime)) {
+        effData->appFrameParam->setValue(float(nextFrameNo));
+        ++updated;
+    } else {
+        ++skipped;
+    }
+
+    for (auto &pd : effData->passData) {
+        const QSize inputSize(pd.passInput->width(), pd.passInput->height());
+        if (inputSize != pd.lastInputSize) {
+            setTextureInfoUniform(pd.texture0InfoParam, inputSize);
+            pd.lastInputSize = inputSize;
+            ++updated;
+        } else {
+            ++skipped;
+        }
+        const QSize outputSize(pd.passOutput->width(), pd.passOutput->height());
+        if (outputSize != pd.lastOutputSize) {
+            pd.destSizeParam->setValue(QVector2D(outputSize.width(), outputSize.height()));
+            pd.lastOutputSize = outputSize;
+            ++updated;
+        } else {
+            ++skipped;
+        }
+    }
+
+    for (auto &tb : effData->textureBuffers) {
+        const QSize size = Q3DSImageManager::instance().size(tb.texture);
+        if (size != tb.lastTextureInfoSize) {
+            for (Qt3DRender::QParameter *param : tb.textureInfoParams)
+                setTextureInfoUniform(param, size);
+            tb.lastTextureInfoSize = size;
+            updated += tb.textureInfoParams.count();
+        } else {
+            skipped += tb.textureInfoParams.count();
+        }
     }
-    for (const auto &tb : effData->textureBuffers) {
-        for (Qt3DRender::QParameter *param : tb.textureInfoParams)
-            setTextureInfoUniform(param, tb.texture);
+
+    for (auto &p : effData->sourceDepTextureInfoParams) {
+        const QSize size = Q3DSImageManager::instance().size(p.texture);
+        if (size != p.lastSize) {
+            setTextureInfoUniform(p.param, size);
+            p.lastSize = size;
+            ++updated;
+        } else {
+            ++skipped;
+        }
     }
-    for (const auto &p : effData->sourceDepTextureInfoParams)
-        setTextureInfoUniform(p.first, p.second);
+
+    m_profiler->reportEffectParamUpdates(updated, skipped);
 }
 
 namespace {
@@ -6831,7 +7517,9 @@ void Q3DSSceneManager::updateLightsParams(const QVector<Q3DSNodeAttached::Lights
     dst->lightAmbientTotalParamenter->setValue(lightAmbientTotal);
 }
 
-void Q3DSSceneManager::updateLightsBuffer(const QVector<Q3DSLightSource> &lights, Qt3DRender::QBuffer *uniformBuffer)
+void Q3DSSceneManager::updateLightsBuffer(const QVector<Q3DSNodeAttached::LightsData *> &lights,
+                                          QVector<Q3DSLightSource> Q3DSNodeAttached::LightsData::*lightList,
+                                          Qt3DRender::QBuffer *uniformBuffer, QByteArray *bufferData)
 {
     if (!uniformBuffer) // no models in the layer -> no buffers -> handle gracefully
         return; // can also get here when no custom material-specific buffers exist for a given layer because it only uses default material, this is normal
@@ -6839,57 +7527,45 @@ void Q3DSSceneManager::updateLightsBuffer(const QVector<Q3DSLightSource> &lights
     Q_ASSERT(sizeof(Q3DSLightSourceData) == 240);
     // uNumLights takes 4 * sizeof(qint32) since the next member must be 4N (16 bytes) aligned
     const int uNumLightsSize = 4 * sizeof(qint32);
-    QByteArray lightBufferData((sizeof(Q3DSLightSourceData) * m_gfxLimits.maxLightsPerLayer) + uNumLightsSize, '\0');
-    // Set the number of lights
-    qint32 *numLights = reinterpret_cast<qint32 *>(lightBufferData.data());
-    *numLights = lights.count();
-    // Set the lightData
-    Q3DSLightSourceData *lightData = reinterpret_cast<Q3DSLightSourceData *>(lightBufferData.data() + uNumLightsSize);
-    for (int i = 0; i < lights.count(); ++i) {
-        if (i >= m_gfxLimits.maxLightsPerLayer)
-            break;
-        lightData[i].m_position = lights[i].positionParam->value().value<QVector4D>();
-        lightData[i].m_direction = lights[i].directionParam->value().value<QVector3D>().toVector4D();
-        lightData[i].m_up = lights[i].upParam->value().value<QVector4D>();
-        lightData[i].m_right = lights[i].rightParam->value().value<QVector4D>();
-        // diffuse
-        // Normally this is where the materials diffuse color would be mixed with the light
-        // diffuse color, but since we can't update the uniformbuffer between draw calls yet
-        // This is moved back into the shader for now.
-        //auto lightDiffuseColor = lights[i].diffuseParam->value().value<QColor>();
-        //            lightData[i].m_diffuse = QVector4D(materialDiffuseColor.redF() * lightDiffuseColor.redF(),
-        //                                               materialDiffuseColor.greenF() * lightDiffuseColor.greenF(),
-        //                                               materialDiffuseColor.blueF() * lightDiffuseColor.blueF(),
-        //                                               1.0f);
-        lightData[i].m_diffuse = lights[i].diffuseParam->value().value<QVector4D>();
-        // ambient
-        lightData[i].m_ambient = lights[i].ambientParam->value().value<QVector4D>();
-        // specular
-        lightData[i].m_specular = lights[i].specularParam->value().value<QVector4D>();
-        // spotExponent
-        // TODO spotExponent
-        // spotCutoff
-        // TODO spotCutfoff
-        // constantAttenuation
-        lightData[i].m_constantAttenuation = lights[i].constantAttenuationParam->value().toFloat();
-        // linearAttenuation
-        lightData[i].m_linearAttenuation = lights[i].linearAttenuationParam->value().toFloat();
-        // quadraticAttenuation
-        lightData[i].m_quadraticAttenuation = lights[i].quadraticAttenuationParam->value().toFloat();
-        // range
-        // TODO range
-        // width
-        lightData[i].m_width = lights[i].widthParam->value().toFloat();
-        // height
-        lightData[i].m_height = lights[i].heightParam->value().toFloat();
-        // shadowControls
-        lightData[i].m_shadowControls = lights[i].shadowControlsParam->value().value<QVector4D>();
-        // shadowView
-        memcpy(lightData[i].m_shadowView, lights[i].shadowViewParam->value().value<QMatrix4x4>().constData(), 16 * sizeof(float));
-        // shadowIdx
-        lightData[i].m_shadowIdx = lights[i].shadowIdxParam->value().toInt();
+    const int bufferSize = (sizeof(Q3DSLightSourceData) * m_gfxLimits.maxLightsPerLayer) + uNumLightsSize;
+
+    // bufferData is a copy of what the QBuffer has. Compare against it and
+    // upload only the range that changed, or the whole thing on first use.
+    const bool fullUpload = bufferData->size() != bufferSize;
+    if (fullUpload)
+        bufferData->fill('\0', bufferSize);
+
+    char *dst = bufferData->data();
+    int dirtyBegin = fullUpload ? 0 : bufferSize;
+    int dirtyEnd = fullUpload ? bufferSize : 0;
+    auto write = [dst, &dirtyBegin, &dirtyEnd](int offset, const void *src, int size) {
+        if (memcmp(dst + offset, src, size)) {
+            memcpy(dst + offset, src, size);
+            dirtyBegin = qMin(dirtyBegin, offset);
+            dirtyEnd = qMax(dirtyEnd, offset + size);
+        }
+    };
+
+    // Set the lightData. No need to clear the entries beyond numLights when
+    // the count decreases since the shaders do not look at those.
+    qint32 numLights = 0;
+    for (Q3DSNodeAttached::LightsData *lightsData : lights) {
+        for (const Q3DSLightSource &ls : qAsConst(lightsData->*lightList)) {
+            if (numLights >= m_gfxLimits.maxLightsPerLayer)
+                break;
+            Q_ASSERT(ls.data);
+            write(uNumLightsSize + numLights * int(sizeof(Q3DSLightSourceData)), ls.data, sizeof(Q3DSLightSourceData));
+            ++numLights;
+        }
     }
-    uniformBuffer->setData(lightBufferData);
+
+    // Set the number of lights
+    write(0, &numLights, sizeof(qint32));
+
+    if (fullUpload)
+        uniformBuffer->setData(*bufferData);
+    else if (dirtyBegin < dirtyEnd)
+        uniformBuffer->updateData(dirtyBegin, bufferData->mid(dirtyBegin, dirtyEnd - dirtyBegin));
 }
 
 void Q3DSSceneManager::updateModel(Q3DSModelNode *model3DS)
@@ -6946,10 +7622,14 @@ QVector<Q3DSNodeAttached::LightsData *> Q3DSSceneManager::getLightsDataForNode(Q
 // when entering a slide, or when animating a property
 void Q3DSSceneManager::handlePropertyChange(Q3DSGraphObject *obj, const QSet<QString> &keys, int changeFlags)
 {
-    // 'keys' is not used here, rely rather on the pre-baked changeFlags to
-    // determine certain special cases. For others it is enough to
-    // know that _something_ has changed.
-    Q_UNUSED(keys);
+    // 'keys' is not used for the Qt3D side, rely rather on the pre-baked
+    // changeFlags to determine certain special cases. For others it is enough
+    // to know that _something_ has changed. The slide players need to know
+    // about changes to the inputs of their visibility schedules however.
+    if (keys.contains(QLatin1String("eyeball")))
+        ++m_visibilityGeneration;
+    if (keys.contains(QLatin1String("starttime")) || keys.contains(QLatin1String("endtime")))
+        ++m_slideScheduleGeneration;
 
     Q3DSGraphObjectAttached *data = obj->attached();
     if (!data) // Qt3D stuff not yet built for this object -> nothing to do
@@ -7059,20 +7739,14 @@ void Q3DSSceneManager::syncScene()
         // Attempt to update all buffers, if some do not exist (null) that's fine too.
         auto lights = getLightsDataForNode(subtreeObject);
 
-        QVector<Q3DSLightSource> allLights;
-        QVector<Q3DSLightSource> nonAreaLights;
-        QVector<Q3DSLightSource> areaLights;
-
         if (!lights.isEmpty()) {
             Q3DSNodeAttached::LightsData *lightsData = lights.first();
-            for (auto light : lights) {
-                allLights.append(light->allLights);
-                nonAreaLights.append(light->nonAreaLights);
-                areaLights.append(light->areaLights);
-            }
-            updateLightsBuffer(allLights, lightsData->allLightsConstantBuffer);
-            updateLightsBuffer(nonAreaLights, lightsData->nonAreaLightsConstantBuffer);
-            updateLightsBuffer(areaLights, lightsData->areaLightsConstantBuffer);
+            updateLightsBuffer(lights, &Q3DSNodeAttached::LightsData::allLights,
+                               lightsData->allLightsConstantBuffer, &lightsData->allLightsBufferData);
+            updateLightsBuffer(lights, &Q3DSNodeAttached::LightsData::nonAreaLights,
+                               lightsData->nonAreaLightsConstantBuffer, &lightsData->nonAreaLightsBufferData);
+            updateLightsBuffer(lights, &Q3DSNodeAttached::LightsData::areaLights,
+                               lightsData->areaLightsConstantBuffer, &lightsData->areaLightsBufferData);
         }
 
         bool smDidChange = false;
@@ -7114,10 +7788,36 @@ void Q3DSSceneManager::syncScene()
         rebuildModelMaterial(model3DS);
 
     setPendingVisibilities();
+
+    if (m_modelInstancing) {
+        Q3DSUipPresentation::forAllLayers(m_scene, [this](Q3DSLayerNode *layer3DS) {
+            updateInstanceGroups(layer3DS);
+        });
+    }
+}
+
+Q3DSSlidePlayer *Q3DSSceneManager::slidePlayerForObject(Q3DSGraphObject *obj) const
+{
+    Q3DSComponentNode *component = obj->attached() ? obj->attached()->component : nullptr;
+    if (!component)
+        return m_slidePlayer;
+
+    Q3DSSlideAttached *data = component->masterSlide()->attached<Q3DSSlideAttached>();
+    return data ? data->slidePlayer : nullptr;
 }
 
 void Q3DSSceneManager::setPendingVisibilities()
 {
+    // What gets applied is not necessarily what the slide player asked for
+    // (or the change may not come from the slide player at all), so the
+    // player owning the object has to look at all its objects again. The
+    // players of other components keep their state, with deeply nested
+    // components the idle ones would otherwise be re-evaluated every frame.
+    for (auto it = m_pendingObjectVisibility.constBegin(); it != m_pendingObjectVisibility.constEnd(); ++it) {
+        if (Q3DSSlidePlayer *player = slidePlayerForObject(it.key()))
+            player->invalidateVisibilitySchedule();
+    }
+
     for (auto it = m_pendingObjectVisibility.constBegin(); it != m_pendingObjectVisibility.constEnd(); ++it) {
         if (it.key()->isNode() && it.key()->type() != Q3DSGraphObject::Layer && it.key()->type() != Q3DSGraphObject::Camera) {
             Q3DSNode *node = static_cast<Q3DSNode *>(it.key());
@@ -7200,11 +7900,15 @@ bool Q3DSSceneManager::isComponentVisible(Q3DSComponentNode *component)
 void Q3DSSceneManager::prepareNextFrame()
 {
     m_wasDirty = false;
+    m_texturePool.newFrame();
     Q3DSUipPresentation::forAllLayers(m_scene, [](Q3DSLayerNode *layer3DS) {
         static_cast<Q3DSLayerAttached *>(layer3DS->attached())->wasDirty = false;
     });
 
     syncScene();
+    updateSubPresentationActivity();
+    updateSubPresentationSizes();
+    markSubPresentationDependentLayersDirty();
 
     qint64 nextFrameNo = m_frameUpdater->frameCounter() + 1;
     Q3DSUipPresentation::forAllLayers(m_scene, [this, nextFrameNo](Q3DSLayerNode *layer3DS) {
@@ -7230,20 +7934,7 @@ void Q3DSSceneManager::prepareNextFrame()
         if (!layerData->layerFgRoot) // layers with a subpresentation won't have this
             return;
 
-        // m_layerCacheDeps holds scenemanagers for subpresentations whose
-        // result is used as texture maps by us. Best we can do is to check the
-        // global dirty flag and prevent any layer caching to kick in.
-        bool subDirty = false;
-        for (Q3DSSceneManager *subSceneManager : m_layerCacheDeps) {
-            if (subSceneManager->m_wasDirty) {
-                subDirty = true;
-                break;
-            }
-        }
-        // Any QML subpresentations used as texture map disables layer caching
-        // altogether since we have no idea when their content changes.
-        if (m_hasQmlSubPresAsTextureMap)
-            subDirty = true;
+        updateShadowMapCaching(layer3DS);
 
         // Layers having an active post-processing effect relying on time (like
         // the AppFrame uniform) cannot be cached since the effect needs
@@ -7252,7 +7943,7 @@ void Q3DSSceneManager::prepareNextFrame()
         const bool hasTimeDependentEffect = layerData->effectActive
                 && layerData->effectData.combinedEffectFlags.testFlag(Q3DSEffect::ReliesOnTime);
 
-        if (!layerData->wasDirty && !m_layerUncachePending && !subDirty && !hasTimeDependentEffect) {
+        if (!layerData->wasDirty && !m_layerUncachePending && !hasTimeDependentEffect) {
             ++layerData->nonDirtyRenderCount;
             if (layerData->nonDirtyRenderCount > LAYER_CACHING_THRESHOLD) {
                 layerData->nonDirtyRenderCount = 0;
@@ -7271,9 +7962,52 @@ void Q3DSSceneManager::prepareNextFrame()
             }
         }
     });
+
+    updateIdleState();
     m_layerUncachePending = false;
 }
 
+// A frame is idle when nothing changed in it and nothing is going to change on
+// its own in the next one either: no dirty graph objects or layers, no queued
+// events, no playing slides (i.e. no running animations or timed visibility
+// changes), no progressive/temporal AA accumulation, and no effects relying on
+// time. Input, data input, behaviors and API calls all end up as dirty
+// objects or queued events so these are covered as well.
+
+void Q3DSSceneManager::updateIdleState()
+{
+    bool idle = !m_wasDirty && !m_layerUncachePending && m_eventQueue.isEmpty();
+
+    if (idle) {
+        Q3DSUipPresentation::forAllLayers(m_scene, [&idle](Q3DSLayerNode *layer3DS) {
+            Q3DSLayerAttached *layerData = layer3DS->attached<Q3DSLayerAttached>();
+            if (!layerData)
+                return;
+            if (layerData->wasDirty)
+                idle = false;
+            else if (layerData->effectActive && layerData->effectData.combinedEffectFlags.testFlag(Q3DSEffect::ReliesOnTime))
+                idle = false;
+        });
+    }
+
+    if (idle && m_slidePlayer) {
+        if (m_slidePlayer->state() == Q3DSSlidePlayer::PlayerState::Playing) {
+            idle = false;
+        } else {
+            // component slide players are children of the main one
+            const auto componentPlayers = m_slidePlayer->findChildren<Q3DSSlidePlayer *>();
+            for (Q3DSSlidePlayer *player : componentPlayers) {
+                if (player->state() == Q3DSSlidePlayer::PlayerState::Playing) {
+                    idle = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    m_idle = idle;
+}
+
 // Now to the nightmare of maintaining per-layer dirty flags. The scene-wide
 // m_wasDirty flag is simple but ultimately of little value since techniques
 // like progressive or temporal AA need to know the status on a per-layer basis.
@@ -7324,6 +8058,329 @@ static void markLayerForObjectDirty(Q3DSGraphObject *obj)
     }
 }
 
+// Subpresentations used as texture maps (not as layers) invalidate only the
+// layers that actually reference the image in question, instead of preventing
+// layer caching in the entire presentation. For QML subpresentations the
+// engine maintains a change counter since there is no scenemanager to ask.
+
+void Q3DSSceneManager::markSubPresentationDependentLayersDirty()
+{
+    if (m_subPresImages.isEmpty())
+        return;
+
+    QSet<QString> dirtySubPresIds;
+    for (const Q3DSSubPresentation &subPres : qAsConst(m_subPresentations)) {
+        if (subPres.sceneManager) {
+            if (subPres.sceneManager->m_wasDirty)
+                dirtySubPresIds.insert(subPres.id);
+        } else if (subPres.qmlContentChangeCount) {
+            const int changeCount = *subPres.qmlContentChangeCount;
+            auto it = m_qmlSubPresChangeCounts.find(subPres.id);
+            if (it == m_qmlSubPresChangeCounts.end() || *it != changeCount) {
+                m_qmlSubPresChangeCounts.insert(subPres.id, changeCount);
+                dirtySubPresIds.insert(subPres.id);
+            }
+        }
+    }
+    if (dirtySubPresIds.isEmpty())
+        return;
+
+    bool allLayersDirty = false;
+    for (auto it = m_subPresImages.cbegin(), itEnd = m_subPresImages.cend(); it != itEnd; ++it) {
+        if (!dirtySubPresIds.contains(it.value()))
+            continue;
+        Q3DSImage *image3DS = it.key();
+        Q3DSImageAttached *data = image3DS->attached<Q3DSImageAttached>();
+        // Images used by custom materials, effects or light probes are not
+        // tracked per layer. Be conservative for these.
+        if (!data || data->referencingDefaultMaterials.isEmpty()) {
+            allLayersDirty = true;
+            break;
+        }
+        markLayerForObjectDirty(image3DS);
+    }
+    if (allLayersDirty) {
+        Q3DSUipPresentation::forAllLayers(m_scene, [](Q3DSLayerNode *layer3DS) {
+            static_cast<Q3DSLayerAttached *>(layer3DS->attached())->wasDirty = true;
+        });
+    }
+}
+
+// Subpresentations render into their texture every frame, regardless of
+// anything showing that texture. With many subpresentations spread over
+// different slides that is mostly wasted work, so the ones not referenced by
+// a visible subpresentation layer or a visible model's image are suspended:
+// their render target selector (or QScene2D) is disabled, and the slide
+// players of .uip subpresentations are paused. Frame processing and behaviors
+// keep running. Images that are not tracked per model (custom materials,
+// effects, light probes) count as always referenced.
+
+void Q3DSSceneManager::updateSubPresentationActivity()
+{
+    if (m_subPresentations.isEmpty())
+        return;
+
+    QSet<QString> referenced;
+    Q3DSUipPresentation::forAllLayers(m_scene, [&referenced](Q3DSLayerNode *layer3DS) {
+        if (layer3DS->sourcePath().isEmpty())
+            return;
+        Q3DSLayerAttached *layerData = layer3DS->attached<Q3DSLayerAttached>();
+        if (layerData && layer3DS->flags().testFlag(Q3DSNode::Active)
+                && layerData->visibilityTag == Q3DSGraphObjectAttached::Visible)
+        {
+            referenced.insert(layer3DS->sourcePath());
+        }
+    });
+    for (auto it = m_subPresImages.cbegin(), itEnd = m_subPresImages.cend(); it != itEnd; ++it) {
+        if (referenced.contains(it.value()))
+            continue;
+        Q3DSImageAttached *data = it.key()->attached<Q3DSImageAttached>();
+        if (!data || data->referencingDefaultMaterials.isEmpty()) {
+            referenced.insert(it.value());
+            continue;
+        }
+        for (Q3DSDefaultMaterial *mat3DS : qAsConst(data->referencingDefaultMaterials)) {
+            Q3DSMaterialAttached *matData = mat3DS->attached<Q3DSMaterialAttached>();
+            const bool visible = matData && std::any_of(matData->perModelData.keyBegin(), matData->perModelData.keyEnd(),
+                                                        [](Q3DSModelNode *model3DS) {
+                Q3DSNodeAttached *modelData = model3DS->attached<Q3DSNodeAttached>();
+                return modelData && modelData->globalEffectiveVisibility;
+            });
+            if (visible) {
+                referenced.insert(it.value());
+                break;
+            }
+        }
+    }
+
+    for (const Q3DSSubPresentation &subPres : qAsConst(m_subPresentations)) {
+        const bool active = referenced.contains(subPres.id);
+        if (active != m_inactiveSubPresentations.contains(subPres.id))
+            continue;
+
+        qCDebug(lcPerf, "%s subpresentation %s", active ? "Resuming" : "Suspending", qPrintable(subPres.id));
+        if (active)
+            m_inactiveSubPresentations.remove(subPres.id);
+        else
+            m_inactiveSubPresentations.insert(subPres.id);
+
+        if (subPres.frameGraph)
+            subPres.frameGraph->setEnabled(active);
+        if (subPres.scene2d)
+            subPres.scene2d->setEnabled(active);
+        if (subPres.sceneManager)
+            subPres.sceneManager->setSuspended(!active);
+        // the texture has not been rendered to in the meantime
+        if (active)
+            m_layerUncachePending = true;
+    }
+}
+
+void Q3DSSceneManager::setSuspended(bool suspended)
+{
+    if (m_suspended == suspended)
+        return;
+
+    m_suspended = suspended;
+
+    if (suspended) {
+        // Pausing stops the animators but keeps the slide time, unlike
+        // stopping, and resuming does not restart looping slides.
+        if (m_slidePlayer) {
+            QVector<Q3DSSlidePlayer *> players { m_slidePlayer };
+            // component slide players are children of the main one
+            players += m_slidePlayer->findChildren<Q3DSSlidePlayer *>().toVector();
+            for (Q3DSSlidePlayer *player : qAsConst(players)) {
+                if (player->state() == Q3DSSlidePlayer::PlayerState::Playing) {
+                    player->pause();
+                    m_suspendedPlayers.append(player);
+                }
+            }
+        }
+    } else {
+        // the ones stopped in the meantime stay stopped
+        for (const QPointer<Q3DSSlidePlayer> &player : qAsConst(m_suspendedPlayers)) {
+            if (player && player->state() == Q3DSSlidePlayer::PlayerState::Paused)
+                player->play();
+        }
+        m_suspendedPlayers.clear();
+    }
+}
+
+// A .uip subpresentation used as a texture map renders at its authored size
+// by default, which says little about how large it appears on screen. The
+// footprint is estimated from the projected bounds of the visible models using
+// it, and the render target follows that in power of two steps. Growing
+// happens right away, shrinking only once the footprint has stayed well below
+// the next smaller step for a while, so that moving models do not keep
+// reallocating the textures. Subpresentations sourced by layers already follow
+// the layer size and are left alone here.
+
+static const float SUBPRES_MIN_SCALE = 0.125f;
+static const float SUBPRES_MAX_SCALE = 2.0f;
+static const float SUBPRES_SHRINK_MARGIN = 0.8f;
+static const int SUBPRES_SHRINK_FRAMES = 30;
+static const int SUBPRES_MAX_TEXTURE_SIZE = 4096;
+
+static QMatrix4x4 cameraViewMatrix(const QMatrix4x4 &cameraWorldTransform)
+{
+    const QVector4D position = cameraWorldTransform * QVector4D(0.0f, 0.0f, 0.0f, 1.0f);
+    const QVector4D viewDirection = cameraWorldTransform * QVector4D(0.0f, 0.0f, -1.0f, 0.0f);
+    const QVector4D upVector = cameraWorldTransform * QVector4D(0.0f, 1.0f, 0.0f, 0.0f);
+    QMatrix4x4 m;
+    m.lookAt(QVector3D(position), QVector3D(position + viewDirection), QVector3D(upVector));
+    return m;
+}
+
+// Size of the model's bounding box on screen, in layer pixels. Falls back to
+// the entire layer when that cannot be determined.
+static QSizeF projectedModelSize(Q3DSModelNode *model3DS)
+{
+    Q3DSModelAttached *data = model3DS->attached<Q3DSModelAttached>();
+    Q3DSLayerAttached *layerData = data->layer3DS ? data->layer3DS->attached<Q3DSLayerAttached>() : nullptr;
+    if (!layerData)
+        return QSizeF();
+
+    const QSizeF layerSize(layerData->layerSize);
+    Q3DSCameraAttached *cameraData = layerData->cam3DS ? layerData->cam3DS->attached<Q3DSCameraAttached>() : nullptr;
+    if (!cameraData || !cameraData->camera || data->subMeshes.isEmpty())
+        return layerSize;
+
+    const QMatrix4x4 mvp = cameraData->camera->lens()->projectionMatrix()
+            * cameraViewMatrix(cameraData->globalTransform) * data->globalTransform;
+    float minX = 1.0f, minY = 1.0f, maxX = -1.0f, maxY = -1.0f;
+    for (const Q3DSModelAttached::SubMesh &sm : data->subMeshes) {
+        if (!sm.mesh || !sm.mesh->hasBounds())
+            return layerSize;
+        const QVector3D bmin = sm.mesh->minimumBounds();
+        const QVector3D bmax = sm.mesh->maximumBounds();
+        for (int i = 0; i < 8; ++i) {
+            const QVector4D p = mvp * QVector4D(i & 1 ? bmax.x() : bmin.x(),
+                                                i & 2 ? bmax.y() : bmin.y(),
+                                                i & 4 ? bmax.z() : bmin.z(), 1.0f);
+            // crossing the camera plane, the projection is meaningless
+            if (p.w() <= 0.0f)
+                return layerSize;
+            minX = qMin(minX, p.x() / p.w());
+            minY = qMin(minY, p.y() / p.w());
+            maxX = qMax(maxX, p.x() / p.w());
+            maxY = qMax(maxY, p.y() / p.w());
+        }
+    }
+    minX = qMax(minX, -1.0f);
+    minY = qMax(minY, -1.0f);
+    maxX = qMin(maxX, 1.0f);
+    maxY = qMin(maxY, 1.0f);
+    if (maxX <= minX || maxY <= minY)
+        return QSizeF();
+
+    return QSizeF((maxX - minX) * 0.5f * layerSize.width(), (maxY - minY) * 0.5f * layerSize.height());
+}
+
+// Picks the power of two scale covering the wanted one. Returns the current
+// scale as long as no change is due.
+float Q3DSSceneManager::nextSubPresentationScale(float current, float wanted, float maxScale, int *shrinkFrameCount)
+{
+    float scale = SUBPRES_MIN_SCALE;
+    while (scale < wanted && scale * 2.0f <= maxScale)
+        scale *= 2.0f;
+
+    if (scale > current) {
+        *shrinkFrameCount = 0;
+        return scale;
+    }
+    if (scale < current && wanted < current * 0.5f * SUBPRES_SHRINK_MARGIN) {
+        if (++*shrinkFrameCount < SUBPRES_SHRINK_FRAMES)
+            return current;
+        *shrinkFrameCount = 0;
+        return scale;
+    }
+    *shrinkFrameCount = 0;
+    return current;
+}
+
+void Q3DSSceneManager::updateSubPresentationSizes()
+{
+    if (m_subPresImages.isEmpty())
+        return;
+
+    QSet<QString> layerSources;
+    Q3DSUipPresentation::forAllLayers(m_scene, [&layerSources](Q3DSLayerNode *layer3DS) {
+        if (!layer3DS->sourcePath().isEmpty())
+            layerSources.insert(layer3DS->sourcePath());
+    });
+
+    QHash<QString, QSizeF> footprints;
+    for (const Q3DSSubPresentation &subPres : qAsConst(m_subPresentations)) {
+        if (subPres.sceneManager && !subPres.presentationSize.isEmpty()
+                && !layerSources.contains(subPres.id) && !m_inactiveSubPresentations.contains(subPres.id))
+        {
+            footprints.insert(subPres.id, QSizeF());
+        }
+    }
+    if (footprints.isEmpty())
+        return;
+
+    for (auto it = m_subPresImages.cbegin(), itEnd = m_subPresImages.cend(); it != itEnd; ++it) {
+        auto footprintIt = footprints.find(it.value());
+        if (footprintIt == footprints.end())
+            continue;
+        Q3DSImage *image = it.key();
+        Q3DSImageAttached *data = image->attached<Q3DSImageAttached>();
+        // not tracked per model, keep the authored size
+        if (!data || data->referencingDefaultMaterials.isEmpty())
+            continue;
+        QSizeF &footprint(*footprintIt);
+        for (Q3DSDefaultMaterial *mat3DS : qAsConst(data->referencingDefaultMaterials)) {
+            Q3DSMaterialAttached *matData = mat3DS->attached<Q3DSMaterialAttached>();
+            if (!matData)
+                continue;
+            for (auto modelIt = matData->perModelData.keyBegin(), modelItEnd = matData->perModelData.keyEnd(); modelIt != modelItEnd; ++modelIt) {
+                Q3DSModelNode *model3DS = *modelIt;
+                Q3DSNodeAttached *modelData = model3DS->attached<Q3DSNodeAttached>();
+                if (!modelData || !modelData->globalEffectiveVisibility)
+                    continue;
+                // tiling shows the texture several times in the same area
+                const QSizeF sz = projectedModelSize(model3DS);
+                footprint = footprint.expandedTo(QSizeF(sz.width() / qMax(1.0f, qAbs(image->scaleU())),
+                                                        sz.height() / qMax(1.0f, qAbs(image->scaleV()))));
+            }
+        }
+    }
+
+    for (Q3DSSubPresentation &subPres : m_subPresentations) {
+        auto it = footprints.constFind(subPres.id);
+        if (it == footprints.cend() || it->isEmpty())
+            continue;
+
+        const QSize &presSize(subPres.presentationSize);
+        const float wanted = float(qMax(it->width() / presSize.width(), it->height() / presSize.height()));
+        const float maxScale = qMin(SUBPRES_MAX_SCALE,
+                                    float(SUBPRES_MAX_TEXTURE_SIZE) / qMax(presSize.width(), presSize.height()));
+        const float scale = nextSubPresentationScale(subPres.renderScale, wanted, maxScale, &subPres.shrinkFrameCount);
+        if (qFuzzyCompare(scale, subPres.renderScale))
+            continue;
+
+        subPres.renderScale = scale;
+        const QSize pixelSize(qMax(1, qRound(presSize.width() * scale)), qMax(1, qRound(presSize.height() * scale)));
+        qCDebug(lcPerf, "Resizing subpresentation %s to %dx%d (scale %g) for an on-screen size of %gx%g",
+                qPrintable(subPres.id), pixelSize.width(), pixelSize.height(), double(scale),
+                it->width(), it->height());
+        subPres.colorTex->setWidth(pixelSize.width());
+        subPres.colorTex->setHeight(pixelSize.height());
+        if (subPres.depthOrDepthStencilTex) {
+            subPres.depthOrDepthStencilTex->setWidth(pixelSize.width());
+            subPres.depthOrDepthStencilTex->setHeight(pixelSize.height());
+        }
+        if (subPres.stencilTex) {
+            subPres.stencilTex->setWidth(pixelSize.width());
+            subPres.stencilTex->setHeight(pixelSize.height());
+        }
+        // the logical size stays, only the device pixel ratio changes
+        subPres.sceneManager->updateSizes(presSize, scale, QRect(QPoint(0, 0), presSize));
+    }
+}
+
 void Q3DSSceneManager::updateSubTreeRecursive(Q3DSGraphObject *obj)
 {
     switch (obj->type()) {
@@ -7363,6 +8420,7 @@ void Q3DSSceneManager::updateSubTreeRecursive(Q3DSGraphObject *obj)
             updateNodeFromChangeFlags(light3DS, data->transform, data->frameChangeFlags);
             if (data->frameDirty & (Q3DSGraphObjectAttached::LightDirty | Q3DSGraphObjectAttached::GlobalTransformDirty)) {
                 setLightProperties(light3DS);
+                markShadowMapsDirty(data->layer3DS);
                 if (!(data->frameChangeFlags & Q3DSNode::EyeballChanges)) {// already done if eyeball changed
                     if (light3DS->scope() && isLightScopeValid(light3DS->scope(), data->layer3DS))
                         m_subTreesWithDirtyLights.insert(SubTreeWithDirtyLight(light3DS->scope(), false));
@@ -7383,6 +8441,8 @@ void Q3DSSceneManager::updateSubTreeRecursive(Q3DSGraphObject *obj)
             updateNodeFromChangeFlags(model3DS, data->transform, data->frameChangeFlags);
             if (data->frameDirty & (Q3DSGraphObjectAttached::ModelDirty | Q3DSGraphObjectAttached::GlobalOpacityDirty)) {
                 updateModel(model3DS);
+                if (data->frameDirty & Q3DSGraphObjectAttached::ModelDirty) // e.g. mesh change
+                    markShadowMapsDirty(data->layer3DS);
                 m_wasDirty = true;
                 markLayerForObjectDirty(model3DS);
             }
@@ -7415,6 +8475,7 @@ void Q3DSSceneManager::updateSubTreeRecursive(Q3DSGraphObject *obj)
         Q3DSLayerNode *layer3DS = static_cast<Q3DSLayerNode *>(obj);
         Q3DSLayerAttached *data = static_cast<Q3DSLayerAttached *>(layer3DS->attached());
         if (data && (data->frameDirty & Q3DSGraphObjectAttached::LayerDirty)) {
+            markShadowMapsDirty(layer3DS); // size or content change
             updateSizesForLayer(layer3DS, data->parentSize);
             setLayerProperties(layer3DS);
             if (data->frameChangeFlags & Q3DSLayerNode::AoOrShadowChanges) {
@@ -7612,6 +8673,8 @@ void Q3DSSceneManager::setNodeVisibility(Q3DSNode *node, bool visible)
     if (!layerData->opaqueTag || !layerData->transparentTag) // bail out for subpresentation layers
         return;
 
+    layerData->shadowMapData.dirty = true;
+
     if (!visible) {
         data->visibilityTag = Q3DSGraphObjectAttached::Hidden;
         data->entity->removeComponent(layerData->opaqueTag);
@@ -7976,13 +9039,22 @@ void Q3DSSceneManager::handleEvent(const Q3DSGraphObject::Event &e)
         slide = component->currentSlide();
 
     const auto runSlideAction = [this, &e](Q3DSSlide *slide) {
-        if (slide) {
-            for (const Q3DSAction &action : slide->actions()) {
-                if (!action.eyeball || action.triggerObject != e.target)
-                    continue;
-                if (action.event == e.event)
-                    runAction(action);
-            }
+        if (!slide)
+            return;
+        // Events bubble up to the scene so most of them arrive here for
+        // objects that trigger nothing. Bail out before touching the name.
+        const auto &dispatch = actionDispatchTable(slide);
+        auto it = dispatch.constFind(e.target);
+        if (it == dispatch.cend())
+            return;
+        const int eventId = m_actionEventIds.value(e.event, -1);
+        if (eventId < 0)
+            return;
+        // the handlers may change the slide's actions, so iterate on a copy
+        const QVector<Q3DSCompiledAction> actions = *it;
+        for (const Q3DSCompiledAction &action : actions) {
+            if (action.eventId == eventId)
+                runAction(action);
         }
     };
 
@@ -8030,21 +9102,178 @@ void Q3DSSceneManager::flushEventQueue()
     }
 }
 
-void Q3DSSceneManager::runAction(const Q3DSAction &action)
+int Q3DSSceneManager::actionEventId(const QString &event)
+{
+    auto it = m_actionEventIds.constFind(event);
+    if (it != m_actionEventIds.cend())
+        return *it;
+
+    const int id = m_actionEventIds.count();
+    m_actionEventIds.insert(event, id);
+    return id;
+}
+
+static QVariant convertActionValue(const QString &value, int type)
+{
+    // Only the types for which setProps() does nothing beyond the plain
+    // string conversion are handled here. Anything else (strings which may be
+    // paths, enums, object references, dynamic properties) keeps going
+    // through applyPropertyChanges().
+    switch (type) {
+    case QMetaType::Bool:
+    {
+        bool v;
+        if (Q3DS::convertToBool(&value, &v))
+            return v;
+    }
+        break;
+    case QMetaType::Int:
+    {
+        qint32 v;
+        if (Q3DS::convertToInt32(&value, &v))
+            return v;
+    }
+        break;
+    case QMetaType::Float:
+    {
+        float v;
+        if (Q3DS::convertToFloat(&value, &v))
+            return v;
+    }
+        break;
+    case QMetaType::QVector2D:
+    {
+        QVector2D v;
+        if (Q3DS::convertToVector2D(&value, &v))
+            return v;
+    }
+        break;
+    case QMetaType::QVector3D:
+    {
+        QVector3D v;
+        if (Q3DS::convertToVector3D(&value, &v))
+            return v;
+    }
+        break;
+    case QMetaType::QColor:
+    {
+        QVector3D v;
+        if (Q3DS::convertToVector3D(&value, &v))
+            return QColor::fromRgbF(v.x(), v.y(), v.z());
+    }
+        break;
+    default:
+        break;
+    }
+    return QVariant();
+}
+
+Q3DSCompiledAction Q3DSSceneManager::compileAction(const Q3DSAction &action)
 {
+    Q3DSCompiledAction c;
+    c.handler = action.handler;
+    c.id = action.id;
+    c.targetObject = action.targetObject;
+    c.eventId = actionEventId(action.event);
+    c.argsValid = true;
+
     switch (action.handler) {
     case Q3DSAction::SetProperty:
     {
         Q3DSAction::HandlerArgument propName = action.handlerWithArgType(Q3DSAction::HandlerArgument::Property);
         Q3DSAction::HandlerArgument propValue = action.handlerWithArgType(Q3DSAction::HandlerArgument::Dependent);
-        if (propName.isValid() && propValue.isValid()) {
+        c.argsValid = propName.isValid() && propValue.isValid();
+        c.name = propName.value;
+        if (c.argsValid && c.targetObject && !c.name.isEmpty()) {
+            const QMetaObject *mo = c.targetObject->metaObject();
+            const int idx = mo->indexOfProperty(c.name.toLatin1().constData());
+            if (idx >= 0 && mo->property(idx).isWritable())
+                c.value = convertActionValue(propValue.value, mo->property(idx).userType());
+            if (c.value.isValid()) {
+                c.property = mo->property(idx);
+                c.changeList = { Q3DSPropertyChange(c.name) };
+            } else {
+                c.changeList = { Q3DSPropertyChange(c.name, propValue.value) };
+            }
+        }
+    }
+        break;
+    case Q3DSAction::FireEvent:
+    {
+        Q3DSAction::HandlerArgument event = action.handlerWithArgType(Q3DSAction::HandlerArgument::Event);
+        c.argsValid = event.isValid();
+        c.name = event.value;
+    }
+        break;
+    case Q3DSAction::EmitSignal:
+    {
+        Q3DSAction::HandlerArgument signalName = action.handlerWithArgType(Q3DSAction::HandlerArgument::Signal);
+        c.argsValid = signalName.isValid();
+        c.name = signalName.value;
+    }
+        break;
+    case Q3DSAction::GoToSlide:
+    {
+        Q3DSAction::HandlerArgument slideName = action.handlerWithArgType(Q3DSAction::HandlerArgument::Slide);
+        c.argsValid = slideName.isValid();
+        c.name = slideName.value;
+    }
+        break;
+    case Q3DSAction::GoToTime:
+    {
+        Q3DSAction::HandlerArgument newTime = action.handlerWithName(QLatin1String("Time"));
+        Q3DSAction::HandlerArgument shouldPause = action.handlerWithName(QLatin1String("Pause"));
+        c.argsValid = newTime.isValid();
+        c.seekTimeMs = newTime.value.toFloat(); // input value is assumed to be in milliseconds
+        if (shouldPause.isValid())
+            Q3DS::convertToBool(&shouldPause.value, &c.pause);
+    }
+        break;
+    case Q3DSAction::BehaviorHandler:
+        c.name = action.behaviorHandler;
+        break;
+    default:
+        break;
+    }
+
+    return c;
+}
+
+const QHash<Q3DSGraphObject *, QVector<Q3DSCompiledAction>> &Q3DSSceneManager::actionDispatchTable(Q3DSSlide *slide)
+{
+    Q3DSSlideAttached *data = slide->attached<Q3DSSlideAttached>();
+    if (!data) {
+        data = new Q3DSSlideAttached;
+        data->entity = m_rootEntity;
+        slide->setAttached(data);
+    }
+
+    if (data->actionDispatchDirty) {
+        data->actionDispatch.clear();
+        for (const Q3DSAction &action : slide->actions()) {
+            if (action.eyeball && action.triggerObject)
+                data->actionDispatch[action.triggerObject].append(compileAction(action));
+        }
+        data->actionDispatchDirty = false;
+    }
+
+    return data->actionDispatch;
+}
+
+void Q3DSSceneManager::runAction(const Q3DSCompiledAction &action)
+{
+    switch (action.handler) {
+    case Q3DSAction::SetProperty:
+    {
+        if (action.argsValid) {
             Q3DSGraphObject *target = action.targetObject;
-            const QString name = propName.value;
-            const QString value = propValue.value;
-            if (target && !name.isEmpty()) {
-                Q3DSPropertyChangeList cl { Q3DSPropertyChange(name, value) };
-                target->applyPropertyChanges(cl);
-                target->notifyPropertyChanges(cl);
+            if (target && !action.name.isEmpty()) {
+                if (action.property.isValid()) {
+                    action.property.writeOnGadget(target, action.value);
+                } else {
+                    target->applyPropertyChanges(action.changeList);
+                }
+                target->notifyPropertyChanges(action.changeList);
             } else {
                 qWarning("SetProperty action %s has invalid target", action.id.constData());
             }
@@ -8055,11 +9284,10 @@ void Q3DSSceneManager::runAction(const Q3DSAction &action)
         break;
     case Q3DSAction::FireEvent:
     {
-        Q3DSAction::HandlerArgument event = action.handlerWithArgType(Q3DSAction::HandlerArgument::Event);
-        if (event.isValid()) {
+        if (action.argsValid) {
             Q3DSGraphObject *target = action.targetObject;
-            if (target && !event.value.isEmpty())
-                queueEvent(Q3DSGraphObject::Event(target, event.value));
+            if (target && !action.name.isEmpty())
+                queueEvent(Q3DSGraphObject::Event(target, action.name));
         }
     }
         break;
@@ -8068,19 +9296,17 @@ void Q3DSSceneManager::runAction(const Q3DSAction &action)
         // expose this in the public API somehow, no further actions are needed
         // on the runtime's side.
     {
-        Q3DSAction::HandlerArgument signalName = action.handlerWithArgType(Q3DSAction::HandlerArgument::Signal);
-        if (signalName.isValid()) {
+        if (action.argsValid) {
             Q3DSGraphObject *target = action.targetObject;
-            if (target && !signalName.value.isEmpty())
-                emit m_engine->customSignalEmitted(target, signalName.value);
+            if (target && !action.name.isEmpty())
+                emit m_engine->customSignalEmitted(target, action.name);
         }
     }
         break;
     case Q3DSAction::GoToSlide:
     {
-        Q3DSAction::HandlerArgument slideName = action.handlerWithArgType(Q3DSAction::HandlerArgument::Slide);
-        if (slideName.isValid())
-            changeSlideByName(action.targetObject, slideName.value);
+        if (action.argsValid)
+            changeSlideByName(action.targetObject, action.name);
         else
             qWarning("GoToSlide action %s has no valid slide name argument", action.id.constData());
     }
@@ -8137,15 +9363,8 @@ void Q3DSSceneManager::runAction(const Q3DSAction &action)
         break;
     case Q3DSAction::GoToTime:
     {
-        Q3DSAction::HandlerArgument newTime = action.handlerWithName(QLatin1String("Time"));
-        Q3DSAction::HandlerArgument shouldPause = action.handlerWithName(QLatin1String("Pause"));
-        if (action.targetObject && newTime.isValid()) {
-            const float seekTimeMs = newTime.value.toFloat(); // input value is assumed to be in milliseconds
-            bool pause = false;
-            if (shouldPause.isValid())
-                Q3DS::convertToBool(&shouldPause.value, &pause);
-            goToTimeAction(action.targetObject, seekTimeMs, pause);
-        }
+        if (action.targetObject && action.argsValid)
+            goToTimeAction(action.targetObject, action.seekTimeMs, action.pause);
     }
         break;
     case Q3DSAction::BehaviorHandler:
@@ -8157,7 +9376,7 @@ void Q3DSSceneManager::runAction(const Q3DSAction &action)
             if (handles.contains(bi))
                 qmlObj = handles[bi].object;
             if (qmlObj)
-                qmlObj->call(action.behaviorHandler);
+                qmlObj->call(action.name);
             // else the behavior instance is not loaded (QML object is not
             // active) - this is fine and not an error when the behavior instance
             // has active (eyeball) == false
@@ -8178,6 +9397,31 @@ void Q3DSSceneManager::handleNodeGlobalChange(Q3DSNode *node)
 
     Q3DSGraphObjectAttached::FrameDirtyFlags dirty = node->attached()->frameDirty;
 
+    // Moving or hiding a model (or a light or the camera) invalidates the
+    // shadow maps of its layer.
+    if (dirty & (Q3DSGraphObjectAttached::GlobalTransformDirty | Q3DSGraphObjectAttached::GlobalVisibilityDirty)) {
+        switch (node->type()) {
+        case Q3DSGraphObject::Model:
+        case Q3DSGraphObject::Text:
+        case Q3DSGraphObject::Light:
+        case Q3DSGraphObject::Camera:
+        {
+            Q3DSNodeAttached *data = node->attached<Q3DSNodeAttached>();
+            if (data->layer3DS)
+                markShadowMapsDirty(data->layer3DS);
+        }
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Instance groups take these from the instance buffer.
+    if (node->type() == Q3DSGraphObject::Model) {
+        if (Q3DSLayerAttached::InstanceGroup *group = node->attached<Q3DSModelAttached>()->instanceGroup)
+            group->bufferDirty = true;
+    }
+
     if (dirty.testFlag(Q3DSGraphObjectAttached::GlobalVisibilityDirty)) {
         if (node->type() == Q3DSGraphObject::Camera) {
             Q3DSCameraAttached *data = node->attached<Q3DSCameraAttached>();
@@ -8263,6 +9507,33 @@ void Q3DSSceneManager::handleSceneChange(Q3DSScene *, Q3DSGraphObject::DirtyFlag
 
             m_pendingObjectVisibility.remove(objOrChild);
 
+            if (objOrChild->type() == Q3DSGraphObject::Image) {
+                m_subPresImages.remove(static_cast<Q3DSImage *>(objOrChild));
+            } else if (objOrChild->type() == Q3DSGraphObject::Model) {
+                // A referenced material keeps the per-model data in the
+                // material it refers to, which may be outside of this subtree.
+                Q3DSModelNode *model3DS = static_cast<Q3DSModelNode *>(objOrChild);
+                leaveInstanceGroup(model3DS);
+                Q3DSLayerNode *layer3DS = static_cast<Q3DSModelAttached *>(data)->layer3DS;
+                if (layer3DS && layer3DS->attached())
+                    layer3DS->attached<Q3DSLayerAttached>()->instancingDirtyModels.remove(model3DS);
+                for (Q3DSGraphObject *c = model3DS->firstChild(); c; c = c->nextSibling()) {
+                    Q3DSGraphObject *mat = c;
+                    if (c->type() == Q3DSGraphObject::ReferencedMaterial)
+                        mat = static_cast<Q3DSReferencedMaterial *>(c)->referencedMaterial();
+                    if (mat && mat->attached() && (mat->type() == Q3DSGraphObject::DefaultMaterial
+                                                   || mat->type() == Q3DSGraphObject::CustomMaterial))
+                    {
+                        static_cast<Q3DSMaterialAttached *>(mat->attached())->perModelData.remove(model3DS);
+                    }
+                }
+            } else if (objOrChild->type() == Q3DSGraphObject::DefaultMaterial) {
+                for (auto it = m_subPresImages.cbegin(), itEnd = m_subPresImages.cend(); it != itEnd; ++it) {
+                    if (Q3DSImageAttached *imageData = it.key()->attached<Q3DSImageAttached>())
+                        imageData->referencingDefaultMaterials.remove(static_cast<Q3DSDefaultMaterial *>(objOrChild));
+                }
+            }
+
             if (objOrChild->type() == Q3DSGraphObject::Effect) {
                 Q3DSEffectInstance *eff3DS = static_cast<Q3DSEffectInstance *>(objOrChild);
                 Q3DSLayerNode *layer3DS = findLayerForObjectInScene(eff3DS);
@@ -8278,6 +9549,20 @@ void Q3DSSceneManager::handleSceneChange(Q3DSScene *, Q3DSGraphObject::DirtyFlag
             // only thing that's still set is obj's parent ptr). Therefore the
             // compositor will not see this layer anymore.
             rebuildCompositorLayerChain();
+
+            // Tear down the layer's framegraph subtree (which also takes the
+            // entities of the layer contents with it) and give its render
+            // target textures back to the pool.
+            Q3DSLayerAttached *layerData = obj->attached<Q3DSLayerAttached>();
+            if (layerData && layerData->layerFgRoot) {
+                delete layerData->layerFgRoot;
+                layerData->layerFgRoot = nullptr;
+                delete layerData->layerFgDummyParent;
+                layerData->layerFgDummyParent = nullptr;
+                delete layerData->advBlend.tempRt;
+                layerData->advBlend.tempRt = nullptr;
+                releaseLayerTextures(layerData);
+            }
         } else {
             // ensure the containing layer stays up-to-date
             Q3DSLayerNode *layer3DS = findLayerForObjectInScene(obj);
@@ -8462,8 +9747,8 @@ void Q3DSSceneManager::handleSlideObjectChange(Q3DSSlide *slide, const Q3DSSlide
         break;
 
     case Q3DSSlide::SlideActionAdded: // addAction() was called
-        break;
     case Q3DSSlide::SlideActionRemoved: // removeAction() was called
+        slide->attached<Q3DSSlideAttached>()->actionDispatchDirty = true;
         break;
 
     default:
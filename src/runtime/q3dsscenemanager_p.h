@@ -44,6 +44,8 @@
 #include "q3dsuippresentation_p.h"
 #include "q3dsgraphicslimits_p.h"
 #include "q3dsinputmanager_p.h"
+#include "q3dstexturepool_p.h"
+#include "q3dsqualitygovernor_p.h"
 
 #include <QDebug>
 #include <QWindow>
@@ -51,6 +53,9 @@
 #include <QQueue>
 #include <QElapsedTimer>
 #include <QMutex>
+#include <QSharedPointer>
+#include <QPointer>
+#include <QMetaProperty>
 
 QT_BEGIN_NAMESPACE
 
@@ -64,6 +69,7 @@ class Q3DSProfiler;
 class Q3DSProfileUi;
 class Q3DSEngine;
 class Q3DSMesh;
+class Q3DSShaderProgramCache;
 class Q3DSSlidePlayer;
 class Q3DSConsoleCommands;
 
@@ -87,6 +93,7 @@ class QLayer;
 class QParameter;
 class QRenderPass;
 class QShaderProgram;
+class QEffect;
 class QBuffer;
 class QPaintedTextureImage;
 class QLayerFilter;
@@ -99,6 +106,9 @@ class QRayCaster;
 class QViewport;
 class QScissorTest;
 class QRenderStateSet;
+class QGeometryRenderer;
+class QAttribute;
+class QMaterial;
 }
 
 namespace Qt3DExtras {
@@ -110,30 +120,6 @@ class QPlaneMesh;
 // update are accessible in a sane manner. This is done via the *Attached
 // objects, with the pointers stored in the Q3DSNodes themselves.
 
-struct Q3DSLightSource
-{
-    Qt3DRender::QParameter *positionParam = nullptr;
-    Qt3DRender::QParameter *directionParam = nullptr;
-    Qt3DRender::QParameter *upParam = nullptr;
-    Qt3DRender::QParameter *rightParam = nullptr;
-    Qt3DRender::QParameter *diffuseParam = nullptr;
-    Qt3DRender::QParameter *ambientParam = nullptr;
-    Qt3DRender::QParameter *specularParam = nullptr;
-    //Qt3DRender::QParameter *spotExponentParam = nullptr;
-    //Qt3DRender::QParameter *spotCutoffParam = nullptr;
-    Qt3DRender::QParameter *constantAttenuationParam = nullptr;
-    Qt3DRender::QParameter *linearAttenuationParam = nullptr;
-    Qt3DRender::QParameter *quadraticAttenuationParam = nullptr;
-    //Qt3DRender::QParameter *rangeParam = nullptr;
-    Qt3DRender::QParameter *widthParam = nullptr;
-    Qt3DRender::QParameter *heightParam = nullptr;
-    Qt3DRender::QParameter *shadowControlsParam = nullptr;
-    Qt3DRender::QParameter *shadowViewParam = nullptr;
-    Qt3DRender::QParameter *shadowIdxParam = nullptr;
-};
-
-Q_DECLARE_TYPEINFO(Q3DSLightSource, Q_MOVABLE_TYPE);
-
 // note this struct must exactly match the memory layout of the GLSL struct
 // (which is typically in a std140 layout uniform block). If you make changes
 // here you need to adjust the code in funcsampleLightVars/sampleLight.glsllib
@@ -163,6 +149,34 @@ struct Q3DSLightSourceData
 
 Q_DECLARE_TYPEINFO(Q3DSLightSourceData, Q_MOVABLE_TYPE);
 
+struct Q3DSLightSource
+{
+    Qt3DRender::QParameter *positionParam = nullptr;
+    Qt3DRender::QParameter *directionParam = nullptr;
+    Qt3DRender::QParameter *upParam = nullptr;
+    Qt3DRender::QParameter *rightParam = nullptr;
+    Qt3DRender::QParameter *diffuseParam = nullptr;
+    Qt3DRender::QParameter *ambientParam = nullptr;
+    Qt3DRender::QParameter *specularParam = nullptr;
+    //Qt3DRender::QParameter *spotExponentParam = nullptr;
+    //Qt3DRender::QParameter *spotCutoffParam = nullptr;
+    Qt3DRender::QParameter *constantAttenuationParam = nullptr;
+    Qt3DRender::QParameter *linearAttenuationParam = nullptr;
+    Qt3DRender::QParameter *quadraticAttenuationParam = nullptr;
+    //Qt3DRender::QParameter *rangeParam = nullptr;
+    Qt3DRender::QParameter *widthParam = nullptr;
+    Qt3DRender::QParameter *heightParam = nullptr;
+    Qt3DRender::QParameter *shadowControlsParam = nullptr;
+    Qt3DRender::QParameter *shadowViewParam = nullptr;
+    Qt3DRender::QParameter *shadowIdxParam = nullptr;
+    // The values in uniform buffer layout. Owned by the Q3DSLightAttached
+    // and written directly in setLightProperties(). The QParameters above
+    // are only kept up-to-date when uniform buffers are not available.
+    Q3DSLightSourceData *data = nullptr;
+};
+
+Q_DECLARE_TYPEINFO(Q3DSLightSource, Q_MOVABLE_TYPE);
+
 // must match cbAoShadowParam in Q3DSShaderManager::getSsaoTextureShader()
 struct Q3DSAmbientOcclusionData
 {
@@ -189,6 +203,10 @@ public:
         Qt3DRender::QBuffer *allLightsConstantBuffer = nullptr;
         Qt3DRender::QBuffer *nonAreaLightsConstantBuffer = nullptr;
         Qt3DRender::QBuffer *areaLightsConstantBuffer = nullptr;
+        // CPU-side copies of the buffer contents, used to upload changed ranges only
+        QByteArray allLightsBufferData;
+        QByteArray nonAreaLightsBufferData;
+        QByteArray areaLightsBufferData;
         Qt3DRender::QParameter *lightAmbientTotalParamenter = nullptr;
     };
     Qt3DCore::QTransform *transform = nullptr;
@@ -207,6 +225,9 @@ public:
         // layers always have light data
         lightsData.reset(new Q3DSNodeAttached::LightsData);
     }
+    ~Q3DSLayerAttached() {
+        qDeleteAll(instanceGroups);
+    }
     Qt3DCore::QEntity *layerSceneRootEntity = nullptr;
     Qt3DCore::QEntity *compositorEntity = nullptr;
     Qt3DRender::QFrameGraphNode *layerFgRoot = nullptr;
@@ -246,6 +267,7 @@ public:
     QPointF layerPos;
     int msaaSampleCount = 0;
     int ssaaScaleFactor = 1;
+    float renderScale = 1.0f; // from the quality governor, applies on top of SSAA
     int nonDirtyRenderCount = 0;
     bool usesDefaultCompositorProgram = true;
     bool effectActive = false;
@@ -254,6 +276,9 @@ public:
     Qt3DRender::QParameter *cameraPropertiesParam = nullptr;
     Qt3DRender::QLayer *opaqueTag = nullptr;
     Qt3DRender::QLayer *transparentTag = nullptr;
+    // for the entities drawing instance groups, these must not be picked
+    Qt3DRender::QLayer *instancedOpaqueTag = nullptr;
+    Qt3DRender::QLayer *instancedTransparentTag = nullptr;
     Qt3DRender::QRayCaster *layerRayCaster = nullptr;
 
     struct RayCastQueueEntry {
@@ -265,6 +290,45 @@ public:
     };
     QQueue<RayCastQueueEntry> rayCastQueue;
 
+    // Default material effects (technique, passes, render states) keyed by
+    // shader program and pass configuration. Models with equivalent materials
+    // share these; only the QMaterial holding the parameters is per submesh.
+    QHash<QPair<Qt3DRender::QShaderProgram *, int>, Qt3DRender::QEffect *> defaultMaterialEffects;
+    // Their variants for instanced drawing, null when the program cannot be instanced.
+    QHash<Qt3DRender::QEffect *, Qt3DRender::QEffect *> instancedEffects;
+
+    // Models with the same mesh and an equivalent default material. Once
+    // there are at least two, they are drawn by one entity with an instanced
+    // draw call, taking the transform and opacity from a per-instance
+    // buffer. The models keep their own entities (without the material) for
+    // picking. See updateInstanceGroups().
+    struct InstanceGroup {
+        Q3DSMesh *mesh = nullptr;
+        Qt3DRender::QEffect *effect = nullptr; // what the members would use on their own
+        bool hasTransparency = false;
+        // The material parameters the members agree on. Parameters shared
+        // between the members (lights, referenced materials) match whatever
+        // their value, the others by value. The alpha of material_diffuse
+        // is the object opacity, that is per instance.
+        struct Param {
+            Qt3DRender::QParameter *param;
+            QString name;
+            QVariant value;
+        };
+        QVector<Param> params;
+        QVector<Q3DSModelNode *> models;
+        Qt3DCore::QEntity *entity = nullptr; // null while there is a single member
+        Qt3DRender::QGeometryRenderer *renderer = nullptr;
+        Qt3DRender::QBuffer *instanceBuffer = nullptr;
+        QVector<Qt3DRender::QAttribute *> instanceAttributes;
+        Qt3DRender::QMaterial *material = nullptr;
+        Qt3DRender::QParameter *diffuseParam = nullptr;
+        bool membersDirty = false;
+        bool bufferDirty = false;
+    };
+    QVector<InstanceGroup *> instanceGroups;
+    QSet<Q3DSModelNode *> instancingDirtyModels;
+
     struct DepthTextureData {
         bool enabled = false;
         Qt3DRender::QRenderTargetSelector *rtSelector = nullptr;
@@ -314,6 +378,10 @@ public:
         Qt3DRender::QFrameGraphNode *shadowRoot = nullptr;
         QVector<PerLightShadowMapData> shadowCasters;
         Qt3DRender::QAbstractTexture *defaultShadowDS = nullptr;
+        // true when a light or a potential shadow caster changed since the
+        // last frame; the shadow passes can be skipped otherwise
+        bool dirty = true;
+        int nonDirtyRenderCount = 0;
         struct CustomMaterialData {
             // custom materials need a uNumShadowMaps and uNumShadowCubes
             Qt3DRender::QParameter *numShadowMapsParam = nullptr;
@@ -437,6 +505,7 @@ class Q3DSLightAttached : public Q3DSNodeAttached
 {
 public:
     Q3DSLightSource lightSource;
+    Q3DSLightSourceData lightSourceData = {};
 };
 
 class Q3DSAliasAttached : public Q3DSNodeAttached
@@ -458,6 +527,7 @@ public:
         bool hasTransparency = false;
     };
     QVector<SubMesh> subMeshes;
+    Q3DSLayerAttached::InstanceGroup *instanceGroup = nullptr;
 };
 
 Q_DECLARE_TYPEINFO(Q3DSModelAttached::SubMesh, Q_MOVABLE_TYPE);
@@ -578,9 +648,13 @@ public:
     Qt3DRender::QParameter *appFrameParam = nullptr;
     Qt3DRender::QParameter *fpsParam = nullptr;
     Qt3DRender::QParameter *cameraClipRangeParam = nullptr;
+    // The last* members hold the values last written to the corresponding
+    // parameters so that the per-frame updates can skip unchanged ones.
+    QVector2D lastCameraClipRange = QVector2D(-1, -1);
     struct TextureBuffer {
         Qt3DRender::QAbstractTexture *texture = nullptr;
         QVector<Qt3DRender::QParameter *> textureInfoParams;
+        QSize lastTextureInfoSize;
         bool hasSceneLifetime = false;
     };
     QHash<QString, TextureBuffer> textureBuffers;
@@ -589,9 +663,16 @@ public:
         Qt3DRender::QParameter *texture0InfoParam = nullptr;
         Qt3DRender::QAbstractTexture *passOutput = nullptr;
         Qt3DRender::QParameter *destSizeParam = nullptr;
+        QSize lastInputSize;
+        QSize lastOutputSize;
     };
     QVector<PassData> passData;
-    QVector<QPair<Qt3DRender::QParameter *, Qt3DRender::QAbstractTexture *> > sourceDepTextureInfoParams;
+    struct TextureInfoParam {
+        Qt3DRender::QParameter *param = nullptr;
+        Qt3DRender::QAbstractTexture *texture = nullptr;
+        QSize lastSize;
+    };
+    QVector<TextureInfoParam> sourceDepTextureInfoParams;
     QVector<Qt3DRender::QFrameGraphNode *> passFgRoots;
     Qt3DRender::QAbstractTexture *sourceTexture = nullptr; // never owned
     Qt3DRender::QAbstractTexture *outputTexture = nullptr;
@@ -600,6 +681,30 @@ public:
     void reset();
 };
 
+// A slide action with its handler arguments looked up and parsed in advance,
+// so that dispatching an event does not need to touch the strings again.
+struct Q3DSCompiledAction
+{
+    Q3DSAction::HandlerType handler = Q3DSAction::SetProperty;
+    QByteArray id;
+    Q3DSGraphObject *targetObject = nullptr;
+    int eventId = -1;
+    bool argsValid = false;
+    // SetProperty. When property is valid, value holds the already converted
+    // value and changeList only carries the name for notifyPropertyChanges.
+    // Otherwise changeList is applied as-is via applyPropertyChanges.
+    QMetaProperty property;
+    QVariant value;
+    Q3DSPropertyChangeList changeList;
+    // FireEvent, EmitSignal, GoToSlide, BehaviorHandler
+    QString name;
+    // GoToTime
+    float seekTimeMs = 0;
+    bool pause = false;
+};
+
+Q_DECLARE_TYPEINFO(Q3DSCompiledAction, Q_MOVABLE_TYPE);
+
 class Q3DSSlideAttached : public Q3DSGraphObjectAttached
 {
 public:
@@ -607,6 +712,10 @@ public:
     Qt3DAnimation::QClipAnimator *animator = nullptr;
     QVector<Qt3DAnimation::QClipAnimator *> animators;
     int slideObjectChangeObserverIndex = -1;
+    // The eyeball-enabled actions of the slide grouped by trigger object.
+    // Rebuilt on the next event after the slide's action list changes.
+    QHash<Q3DSGraphObject *, QVector<Q3DSCompiledAction>> actionDispatch;
+    bool actionDispatchDirty = true;
 };
 
 class Q3DSImageAttached : public Q3DSGraphObjectAttached
@@ -627,6 +736,18 @@ struct Q3DSSubPresentation
     Qt3DRender::QAbstractTexture *colorTex = nullptr;
     Qt3DRender::QAbstractTexture *depthOrDepthStencilTex = nullptr;
     Qt3DRender::QAbstractTexture *stencilTex = nullptr;
+    // QML subpresentations have no scenemanager; this is incremented instead
+    // whenever the Qt Quick scene may have rendered new content.
+    QSharedPointer<int> qmlContentChangeCount;
+    // What gets disabled while nothing visible samples colorTex: the render
+    // target selector of .uip subpresentations, the QScene2D of QML ones.
+    Qt3DRender::QFrameGraphNode *frameGraph = nullptr;
+    QPointer<Qt3DCore::QNode> scene2d;
+    // Authored size, and the scale the render target currently uses for it
+    // when the subpresentation is only used as a texture map.
+    QSize presentationSize;
+    float renderScale = 1.0f;
+    int shrinkFrameCount = 0;
 };
 
 struct Q3DSGuiData
@@ -688,7 +809,6 @@ public:
     void updateSizes(const QSize &size, qreal dpr, const QRect &viewport = QRect(), bool forceSynchronous = false);
 
     void prepareEngineReset();
-    static void prepareEngineResetGlobal();
 
     Q3DSSlide *currentSlide() const { return m_currentSlide; }
     Q3DSSlide *masterSlide() const { return m_masterSlide; }
@@ -696,6 +816,18 @@ public:
     void setComponentCurrentSlide(Q3DSSlide *newSlide, bool flush = false);
 
     void setLayerCaching(bool enabled);
+    void setQuality(const Q3DSQualityGovernor::Quality &quality);
+
+    // true when the last frame neither had changes nor needs a follow-up one
+    bool isIdle() const { return m_idle; }
+
+    // false while nothing visible shows the subpresentation's texture
+    bool isSubPresentationActive(const QString &id) const { return !m_inactiveSubPresentations.contains(id); }
+    // For the scene manager of such a subpresentation: the playing slide
+    // players are paused, and continue from the same time when resumed.
+    void setSuspended(bool suspended);
+    bool isSuspended() const { return m_suspended; }
+    static float nextSubPresentationScale(float current, float wanted, float maxScale, int *shrinkFrameCount);
 
     void prepareAnimators();
 
@@ -728,11 +860,12 @@ public:
     };
     Q_DECLARE_FLAGS(EffectActivationFlags, EffectActivationFlag)
 
-    static QVector<Qt3DRender::QRenderPass *> standardRenderPasses(Qt3DRender::QShaderProgram *program,
+    static QVector<Qt3DRender::QRenderPass *> standardRenderPasses(Q3DSShaderProgramCache *programs,
+                                                                   Qt3DRender::QShaderProgram *program,
                                                                    Q3DSLayerNode *layer3DS,
                                                                    Q3DSDefaultMaterial::BlendMode blendMode = Q3DSDefaultMaterial::Normal,
                                                                    bool hasDisplacement = false);
-    static QVector<Qt3DRender::QTechnique *> computeTechniques(Q3DSLayerNode *layer3DS);
+    static QVector<Qt3DRender::QTechnique *> computeTechniques(Q3DSShaderProgramCache *programs, Q3DSLayerNode *layer3DS);
     static void markAsMainTechnique(Qt3DRender::QTechnique *technique);
 
     Q3DSProfiler *profiler() { return m_profiler; }
@@ -773,8 +906,10 @@ private:
     void buildSubPresentationLayer(Q3DSLayerNode *layer3DS, const QSize &parentSize);
     Qt3DRender::QRenderTarget *newLayerRenderTarget(const QSize &layerPixelSize, int msaaSampleCount,
                                                     Qt3DRender::QAbstractTexture **colorTex, Qt3DRender::QAbstractTexture **dsTexOrRb,
-                                                    Qt3DCore::QNode *textureParentNode, Q3DSLayerNode *layer3DS,
+                                                    Q3DSLayerNode *layer3DS,
                                                     Qt3DRender::QAbstractTexture *existingDS = nullptr);
+    Qt3DRender::QAbstractTexture *acquireTexture(const Q3DSTexturePool::Key &key, const char *info, ...);
+    void releaseTexture(Qt3DRender::QAbstractTexture *texture);
     QSize calculateLayerSize(Q3DSLayerNode *layer3DS, const QSize &parentSize);
     QPointF calculateLayerPos(Q3DSLayerNode *layer3DS, const QSize &parentSize);
     void updateSizesForLayer(Q3DSLayerNode *layer3DS, const QSize &newParentSize);
@@ -786,6 +921,9 @@ private:
     void updateAoParameters(Q3DSLayerNode *layer3DS);
     void updateSsaoStatus(Q3DSLayerNode *layer3DS, bool *aoDidChange = nullptr);
     void updateShadowMapStatus(Q3DSLayerNode *layer3DS, bool *smDidChange = nullptr);
+    void releaseShadowMapTextures(Q3DSLayerAttached *layerData, Q3DSLayerAttached::PerLightShadowMapData *d);
+    void releaseLayerTextures(Q3DSLayerAttached *layerData);
+    void updateShadowMapCaching(Q3DSLayerNode *layer3DS);
     void updateCubeShadowMapParams(Q3DSLayerAttached::PerLightShadowMapData *d, Q3DSLightNode *light3DS, const QString &lightIndexStr);
     void updateCubeShadowCam(Q3DSLayerAttached::PerLightShadowMapData *d, int faceIdx, Q3DSLightNode *light3DS);
     void genCubeBlurPassFg(Q3DSLayerAttached::PerLightShadowMapData *d, Qt3DRender::QAbstractTexture *inTex,
@@ -820,14 +958,24 @@ private:
 
     Qt3DCore::QEntity *buildModel(Q3DSModelNode *model3DS, Q3DSLayerNode *layer3DS, Qt3DCore::QEntity *parent);
     void rebuildModelSubMeshes(Q3DSModelNode *model3DS);
+    void pregenerateMaterialShaders(Q3DSLayerNode *layer3DS);
     void buildModelMaterial(Q3DSModelNode *model3DS);
     void retagSubMeshes(Q3DSModelNode *model3DS);
+    void markInstancingDirty(Q3DSModelNode *model3DS);
+    void leaveInstanceGroup(Q3DSModelNode *model3DS);
+    bool joinInstanceGroup(Q3DSModelNode *model3DS);
+    void updateInstanceGroups(Q3DSLayerNode *layer3DS);
+    Qt3DRender::QEffect *instancedEffect(Q3DSLayerNode *layer3DS, Qt3DRender::QEffect *effect);
     bool checkImageTransparency(Q3DSImage *image) const;
     void prepareTextureParameters(Q3DSTextureParameters &textureParameters, const QString &name, Q3DSImage *image3DS);
     QVector<Qt3DRender::QParameter *> prepareDefaultMaterial(Q3DSDefaultMaterial *m, Q3DSReferencedMaterial *rm, Q3DSModelNode *model3DS);
     Qt3DRender::QAbstractTexture *createCustomPropertyTexture(const Q3DSCustomPropertyParameter &p);
     QVector<Qt3DRender::QParameter *> prepareCustomMaterial(Q3DSCustomMaterialInstance *m, Q3DSReferencedMaterial *rm, Q3DSModelNode *model3DS);
     void setImageTextureFromSubPresentation(Qt3DRender::QParameter *sampler, Q3DSImage *image);
+    void markSubPresentationDependentLayersDirty();
+    void updateSubPresentationActivity();
+    void updateSubPresentationSizes();
+    void updateIdleState();
     void updateTextureParameters(Q3DSTextureParameters &textureParameters, Q3DSImage *image);
     void updateDefaultMaterial(Q3DSDefaultMaterial *m, Q3DSReferencedMaterial *rm, Q3DSModelNode *model3DS);
     void updateCustomMaterial(Q3DSCustomMaterialInstance *m, Q3DSReferencedMaterial *rm, Q3DSModelNode *model3DS);
@@ -842,7 +990,11 @@ private:
     void updateEffectForNextFrame(Q3DSEffectInstance *eff3DS, qint64 nextFrameNo);
     void gatherLights(Q3DSLayerNode *layer);
     void updateLightsParams(const QVector<Q3DSNodeAttached::LightsData *> &lights, Q3DSNodeAttached::LightsData *dst);
-    void updateLightsBuffer(const QVector<Q3DSLightSource> &lights, Qt3DRender::QBuffer *uniformBuffer);
+    void updateLightsBuffer(const QVector<Q3DSNodeAttached::LightsData *> &lights,
+                            QVector<Q3DSLightSource> Q3DSNodeAttached::LightsData::*lightList,
+                            Qt3DRender::QBuffer *uniformBuffer, QByteArray *bufferData);
+    void updateLightSourceParams(Q3DSLightSource *ls);
+    void setLightShadowIdx(Q3DSLightNode *light3DS, qint32 idx);
     void updateModel(Q3DSModelNode *model3DS);
     QVector<Q3DSNodeAttached::LightsData *> getLightsDataForNode(Q3DSGraphObject *object);
     QVector<Qt3DRender::QParameter *> prepareSeparateLightUniforms(const QVector<Q3DSLightSource> &allLights, const QString &lightsUniformName);
@@ -875,6 +1027,7 @@ private:
     void updateNodeFromChangeFlags(Q3DSNode *node, Qt3DCore::QTransform *transform, int changeFlags);
     void updateSubTreeRecursive(Q3DSGraphObject *obj);
     void setPendingVisibilities();
+    Q3DSSlidePlayer *slidePlayerForObject(Q3DSGraphObject *obj) const;
     void syncScene();
     void prepareNextFrame();
 
@@ -890,7 +1043,10 @@ private:
 
     void handleEvent(const Q3DSGraphObject::Event &e);
     void flushEventQueue();
-    void runAction(const Q3DSAction &action);
+    int actionEventId(const QString &event);
+    Q3DSCompiledAction compileAction(const Q3DSAction &action);
+    const QHash<Q3DSGraphObject *, QVector<Q3DSCompiledAction>> &actionDispatchTable(Q3DSSlide *slide);
+    void runAction(const Q3DSCompiledAction &action);
 
     Qt3DRender::QAbstractTexture *dummyTexture();
 
@@ -904,7 +1060,7 @@ private:
     Q3DSSlide *m_masterSlide;
     int m_slideGraphChangeObserverIndex = -1;
     Q3DSSlide *m_currentSlide;
-    Qt3DCore::QEntity *m_rootEntity;
+    Qt3DCore::QEntity *m_rootEntity = nullptr;
     Q3DSFrameUpdater *m_frameUpdater = nullptr;
     Q3DSDefaultMaterialGenerator *m_matGen;
     Q3DSCustomMaterialGenerator *m_customMaterialGen;
@@ -915,14 +1071,29 @@ private:
     QSet<SubTreeWithDirtyLight> m_subTreesWithDirtyLights;
     QSet<Q3DSDefaultMaterial *> m_pendingDefMatRebuild;
     QHash<Q3DSGraphObject *, bool> m_pendingObjectVisibility;
+    // Bumped when something else than the slide time may have changed object
+    // visibility, or the start and end times of slide objects changed. The
+    // slide players evaluate all objects then instead of only the ones whose
+    // interval boundary was crossed. Applying queued visibility changes only
+    // affects the players owning the objects, see setPendingVisibilities().
+    quint64 m_visibilityGeneration = 0;
+    quint64 m_slideScheduleGeneration = 0;
+    // Bumped whenever a slide player changes slides.
+    quint64 m_slideGeneration = 1;
     Qt3DRender::QLayer *m_fsQuadTag = nullptr;
     QStack<Q3DSComponentNode *> m_componentNodeStack;
     QSet<Q3DSLayerNode *> m_pendingSubPresLayers;
     QVector<QPair<Qt3DRender::QParameter *, Q3DSImage *> > m_pendingSubPresImages;
     QVector<Q3DSSubPresentation> m_subPresentations;
+    QSet<QString> m_inactiveSubPresentations;
     Qt3DRender::QAbstractTexture *m_dummyTex = nullptr;
     bool m_wasDirty = false;
+    bool m_idle = false;
+    bool m_suspended = false;
+    QVector<QPointer<Q3DSSlidePlayer> > m_suspendedPlayers;
     Q3DSProfiler *m_profiler = nullptr;
+    Q3DSShaderProgramCache *m_shaderPrograms = nullptr;
+    Q3DSTexturePool m_texturePool;
     Q3DSGuiData m_guiData;
     Q3DSProfileUi *m_profileUi = nullptr;
     Q3DSConsoleCommands *m_consoleCommands = nullptr;
@@ -933,11 +1104,14 @@ private:
     Q3DSSlidePlayer *m_slidePlayer = nullptr;
     Q3DSInputManager *m_inputManager = nullptr;
     QVector<Q3DSGraphObject::Event> m_eventQueue;
+    QHash<QString, int> m_actionEventIds;
     bool m_inDestructor = false;
     bool m_layerCaching = true;
     bool m_layerUncachePending = false;
-    QSet<Q3DSSceneManager *> m_layerCacheDeps;
-    bool m_hasQmlSubPresAsTextureMap = false;
+    bool m_modelInstancing = false;
+    Q3DSQualityGovernor::Quality m_quality;
+    QHash<Q3DSImage *, QString> m_subPresImages;
+    QHash<QString, int> m_qmlSubPresChangeCounts;
     Q3DSViewportData m_viewportData;
     Qt3DRender::QFrameGraphNode *m_compositorFgContainer = nullptr;
     Qt3DRender::QFrameGraphNode *m_compositorRoot = nullptr;
@@ -688,6 +688,9 @@ void Q3DSSlidePlayer::handleCurrentSlideChanged(Q3DSSlide *slide,
     qCDebug(lcSlidePlayer, "Handling current slide change: from slide \"%s\", to slide \"%s\"",
             qPrintable(getSlideName(previousSlide)), qPrintable(getSlideName(slide)));
 
+    if (slideDidChange)
+        ++m_sceneManager->m_slideGeneration;
+
     static const auto cleanUpComponentPlayers = [](Q3DSSlide *slide) {
         if (!slide)
             return;
@@ -797,6 +800,14 @@ static bool objectHasVisibilityTag(Q3DSGraphObject *object)
 }
 
 void Q3DSSlidePlayer::setSlideTime(Q3DSSlide *slide, float time)
+{
+    // We force an update if we are at the beginning (0.0f) or the end (-1.0f)
+    // to ensure the scenemanager has correct global values for visibility during
+    // slide changes
+    setSlideTime(slide, time, qFuzzyCompare(time, 0.0f) || qFuzzyCompare(time, -1.0f));
+}
+
+void Q3DSSlidePlayer::setSlideTime(Q3DSSlide *slide, float time, bool forceUpdate)
 {
     if (!slide)
         return;
@@ -813,29 +824,85 @@ void Q3DSSlidePlayer::setSlideTime(Q3DSSlide *slide, float time)
             parentVisible = (m_component->attached()->visibilityTag == Q3DSGraphObjectAttached::Visible);
     }
 
-    // We force an update if we are at the beginning (0.0f) or the end (-1.0f)
-    // to ensure the scenemanager has correct global values for visibility during
-    // slide changes
-    const bool forceUpdate = (qFuzzyCompare(time, 0.0f) || qFuzzyCompare(time, -1.0f));
-    const auto updateObjects = [=](Q3DSSlide *s) {
-        if (!s)
-            return;
+    const bool isCurrentSlide = (m_data.slideDeck->currentSlide() == slide);
+
+    // When nothing but the time changed since all objects were last
+    // evaluated, only the objects with a start or end time in between the
+    // previous and the current time can change their visibility. Anything else
+    // affecting visibility (eyeball changes, visibility changes applied by the
+    // scene manager, objects added or removed, start/end time changes) bumps
+    // one of the scene manager's generation counters.
+    const bool incremental = !forceUpdate && isCurrentSlide
+            && m_schedule.upToDate && m_schedule.slide == slide
+            && m_schedule.scheduleGeneration == m_sceneManager->m_slideScheduleGeneration
+            && m_schedule.visibilityGeneration == m_sceneManager->m_visibilityGeneration
+            && m_schedule.parentVisible == parentVisible;
+
+    if (incremental) {
+        m_schedule.objects.forCrossedObjects(m_schedule.time, time, [=](Q3DSGraphObject *obj) {
+            setObjectVisibility(obj, parentVisible, false, time);
+        });
+    } else {
+        const auto updateObjects = [=](Q3DSSlide *s) {
+            if (!s)
+                return;
 
-        for (Q3DSGraphObject *obj : s->objects())
-            setObjectVisibility(obj, parentVisible, forceUpdate, time);
-    };
+            for (Q3DSGraphObject *obj : s->objects())
+                setObjectVisibility(obj, parentVisible, forceUpdate, time);
+        };
+
+        updateObjects(static_cast<Q3DSSlide *>(slide->parent()));
+        updateObjects(slide);
+        ++m_fullVisibilityUpdateCount;
+
+        // Entering or leaving the slide, the start and end times are about
+        // to change due to the slide's property changes.
+        m_schedule.upToDate = isCurrentSlide && !forceUpdate;
+        if (m_schedule.upToDate) {
+            if (m_schedule.slide != slide || m_schedule.scheduleGeneration != m_sceneManager->m_slideScheduleGeneration)
+                buildSchedule(slide);
+            m_schedule.visibilityGeneration = m_sceneManager->m_visibilityGeneration;
+            m_schedule.parentVisible = parentVisible;
+        } else {
+            m_schedule.slide = nullptr;
+        }
+    }
 
-    updateObjects(static_cast<Q3DSSlide *>(slide->parent()));
-    updateObjects(slide);
+    if (m_schedule.upToDate)
+        m_schedule.time = time;
 
     // This method is called for all slides, but we only want to update the
     // position for the associated slide player once
-    if (m_data.slideDeck->currentSlide() != slide)
+    if (!isCurrentSlide)
         return;
 
     sendPositionChanged(slide, time);
 }
 
+void Q3DSSlidePlayer::buildSchedule(Q3DSSlide *slide)
+{
+    m_schedule.slide = slide;
+    m_schedule.scheduleGeneration = m_sceneManager->m_slideScheduleGeneration;
+    m_schedule.objects.clear();
+
+    const auto addObjects = [this](Q3DSSlide *s) {
+        if (!s)
+            return;
+
+        for (Q3DSGraphObject *obj : s->objects()) {
+            if (obj->isNode() || obj->type() == Q3DSGraphObject::Effect)
+                m_schedule.objects.addObject(obj, obj->startTime(), obj->endTime());
+        }
+    };
+
+    addObjects(static_cast<Q3DSSlide *>(slide->parent()));
+    addObjects(slide);
+    m_schedule.objects.sort();
+
+    qCDebug(lcSlidePlayer, "Built visibility schedule for \"%s\" with %d objects",
+            qPrintable(getSlideName(slide)), m_schedule.objects.count());
+}
+
 void Q3DSSlidePlayer::setObjectVisibility(Q3DSGraphObject *obj, bool parentVisible, bool forceUpdate, float time)
 {
     if (obj->state() != Q3DSGraphObject::Enabled)
@@ -863,7 +930,12 @@ void Q3DSSlidePlayer::setObjectVisibility(Q3DSGraphObject *obj, bool parentVisib
             && time >= obj->startTime() && time <= obj->endTime()
             && (nodeActive || effectActive);
 
-    if (forceUpdate || shouldBeVisible != objectHasVisibilityTag(obj))
+    // Compare with what is going to be applied when something is queued
+    // already, that may not be what we asked for.
+    const auto pendingIt = m_sceneManager->m_pendingObjectVisibility.constFind(obj);
+    const bool isVisible = (pendingIt != m_sceneManager->m_pendingObjectVisibility.cend())
+            ? pendingIt.value() : objectHasVisibilityTag(obj);
+    if (forceUpdate || shouldBeVisible != isVisible)
         updateObjectVisibility(obj, shouldBeVisible);
 
     if (obj->type() == Q3DSGraphObject::Component) {
@@ -872,9 +944,12 @@ void Q3DSSlidePlayer::setObjectVisibility(Q3DSGraphObject *obj, bool parentVisib
         Q3DSSlidePlayer *player = componentCurrentSlide->attached<Q3DSSlideAttached>()->slidePlayer;
         // If the component is not playing it won't get time updates, so to ensure it correctly
         // updates its visibility we tell it to update with time from its last time update.
+        // Not forced: unless the component's visibility or something else
+        // affecting its objects changed, this stays with the component and
+        // does not go down its nested components every time we get here.
         if (player->state() != PlayerState::Idle && player->state() != PlayerState::Playing) {
             const float lastTime = player->position();
-            player->setSlideTime(componentCurrentSlide, lastTime);
+            player->setSlideTime(componentCurrentSlide, lastTime, false);
         }
     }
 }
@@ -920,7 +995,6 @@ void Q3DSSlidePlayer::updateObjectVisibility(Q3DSGraphObject *obj, bool shouldBe
 
 bool Q3DSSlidePlayer::isSlideVisible(Q3DSSlide *slide)
 {
-    qCDebug(lcSlidePlayer, "Checking visibility for \"%s\"", qPrintable(getSlideName(slide)));
     // If we the slide is not null, we assume it's visible until proven otherwise.
     bool visible = (slide != nullptr);
     if (slide) {
@@ -928,17 +1002,9 @@ bool Q3DSSlidePlayer::isSlideVisible(Q3DSSlide *slide)
         Q3DSSlideDeck *slideDeck = player->slideDeck();
         const bool isMasterSlide = (slideDeck->masterSlide() == slide);
         const bool isCurrentSlide = (slideDeck->currentSlide() == slide);
-        if (isCurrentSlide || isMasterSlide) {
-            Q3DSSlide *parentSlide = slideDeck->parentSlide();
-            if (parentSlide) {
-                // We're a component and current, continue up the ladder...
-                visible = isSlideVisible(parentSlide);
-            } else {
-                visible = true;
-            }
-        } else {
-            visible = false;
-        }
+        // A component's slides are visible when current (or master) and
+        // the slide holding the component is visible.
+        visible = (isCurrentSlide || isMasterSlide) && player->isParentSlideVisible();
     }
 
     qCDebug(lcSlidePlayer, "The slides's (\"%s\") visibility is %d", qPrintable(getSlideName(slide)), visible);
@@ -946,6 +1012,21 @@ bool Q3DSSlidePlayer::isSlideVisible(Q3DSSlide *slide)
     return  visible;
 }
 
+bool Q3DSSlidePlayer::isParentSlideVisible()
+{
+    Q3DSSlide *parentSlide = m_data.slideDeck->parentSlide();
+    if (!parentSlide)
+        return true;
+
+    // Walking up the hierarchy for every slide of every nested component
+    // adds up, so the result is kept until some player changes slides.
+    if (m_parentSlideVisibility.slideGeneration != m_sceneManager->m_slideGeneration) {
+        m_parentSlideVisibility.visible = isSlideVisible(parentSlide);
+        m_parentSlideVisibility.slideGeneration = m_sceneManager->m_slideGeneration;
+    }
+    return m_parentSlideVisibility.visible;
+}
+
 void Q3DSSlidePlayer::processPropertyChanges(Q3DSSlide *currentSlide)
 {
     Q_ASSERT(currentSlide->attached());
@@ -1102,24 +1183,46 @@ void Q3DSSlidePlayer::evaluateDynamicObjectVisibility(Q3DSGraphObject *obj)
 
 void Q3DSSlidePlayer::objectAboutToBeAddedToScene(Q3DSGraphObject *obj)
 {
+    ++m_sceneManager->m_slideScheduleGeneration;
     evaluateDynamicObjectVisibility(obj);
 }
 
 void Q3DSSlidePlayer::objectAboutToBeRemovedFromScene(Q3DSGraphObject *obj)
 {
+    ++m_sceneManager->m_slideScheduleGeneration;
     m_animationManager->objectAboutToBeRemovedFromScene(obj);
 }
 
 void Q3DSSlidePlayer::objectAddedToSlide(Q3DSGraphObject *obj, Q3DSSlide *slide)
 {
     qDebug(lcSlidePlayer) << "Dyn.added object" << obj->id() << "to slide" << slide->id();
+    ++m_sceneManager->m_slideScheduleGeneration;
     evaluateDynamicObjectVisibility(obj);
 }
 
 void Q3DSSlidePlayer::objectRemovedFromSlide(Q3DSGraphObject *obj, Q3DSSlide *slide)
 {
     qDebug(lcSlidePlayer) << "Dyn.removed object" << obj->id() << "from slide" << slide->id();
+    ++m_sceneManager->m_slideScheduleGeneration;
     evaluateDynamicObjectVisibility(obj);
 }
 
+void Q3DSSlideObjectSchedule::clear()
+{
+    m_starts.clear();
+    m_ends.clear();
+}
+
+void Q3DSSlideObjectSchedule::addObject(Q3DSGraphObject *obj, float startTime, float endTime)
+{
+    m_starts.append({ startTime, endTime, obj });
+    m_ends.append({ endTime, startTime, obj });
+}
+
+void Q3DSSlideObjectSchedule::sort()
+{
+    std::sort(m_starts.begin(), m_starts.end());
+    std::sort(m_ends.begin(), m_ends.end());
+}
+
 QT_END_NAMESPACE
@@ -46,6 +46,7 @@
 #include "q3dsuippresentation_p.h"
 #include "q3dsscenemanager_p.h"
 #include <QtCore/qvector.h>
+#include <algorithm>
 
 QT_BEGIN_NAMESPACE
 
@@ -57,6 +58,52 @@ namespace Q3DSSlideUtils
     Q3DSV_PRIVATE_EXPORT void getStartAndEndTime(Q3DSSlide *slide, qint32 *start, qint32 *end);
 };
 
+// The start and end times of the objects on a slide, sorted, so that when the
+// time moves (in either direction, by any amount) only the objects with an
+// interval boundary in between the old and new time need to be visited.
+class Q3DSV_PRIVATE_EXPORT Q3DSSlideObjectSchedule
+{
+public:
+    void clear();
+    void addObject(Q3DSGraphObject *obj, float startTime, float endTime);
+    // Must be called after adding the objects.
+    void sort();
+
+    int count() const { return m_starts.count(); }
+
+    // Calls f, once, for every object that may have entered or left its
+    // [start, end] interval when going from time 'from' to 'to'.
+    template<typename F>
+    void forCrossedObjects(float from, float to, F f) const
+    {
+        const float lo = qMin(from, to);
+        const float hi = qMax(from, to);
+        auto inRange = [lo, hi](float t) { return t >= lo && t <= hi; };
+        const auto byTime = [](const Boundary &b, float t) { return b.time < t; };
+        for (auto it = std::lower_bound(m_starts.cbegin(), m_starts.cend(), lo, byTime);
+             it != m_starts.cend() && it->time <= hi; ++it)
+        {
+            f(it->obj);
+        }
+        for (auto it = std::lower_bound(m_ends.cbegin(), m_ends.cend(), lo, byTime);
+             it != m_ends.cend() && it->time <= hi; ++it)
+        {
+            if (!inRange(it->otherTime)) // else already visited via its start
+                f(it->obj);
+        }
+    }
+
+private:
+    struct Boundary {
+        float time;
+        float otherTime;
+        Q3DSGraphObject *obj;
+        bool operator<(const Boundary &other) const { return time < other.time; }
+    };
+    QVector<Boundary> m_starts;
+    QVector<Boundary> m_ends;
+};
+
 class Q3DSV_PRIVATE_EXPORT Q3DSSlidePlayer : public QObject
 {
     Q_OBJECT
@@ -110,6 +157,11 @@ public:
     void objectAddedToSlide(Q3DSGraphObject *obj, Q3DSSlide *slide);
     void objectRemovedFromSlide(Q3DSGraphObject *obj, Q3DSSlide *slide);
 
+    // Makes the next time update evaluate all objects of this player.
+    void invalidateVisibilitySchedule() { m_schedule.upToDate = false; }
+    // How many times all objects were evaluated, mainly for tests.
+    int fullVisibilityUpdateCount() const { return m_fullVisibilityUpdateCount; }
+
 public Q_SLOTS:
     void play();
     void stop();
@@ -141,6 +193,8 @@ private:
     void onDurationChanged(float duration);
     void onSlideFinished(Q3DSSlide *slide);
     void setSlideTime(Q3DSSlide *slide, float time);
+    void setSlideTime(Q3DSSlide *slide, float time, bool forceUpdate);
+    void buildSchedule(Q3DSSlide *slide);
 
     void handleCurrentSlideChanged(Q3DSSlide *slide,
                                    Q3DSSlide *previousSlide,
@@ -151,9 +205,31 @@ private:
     void setObjectVisibility(Q3DSGraphObject *obj, bool parentVisible, bool forceUpdate, float time);
     void updateObjectVisibility(Q3DSGraphObject *obj, bool visible);
     bool isSlideVisible(Q3DSSlide *slide);
+    bool isParentSlideVisible();
     void processPropertyChanges(Q3DSSlide *currentSlide);
     void evaluateDynamicObjectVisibility(Q3DSGraphObject *obj);
 
+    // Lets setSlideTime() visit only the objects whose visibility can have
+    // changed due to the time moving. Valid for one slide, as long as the
+    // scene manager's generation counters are unchanged.
+    struct VisibilitySchedule {
+        Q3DSSlide *slide = nullptr;
+        Q3DSSlideObjectSchedule objects;
+        quint64 scheduleGeneration = 0;
+        quint64 visibilityGeneration = 0;
+        bool parentVisible = false;
+        bool upToDate = false; // all objects were evaluated for 'time'
+        float time = 0.0f;
+    } m_schedule;
+    int m_fullVisibilityUpdateCount = 0;
+
+    // Whether the slide holding our component is visible, valid until any
+    // player changes slides.
+    struct {
+        quint64 slideGeneration = 0;
+        bool visible = false;
+    } m_parentSlideVisibility;
+
     struct Data {
         Q3DSSlideDeck *slideDeck = nullptr;
         PlayerState state = PlayerState::Idle;
@@ -0,0 +1,193 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of Qt 3D Studio.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "q3dstexturepool_p.h"
+#include "q3dslogging_p.h"
+#include <Qt3DCore/QNode>
+#include <Qt3DRender/QTexture>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    A simple recycler for render target textures. Textures in the pool are
+    always parented to the node set via setParentNode(), meaning they survive
+    the deletion of whatever framegraph subtree used them, and they go away
+    together with the Qt 3D scene.
+
+    Released textures are only recycled, never aliased: a texture is handed
+    out to a new user only after its previous user gave it back. This is
+    sufficient for the typical cases (effects getting enabled and disabled,
+    progressive/temporal AA stealing the layer's color buffer, shadow map
+    resolution changes, slide changes toggling layers' features) without
+    requiring any knowledge about the ordering of passes in the framegraph.
+
+    Textures that stay unused for maxIdleFrames() frames are destroyed in
+    newFrame().
+ */
+
+Q3DSTexturePool::Key Q3DSTexturePool::Key::fromTexture(Qt3DRender::QAbstractTexture *texture)
+{
+    return Key(texture->target(), texture->format(),
+               QSize(texture->width(), texture->height()),
+               texture->samples());
+}
+
+Q3DSTexturePool::Q3DSTexturePool()
+{
+}
+
+Q3DSTexturePool::~Q3DSTexturePool()
+{
+    clear();
+}
+
+void Q3DSTexturePool::setParentNode(Qt3DCore::QNode *node)
+{
+    if (m_parentNode == node)
+        return;
+
+    // the textures belong to the previous scene, drop them
+    clear();
+    m_parentNode = node;
+}
+
+static Qt3DRender::QAbstractTexture *newTexture(Qt3DRender::QAbstractTexture::Target target)
+{
+    switch (target) {
+    case Qt3DRender::QAbstractTexture::Target2DMultisample:
+        return new Qt3DRender::QTexture2DMultisample;
+    case Qt3DRender::QAbstractTexture::TargetCubeMap:
+        return new Qt3DRender::QTextureCubeMap;
+    default:
+        Q_ASSERT(target == Qt3DRender::QAbstractTexture::Target2D);
+        return new Qt3DRender::QTexture2D;
+    }
+}
+
+Qt3DRender::QAbstractTexture *Q3DSTexturePool::acquire(const Key &key, bool *reused)
+{
+    Qt3DRender::QAbstractTexture *texture = nullptr;
+
+    // Prefer the most recently released texture. The list is short (a few
+    // dozen entries at most) so a linear search is good enough.
+    for (int i = m_free.count() - 1; i >= 0; --i) {
+        if (!m_free[i].texture) {
+            m_free.remove(i);
+            continue;
+        }
+        if (m_free[i].key == key) {
+            texture = m_free[i].texture;
+            m_free.remove(i);
+            break;
+        }
+    }
+
+    if (texture) {
+        ++m_stats.reused;
+        // Sampler state is not part of the key; reset it so that the new
+        // user starts from the same state as with a freshly created texture.
+        texture->setMinificationFilter(Qt3DRender::QAbstractTexture::Nearest);
+        texture->setMagnificationFilter(Qt3DRender::QAbstractTexture::Nearest);
+        texture->setWrapMode(Qt3DRender::QTextureWrapMode());
+        texture->setGenerateMipMaps(false);
+        texture->setMaximumAnisotropy(1.0f);
+        texture->setComparisonMode(Qt3DRender::QAbstractTexture::CompareNone);
+        if (reused)
+            *reused = true;
+        return texture;
+    }
+
+    ++m_stats.created;
+    texture = newTexture(key.target);
+    texture->setFormat(key.format);
+    texture->setWidth(key.size.width());
+    texture->setHeight(key.size.height());
+    if (key.target == Qt3DRender::QAbstractTexture::Target2DMultisample)
+        texture->setSamples(key.samples);
+    texture->setParent(m_parentNode.data());
+
+    if (reused)
+        *reused = false;
+    return texture;
+}
+
+void Q3DSTexturePool::release(Qt3DRender::QAbstractTexture *texture)
+{
+    if (!texture)
+        return;
+
+    if (!m_parentNode) {
+        delete texture;
+        return;
+    }
+
+    // The user may have parented it to something that is about to be deleted.
+    texture->setParent(m_parentNode.data());
+
+    FreeTexture t;
+    t.texture = texture;
+    t.key = Key::fromTexture(texture); // size may have changed since acquire()
+    t.releaseFrame = m_frame;
+    m_free.append(t);
+}
+
+void Q3DSTexturePool::newFrame()
+{
+    ++m_frame;
+
+    for (int i = 0; i < m_free.count(); ++i) {
+        FreeTexture &t(m_free[i]);
+        if (!t.texture) {
+            m_free.remove(i--);
+        } else if (m_frame - t.releaseFrame > m_maxIdleFrames) {
+            qCDebug(lcPerf, "Destroying unused pooled texture %p (%dx%d)",
+                    t.texture.data(), t.key.size.width(), t.key.size.height());
+            delete t.texture.data();
+            m_free.remove(i--);
+            ++m_stats.destroyed;
+        }
+    }
+}
+
+void Q3DSTexturePool::clear()
+{
+    for (const FreeTexture &t : qAsConst(m_free))
+        delete t.texture.data();
+
+    m_free.clear();
+}
+
+Q3DSTexturePool::Stats Q3DSTexturePool::stats() const
+{
+    Stats s = m_stats;
+    s.freeCount = m_free.count();
+    return s;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,136 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of Qt 3D Studio.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef Q3DSTEXTUREPOOL_P_H
+#define Q3DSTEXTUREPOOL_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "q3dsruntimeglobal_p.h"
+#include <QSize>
+#include <QVector>
+#include <QPointer>
+#include <Qt3DRender/QAbstractTexture>
+
+QT_BEGIN_NAMESPACE
+
+namespace Qt3DCore {
+class QNode;
+}
+
+// Render target textures (layer color and depth-stencil buffers, effect
+// buffers, AA accumulators, shadow maps) are drawn from this pool instead of
+// being created and destroyed on the spot. Released textures are kept around
+// for a number of frames and are handed out again when a texture with the
+// same target, format, size and sample count is requested.
+class Q3DSV_PRIVATE_EXPORT Q3DSTexturePool
+{
+public:
+    struct Key {
+        Key() = default;
+        Key(Qt3DRender::QAbstractTexture::Target target_,
+            Qt3DRender::QAbstractTexture::TextureFormat format_,
+            const QSize &size_,
+            int samples_ = 0)
+            : target(target_), format(format_), size(size_),
+              // non-multisample textures report 1, make them all compare equal
+              samples(target_ == Qt3DRender::QAbstractTexture::Target2DMultisample ? samples_ : 0)
+        { }
+        static Key fromTexture(Qt3DRender::QAbstractTexture *texture);
+
+        Qt3DRender::QAbstractTexture::Target target = Qt3DRender::QAbstractTexture::Target2D;
+        Qt3DRender::QAbstractTexture::TextureFormat format = Qt3DRender::QAbstractTexture::RGBA8_UNorm;
+        QSize size;
+        int samples = 0;
+    };
+
+    struct Stats {
+        int created = 0;
+        int reused = 0;
+        int destroyed = 0;
+        int freeCount = 0;
+    };
+
+    Q3DSTexturePool();
+    ~Q3DSTexturePool();
+
+    void setParentNode(Qt3DCore::QNode *node);
+    Qt3DCore::QNode *parentNode() const { return m_parentNode; }
+
+    void setMaxIdleFrames(int frames) { m_maxIdleFrames = frames; }
+    int maxIdleFrames() const { return m_maxIdleFrames; }
+
+    Qt3DRender::QAbstractTexture *acquire(const Key &key, bool *reused = nullptr);
+    void release(Qt3DRender::QAbstractTexture *texture);
+
+    void newFrame();
+    void clear();
+
+    Stats stats() const;
+
+private:
+    Q_DISABLE_COPY(Q3DSTexturePool)
+
+    struct FreeTexture {
+        QPointer<Qt3DRender::QAbstractTexture> texture;
+        Key key;
+        qint64 releaseFrame = 0;
+    };
+
+    QPointer<Qt3DCore::QNode> m_parentNode;
+    QVector<FreeTexture> m_free;
+    qint64 m_frame = 0;
+    int m_maxIdleFrames = 60;
+    Stats m_stats;
+};
+
+Q_DECLARE_TYPEINFO(Q3DSTexturePool::Key, Q_MOVABLE_TYPE);
+
+inline bool operator==(const Q3DSTexturePool::Key &a, const Q3DSTexturePool::Key &b) Q_DECL_NOTHROW
+{
+    return a.target == b.target && a.format == b.format && a.size == b.size && a.samples == b.samples;
+}
+
+inline bool operator!=(const Q3DSTexturePool::Key &a, const Q3DSTexturePool::Key &b) Q_DECL_NOTHROW
+{
+    return !(a == b);
+}
+
+QT_END_NAMESPACE
+
+#endif // Q3DSTEXTUREPOOL_P_H
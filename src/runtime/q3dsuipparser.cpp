@@ -92,11 +92,15 @@ Q3DSUipPresentation *Q3DSUipParser::parse(const QString &filename, const QString
     return createPresentation(presentationName);
 }
 
-Q3DSUipPresentation *Q3DSUipParser::parseData(const QByteArray &data, const QString &presentationName)
+Q3DSUipPresentation *Q3DSUipParser::parseData(const QByteArray &data, const QString &presentationName,
+                                              const QString &sourceFileName)
 {
     if (!setSourceData(data))
         return nullptr;
 
+    if (!sourceFileName.isEmpty())
+        *sourceInfo() = QFileInfo(sourceFileName);
+
     return createPresentation(presentationName);
 }
 
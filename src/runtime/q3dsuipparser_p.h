@@ -52,7 +52,9 @@ class Q3DSV_PRIVATE_EXPORT Q3DSUipParser : public Q3DSAbstractXmlParser
 {
 public:
     Q3DSUipPresentation *parse(const QString &filename, const QString &presentationName);
-    Q3DSUipPresentation *parseData(const QByteArray &data, const QString &presentationName);
+    // sourceFileName, when set, is what asset file names are resolved against
+    Q3DSUipPresentation *parseData(const QByteArray &data, const QString &presentationName,
+                                   const QString &sourceFileName = QString());
 
 private:
     Q3DSUipPresentation *createPresentation(const QString &presentationName);
@@ -34,6 +34,7 @@
 #include "q3dsscenemanager_p.h"
 #include "q3dsutils_p.h"
 #include "q3dslogging_p.h"
+#include "q3dsassetcache_p.h"
 #include <QXmlStreamReader>
 #include <QLoggingCategory>
 #include <functional>
@@ -656,7 +657,7 @@ static Q3DSPropertyChange createObjectRefSetter(Member &member,
     Q3DSPropertyChange result;
     if (member != value) {
         member = value;
-        memberUnresolved = QLatin1String("#") + QString::fromUtf8(value->id());
+        memberUnresolved = value ? QLatin1String("#") + QString::fromUtf8(value->id()) : QString();
         result = Q3DSPropertyChange(QLatin1String(uipname));
     }
 
@@ -811,9 +812,11 @@ bool Q3DSGraphObject::setProperty(const char *name, const QVariant &v)
             extraMetaData()->data->propertyValues[propIdx] = v;
         else
             extraMetaData()->data->propertyNames.remove(idx);
+        ++extraMetaData()->data->generation;
     } else if (v.isValid()) {
         extraMetaData()->data->propertyNames.push_back(name);
         extraMetaData()->data->propertyValues.push_back(v);
+        ++extraMetaData()->data->generation;
     }
 
     return false;
@@ -835,6 +838,14 @@ QVector<QVariant> Q3DSGraphObject::dynamicPropertyValues() const
     return extraMetaData()->data->propertyValues;
 }
 
+quint32 Q3DSGraphObject::dynamicPropertiesGeneration() const
+{
+    if (extraMetaData()->data.isNull())
+        return 0;
+
+    return extraMetaData()->data->generation;
+}
+
 QVariantMap Q3DSGraphObject::dynamicProperties() const
 {
     QVariantMap dynProps;
@@ -857,6 +868,7 @@ void Q3DSGraphObject::clearDynamicProperties()
 
     d->propertyNames.clear();
     d->propertyValues.clear();
+    ++d->generation;
 }
 
 Q3DSPropertyChangeList Q3DSGraphObject::applyDynamicProperties(const QVariantMap &v)
@@ -869,6 +881,7 @@ Q3DSPropertyChangeList Q3DSGraphObject::applyDynamicProperties(const QVariantMap
         const int idx = extraMetaData()->data->propertyNames.indexOf(it.key().toLatin1());
         if (idx != -1) {
             extraMetaData()->data->propertyValues[idx] = it.value();
+            ++extraMetaData()->data->generation;
             changeList.append(Q3DSPropertyChange(it.key()));
         }
     }
@@ -2228,6 +2241,26 @@ static void importCustomProperties(Q3DSGraphObject *obj,
     }
 }
 
+// The custom property values that are not the defaults, i.e. the ones set by
+// the presentation, slides, animations or the application.
+static QVariantMap changedCustomProperties(Q3DSGraphObject *obj,
+                                           const QMap<QString, Q3DSMaterial::PropertyElement> &customPropMeta,
+                                           Q3DSUipPresentation &pres)
+{
+    QVariantMap result;
+    const QVariantMap values = obj->dynamicProperties();
+    for (auto it = values.cbegin(), itEnd = values.cend(); it != itEnd; ++it) {
+        auto meta = customPropMeta.constFind(it.key());
+        if (meta == customPropMeta.cend())
+            continue;
+        QVariant defaultValue = Q3DS::convertToVariant(meta->defaultValue, *meta);
+        mapCustomPropertyFileNames(it.key(), &defaultValue, customPropMeta, pres);
+        if (it.value() != defaultValue)
+            result.insert(it.key(), it.value());
+    }
+    return result;
+}
+
 void Q3DSCustomMaterialInstance::resolveReferences(Q3DSUipPresentation &pres)
 {
     // Only do the rest if sourcepath actually changed because the custom
@@ -2246,18 +2279,43 @@ void Q3DSCustomMaterialInstance::resolveReferences(Q3DSUipPresentation &pres)
     if (!idOrFilename.startsWith(QLatin1Char('#')))
         idOrFilename = pres.assetFileName(idOrFilename, nullptr);
 
+    const Q3DSCustomMaterial oldMaterial = m_material;
+    QVariantMap keptValues;
+    if (m_keepCustomProperties) {
+        keptValues = changedCustomProperties(this, oldMaterial.properties(), pres);
+        m_keepCustomProperties = false;
+    }
+
     m_material = pres.customMaterial(idOrFilename);
     if (m_material.isNull())
         return;
 
     importCustomProperties(this, m_material.properties(), &m_pendingCustomProperties, pres);
 
+    if (!keptValues.isEmpty()) {
+        const QMap<QString, Q3DSMaterial::PropertyElement> &props(m_material.properties());
+        for (auto it = keptValues.begin(); it != keptValues.end(); ) {
+            auto meta = props.constFind(it.key());
+            if (meta == props.cend() || meta->type != oldMaterial.properties().value(it.key()).type)
+                it = keptValues.erase(it);
+            else
+                ++it;
+        }
+        applyDynamicProperties(keptValues);
+    }
+
     resolveRef(m_lightmapIndirectMap_unresolved, Q3DSGraphObject::Image, &m_lightmapIndirectMap, pres);
     resolveRef(m_lightmapRadiosityMap_unresolved, Q3DSGraphObject::Image, &m_lightmapRadiosityMap, pres);
     resolveRef(m_lightmapShadowMap_unresolved, Q3DSGraphObject::Image, &m_lightmapShadowMap, pres);
     resolveRef(m_lightProbe_unresolved, Q3DSGraphObject::Image, &m_lightProbe, pres);
 }
 
+void Q3DSCustomMaterialInstance::reloadMaterial()
+{
+    m_materialIsResolved = false;
+    m_keepCustomProperties = true;
+}
+
 int Q3DSCustomMaterialInstance::mapChangeFlags(const Q3DSPropertyChangeList &changeList)
 {
     int changeFlags = Q3DSGraphObject::mapChangeFlags(changeList);
@@ -3482,15 +3540,25 @@ Q3DSUipPresentation::~Q3DSUipPresentation()
 {
     delete d->scene;
     delete d->masterSlide;
+    releaseSharedAssets();
 }
 
 void Q3DSUipPresentation::reset()
 {
     delete d->scene;
     delete d->masterSlide;
+    releaseSharedAssets();
     d.reset(new Q3DSUipPresentationData);
 }
 
+void Q3DSUipPresentation::releaseSharedAssets()
+{
+    Q3DSAssetCache &cache(Q3DSAssetCache::instance());
+    for (const QString &key : qAsConst(d->assetCacheKeys))
+        cache.release(key);
+    d->assetCacheKeys.clear();
+}
+
 QString Q3DSUipPresentation::sourceFile() const
 {
     return d->sourceFile;
@@ -3982,23 +4050,29 @@ void Q3DSUipPresentation::unregisterObject(const QByteArray &id)
     d->objects.remove(id);
 }
 
-template<typename T, typename ParserT>
-bool loadMeta(const QByteArray &id, const QString &assetFilename, QHash<QByteArray, T> *dst)
-{
-    ParserT p;
-    bool ok = false;
-    T eff = p.parse(assetFilename, &ok);
-    if (!ok) {
+template<typename T>
+bool loadMeta(const QByteArray &id, const QString &assetFilename,
+              bool (Q3DSAssetCache::*get)(const QString &, T *, QString *),
+              QHash<QByteArray, T> *dst, QVector<QString> *cacheKeys)
+{
+    // Parsed metadata is shared with other presentations referencing the
+    // same file. T is implicitly shared so the copy here is cheap.
+    T eff;
+    QString cacheKey;
+    if (!(Q3DSAssetCache::instance().*get)(assetFilename, &eff, &cacheKey)) {
         qWarning("Failed to parse metadata %s", qPrintable(assetFilename));
         return false;
     }
+    cacheKeys->append(cacheKey);
     dst->insert(id, eff);
     return true;
 }
 
 bool Q3DSUipPresentation::loadCustomMaterial(const QByteArray &id, const QString &assetFilename)
 {
-    return loadMeta<Q3DSCustomMaterial, Q3DSCustomMaterialParser>(id, assetFilename, &d->customMaterials);
+    d->customMaterialFiles.insert(id, QFileInfo(assetFilename).absoluteFilePath());
+    return loadMeta<Q3DSCustomMaterial>(id, assetFilename, &Q3DSAssetCache::customMaterial,
+                                        &d->customMaterials, &d->assetCacheKeys);
 }
 
 Q3DSCustomMaterial Q3DSUipPresentation::customMaterial(const QString &idOrFilename)
@@ -4012,7 +4086,8 @@ Q3DSCustomMaterial Q3DSUipPresentation::customMaterial(const QString &idOrFilena
 
 bool Q3DSUipPresentation::loadEffect(const QByteArray &id, const QString &assetFilename)
 {
-    return loadMeta<Q3DSEffect, Q3DSEffectParser>(id, assetFilename, &d->effects);
+    return loadMeta<Q3DSEffect>(id, assetFilename, &Q3DSAssetCache::effect,
+                                &d->effects, &d->assetCacheKeys);
 }
 
 Q3DSEffect Q3DSUipPresentation::effect(const QString &idOrFilename)
@@ -4029,7 +4104,8 @@ Q3DSEffect Q3DSUipPresentation::effect(const QString &idOrFilename)
 
 bool Q3DSUipPresentation::loadBehavior(const QByteArray &id, const QString &assetFilename)
 {
-    return loadMeta<Q3DSBehavior, Q3DSBehaviorParser>(id, assetFilename, &d->behaviors);
+    return loadMeta<Q3DSBehavior>(id, assetFilename, &Q3DSAssetCache::behavior,
+                                  &d->behaviors, &d->assetCacheKeys);
 }
 
 Q3DSBehavior Q3DSUipPresentation::behavior(const QString &idOrFilename)
@@ -4049,7 +4125,10 @@ MeshList Q3DSUipPresentation::mesh(const QString &assetFilename, int part)
 
     QElapsedTimer t;
     t.start();
-    MeshList m = Q3DSMeshLoader::loadMesh(assetFilename, part, false);
+    QString cacheKey;
+    MeshList m = Q3DSMeshLoader::loadMesh(assetFilename, part, false, &cacheKey);
+    if (!cacheKey.isEmpty())
+        d->assetCacheKeys.append(cacheKey);
     qCDebug(lcPerf, "Mesh %s loaded in %lld ms", qPrintable(assetFilename), t.elapsed());
     d->meshesLoadTime += t.elapsed();
 
@@ -4057,6 +4136,66 @@ MeshList Q3DSUipPresentation::mesh(const QString &assetFilename, int part)
     return m;
 }
 
+void Q3DSUipPresentation::invalidateMeshes(const QStringList &assetFilenames)
+{
+    for (auto it = d->meshes.begin(); it != d->meshes.end(); ) {
+        if (assetFilenames.contains(QFileInfo(it.key().fn).absoluteFilePath()))
+            it = d->meshes.erase(it);
+        else
+            ++it;
+    }
+}
+
+void Q3DSUipPresentation::deleteMeshes()
+{
+    for (const MeshList &m : qAsConst(d->meshes))
+        qDeleteAll(m);
+    d->meshes.clear();
+}
+
+QStringList Q3DSUipPresentation::modifiedAssetFiles() const
+{
+    return Q3DSAssetCache::instance().modifiedFiles(d->assetCacheKeys);
+}
+
+QStringList Q3DSUipPresentation::customMaterialFiles() const
+{
+    QStringList result;
+    for (const QString &fn : qAsConst(d->customMaterialFiles)) {
+        if (!result.contains(fn))
+            result.append(fn);
+    }
+    return result;
+}
+
+QVector<Q3DSCustomMaterialInstance *> Q3DSUipPresentation::reloadCustomMaterials(const QStringList &fileNames)
+{
+    QSet<QByteArray> reloaded;
+    for (auto it = d->customMaterialFiles.cbegin(), itEnd = d->customMaterialFiles.cend(); it != itEnd; ++it) {
+        if (fileNames.contains(it.value()))
+            reloaded.insert(it.key());
+    }
+    for (const QByteArray &key : qAsConst(reloaded)) {
+        d->customMaterials.remove(key);
+        loadCustomMaterial(key, d->customMaterialFiles.value(key));
+    }
+
+    QVector<Q3DSCustomMaterialInstance *> instances;
+    if (reloaded.isEmpty() || !d->scene)
+        return instances;
+
+    forAllObjectsOfType(d->scene, Q3DSGraphObject::CustomMaterial, [this, &reloaded, &instances](Q3DSGraphObject *obj) {
+        Q3DSCustomMaterialInstance *instance = static_cast<Q3DSCustomMaterialInstance *>(obj);
+        const QString source = instance->sourcePath();
+        const QByteArray key = source.startsWith(QLatin1Char('#')) ? source.toUtf8() : assetFileName(source, nullptr).toUtf8();
+        if (reloaded.contains(key)) {
+            instance->reloadMaterial();
+            instances.append(instance);
+        }
+    });
+    return instances;
+}
+
 const Q3DSUipPresentation::ImageBufferMap &Q3DSUipPresentation::imageBuffer() const
 {
     return d->imageBuffers;
@@ -57,6 +57,7 @@
 #include <QColor>
 #include <QImage>
 #include <QVariant>
+#include <QStringList>
 
 #include <functional>
 
@@ -375,6 +376,8 @@ public:
     bool setProperty(const char *name, const QVariant &v);
     QVector<QByteArray> dynamicPropertyNames() const;
     QVector<QVariant> dynamicPropertyValues() const;
+    // Incremented whenever a dynamic property is added, removed or written.
+    quint32 dynamicPropertiesGeneration() const;
 
     // keep in mind that certain objects, e.g. effects, remove all dynamic
     // properties upon certain conditions
@@ -415,6 +418,7 @@ private:
         struct Data {
             QVector<QByteArray> propertyNames;
             QVector<QVariant> propertyValues;
+            quint32 generation = 0;
         };
         QScopedPointer<Data> data;
     } metaData;
@@ -1836,6 +1840,9 @@ public:
     Q3DSPropertyChange setLightProbe(Q3DSImage *v);
 
     const Q3DSCustomMaterial *material() const { return &m_material; }
+    // The definition changed, resolve it again. Custom property values other
+    // than the defaults are kept when the new definition still has them.
+    void reloadMaterial();
 
 private:
     Q_DISABLE_COPY(Q3DSCustomMaterialInstance)
@@ -1844,6 +1851,7 @@ private:
     QString m_material_unresolved;
     Q3DSCustomMaterial m_material;
     bool m_materialIsResolved = false;
+    bool m_keepCustomProperties = false;
     QVariantMap m_materialPropertyVals;
     Q3DSPropertyChangeList m_pendingCustomProperties;
     // lightmaps
@@ -2026,6 +2034,20 @@ public:
     Q3DSEffect effect(const QString &idOrFilename);
     Q3DSBehavior behavior(const QString &idOrFilename);
     MeshList mesh(const QString &assetFilename, int part = 1);
+    // Drops the cached meshes loaded from the given files, so that they get
+    // loaded again when models referencing them resolve their references.
+    void invalidateMeshes(const QStringList &assetFilenames);
+    // For presentations that never had a scene built: deletes the loaded
+    // meshes. Otherwise they are owned by the Qt 3D scene.
+    void deleteMeshes();
+    // Referenced meshes, materials, effects and behaviors changed on disk.
+    QStringList modifiedAssetFiles() const;
+    // The absolute file names of the loaded custom material definitions.
+    QStringList customMaterialFiles() const;
+    // Loads the given custom material definitions again and marks the
+    // instances in the scene that use them for resolving. The instances are
+    // returned, notifying their "class" property rebuilds their materials.
+    QVector<Q3DSCustomMaterialInstance *> reloadCustomMaterials(const QStringList &fileNames);
 
     typedef QHash<QString, bool> ImageBufferMap;
     const ImageBufferMap &imageBuffer() const;
@@ -2085,6 +2107,7 @@ private:
     bool loadCustomMaterial(const QByteArray &id, const QString &assetFilename);
     bool loadEffect(const QByteArray &id, const QString &assetFilename);
     bool loadBehavior(const QByteArray &id, const QString &assetFilename);
+    void releaseSharedAssets();
     Q3DSGraphObject *getObject(const QByteArray &id) const;
     Q3DSGraphObject *getObjectByName(const QString &name) const;
 
@@ -2110,6 +2133,7 @@ struct Q3DSUipPresentationData
     Q3DSSlide *masterSlide = nullptr;
     QHash<QByteArray, Q3DSGraphObject *> objects; // node ptrs managed by scene, not owned
     QHash<QByteArray, Q3DSCustomMaterial> customMaterials;
+    QHash<QByteArray, QString> customMaterialFiles;
     QHash<QByteArray, Q3DSEffect> effects;
     QHash<QByteArray, Q3DSBehavior> behaviors;
     // Note: the key here is the sourcePath before it's resolved!
@@ -2121,6 +2145,8 @@ struct Q3DSUipPresentationData
         int part;
     };
     QHash<MeshId, MeshList> meshes;
+    // references held on shared entries in Q3DSAssetCache
+    QVector<QString> assetCacheKeys;
 
     const Q3DSDataInputEntry::Map *dataInputEntries = nullptr;
     Q3DSUipPresentation::DataInputMap dataInputMap;
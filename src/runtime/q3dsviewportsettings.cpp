@@ -56,6 +56,11 @@ Q3DSViewportSettings::ScaleMode Q3DSViewportSettings::scaleMode() const
     return m_scaleMode;
 }
 
+qint64 Q3DSViewportSettings::textureMemoryBudget() const
+{
+    return m_textureMemoryBudget;
+}
+
 void Q3DSViewportSettings::setMatteEnabled(bool isEnabled)
 {
     if (m_matteEnabled != isEnabled) {
@@ -88,4 +93,12 @@ void Q3DSViewportSettings::setScaleMode(Q3DSViewportSettings::ScaleMode mode)
     }
 }
 
+void Q3DSViewportSettings::setTextureMemoryBudget(qint64 bytes)
+{
+    if (m_textureMemoryBudget != bytes) {
+        m_textureMemoryBudget = bytes;
+        emit textureMemoryBudgetChanged();
+    }
+}
+
 QT_END_NAMESPACE
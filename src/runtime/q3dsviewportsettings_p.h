@@ -54,6 +54,7 @@ class Q3DSV_PRIVATE_EXPORT Q3DSViewportSettings : public QObject
     Q_PROPERTY(QColor matteColor READ matteColor WRITE setMatteColor NOTIFY matteColorChanged)
     Q_PROPERTY(bool showRenderStats READ isShowingRenderStats WRITE setShowRenderStats NOTIFY showRenderStatsChanged)
     Q_PROPERTY(ScaleMode scaleMode READ scaleMode WRITE setScaleMode NOTIFY scaleModeChanged)
+    Q_PROPERTY(qint64 textureMemoryBudget READ textureMemoryBudget WRITE setTextureMemoryBudget NOTIFY textureMemoryBudgetChanged)
 
 public:
     enum ScaleMode {
@@ -69,18 +70,21 @@ public:
     QColor matteColor() const;
     bool isShowingRenderStats() const;
     ScaleMode scaleMode() const;
+    qint64 textureMemoryBudget() const;
 
 public Q_SLOTS:
     void setMatteEnabled(bool isEnabled);
     void setMatteColor(const QColor &color);
     void setShowRenderStats(bool show);
     void setScaleMode(ScaleMode mode);
+    void setTextureMemoryBudget(qint64 bytes);
 
 Q_SIGNALS:
     void matteEnabledChanged();
     void matteColorChanged();
     void showRenderStatsChanged();
     void scaleModeChanged();
+    void textureMemoryBudgetChanged();
 
 private:
     Q_DISABLE_COPY(Q3DSViewportSettings)
@@ -89,6 +93,7 @@ private:
     QColor m_matteColor = QColor(51, 51, 51);
     bool m_showRenderStats = false;
     Q3DSViewportSettings::ScaleMode m_scaleMode = ScaleModeFill;
+    qint64 m_textureMemoryBudget = -1;
 };
 
 QT_END_NAMESPACE
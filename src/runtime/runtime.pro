@@ -36,7 +36,11 @@ SOURCES += \
     q3dsconsolecommands.cpp \
     q3dsinlineqmlsubpresentation.cpp \
     q3dslogging.cpp \
-    q3dsviewportsettings.cpp
+    q3dsviewportsettings.cpp \
+    q3dstexturepool.cpp \
+    q3dsqualitygovernor.cpp \
+    q3dsassetcache.cpp \
+    q3dspresentationdiff.cpp
 
 HEADERS += \
     q3dsruntimeglobal.h \
@@ -77,7 +81,11 @@ HEADERS += \
     q3dsconsolecommands_p.h \
     q3dsinlineqmlsubpresentation_p.h \
     q3dslogging_p.h \
-    q3dsviewportsettings_p.h
+    q3dsviewportsettings_p.h \
+    q3dstexturepool_p.h \
+    q3dsqualitygovernor_p.h \
+    q3dsassetcache_p.h \
+    q3dspresentationdiff_p.h
 
 qtHaveModule(widgets) {
     QT += widgets
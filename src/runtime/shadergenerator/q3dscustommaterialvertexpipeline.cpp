@@ -460,6 +460,60 @@ struct ShaderGenerator : public Q3DSCustomMaterialShaderGenerator
 
         return generateCustomMaterialShader(shaderName);
     }
+
+    QByteArray variantKey(Q3DSGraphObject &material,
+                          Q3DSReferencedMaterial *referencedMaterial,
+                          const Q3DSShaderFeatureSet &featureSet,
+                          const QVector<Q3DSLightNode *> &lights,
+                          bool hasTransparency,
+                          const QString &shaderName) override
+    {
+        if (material.type() != Q3DSGraphObject::CustomMaterial)
+            return QByteArray();
+
+        Q3DSCustomMaterialInstance *instance = static_cast<Q3DSCustomMaterialInstance *>(&material);
+        const Q3DSCustomMaterial *customMaterial = instance->material();
+        Q3DSShaderVariantKeyBuilder key("custom");
+
+        // The material definition is shared by all instances, the shader code
+        // identifies it.
+        for (const Q3DSMaterial::Shader &shader : customMaterial->shaders()) {
+            key.add(shader.name);
+            key.add(shader.shared);
+            key.add(shader.vertexShader);
+            key.add(shader.fragmentShader);
+        }
+        key.add(shaderName);
+        for (const Q3DSMaterial::PropertyElement &property : customMaterial->properties()) {
+            key.add(property.name);
+            key.add(int(property.type));
+        }
+        key.add(customMaterial->layerCount());
+        key.addFlag(customMaterial->shaderIsDielectric());
+        key.addFlag(customMaterial->shaderIsSpecular());
+        key.addFlag(customMaterial->shaderIsCutoutEnabled());
+        key.addFlag(customMaterial->shaderIsTransmissive());
+        key.addFlag(customMaterial->materialHasTransparency());
+        key.add(customMaterial->emissiveMaskMapName());
+
+        if (referencedMaterial && referencedMaterial->lightmapIndirectMap())
+            key.addImage(referencedMaterial->lightmapIndirectMap());
+        else
+            key.addImage(instance->lightmapIndirectMap());
+        if (referencedMaterial && referencedMaterial->lightmapRadiosityMap())
+            key.addImage(referencedMaterial->lightmapRadiosityMap());
+        else
+            key.addImage(instance->lightmapRadiosityMap());
+        if (referencedMaterial && referencedMaterial->lightmapShadowMap())
+            key.addImage(referencedMaterial->lightmapShadowMap());
+        else
+            key.addImage(instance->lightmapShadowMap());
+
+        key.addFeatures(featureSet);
+        key.addLights(lights);
+        key.addFlag(hasTransparency);
+        return key.result();
+    }
 };
 }
 
@@ -561,12 +615,9 @@ void Q3DSCustomMaterialVertexPipeline::beginFragmentGeneration()
     fragment() << "void main()" << "\n" << "{" << "\n";
 }
 
-Q3DSCustomMaterialShaderGenerator &Q3DSCustomMaterialShaderGenerator::createCustomMaterialShaderGenerator()
+Q3DSCustomMaterialShaderGenerator *Q3DSCustomMaterialShaderGenerator::createCustomMaterialShaderGenerator()
 {
-    static ShaderGenerator *shaderGenerator = nullptr;
-    if (!shaderGenerator)
-        shaderGenerator = new ShaderGenerator();
-    return *shaderGenerator;
+    return new ShaderGenerator();
 }
 
 void Q3DSCustomMaterialVertexPipeline::generateUVCoords(quint32 inUVSet)
@@ -72,7 +72,7 @@ public:
 class Q3DSCustomMaterialShaderGenerator : public Q3DSAbstractMaterialGenerator
 {
 public:
-    static Q3DSCustomMaterialShaderGenerator &createCustomMaterialShaderGenerator();
+    static Q3DSCustomMaterialShaderGenerator *createCustomMaterialShaderGenerator();
 };
 
 QT_END_NAMESPACE
@@ -1149,6 +1149,55 @@ struct ShaderGenerator : public Q3DSDefaultMaterialShaderGenerator
 
         return generateMaterialShader(description);
     }
+
+    QByteArray variantKey(Q3DSGraphObject &defaultMaterial,
+                          Q3DSReferencedMaterial *referencedMaterial,
+                          const Q3DSShaderFeatureSet &featureSet,
+                          const QVector<Q3DSLightNode*> &lights,
+                          bool hasTransparency,
+                          const QString &) override
+    {
+        if (defaultMaterial.type() != Q3DSGraphObject::DefaultMaterial)
+            return QByteArray();
+
+        Q3DSDefaultMaterial *material = static_cast<Q3DSDefaultMaterial *>(&defaultMaterial);
+        Q3DSShaderVariantKeyBuilder key("default");
+        key.add(int(material->shaderLighting()));
+        key.add(int(material->specularModel()));
+        key.addFlag(material->specularAmount() > 0.01f);
+        key.addFlag(material->fresnelPower() > 0.0f);
+        key.addFlag(material->vertexColors());
+
+        key.addImage(material->diffuseMap());
+        key.addImage(material->specularReflection());
+        key.addImage(material->specularMap());
+        key.addImage(material->roughnessMap());
+        key.addImage(material->bumpMap());
+        key.addImage(material->normalMap());
+        key.addImage(material->displacementMap());
+        key.addImage(material->opacityMap());
+        key.addImage(material->emissiveMap());
+        key.addImage(material->translucencyMap());
+
+        // the referenced material's lightmaps take precedence, like in generateFragmentShader()
+        if (referencedMaterial && referencedMaterial->lightmapIndirectMap())
+            key.addImage(referencedMaterial->lightmapIndirectMap());
+        else
+            key.addImage(material->lightmapIndirectMap());
+        if (referencedMaterial && referencedMaterial->lightmapRadiosityMap())
+            key.addImage(referencedMaterial->lightmapRadiosityMap());
+        else
+            key.addImage(material->lightmapRadiosityMap());
+        if (referencedMaterial && referencedMaterial->lightmapShadowMap())
+            key.addImage(referencedMaterial->lightmapShadowMap());
+        else
+            key.addImage(material->lightmapShadowMap());
+
+        key.addFeatures(featureSet);
+        key.addLights(lights);
+        key.addFlag(hasTransparency);
+        return key.result();
+    }
 };
 
 } // namespace
@@ -1494,12 +1543,9 @@ Q3DSShaderGeneratorStages::Enum Q3DSVertexPipelineImpl::stage() const
     return const_cast<Q3DSVertexPipelineImpl *>(this)->activeStage().stage();
 }
 
-Q3DSDefaultMaterialShaderGenerator &Q3DSDefaultMaterialShaderGenerator::createDefaultMaterialShaderGenerator()
+Q3DSDefaultMaterialShaderGenerator *Q3DSDefaultMaterialShaderGenerator::createDefaultMaterialShaderGenerator()
 {
-    static ShaderGenerator *defaultGenerator = nullptr;
-    if (!defaultGenerator)
-        defaultGenerator = new ShaderGenerator();
-    return *defaultGenerator;
+    return new ShaderGenerator();
 }
 
 QT_END_NAMESPACE
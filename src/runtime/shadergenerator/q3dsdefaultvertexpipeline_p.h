@@ -130,7 +130,8 @@ public:
                                               const QString &displacementImageName,
                                               Q3DSImage *displacementImage) = 0;
 
-    static Q3DSDefaultMaterialShaderGenerator &createDefaultMaterialShaderGenerator();
+    // Generators are not thread-safe, each thread needs its own.
+    static Q3DSDefaultMaterialShaderGenerator *createDefaultMaterialShaderGenerator();
 };
 
 struct Q3DSVertexPipelineImpl : public Q3DSDefaultVertexPipeline
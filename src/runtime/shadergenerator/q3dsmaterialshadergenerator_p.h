@@ -44,9 +44,62 @@
 #include "q3dsshaderprogramgenerator_p.h"
 #include "q3dsuippresentation_p.h"
 #include "q3dsscenemanager_p.h"
+#include <QtCore/QCryptographicHash>
 
 QT_BEGIN_NAMESPACE
 
+// Collects the inputs of a material shader generator into a variant key.
+class Q3DSShaderVariantKeyBuilder
+{
+public:
+    explicit Q3DSShaderVariantKeyBuilder(const char *generator)
+        : m_hash(QCryptographicHash::Sha1)
+    {
+        add(QByteArray(generator));
+    }
+
+    void add(const QByteArray &v)
+    {
+        m_hash.addData(v);
+        m_hash.addData("\0", 1);
+    }
+    void add(const QString &v) { add(v.toUtf8()); }
+    void add(int v) { add(QByteArray::number(v)); }
+    void addFlag(bool v) { add(QByteArray(v ? "1" : "0")); }
+
+    void addImage(Q3DSImage *image)
+    {
+        if (image) {
+            add(int(image->mappingMode()));
+            addFlag(image->hasPremultipliedAlpha());
+        } else {
+            add(QByteArray("-"));
+        }
+    }
+
+    void addFeatures(const Q3DSShaderFeatureSet &featureSet)
+    {
+        for (const Q3DSShaderPreprocessorFeature &f : featureSet) {
+            add(f.name);
+            addFlag(f.enabled);
+        }
+    }
+
+    void addLights(const QVector<Q3DSLightNode *> &lights)
+    {
+        add(lights.count());
+        for (Q3DSLightNode *light : lights) {
+            add(int(light->lightType()));
+            addFlag(light->castShadow());
+        }
+    }
+
+    QByteArray result() const { return m_hash.result(); }
+
+private:
+    QCryptographicHash m_hash;
+};
+
 class Q3DSAbstractMaterialGenerator
 {
 public:
@@ -70,6 +123,16 @@ public:
                                                        const QVector<Q3DSLightNode*> &lights,
                                                        bool hasTransparency,
                                                        const QString &description) = 0;
+
+    // Identifies the program generateShader() produces for the same arguments
+    // (shaderName being the description), without generating anything. This
+    // must cover every input the generator looks at.
+    virtual QByteArray variantKey(Q3DSGraphObject &material,
+                                  Q3DSReferencedMaterial *referencedMaterial,
+                                  const Q3DSShaderFeatureSet &featureSet,
+                                  const QVector<Q3DSLightNode*> &lights,
+                                  bool hasTransparency,
+                                  const QString &shaderName) = 0;
 };
 
 QT_END_NAMESPACE
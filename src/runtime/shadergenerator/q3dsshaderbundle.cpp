@@ -0,0 +1,371 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of Qt 3D Studio.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "q3dsshaderbundle_p.h"
+#include "q3dsshadermanager_p.h"
+#include "q3dsdefaultmaterialgenerator_p.h"
+#include "q3dsgraphicslimits_p.h"
+#include "q3dsuippresentation_p.h"
+#include <QFile>
+#include <QDataStream>
+
+QT_BEGIN_NAMESPACE
+
+static const quint32 BUNDLE_MAGIC = 0x51334453; // Q3DS
+static const quint32 BUNDLE_VERSION = 2;
+
+// What the generated code depends on, apart from the #version line: the API,
+// the GLSL 1.00/1.30 split, the GLES2 path (which also selects the shader
+// library), the light count and texture LOD support. The exact context
+// version does not belong here, drivers commonly give 4.5 or 4.6 for a 4.3
+// request.
+QByteArray Q3DSShaderBundle::currentTarget()
+{
+    const Q3DSGraphicsLimits limits = Q3DS::graphicsLimits();
+    const QSurfaceFormat &format(limits.format);
+    QByteArray target = format.renderableType() == QSurfaceFormat::OpenGLES ? QByteArrayLiteral("gles") : QByteArrayLiteral("gl");
+    target += format.majorVersion() >= 3 ? '3' : '2';
+    target += QByteArrayLiteral(" lights=") + QByteArray::number(limits.maxLightsPerLayer);
+    if (limits.useGles2Path)
+        target += QByteArrayLiteral(" gles2path");
+    if (limits.shaderTextureLodSupported)
+        target += QByteArrayLiteral(" texturelod");
+    return target;
+}
+
+// The version in the generated #version line. A bundle generated for an older
+// version is fine on a newer context, not the other way around.
+int Q3DSShaderBundle::currentGlslVersion()
+{
+    const QSurfaceFormat &format(Q3DS::graphicsLimits().format);
+    if (format.majorVersion() < 3)
+        return format.renderableType() == QSurfaceFormat::OpenGLES ? 100 : 110;
+    return format.majorVersion() * 100 + format.minorVersion() * 10;
+}
+
+bool Q3DSShaderBundle::isUsable() const
+{
+    return m_target == currentTarget() && m_glslVersion <= currentGlslVersion();
+}
+
+bool Q3DSShaderBundle::load(const QString &fileName, QString *error)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly)) {
+        if (error)
+            *error = f.errorString();
+        return false;
+    }
+
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_5_8);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != BUNDLE_MAGIC || version != BUNDLE_VERSION) {
+        if (error)
+            *error = QLatin1String("Not a shader bundle or unsupported version");
+        return false;
+    }
+
+    QByteArray target;
+    quint32 glslVersion = 0;
+    quint32 count = 0;
+    in >> target >> glslVersion >> count;
+    QHash<QByteArray, Entry> entries;
+    entries.reserve(int(count));
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QByteArray key;
+        Entry e;
+        in >> key >> e.description
+           >> e.sources.vertex >> e.sources.tessControl >> e.sources.tessEval
+           >> e.sources.geometry >> e.sources.fragment;
+        entries.insert(key, e);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        if (error)
+            *error = QLatin1String("Truncated shader bundle");
+        return false;
+    }
+
+    m_target = target;
+    m_glslVersion = int(glslVersion);
+    m_entries = entries;
+    return true;
+}
+
+bool Q3DSShaderBundle::save(const QString &fileName, QString *error) const
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        if (error)
+            *error = f.errorString();
+        return false;
+    }
+
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_5_8);
+    out << BUNDLE_MAGIC << BUNDLE_VERSION << m_target << quint32(m_glslVersion) << quint32(m_entries.count());
+    for (auto it = m_entries.cbegin(), ite = m_entries.cend(); it != ite; ++it) {
+        const Entry &e(it.value());
+        out << it.key() << e.description
+            << e.sources.vertex << e.sources.tessControl << e.sources.tessEval
+            << e.sources.geometry << e.sources.fragment;
+    }
+
+    if (out.status() != QDataStream::Ok) {
+        if (error)
+            *error = f.errorString();
+        return false;
+    }
+    return true;
+}
+
+const Q3DSShaderBundle::Entry *Q3DSShaderBundle::find(const QByteArray &key) const
+{
+    auto it = m_entries.constFind(key);
+    return it != m_entries.cend() ? &it.value() : nullptr;
+}
+
+namespace {
+
+Q3DSLayerNode *layerForObject(Q3DSGraphObject *obj)
+{
+    while (obj && obj->type() != Q3DSGraphObject::Layer)
+        obj = obj->parent();
+    return static_cast<Q3DSLayerNode *>(obj);
+}
+
+// What the slide player does when entering a slide, minus the animations.
+void enterSlide(Q3DSSlide *slide)
+{
+    if (Q3DSSlide *master = static_cast<Q3DSSlide *>(slide->parent())) {
+        for (Q3DSGraphObject *object : master->objects()) {
+            if (object->isNode())
+                object->applyPropertyChanges(static_cast<Q3DSNode *>(object)->masterRollbackList());
+            else if (object->type() == Q3DSGraphObject::Effect)
+                object->applyPropertyChanges(static_cast<Q3DSEffectInstance *>(object)->masterRollbackList());
+        }
+    }
+    const auto &propertyChanges = slide->propertyChanges();
+    for (auto it = propertyChanges.cbegin(), ite = propertyChanges.cend(); it != ite; ++it)
+        it.key()->applyPropertyChanges(*it.value());
+}
+
+Q3DSSlide *firstSlide(Q3DSSlide *master)
+{
+    return static_cast<Q3DSSlide *>(master->firstChild());
+}
+
+QVector<QVariant> alternativeValues(const QVariant &value)
+{
+    switch (value.userType()) {
+    case QMetaType::Bool:
+        return { !value.toBool() };
+    case QMetaType::Int:
+    case QMetaType::Float:
+    case QMetaType::Double:
+    {
+        // enough to flip things like aoStrength > 0 or opacity < 1
+        QVector<QVariant> values;
+        for (double d : { 0.0, 1.0 }) {
+            QVariant v(d);
+            if (v.convert(value.userType()) && v != value)
+                values.append(v);
+        }
+        return values;
+    }
+    default:
+        return {};
+    }
+}
+
+} // namespace
+
+int Q3DSShaderBundle::addPresentation(Q3DSUipPresentation *presentation)
+{
+    const int oldCount = m_entries.count();
+
+    QVector<Q3DSSlide *> decks { presentation->masterSlide() };
+    Q3DSUipPresentation::forAllObjectsOfType(presentation->scene(), Q3DSGraphObject::Component, [&decks](Q3DSGraphObject *obj) {
+        if (Q3DSSlide *master = static_cast<Q3DSComponentNode *>(obj)->masterSlide())
+            decks.append(master);
+    });
+
+    // A layer that had shadows in one slide keeps them in all the others
+    // visited afterwards, so go again when that turned up new layers.
+    int layersWithShadows;
+    do {
+        layersWithShadows = m_layersWithShadows.count();
+        addSlideVariants(presentation, decks);
+    } while (m_layersWithShadows.count() != layersWithShadows);
+
+    return m_entries.count() - oldCount;
+}
+
+void Q3DSShaderBundle::addSlideVariants(Q3DSUipPresentation *presentation, const QVector<Q3DSSlide *> &decks)
+{
+    // The initial state, every deck on its first slide.
+    for (Q3DSSlide *master : decks) {
+        if (firstSlide(master))
+            enterSlide(firstSlide(master));
+    }
+
+    for (Q3DSSlide *master : decks) {
+        for (Q3DSGraphObject *slide = master->firstChild(); slide; slide = slide->nextSibling()) {
+            enterSlide(static_cast<Q3DSSlide *>(slide));
+            addVariants(presentation);
+
+            // Properties controlled by data inputs can change any time,
+            // alter them one by one. Combinations are left to the runtime.
+            const Q3DSUipPresentation::DataInputMap *dataInputs = presentation->dataInputMap();
+            for (auto it = dataInputs->cbegin(), ite = dataInputs->cend(); it != ite; ++it) {
+                Q3DSGraphObject *target = it.value();
+                const QStringList properties = target->dataInputControlledProperties()->values(it.key());
+                for (const QString &property : properties) {
+                    const QByteArray name = property.toLatin1();
+                    const QVariant value = target->property(name.constData());
+                    if (!value.isValid()) // @slide, @timeline
+                        continue;
+                    for (const QVariant &alternative : alternativeValues(value)) {
+                        target->applyPropertyChanges({ Q3DSPropertyChange::fromVariant(property, alternative) });
+                        addVariants(presentation);
+                    }
+                    target->applyPropertyChanges({ Q3DSPropertyChange::fromVariant(property, value) });
+                }
+            }
+        }
+        if (firstSlide(master))
+            enterSlide(firstSlide(master));
+    }
+}
+
+void Q3DSShaderBundle::addVariants(Q3DSUipPresentation *presentation)
+{
+    Q3DSShaderManager &shaderManager(Q3DSShaderManager::instance());
+    const int maxLights = Q3DS::graphicsLimits().maxLightsPerLayer;
+
+    auto add = [this](const QByteArray &key, const QString &description, Qt3DRender::QShaderProgram *program) {
+        Entry e;
+        e.description = description;
+        e.sources.vertex = program->vertexShaderCode();
+        e.sources.tessControl = program->tessellationControlShaderCode();
+        e.sources.tessEval = program->tessellationEvaluationShaderCode();
+        e.sources.geometry = program->geometryShaderCode();
+        e.sources.fragment = program->fragmentShaderCode();
+        m_entries.insert(key, e);
+        delete program;
+    };
+
+    Q3DSUipPresentation::forAllLayers(presentation->scene(), [&](Q3DSLayerNode *layer3DS) {
+        // Like Q3DSSceneManager::gatherLights(): active lights go to their
+        // scope, or to the layer when there is no (valid) scope.
+        QHash<Q3DSGraphObject *, QVector<Q3DSLightNode *>> scopedLights;
+        Q3DSUipPresentation::forAllObjectsInSubTree(layer3DS, [layer3DS, &scopedLights](Q3DSGraphObject *obj) {
+            if (obj->type() != Q3DSGraphObject::Light)
+                return;
+            Q3DSLightNode *light3DS = static_cast<Q3DSLightNode *>(obj);
+            if (!light3DS->flags().testFlag(Q3DSNode::Active))
+                return;
+            Q3DSGraphObject *scope = light3DS->scope();
+            if (!scope || scope->type() == Q3DSGraphObject::Scene || layerForObject(scope) != layer3DS)
+                scope = layer3DS;
+            scopedLights[scope].append(light3DS);
+        });
+
+        // The layer's shadow map list only grows at runtime, so once there
+        // was a shadow caster the materials are generated with shadows, even
+        // after the light stops casting.
+        bool shadowMaps = false;
+        for (Q3DSLightNode *light3DS : scopedLights.value(layer3DS))
+            shadowMaps |= light3DS->castShadow();
+        if (shadowMaps)
+            m_layersWithShadows.insert(layer3DS->id());
+        QVector<bool> shadowVariants { shadowMaps };
+        if (!shadowMaps && m_layersWithShadows.contains(layer3DS->id()))
+            shadowVariants.append(true);
+
+        const bool ssao = layer3DS->aoStrength() > 0.0f;
+
+        Q3DSUipPresentation::forAllModels(layer3DS->firstChild(), [&](Q3DSModelNode *model3DS) {
+            QVector<Q3DSLightNode *> lights;
+            for (Q3DSGraphObject *obj = model3DS; obj; obj = obj->parent()) {
+                lights += scopedLights.value(obj);
+                if (obj == layer3DS)
+                    break;
+            }
+            if (lights.count() > maxLights)
+                lights.resize(maxLights);
+
+            for (Q3DSGraphObject *child = model3DS->firstChild(); child; child = child->nextSibling()) {
+                Q3DSReferencedMaterial *referencedMaterial = nullptr;
+                Q3DSGraphObject *material = child;
+                if (child->type() == Q3DSGraphObject::ReferencedMaterial) {
+                    referencedMaterial = static_cast<Q3DSReferencedMaterial *>(child);
+                    material = referencedMaterial->referencedMaterial();
+                    if (!material)
+                        continue;
+                }
+
+                for (bool shadows : shadowVariants) {
+                    if (material->type() == Q3DSGraphObject::DefaultMaterial) {
+                        auto defaultMaterial = static_cast<Q3DSDefaultMaterial *>(material);
+                        Q3DSShaderFeatureSet features;
+                        Q3DSDefaultMaterialGenerator::fillFeatureSet(&features, layer3DS,
+                                                                     defaultMaterial->lightProbe() || (referencedMaterial && referencedMaterial->lightProbe()),
+                                                                     shadows, ssao);
+                        const QByteArray key = shaderManager.variantKey(*defaultMaterial, referencedMaterial, lights, false, features);
+                        if (!m_entries.contains(key)) {
+                            add(key, QString(QLatin1String("default material %1")).arg(QString::fromUtf8(defaultMaterial->id())),
+                                shaderManager.generateShaderProgram(nullptr, *defaultMaterial, referencedMaterial, lights, false, features));
+                        }
+                    } else if (material->type() == Q3DSGraphObject::CustomMaterial) {
+                        auto customMaterial = static_cast<Q3DSCustomMaterialInstance *>(material);
+                        const QVector<Q3DSMaterial::Pass> &passes(customMaterial->material()->passes());
+                        if (passes.isEmpty())
+                            continue;
+                        Q3DSShaderFeatureSet features;
+                        Q3DSDefaultMaterialGenerator::fillFeatureSet(&features, layer3DS,
+                                                                     customMaterial->lightProbe() || (referencedMaterial && referencedMaterial->lightProbe()),
+                                                                     shadows, ssao);
+                        const QString &shaderName(passes.first().shaderName);
+                        const QByteArray key = shaderManager.variantKey(*customMaterial, referencedMaterial, lights, false, features, shaderName);
+                        if (!m_entries.contains(key)) {
+                            add(key, QString(QLatin1String("custom material %1")).arg(QString::fromUtf8(customMaterial->id())),
+                                shaderManager.generateShaderProgram(nullptr, *customMaterial, referencedMaterial, lights, false, features, shaderName));
+                        }
+                    }
+                }
+            }
+        }, true);
+    });
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,110 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of Qt 3D Studio.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef Q3DSSHADERBUNDLE_P_H
+#define Q3DSSHADERBUNDLE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "q3dsruntimeglobal_p.h"
+#include "q3dsshaderprogramgenerator_p.h"
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+
+class Q3DSUipPresentation;
+class Q3DSSlide;
+
+// Material shader programs generated ahead of time (by the q3dsshaderbundler
+// tool) for every material variant a set of presentations can reach, keyed by
+// the material generators' variant keys. The runtime looks programs up in the
+// loaded bundles before generating anything, which avoids generating shaders
+// while building the scene and when lights, shadows or IBL change later on.
+//
+// The generated GLSL depends on the graphics limits and the GLSL version,
+// hence a bundle is only used when its target matches the runtime's and its
+// GLSL version is supported.
+class Q3DSV_PRIVATE_EXPORT Q3DSShaderBundle
+{
+public:
+    struct Entry {
+        QString description;
+        Q3DSShaderProgramSources sources;
+    };
+
+    // The target and GLSL version for the current Q3DS::graphicsLimits().
+    static QByteArray currentTarget();
+    static int currentGlslVersion();
+
+    QByteArray target() const { return m_target; }
+    void setTarget(const QByteArray &target) { m_target = target; }
+    int glslVersion() const { return m_glslVersion; }
+    void setGlslVersion(int version) { m_glslVersion = version; }
+    // true when the programs can be used with the current graphics limits
+    bool isUsable() const;
+
+    bool load(const QString &fileName, QString *error = nullptr);
+    bool save(const QString &fileName, QString *error = nullptr) const;
+
+    int count() const { return m_entries.count(); }
+    bool isEmpty() const { return m_entries.isEmpty(); }
+    const Entry *find(const QByteArray &key) const;
+    void insert(const QByteArray &key, const Entry &entry) { m_entries.insert(key, entry); }
+    QList<QByteArray> keys() const { return m_entries.keys(); }
+
+    // Generates the programs for the materials of all models in all layers,
+    // in the state of every slide (including component slides) and with the
+    // data input controlled properties altered. Changes the property values in
+    // the presentation. Returns the number of programs added.
+    int addPresentation(Q3DSUipPresentation *presentation);
+
+private:
+    void addSlideVariants(Q3DSUipPresentation *presentation, const QVector<Q3DSSlide *> &decks);
+    void addVariants(Q3DSUipPresentation *presentation);
+
+    QByteArray m_target = currentTarget();
+    int m_glslVersion = currentGlslVersion();
+    QHash<QByteArray, Entry> m_entries;
+    QSet<QByteArray> m_layersWithShadows;
+};
+
+QT_END_NAMESPACE
+
+#endif // Q3DSSHADERBUNDLE_P_H
@@ -30,9 +30,149 @@
 #include "q3dsshadermanager_p.h"
 #include "q3dsshadergenerators_p.h"
 #include "q3dsgraphicslimits_p.h"
+#include "q3dsshaderbundle_p.h"
+#include "q3dslogging_p.h"
+#include "q3dsprofiler_p.h"
+#include <QFileInfo>
+#include <QCryptographicHash>
+#include <QRegularExpression>
+#include <QElapsedTimer>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QThreadStorage>
+#include <algorithm>
+#include <functional>
+#include <vector>
 
 QT_BEGIN_NAMESPACE
 
+Qt3DRender::QShaderProgram *Q3DSShaderProgramCache::program(const QByteArray &key) const
+{
+    auto it = m_programs.find(key);
+    if (it == m_programs.end())
+        return nullptr;
+    it->lastUse = ++m_useCounter;
+    return it->program;
+}
+
+Qt3DRender::QShaderProgram *Q3DSShaderProgramCache::createProgram(const QByteArray &key,
+                                                                  const Q3DSShaderProgramSources &sources,
+                                                                  const QString &name)
+{
+    QElapsedTimer createTime;
+    createTime.start();
+
+    auto shaderProgram = new Qt3DRender::QShaderProgram();
+    shaderProgram->setVertexShaderCode(sources.vertex);
+    shaderProgram->setTessellationControlShaderCode(sources.tessControl);
+    shaderProgram->setTessellationEvaluationShaderCode(sources.tessEval);
+    shaderProgram->setGeometryShaderCode(sources.geometry);
+    shaderProgram->setFragmentShaderCode(sources.fragment);
+
+    if (m_programs.count() >= MAX_PROGRAMS && !m_programs.contains(key))
+        trim();
+    Entry e;
+    e.program = shaderProgram;
+    e.lastUse = ++m_useCounter;
+    m_programs.insert(key, e);
+
+    if (m_profiler) {
+        m_profiler->reportShaderProgramCreation(createTime.nsecsElapsed());
+        m_profiler->trackNewObject(shaderProgram, Q3DSProfiler::ShaderProgramObject, "Shader program %s", qPrintable(name));
+    }
+
+    return shaderProgram;
+}
+
+int Q3DSShaderProgramCache::count() const
+{
+    return std::count_if(m_programs.cbegin(), m_programs.cend(),
+                         [](const Entry &e) { return !e.program.isNull(); });
+}
+
+void Q3DSShaderProgramCache::trim()
+{
+    for (auto it = m_programs.begin(); it != m_programs.end(); ) {
+        if (it->program.isNull())
+            it = m_programs.erase(it);
+        else
+            ++it;
+    }
+
+    // make room for a quarter of the limit, so that this does not run on
+    // every new program
+    const int excess = m_programs.count() - MAX_PROGRAMS * 3 / 4;
+    if (excess <= 0)
+        return;
+
+    QVector<QPair<quint64, QByteArray>> entries;
+    entries.reserve(m_programs.count());
+    for (auto it = m_programs.cbegin(), itEnd = m_programs.cend(); it != itEnd; ++it)
+        entries.append(qMakePair(it->lastUse, it.key()));
+    std::partial_sort(entries.begin(), entries.begin() + excess, entries.end());
+    for (int i = 0; i < excess; ++i)
+        m_programs.remove(entries[i].second);
+}
+
+void Q3DSShaderProgramCache::clear()
+{
+    m_programs.clear();
+    m_builtinPrograms.clear();
+}
+
+namespace {
+
+// The generators keep state while generating a program, so each thread has
+// its own set.
+struct ShaderGenerators
+{
+    ShaderGenerators()
+        : material(Q3DSDefaultMaterialShaderGenerator::createDefaultMaterialShaderGenerator())
+        , customMaterial(Q3DSCustomMaterialShaderGenerator::createCustomMaterialShaderGenerator())
+        , program(Q3DSAbstractShaderProgramGenerator::createProgramGenerator())
+    {
+    }
+    ~ShaderGenerators()
+    {
+        delete material;
+        delete customMaterial;
+        delete program;
+    }
+
+    Q3DSDefaultMaterialShaderGenerator *material;
+    Q3DSCustomMaterialShaderGenerator *customMaterial;
+    Q3DSAbstractShaderProgramGenerator *program;
+};
+
+ShaderGenerators *shaderGenerators()
+{
+    static QThreadStorage<ShaderGenerators *> generators;
+    if (!generators.hasLocalData())
+        generators.setLocalData(new ShaderGenerators);
+    return generators.localData();
+}
+
+class PregenerateWorker : public QRunnable
+{
+public:
+    PregenerateWorker(const std::function<void()> &work, QSemaphore *done)
+        : m_work(work), m_done(done)
+    { }
+
+    void run() override
+    {
+        m_work();
+        m_done->release();
+    }
+
+private:
+    std::function<void()> m_work;
+    QSemaphore *m_done;
+};
+
+} // namespace
+
 Q3DSShaderManager &Q3DSShaderManager::instance()
 {
     static Q3DSShaderManager instance;
@@ -42,42 +182,238 @@ Q3DSShaderManager &Q3DSShaderManager::instance()
 
 Q3DSDefaultMaterialShaderGenerator *Q3DSShaderManager::defaultMaterialShaderGenerator()
 {
-    return m_materialShaderGenerator;
+    return shaderGenerators()->material;
 }
 
 Q3DSCustomMaterialShaderGenerator *Q3DSShaderManager::customMaterialShaderGenerator()
 {
-    return m_customMaterialShaderGenerator;
+    return shaderGenerators()->customMaterial;
+}
+
+Q3DSAbstractShaderProgramGenerator *Q3DSShaderManager::programGenerator(Q3DSShaderProgramCache *programs)
+{
+    Q3DSAbstractShaderProgramGenerator *generator = shaderGenerators()->program;
+    generator->setProgramCache(programs);
+    return generator;
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::generateShaderProgram(Q3DSDefaultMaterial &material,
+Qt3DRender::QShaderProgram *Q3DSShaderManager::generateShaderProgram(Q3DSShaderProgramCache *programs,
+                                                                     Q3DSDefaultMaterial &material,
                                                                      Q3DSReferencedMaterial *referencedMaterial,
                                                                      const QVector<Q3DSLightNode*> &lights,
                                                                      bool hasTransparency,
                                                                      const Q3DSShaderFeatureSet &featureSet)
 {
-    Q3DSSubsetMaterialVertexPipeline pipeline(*m_materialShaderGenerator, *m_shaderProgramGenerator, false);
-    return m_materialShaderGenerator->generateShader(material, referencedMaterial, pipeline, featureSet, lights, hasTransparency,
-                                                     QString(QLatin1String("default material %1")).arg(QString::fromLatin1(material.id())));
+    Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+    const QString description = QString(QLatin1String("default material %1")).arg(QString::fromLatin1(material.id()));
+    if (hasPregeneratedSources()) {
+        const QByteArray key = variantKey(material, referencedMaterial, lights, hasTransparency, featureSet);
+        Q3DSShaderProgramSources sources;
+        if (pregeneratedSources(key, &sources))
+            return generator->programForSources(key, sources, description);
+        qCDebug(lcPerf, "No bundled or pregenerated shader for %s, generating", qPrintable(description));
+    }
+
+    Q3DSDefaultMaterialShaderGenerator *materialGenerator = defaultMaterialShaderGenerator();
+    Q3DSSubsetMaterialVertexPipeline pipeline(*materialGenerator, *generator, false);
+    return materialGenerator->generateShader(material, referencedMaterial, pipeline, featureSet, lights, hasTransparency,
+                                             description);
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::generateShaderProgram(Q3DSCustomMaterialInstance &material,
+Qt3DRender::QShaderProgram *Q3DSShaderManager::generateShaderProgram(Q3DSShaderProgramCache *programs,
+                                                                     Q3DSCustomMaterialInstance &material,
                                                                      Q3DSReferencedMaterial *referencedMaterial,
                                                                      const QVector<Q3DSLightNode *> &lights,
                                                                      bool hasTransparency,
                                                                      const Q3DSShaderFeatureSet &featureSet,
                                                                      const QString &shaderName)
 {
-    Q3DSCustomMaterialVertexPipeline pipeline(*m_materialShaderGenerator, *m_shaderProgramGenerator, false);
-    return m_customMaterialShaderGenerator->generateShader(material, referencedMaterial, pipeline, featureSet, lights, hasTransparency, shaderName);
+    Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+    if (hasPregeneratedSources()) {
+        const QByteArray key = variantKey(material, referencedMaterial, lights, hasTransparency, featureSet, shaderName);
+        Q3DSShaderProgramSources sources;
+        if (pregeneratedSources(key, &sources))
+            return generator->programForSources(key, sources, shaderName);
+        qCDebug(lcPerf, "No bundled or pregenerated shader for custom material %s, generating", material.id().constData());
+    }
+
+    Q3DSCustomMaterialVertexPipeline pipeline(*defaultMaterialShaderGenerator(), *generator, false);
+    return customMaterialShaderGenerator()->generateShader(material, referencedMaterial, pipeline, featureSet, lights, hasTransparency, shaderName);
+}
+
+QByteArray Q3DSShaderManager::variantKey(Q3DSDefaultMaterial &material,
+                                         Q3DSReferencedMaterial *referencedMaterial,
+                                         const QVector<Q3DSLightNode *> &lights,
+                                         bool hasTransparency,
+                                         const Q3DSShaderFeatureSet &featureSet)
+{
+    return defaultMaterialShaderGenerator()->variantKey(material, referencedMaterial, featureSet, lights, hasTransparency, QString());
+}
+
+QByteArray Q3DSShaderManager::variantKey(Q3DSCustomMaterialInstance &material,
+                                         Q3DSReferencedMaterial *referencedMaterial,
+                                         const QVector<Q3DSLightNode *> &lights,
+                                         bool hasTransparency,
+                                         const Q3DSShaderFeatureSet &featureSet,
+                                         const QString &shaderName)
+{
+    return customMaterialShaderGenerator()->variantKey(material, referencedMaterial, featureSet, lights, hasTransparency, shaderName);
+}
+
+bool Q3DSShaderManager::loadShaderBundle(const QString &fileName)
+{
+    const QFileInfo fi(fileName);
+    const QDateTime lastModified = fi.lastModified();
+    {
+        QMutexLocker lock(&m_sourcesMutex);
+        auto loaded = m_loadedBundles.constFind(fi.absoluteFilePath());
+        if (loaded != m_loadedBundles.cend() && *loaded == lastModified)
+            return true;
+    }
+
+    Q3DSShaderBundle bundle;
+    QString error;
+    if (!bundle.load(fileName, &error)) {
+        qWarning("Failed to load shader bundle %s: %s", qPrintable(fileName), qPrintable(error));
+        return false;
+    }
+    if (!bundle.isUsable()) {
+        qWarning("Ignoring shader bundle %s: generated for %s (GLSL %d), running with %s (GLSL %d)",
+                 qPrintable(fileName), bundle.target().constData(), bundle.glslVersion(),
+                 Q3DSShaderBundle::currentTarget().constData(), Q3DSShaderBundle::currentGlslVersion());
+        return false;
+    }
+
+    QMutexLocker lock(&m_sourcesMutex);
+    for (const QByteArray &key : bundle.keys())
+        m_bundledSources.insert(key, bundle.find(key)->sources);
+    m_loadedBundles.insert(fi.absoluteFilePath(), lastModified);
+
+    qCDebug(lcPerf, "Loaded %d programs from shader bundle %s", bundle.count(), qPrintable(fileName));
+    return true;
+}
+
+int Q3DSShaderManager::bundledProgramCount() const
+{
+    QMutexLocker lock(&m_sourcesMutex);
+    return m_bundledSources.count();
+}
+
+QByteArray Q3DSShaderManager::variantKey(const MaterialVariant &variant)
+{
+    if (variant.material->type() == Q3DSGraphObject::DefaultMaterial) {
+        return variantKey(*static_cast<Q3DSDefaultMaterial *>(variant.material), variant.referencedMaterial,
+                          variant.lights, variant.hasTransparency, variant.featureSet);
+    }
+    Q_ASSERT(variant.material->type() == Q3DSGraphObject::CustomMaterial);
+    return variantKey(*static_cast<Q3DSCustomMaterialInstance *>(variant.material), variant.referencedMaterial,
+                      variant.lights, variant.hasTransparency, variant.featureSet, variant.shaderName);
+}
+
+// Runs the generators of the calling thread without creating a program.
+Q3DSShaderProgramSources Q3DSShaderManager::generateSources(const MaterialVariant &variant)
+{
+    Q3DSShaderProgramSources sources;
+    Q3DSAbstractShaderProgramGenerator *generator = programGenerator(nullptr);
+    generator->setSourcesOutput(&sources);
+
+    Q3DSDefaultMaterialShaderGenerator *materialGenerator = defaultMaterialShaderGenerator();
+    if (variant.material->type() == Q3DSGraphObject::DefaultMaterial) {
+        const QString description = QString(QLatin1String("default material %1")).arg(QString::fromLatin1(variant.material->id()));
+        Q3DSSubsetMaterialVertexPipeline pipeline(*materialGenerator, *generator, false);
+        materialGenerator->generateShader(*variant.material, variant.referencedMaterial, pipeline, variant.featureSet,
+                                          variant.lights, variant.hasTransparency, description);
+    } else {
+        Q3DSCustomMaterialVertexPipeline pipeline(*materialGenerator, *generator, false);
+        customMaterialShaderGenerator()->generateShader(*variant.material, variant.referencedMaterial, pipeline, variant.featureSet,
+                                                        variant.lights, variant.hasTransparency, variant.shaderName);
+    }
+
+    generator->setSourcesOutput(nullptr);
+    return sources;
+}
+
+int Q3DSShaderManager::pregenerateShaderPrograms(const QVector<MaterialVariant> &variants)
+{
+    // The keys are cheap compared to the sources, so these are done here.
+    QVector<QByteArray> keys;
+    QVector<const MaterialVariant *> pending;
+    for (const MaterialVariant &variant : variants) {
+        const QByteArray key = variantKey(variant);
+        if (keys.contains(key))
+            continue;
+        Q3DSShaderProgramSources sources;
+        if (pregeneratedSources(key, &sources))
+            continue;
+        keys.append(key);
+        pending.append(&variant);
+    }
+    if (pending.isEmpty())
+        return 0;
+
+    std::vector<Q3DSShaderProgramSources> results(size_t(pending.count()));
+    QAtomicInt next;
+    auto work = [&pending, &results, &next, this]() {
+        for (int i = next.fetchAndAddRelaxed(1); i < pending.count(); i = next.fetchAndAddRelaxed(1))
+            results[size_t(i)] = generateSources(*pending[i]);
+    };
+
+    // Only take threads that are free right now. The calling thread works
+    // too, so a busy pool means slower, not blocked.
+    QThreadPool *pool = QThreadPool::globalInstance();
+    QSemaphore done;
+    int started = 0;
+    const int workers = qMin(pending.count(), QThread::idealThreadCount()) - 1;
+    for (int i = 0; i < workers; ++i) {
+        PregenerateWorker *worker = new PregenerateWorker(work, &done);
+        if (!pool->tryStart(worker)) {
+            delete worker;
+            break;
+        }
+        ++started;
+    }
+    work();
+    done.acquire(started);
+
+    qCDebug(lcPerf, "Pregenerated %d material shader programs on %d threads", pending.count(), started + 1);
+
+    QMutexLocker lock(&m_sourcesMutex);
+    for (int i = 0; i < pending.count(); ++i) {
+        const Q3DSShaderProgramSources &sources(results[size_t(i)]);
+        m_generatedSources.insert(keys[i], new Q3DSShaderProgramSources(sources), sources.size());
+    }
+    return pending.count();
+}
+
+bool Q3DSShaderManager::hasPregeneratedSources() const
+{
+    QMutexLocker lock(&m_sourcesMutex);
+    return !m_bundledSources.isEmpty() || !m_generatedSources.isEmpty();
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::getCubeDepthNoTessShader(Qt3DCore::QNode *parent)
+bool Q3DSShaderManager::pregeneratedSources(const QByteArray &key, Q3DSShaderProgramSources *sources) const
 {
-    if (!m_cubeDepthShader) {
-        m_shaderProgramGenerator->beginProgram();
-        Q3DSAbstractShaderStageGenerator *vertexShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Vertex);
-        Q3DSAbstractShaderStageGenerator *fragmentShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Fragment);
+    QMutexLocker lock(&m_sourcesMutex);
+    auto it = m_bundledSources.constFind(key);
+    if (it != m_bundledSources.cend()) {
+        *sources = *it;
+        return true;
+    }
+    if (Q3DSShaderProgramSources *generated = m_generatedSources.object(key)) {
+        *sources = *generated;
+        return true;
+    }
+    return false;
+}
+
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getCubeDepthNoTessShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent)
+{
+    Qt3DRender::QShaderProgram *prog = programs->builtinProgram(QByteArrayLiteral("cubeDepthNoTess"));
+    if (!prog) {
+        Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+        generator->beginProgram();
+        Q3DSAbstractShaderStageGenerator *vertexShader = generator->getStage(Q3DSShaderGeneratorStages::Vertex);
+        Q3DSAbstractShaderStageGenerator *fragmentShader = generator->getStage(Q3DSShaderGeneratorStages::Fragment);
 
         vertexShader->addIncoming("attr_pos", "vec3");
         vertexShader->addUniform("modelMatrix", "mat4");
@@ -98,19 +434,22 @@ Qt3DRender::QShaderProgram *Q3DSShaderManager::getCubeDepthNoTessShader(Qt3DCore
         fragmentShader->append("    fragOutput = vec4(dist, dist, dist, 1.0);");
         fragmentShader->append("}");
 
-        m_cubeDepthShader = m_shaderProgramGenerator->compileGeneratedShader(QLatin1String("cubemap face depth shader"), Q3DSShaderFeatureSet());
-        m_cubeDepthShader->setParent(parent);
+        prog = generator->compileGeneratedShader(QLatin1String("cubemap face depth shader"), Q3DSShaderFeatureSet());
+        prog->setParent(parent);
+        programs->setBuiltinProgram(QByteArrayLiteral("cubeDepthNoTess"), prog);
     }
 
-    return m_cubeDepthShader;
+    return prog;
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::getOrthographicDepthNoTessShader(Qt3DCore::QNode *parent)
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getOrthographicDepthNoTessShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent)
 {
-    if (!m_orthoDepthShader) {
-        m_shaderProgramGenerator->beginProgram();
-        Q3DSAbstractShaderStageGenerator *vertexShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Vertex);
-        Q3DSAbstractShaderStageGenerator *fragmentShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Fragment);
+    Qt3DRender::QShaderProgram *prog = programs->builtinProgram(QByteArrayLiteral("orthoDepthNoTess"));
+    if (!prog) {
+        Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+        generator->beginProgram();
+        Q3DSAbstractShaderStageGenerator *vertexShader = generator->getStage(Q3DSShaderGeneratorStages::Vertex);
+        Q3DSAbstractShaderStageGenerator *fragmentShader = generator->getStage(Q3DSShaderGeneratorStages::Fragment);
 
         vertexShader->addIncoming("attr_pos", "vec3");
         vertexShader->addUniform("modelViewProjection", "mat4");
@@ -125,19 +464,23 @@ Qt3DRender::QShaderProgram *Q3DSShaderManager::getOrthographicDepthNoTessShader(
         fragmentShader->append("    fragOutput = vec4(depth);");
         fragmentShader->append("}");
 
-        m_orthoDepthShader = m_shaderProgramGenerator->compileGeneratedShader(QLatin1String("orthographic depth shader"), Q3DSShaderFeatureSet());
-        m_orthoDepthShader->setParent(parent);
+        prog = generator->compileGeneratedShader(QLatin1String("orthographic depth shader"), Q3DSShaderFeatureSet());
+        prog->setParent(parent);
+        programs->setBuiltinProgram(QByteArrayLiteral("orthoDepthNoTess"), prog);
     }
 
-    return m_orthoDepthShader;
+    return prog;
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::getDepthPrepassShader(Qt3DCore::QNode *parent, bool displaced)
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getDepthPrepassShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent, bool displaced)
 {
-    if (!m_depthPrePassShader) {
-        m_shaderProgramGenerator->beginProgram();
-        Q3DSAbstractShaderStageGenerator *vertexShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Vertex);
-        Q3DSAbstractShaderStageGenerator *fragmentShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Fragment);
+    const QByteArray name = displaced ? QByteArrayLiteral("depthPrepassDisplaced") : QByteArrayLiteral("depthPrepass");
+    Qt3DRender::QShaderProgram *prog = programs->builtinProgram(name);
+    if (!prog) {
+        Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+        generator->beginProgram();
+        Q3DSAbstractShaderStageGenerator *vertexShader = generator->getStage(Q3DSShaderGeneratorStages::Vertex);
+        Q3DSAbstractShaderStageGenerator *fragmentShader = generator->getStage(Q3DSShaderGeneratorStages::Fragment);
 
         vertexShader->addIncoming("attr_pos", "vec3");
         vertexShader->addUniform("modelViewProjection", "mat4");
@@ -171,19 +514,128 @@ Qt3DRender::QShaderProgram *Q3DSShaderManager::getDepthPrepassShader(Qt3DCore::Q
         fragmentShader->append("    fragOutput = vec4(0.0);");
         fragmentShader->append("}");
 
-        m_depthPrePassShader = m_shaderProgramGenerator->compileGeneratedShader(displaced ? QLatin1String("depth prepass displaced") : QLatin1String("depth prepass"), Q3DSShaderFeatureSet());
-        m_depthPrePassShader->setParent(parent);
+        prog = generator->compileGeneratedShader(displaced ? QLatin1String("depth prepass displaced") : QLatin1String("depth prepass"), Q3DSShaderFeatureSet());
+        prog->setParent(parent);
+        programs->setBuiltinProgram(name, prog);
+    }
+
+    return prog;
+}
+
+const char *Q3DSShaderManager::instanceModelAttributeNames[4] = {
+    "attr_instanceModel0", "attr_instanceModel1", "attr_instanceModel2", "attr_instanceModel3"
+};
+const char *Q3DSShaderManager::instanceNormalAttributeNames[3] = {
+    "attr_instanceNormal0", "attr_instanceNormal1", "attr_instanceNormal2"
+};
+const char *Q3DSShaderManager::instanceOpacityAttributeName = "attr_instanceOpacity";
+
+bool Q3DSShaderManager::instancedSources(const Q3DSShaderProgramSources &sources, Q3DSShaderProgramSources *result)
+{
+    if (sources.vertex.isEmpty() || !sources.tessControl.isEmpty() || !sources.tessEval.isEmpty()
+            || !sources.geometry.isEmpty())
+    {
+        return false;
+    }
+
+    // The per-model uniforms that have an instanced replacement, and the ones
+    // that do not. All instances are drawn from one entity so Qt 3D would set
+    // the latter to the same value for each of them.
+    static const QRegularExpression instancedUniforms(QStringLiteral(
+        "uniform\\s+mat[34]\\s+(modelMatrix|modelViewProjection|modelNormalMatrix)\\s*;"));
+    static const QRegularExpression otherModelUniforms(QStringLiteral(
+        "uniform\\s+\\w+\\s+(modelView|modelViewNormal|mvp|inverseModelMatrix|inverseModelView|inverseModelViewProjection)\\s*;"));
+    static const QRegularExpression viewProjectionUniform(QStringLiteral("uniform\\s+mat4\\s+viewProjectionMatrix\\s*;"));
+    static const QRegularExpression mainFunc(QStringLiteral("void\\s+main\\s*\\(\\s*\\)\\s*\\{"));
+
+    QString vertex = QString::fromUtf8(sources.vertex);
+    QString fragment = QString::fromUtf8(sources.fragment);
+    if (vertex.contains(otherModelUniforms) || fragment.contains(otherModelUniforms)
+            || fragment.contains(instancedUniforms))
+    {
+        return false;
+    }
+
+    const int declPos = vertex.indexOf(instancedUniforms);
+    if (declPos < 0)
+        return false;
+    vertex.remove(instancedUniforms);
+    const QRegularExpressionMatch vertexMain = mainFunc.match(vertex);
+    if (!vertexMain.hasMatch() || vertexMain.capturedStart() < declPos)
+        return false;
+
+    // The default material takes the object opacity from the alpha of
+    // material_diffuse, that becomes a per-instance factor.
+    const QString opacity = QStringLiteral("float object_opacity = material_diffuse.a;");
+    const QRegularExpressionMatch fragmentMain = mainFunc.match(fragment);
+    if (fragment.contains(opacity)) {
+        if (!fragmentMain.hasMatch())
+            return false;
+        fragment.replace(opacity, QStringLiteral("float object_opacity = material_diffuse.a * varInstanceOpacity;"));
+        fragment.insert(fragmentMain.capturedStart(), QLatin1String("varying float varInstanceOpacity;\n"));
+    } else if (fragment.contains(QLatin1String("material_diffuse"))) {
+        return false;
     }
 
-    return m_depthPrePassShader;
+    vertex.insert(vertexMain.capturedEnd(), QLatin1String("\n    varInstanceOpacity = attr_instanceOpacity;\n"));
+
+    QString decl = QLatin1String("\n");
+    for (const char *name : instanceModelAttributeNames)
+        decl += QLatin1String("attribute vec4 ") + QLatin1String(name) + QLatin1String(";\n");
+    for (const char *name : instanceNormalAttributeNames)
+        decl += QLatin1String("attribute vec3 ") + QLatin1String(name) + QLatin1String(";\n");
+    decl += QLatin1String("attribute float ") + QLatin1String(instanceOpacityAttributeName) + QLatin1String(";\n");
+    if (!vertex.contains(viewProjectionUniform))
+        decl += QLatin1String("uniform mat4 viewProjectionMatrix;\n");
+    decl += QLatin1String("varying float varInstanceOpacity;\n");
+    decl += QLatin1String("#define modelMatrix mat4(attr_instanceModel0, attr_instanceModel1, attr_instanceModel2, attr_instanceModel3)\n");
+    decl += QLatin1String("#define modelViewProjection (viewProjectionMatrix * modelMatrix)\n");
+    decl += QLatin1String("#define modelNormalMatrix mat3(attr_instanceNormal0, attr_instanceNormal1, attr_instanceNormal2)\n");
+    vertex.insert(declPos, decl);
+
+    *result = Q3DSShaderProgramSources();
+    result->vertex = vertex.toUtf8();
+    result->fragment = fragment.toUtf8();
+    return true;
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::getOrthoShadowBlurXShader(Qt3DCore::QNode *parent)
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getInstancedShader(Q3DSShaderProgramCache *programs,
+                                                                  Qt3DCore::QNode *parent,
+                                                                  Qt3DRender::QShaderProgram *program)
 {
-    if (!m_orthoShadowBlurXShader) {
-        m_shaderProgramGenerator->beginProgram();
-        Q3DSAbstractShaderStageGenerator *vertexShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Vertex);
-        Q3DSAbstractShaderStageGenerator *fragmentShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Fragment);
+    Q3DSShaderProgramSources sources;
+    sources.vertex = program->vertexShaderCode();
+    sources.tessControl = program->tessellationControlShaderCode();
+    sources.tessEval = program->tessellationEvaluationShaderCode();
+    sources.geometry = program->geometryShaderCode();
+    sources.fragment = program->fragmentShaderCode();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData("instanced");
+    hash.addData(sources.vertex);
+    hash.addData("\0", 1);
+    hash.addData(sources.fragment);
+    const QByteArray key = hash.result();
+
+    Qt3DRender::QShaderProgram *prog = programs->program(key);
+    if (!prog) {
+        Q3DSShaderProgramSources instanced;
+        if (!instancedSources(sources, &instanced))
+            return nullptr;
+        prog = programs->createProgram(key, instanced, QLatin1String("instanced model shader"));
+        prog->setParent(parent);
+    }
+    return prog;
+}
+
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getOrthoShadowBlurXShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent)
+{
+    Qt3DRender::QShaderProgram *prog = programs->builtinProgram(QByteArrayLiteral("orthoShadowBlurX"));
+    if (!prog) {
+        Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+        generator->beginProgram();
+        Q3DSAbstractShaderStageGenerator *vertexShader = generator->getStage(Q3DSShaderGeneratorStages::Vertex);
+        Q3DSAbstractShaderStageGenerator *fragmentShader = generator->getStage(Q3DSShaderGeneratorStages::Fragment);
 
         // NB! The vertex shader is modified compared to the original: It uses
         // Qt3D attribute names (vertexPosition instead of attr_pos) and takes
@@ -213,19 +665,22 @@ Qt3DRender::QShaderProgram *Q3DSShaderManager::getOrthoShadowBlurXShader(Qt3DCor
         fragmentShader->append("    fragOutput = vec4(outDepth);");
         fragmentShader->append("}");
 
-        m_orthoShadowBlurXShader = m_shaderProgramGenerator->compileGeneratedShader(QLatin1String("shadow map blur X shader"), Q3DSShaderFeatureSet());
-        m_orthoShadowBlurXShader->setParent(parent);
+        prog = generator->compileGeneratedShader(QLatin1String("shadow map blur X shader"), Q3DSShaderFeatureSet());
+        prog->setParent(parent);
+        programs->setBuiltinProgram(QByteArrayLiteral("orthoShadowBlurX"), prog);
     }
 
-    return m_orthoShadowBlurXShader;
+    return prog;
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::getOrthoShadowBlurYShader(Qt3DCore::QNode *parent)
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getOrthoShadowBlurYShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent)
 {
-    if (!m_orthoShadowBlurYShader) {
-        m_shaderProgramGenerator->beginProgram();
-        Q3DSAbstractShaderStageGenerator *vertexShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Vertex);
-        Q3DSAbstractShaderStageGenerator *fragmentShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Fragment);
+    Qt3DRender::QShaderProgram *prog = programs->builtinProgram(QByteArrayLiteral("orthoShadowBlurY"));
+    if (!prog) {
+        Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+        generator->beginProgram();
+        Q3DSAbstractShaderStageGenerator *vertexShader = generator->getStage(Q3DSShaderGeneratorStages::Vertex);
+        Q3DSAbstractShaderStageGenerator *fragmentShader = generator->getStage(Q3DSShaderGeneratorStages::Fragment);
 
         // NB! The vertex shader is modified compared to the original: It uses
         // Qt3D attribute names (vertexPosition instead of attr_pos) and takes
@@ -255,19 +710,22 @@ Qt3DRender::QShaderProgram *Q3DSShaderManager::getOrthoShadowBlurYShader(Qt3DCor
         fragmentShader->append("    fragOutput = vec4(outDepth);");
         fragmentShader->append("}");
 
-        m_orthoShadowBlurYShader = m_shaderProgramGenerator->compileGeneratedShader(QLatin1String("shadow map blur Y shader"), Q3DSShaderFeatureSet());
-        m_orthoShadowBlurYShader->setParent(parent);
+        prog = generator->compileGeneratedShader(QLatin1String("shadow map blur Y shader"), Q3DSShaderFeatureSet());
+        prog->setParent(parent);
+        programs->setBuiltinProgram(QByteArrayLiteral("orthoShadowBlurY"), prog);
     }
 
-    return m_orthoShadowBlurYShader;
+    return prog;
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::getCubeShadowBlurXShader(Qt3DCore::QNode *parent, const Q3DSGraphicsLimits &)
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getCubeShadowBlurXShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent, const Q3DSGraphicsLimits &)
 {
-    if (!m_cubeShadowBlurXShader) {
-        m_shaderProgramGenerator->beginProgram();
-        Q3DSAbstractShaderStageGenerator *vertexShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Vertex);
-        Q3DSAbstractShaderStageGenerator *fragmentShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Fragment);
+    Qt3DRender::QShaderProgram *prog = programs->builtinProgram(QByteArrayLiteral("cubeShadowBlurX"));
+    if (!prog) {
+        Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+        generator->beginProgram();
+        Q3DSAbstractShaderStageGenerator *vertexShader = generator->getStage(Q3DSShaderGeneratorStages::Vertex);
+        Q3DSAbstractShaderStageGenerator *fragmentShader = generator->getStage(Q3DSShaderGeneratorStages::Fragment);
 
         // NB! The vertex shader is modified compared to the original: It uses
         // Qt3D attribute names (vertexPosition instead of attr_pos) and takes
@@ -384,19 +842,22 @@ Qt3DRender::QShaderProgram *Q3DSShaderManager::getCubeShadowBlurXShader(Qt3DCore
         fragmentShader->append("}");
 
         Q3DSShaderFeatureSet featureSet { Q3DSShaderPreprocessorFeature(QLatin1String("Q3DS_NO_FRAGOUTPUT"), true) };
-        m_cubeShadowBlurXShader = m_shaderProgramGenerator->compileGeneratedShader(QLatin1String("cubemap shadow blur X shader"), featureSet);
-        m_cubeShadowBlurXShader->setParent(parent);
+        prog = generator->compileGeneratedShader(QLatin1String("cubemap shadow blur X shader"), featureSet);
+        prog->setParent(parent);
+        programs->setBuiltinProgram(QByteArrayLiteral("cubeShadowBlurX"), prog);
     }
 
-    return m_cubeShadowBlurXShader;
+    return prog;
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::getCubeShadowBlurYShader(Qt3DCore::QNode *parent, const Q3DSGraphicsLimits &)
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getCubeShadowBlurYShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent, const Q3DSGraphicsLimits &)
 {
-    if (!m_cubeShadowBlurYShader) {
-        m_shaderProgramGenerator->beginProgram();
-        Q3DSAbstractShaderStageGenerator *vertexShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Vertex);
-        Q3DSAbstractShaderStageGenerator *fragmentShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Fragment);
+    Qt3DRender::QShaderProgram *prog = programs->builtinProgram(QByteArrayLiteral("cubeShadowBlurY"));
+    if (!prog) {
+        Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+        generator->beginProgram();
+        Q3DSAbstractShaderStageGenerator *vertexShader = generator->getStage(Q3DSShaderGeneratorStages::Vertex);
+        Q3DSAbstractShaderStageGenerator *fragmentShader = generator->getStage(Q3DSShaderGeneratorStages::Fragment);
 
         // NB! The vertex shader is modified compared to the original: It uses
         // Qt3D attribute names (vertexPosition instead of attr_pos) and takes
@@ -513,19 +974,22 @@ Qt3DRender::QShaderProgram *Q3DSShaderManager::getCubeShadowBlurYShader(Qt3DCore
         fragmentShader->append("}");
 
         Q3DSShaderFeatureSet featureSet { Q3DSShaderPreprocessorFeature(QLatin1String("Q3DS_NO_FRAGOUTPUT"), true) };
-        m_cubeShadowBlurYShader = m_shaderProgramGenerator->compileGeneratedShader(QLatin1String("cubemap shadow blur Y shader"), featureSet);
-        m_cubeShadowBlurYShader->setParent(parent);
+        prog = generator->compileGeneratedShader(QLatin1String("cubemap shadow blur Y shader"), featureSet);
+        prog->setParent(parent);
+        programs->setBuiltinProgram(QByteArrayLiteral("cubeShadowBlurY"), prog);
     }
 
-    return m_cubeShadowBlurYShader;
+    return prog;
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::getSsaoTextureShader(Qt3DCore::QNode *parent)
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getSsaoTextureShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent)
 {
-    if (!m_ssaoTextureShader) {
-        m_shaderProgramGenerator->beginProgram();
-        Q3DSAbstractShaderStageGenerator *vertexShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Vertex);
-        Q3DSAbstractShaderStageGenerator *fragmentShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Fragment);
+    Qt3DRender::QShaderProgram *prog = programs->builtinProgram(QByteArrayLiteral("ssaoTexture"));
+    if (!prog) {
+        Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+        generator->beginProgram();
+        Q3DSAbstractShaderStageGenerator *vertexShader = generator->getStage(Q3DSShaderGeneratorStages::Vertex);
+        Q3DSAbstractShaderStageGenerator *fragmentShader = generator->getStage(Q3DSShaderGeneratorStages::Fragment);
 
         // use qt3d attribute names, use modelMatrix as well
         vertexShader->addIncoming("vertexPosition", "vec3");
@@ -584,17 +1048,19 @@ Qt3DRender::QShaderProgram *Q3DSShaderManager::getSsaoTextureShader(Qt3DCore::QN
         fragmentShader->append("    fragOutput = vec4(aoFactor, aoFactor, aoFactor, 1.0);");
         fragmentShader->append("}");
 
-        m_ssaoTextureShader = m_shaderProgramGenerator->compileGeneratedShader(QLatin1String("fullscreen AO pass shader"), Q3DSShaderFeatureSet());
-        m_ssaoTextureShader->setParent(parent);
+        prog = generator->compileGeneratedShader(QLatin1String("fullscreen AO pass shader"), Q3DSShaderFeatureSet());
+        prog->setParent(parent);
+        programs->setBuiltinProgram(QByteArrayLiteral("ssaoTexture"), prog);
     }
 
-    return m_ssaoTextureShader;
+    return prog;
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::getBsdfMipPreFilterShader(Qt3DCore::QNode *parent)
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getBsdfMipPreFilterShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent)
 {
-    if (!m_bsdfMipPreFilterShader) {
-        m_bsdfMipPreFilterShader = new Qt3DRender::QShaderProgram;
+    Qt3DRender::QShaderProgram *prog = programs->builtinProgram(QByteArrayLiteral("bsdfMipPreFilter"));
+    if (!prog) {
+        prog = new Qt3DRender::QShaderProgram;
         Q3DSGraphicsLimits gfxLimits = Q3DS::graphicsLimits();
         const bool isOpenGLES = gfxLimits.format.renderableType() == QSurfaceFormat::OpenGLES;
         QByteArray code;
@@ -658,19 +1124,22 @@ Qt3DRender::QShaderProgram *Q3DSShaderManager::getBsdfMipPreFilterShader(Qt3DCor
                 "  imageStore( outputImage, ivec2(gl_GlobalInvocationID.xy), accumVal );\n"
                 "}\n";
 
-        m_bsdfMipPreFilterShader->setComputeShaderCode(code);
-        m_bsdfMipPreFilterShader->setParent(parent);
+        prog->setComputeShaderCode(code);
+        prog->setParent(parent);
+        programs->setBuiltinProgram(QByteArrayLiteral("bsdfMipPreFilter"), prog);
     }
 
-    return m_bsdfMipPreFilterShader;
+    return prog;
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::getProgAABlendShader(Qt3DCore::QNode *parent)
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getProgAABlendShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent)
 {
-    if (!m_progAABlendShader) {
-        m_shaderProgramGenerator->beginProgram();
-        Q3DSAbstractShaderStageGenerator *vertexShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Vertex);
-        Q3DSAbstractShaderStageGenerator *fragmentShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Fragment);
+    Qt3DRender::QShaderProgram *prog = programs->builtinProgram(QByteArrayLiteral("progAABlend"));
+    if (!prog) {
+        Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+        generator->beginProgram();
+        Q3DSAbstractShaderStageGenerator *vertexShader = generator->getStage(Q3DSShaderGeneratorStages::Vertex);
+        Q3DSAbstractShaderStageGenerator *fragmentShader = generator->getStage(Q3DSShaderGeneratorStages::Fragment);
 
         // Use Qt3D attribute names and take modelMatrix into account since the
         // quad entity may have a transform on it.
@@ -692,12 +1161,13 @@ Qt3DRender::QShaderProgram *Q3DSShaderManager::getProgAABlendShader(Qt3DCore::QN
         fragmentShader->append("    fragOutput = accum*blend_factors.y + lastFrame*blend_factors.x;");
         fragmentShader->append("}");
 
-        m_progAABlendShader = m_shaderProgramGenerator->compileGeneratedShader(
+        prog = generator->compileGeneratedShader(
                     QLatin1String("layer progressive/temporal AA blend shader"), Q3DSShaderFeatureSet());
-        m_progAABlendShader->setParent(parent);
+        prog->setParent(parent);
+        programs->setBuiltinProgram(QByteArrayLiteral("progAABlend"), prog);
     }
 
-    return m_progAABlendShader;
+    return prog;
 }
 
 static void addBlendShaderPreamble(Q3DSAbstractShaderStageGenerator *fragmentShader, int msaaSampleCount)
@@ -733,13 +1203,15 @@ static void addBlendShaderPreamble(Q3DSAbstractShaderStageGenerator *fragmentSha
     fragmentShader->append("    res.a = p0 + p1 + p2;");
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::getBlendOverlayShader(Qt3DCore::QNode *parent, int msaaSampleCount)
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getBlendOverlayShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent, int msaaSampleCount)
 {
-    Qt3DRender::QShaderProgram *&prog = m_blendOverlayShader[msaaSampleCount];
+    const QByteArray name = QByteArrayLiteral("blendOverlay") + QByteArray::number(msaaSampleCount);
+    Qt3DRender::QShaderProgram *prog = programs->builtinProgram(name);
     if (!prog) {
-        m_shaderProgramGenerator->beginProgram();
-        Q3DSAbstractShaderStageGenerator *vertexShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Vertex);
-        Q3DSAbstractShaderStageGenerator *fragmentShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Fragment);
+        Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+        generator->beginProgram();
+        Q3DSAbstractShaderStageGenerator *vertexShader = generator->getStage(Q3DSShaderGeneratorStages::Vertex);
+        Q3DSAbstractShaderStageGenerator *fragmentShader = generator->getStage(Q3DSShaderGeneratorStages::Fragment);
 
         // Use Qt3D attribute names and take modelMatrix into account since the
         // quad entity may have a transform on it.
@@ -766,21 +1238,24 @@ Qt3DRender::QShaderProgram *Q3DSShaderManager::getBlendOverlayShader(Qt3DCore::Q
         fragmentShader->append("    fragOutput = vec4(res.rgb * res.a, res.a);");
         fragmentShader->append("}");
 
-        prog = m_shaderProgramGenerator->compileGeneratedShader(
+        prog = generator->compileGeneratedShader(
                     QLatin1String("advanced overlay blend shader"), Q3DSShaderFeatureSet());
         prog->setParent(parent);
+        programs->setBuiltinProgram(name, prog);
     }
 
     return prog;
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::getBlendColorBurnShader(Qt3DCore::QNode *parent, int msaaSampleCount)
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getBlendColorBurnShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent, int msaaSampleCount)
 {
-    Qt3DRender::QShaderProgram *&prog = m_blendColorBurnShader[msaaSampleCount];
+    const QByteArray name = QByteArrayLiteral("blendColorBurn") + QByteArray::number(msaaSampleCount);
+    Qt3DRender::QShaderProgram *prog = programs->builtinProgram(name);
     if (!prog) {
-        m_shaderProgramGenerator->beginProgram();
-        Q3DSAbstractShaderStageGenerator *vertexShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Vertex);
-        Q3DSAbstractShaderStageGenerator *fragmentShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Fragment);
+        Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+        generator->beginProgram();
+        Q3DSAbstractShaderStageGenerator *vertexShader = generator->getStage(Q3DSShaderGeneratorStages::Vertex);
+        Q3DSAbstractShaderStageGenerator *fragmentShader = generator->getStage(Q3DSShaderGeneratorStages::Fragment);
 
         // Use Qt3D attribute names and take modelMatrix into account since the
         // quad entity may have a transform on it.
@@ -807,21 +1282,24 @@ Qt3DRender::QShaderProgram *Q3DSShaderManager::getBlendColorBurnShader(Qt3DCore:
         fragmentShader->append("    fragOutput = vec4(res.rgb * res.a, res.a);");
         fragmentShader->append("}");
 
-        prog = m_shaderProgramGenerator->compileGeneratedShader(
+        prog = generator->compileGeneratedShader(
                     QLatin1String("advanced color burn blend shader"), Q3DSShaderFeatureSet());
         prog->setParent(parent);
+        programs->setBuiltinProgram(name, prog);
     }
 
     return prog;
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::getBlendColorDodgeShader(Qt3DCore::QNode *parent, int msaaSampleCount)
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getBlendColorDodgeShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent, int msaaSampleCount)
 {
-    Qt3DRender::QShaderProgram *&prog = m_blendColorDodgeShader[msaaSampleCount];
+    const QByteArray name = QByteArrayLiteral("blendColorDodge") + QByteArray::number(msaaSampleCount);
+    Qt3DRender::QShaderProgram *prog = programs->builtinProgram(name);
     if (!prog) {
-        m_shaderProgramGenerator->beginProgram();
-        Q3DSAbstractShaderStageGenerator *vertexShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Vertex);
-        Q3DSAbstractShaderStageGenerator *fragmentShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Fragment);
+        Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+        generator->beginProgram();
+        Q3DSAbstractShaderStageGenerator *vertexShader = generator->getStage(Q3DSShaderGeneratorStages::Vertex);
+        Q3DSAbstractShaderStageGenerator *fragmentShader = generator->getStage(Q3DSShaderGeneratorStages::Fragment);
 
         // Use Qt3D attribute names and take modelMatrix into account since the
         // quad entity may have a transform on it.
@@ -848,24 +1326,27 @@ Qt3DRender::QShaderProgram *Q3DSShaderManager::getBlendColorDodgeShader(Qt3DCore
         fragmentShader->append("    fragOutput = vec4(res.rgb * res.a, res.a);");
         fragmentShader->append("}");
 
-        prog = m_shaderProgramGenerator->compileGeneratedShader(
+        prog = generator->compileGeneratedShader(
                     QLatin1String("advanced color dodge blend shader"), Q3DSShaderFeatureSet());
         prog->setParent(parent);
+        programs->setBuiltinProgram(name, prog);
     }
 
     return prog;
 }
 
-Qt3DRender::QShaderProgram *Q3DSShaderManager::getEffectShader(Qt3DCore::QNode *parent,
+Qt3DRender::QShaderProgram *Q3DSShaderManager::getEffectShader(Q3DSShaderProgramCache *programs,
+                                                               Qt3DCore::QNode *parent,
                                                                const QString &name,
                                                                const QString &vertexShaderSrc,
                                                                const QString &fragmentShaderSrc)
 {
-    // No cache on this level. m_shaderProgramGenerator has one.
+    // No cache on this level, programs has one keyed by the generated sources.
 
-    m_shaderProgramGenerator->beginProgram();
-    Q3DSAbstractShaderStageGenerator *vertexShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Vertex);
-    Q3DSAbstractShaderStageGenerator *fragmentShader = m_shaderProgramGenerator->getStage(Q3DSShaderGeneratorStages::Fragment);
+    Q3DSAbstractShaderProgramGenerator *generator = programGenerator(programs);
+    generator->beginProgram();
+    Q3DSAbstractShaderStageGenerator *vertexShader = generator->getStage(Q3DSShaderGeneratorStages::Vertex);
+    Q3DSAbstractShaderStageGenerator *fragmentShader = generator->getStage(Q3DSShaderGeneratorStages::Fragment);
 
     vertexShader->append("\n#define VERTEX_SHADER\n#include \"effect.glsllib\"\n");
     vertexShader->append(vertexShaderSrc.toUtf8().constData());
@@ -873,40 +1354,13 @@ Qt3DRender::QShaderProgram *Q3DSShaderManager::getEffectShader(Qt3DCore::QNode *
     fragmentShader->append("\n#define FRAGMENT_SHADER\n#include \"effect.glsllib\"\n");
     fragmentShader->append(fragmentShaderSrc.toUtf8().constData());
 
-    Qt3DRender::QShaderProgram *prog = m_shaderProgramGenerator->compileGeneratedShader(name, Q3DSShaderFeatureSet());
+    Qt3DRender::QShaderProgram *prog = generator->compileGeneratedShader(name, Q3DSShaderFeatureSet());
     prog->setParent(parent);
     return prog;
 }
 
 Q3DSShaderManager::Q3DSShaderManager()
-    : m_materialShaderGenerator(&Q3DSDefaultMaterialShaderGenerator::createDefaultMaterialShaderGenerator())
-    , m_customMaterialShaderGenerator(&Q3DSCustomMaterialShaderGenerator::createCustomMaterialShaderGenerator())
-    , m_shaderProgramGenerator(Q3DSAbstractShaderProgramGenerator::createProgramGenerator())
-{
-}
-
-void Q3DSShaderManager::invalidate()
-{
-    m_depthPrePassShader = nullptr;
-    m_orthoDepthShader = nullptr;
-    m_cubeDepthShader = nullptr;
-    m_orthoShadowBlurXShader = nullptr;
-    m_orthoShadowBlurYShader = nullptr;
-    m_cubeShadowBlurXShader = nullptr;
-    m_cubeShadowBlurYShader = nullptr;
-    m_ssaoTextureShader = nullptr;
-    m_bsdfMipPreFilterShader = nullptr;
-    m_progAABlendShader = nullptr;
-    m_blendOverlayShader.clear();
-    m_blendColorBurnShader.clear();
-    m_blendColorDodgeShader.clear();
-
-    m_shaderProgramGenerator->invalidate();
-}
-
-void Q3DSShaderManager::setProfiler(Q3DSProfiler *profiler)
 {
-    m_shaderProgramGenerator->setProfiler(profiler);
 }
 
 QT_END_NAMESPACE
@@ -46,58 +46,158 @@
 #include "q3dscustommaterialvertexpipeline_p.h"
 #include "q3dsuippresentation_p.h"
 #include <Qt3DRender/QShaderProgram>
-#include <QMap>
+#include <QHash>
+#include <QCache>
+#include <QDateTime>
+#include <QMutex>
+#include <QPointer>
 
 QT_BEGIN_NAMESPACE
 
-class Q3DSShaderManager
+class Q3DSProfiler;
+
+// The QShaderProgram nodes of one Q3DSEngine. Nodes must never be shared
+// between aspect engines, so each engine (with all its subpresentations) has
+// its own set, created from the sources Q3DSShaderManager shares between all
+// engines. To be used on the engine's thread only.
+class Q3DSV_PRIVATE_EXPORT Q3DSShaderProgramCache
+{
+public:
+    Qt3DRender::QShaderProgram *program(const QByteArray &key) const;
+    Qt3DRender::QShaderProgram *createProgram(const QByteArray &key,
+                                              const Q3DSShaderProgramSources &sources,
+                                              const QString &name);
+    // the depth, blur, blend, etc. programs looked up by name instead of by sources
+    Qt3DRender::QShaderProgram *builtinProgram(const QByteArray &name) const { return m_builtinPrograms.value(name); }
+    void setBuiltinProgram(const QByteArray &name, Qt3DRender::QShaderProgram *program) { m_builtinPrograms.insert(name, program); }
+
+    int count() const;
+
+    void setProfiler(Q3DSProfiler *profiler) { m_profiler = profiler; }
+    Q3DSProfiler *profiler() const { return m_profiler; }
+
+    // Only forgets the programs, deleting them is not wanted since with Qt 3D
+    // everything gets parented somewhere, and by the time the aspect engine is
+    // recreated the programs may have been deleted already.
+    void clear();
+
+    // Beyond this many entries, the ones whose program is gone are dropped
+    // first, then the least recently used ones. Forgetting a program does not
+    // delete it, its users keep it, it only stops being shared.
+    static const int MAX_PROGRAMS = 1000;
+
+private:
+    void trim();
+
+    struct Entry {
+        QPointer<Qt3DRender::QShaderProgram> program;
+        quint64 lastUse = 0;
+    };
+    mutable QHash<QByteArray, Entry> m_programs;
+    mutable quint64 m_useCounter = 0;
+    QHash<QByteArray, QPointer<Qt3DRender::QShaderProgram>> m_builtinPrograms;
+    Q3DSProfiler *m_profiler = nullptr;
+};
+
+// Shared by all engines in the process, and safe to call from any thread: the
+// generators are per thread and the sources they produce are shared. The
+// program nodes go to the Q3DSShaderProgramCache passed in. Material programs
+// may also be generated without one, the caller then owns the program.
+class Q3DSV_PRIVATE_EXPORT Q3DSShaderManager
 {
 public:
     static Q3DSShaderManager& instance();
     Q3DSShaderManager(Q3DSShaderManager const&) = delete;
     void operator=(Q3DSShaderManager const&) = delete;
 
-    void invalidate();
-    void setProfiler(Q3DSProfiler *profiler);
-
+    // The generators of the calling thread.
     Q3DSDefaultMaterialShaderGenerator *defaultMaterialShaderGenerator();
     Q3DSCustomMaterialShaderGenerator *customMaterialShaderGenerator();
 
-    Qt3DRender::QShaderProgram *generateShaderProgram(Q3DSDefaultMaterial &material,
+    Qt3DRender::QShaderProgram *generateShaderProgram(Q3DSShaderProgramCache *programs,
+                                                      Q3DSDefaultMaterial &material,
                                                       Q3DSReferencedMaterial *referencedMaterial,
                                                       const QVector<Q3DSLightNode*> &lights,
                                                       bool hasTransparency,
                                                       const Q3DSShaderFeatureSet &featureSet);
-    Qt3DRender::QShaderProgram *generateShaderProgram(Q3DSCustomMaterialInstance &material,
+    Qt3DRender::QShaderProgram *generateShaderProgram(Q3DSShaderProgramCache *programs,
+                                                      Q3DSCustomMaterialInstance &material,
                                                       Q3DSReferencedMaterial *referencedMaterial,
                                                       const QVector<Q3DSLightNode*> &lights,
                                                       bool hasTransparency,
                                                       const Q3DSShaderFeatureSet &featureSet,
                                                       const QString &shaderName = QString());
 
-    Qt3DRender::QShaderProgram* getCubeDepthNoTessShader(Qt3DCore::QNode *parent);
-
-    Qt3DRender::QShaderProgram* getOrthographicDepthNoTessShader(Qt3DCore::QNode *parent);
-
-    Qt3DRender::QShaderProgram* getDepthPrepassShader(Qt3DCore::QNode *parent, bool displaced);
-
-    Qt3DRender::QShaderProgram *getOrthoShadowBlurXShader(Qt3DCore::QNode *parent);
-    Qt3DRender::QShaderProgram *getOrthoShadowBlurYShader(Qt3DCore::QNode *parent);
-
-    Qt3DRender::QShaderProgram *getCubeShadowBlurXShader(Qt3DCore::QNode *parent, const Q3DSGraphicsLimits &limits);
-    Qt3DRender::QShaderProgram *getCubeShadowBlurYShader(Qt3DCore::QNode *parent, const Q3DSGraphicsLimits &limits);
-
-    Qt3DRender::QShaderProgram *getSsaoTextureShader(Qt3DCore::QNode *parent);
-
-    Qt3DRender::QShaderProgram *getBsdfMipPreFilterShader(Qt3DCore::QNode *parent);
-
-    Qt3DRender::QShaderProgram *getProgAABlendShader(Qt3DCore::QNode *parent);
-
-    Qt3DRender::QShaderProgram *getBlendOverlayShader(Qt3DCore::QNode *parent, int msaaSampleCount);
-    Qt3DRender::QShaderProgram *getBlendColorBurnShader(Qt3DCore::QNode *parent, int msaaSampleCount);
-    Qt3DRender::QShaderProgram *getBlendColorDodgeShader(Qt3DCore::QNode *parent, int msaaSampleCount);
-
-    Qt3DRender::QShaderProgram *getEffectShader(Qt3DCore::QNode *parent,
+    // Material programs in loaded bundles are used instead of generating
+    // them. Bundles stay loaded for the lifetime of the process.
+    bool loadShaderBundle(const QString &fileName);
+    int bundledProgramCount() const;
+
+    struct MaterialVariant {
+        Q3DSGraphObject *material = nullptr; // default or custom material
+        Q3DSReferencedMaterial *referencedMaterial = nullptr;
+        QVector<Q3DSLightNode *> lights;
+        bool hasTransparency = false;
+        Q3DSShaderFeatureSet featureSet;
+        QString shaderName; // custom materials only
+    };
+
+    // Generates the sources for the variants not bundled or generated
+    // before, on the global thread pool and the calling thread, and returns
+    // once all are done. generateShaderProgram() is then a lookup plus
+    // creating the program node. The materials, lights and layers must not
+    // change meanwhile. Returns the number of programs generated.
+    int pregenerateShaderPrograms(const QVector<MaterialVariant> &variants);
+
+    QByteArray variantKey(Q3DSDefaultMaterial &material,
+                          Q3DSReferencedMaterial *referencedMaterial,
+                          const QVector<Q3DSLightNode*> &lights,
+                          bool hasTransparency,
+                          const Q3DSShaderFeatureSet &featureSet);
+    QByteArray variantKey(Q3DSCustomMaterialInstance &material,
+                          Q3DSReferencedMaterial *referencedMaterial,
+                          const QVector<Q3DSLightNode*> &lights,
+                          bool hasTransparency,
+                          const Q3DSShaderFeatureSet &featureSet,
+                          const QString &shaderName = QString());
+
+    Qt3DRender::QShaderProgram* getCubeDepthNoTessShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent);
+
+    Qt3DRender::QShaderProgram* getOrthographicDepthNoTessShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent);
+
+    Qt3DRender::QShaderProgram* getDepthPrepassShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent, bool displaced);
+
+    // Instanced drawing of models: the variant of a program that takes the
+    // model and normal matrices and the object opacity from the per-instance
+    // attributes below instead of from the Qt 3D uniforms. Returns null when
+    // the program relies on something that cannot come from an instance
+    // (tessellation, geometry shaders, other per-model uniforms).
+    Qt3DRender::QShaderProgram *getInstancedShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent,
+                                                   Qt3DRender::QShaderProgram *program);
+    static bool instancedSources(const Q3DSShaderProgramSources &sources, Q3DSShaderProgramSources *result);
+    // vec4 x 4 (model matrix columns), vec3 x 3 (normal matrix columns), float
+    static const char *instanceModelAttributeNames[4];
+    static const char *instanceNormalAttributeNames[3];
+    static const char *instanceOpacityAttributeName;
+
+    Qt3DRender::QShaderProgram *getOrthoShadowBlurXShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent);
+    Qt3DRender::QShaderProgram *getOrthoShadowBlurYShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent);
+
+    Qt3DRender::QShaderProgram *getCubeShadowBlurXShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent, const Q3DSGraphicsLimits &limits);
+    Qt3DRender::QShaderProgram *getCubeShadowBlurYShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent, const Q3DSGraphicsLimits &limits);
+
+    Qt3DRender::QShaderProgram *getSsaoTextureShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent);
+
+    Qt3DRender::QShaderProgram *getBsdfMipPreFilterShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent);
+
+    Qt3DRender::QShaderProgram *getProgAABlendShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent);
+
+    Qt3DRender::QShaderProgram *getBlendOverlayShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent, int msaaSampleCount);
+    Qt3DRender::QShaderProgram *getBlendColorBurnShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent, int msaaSampleCount);
+    Qt3DRender::QShaderProgram *getBlendColorDodgeShader(Q3DSShaderProgramCache *programs, Qt3DCore::QNode *parent, int msaaSampleCount);
+
+    Qt3DRender::QShaderProgram *getEffectShader(Q3DSShaderProgramCache *programs,
+                                                Qt3DCore::QNode *parent,
                                                 const QString &name,
                                                 const QString &vertexShaderSrc,
                                                 const QString &fragmentShaderSrc);
@@ -105,22 +205,17 @@ public:
 private:
     Q3DSShaderManager();
 
-    Q3DSDefaultMaterialShaderGenerator *m_materialShaderGenerator;
-    Q3DSCustomMaterialShaderGenerator *m_customMaterialShaderGenerator;
-    Q3DSAbstractShaderProgramGenerator *m_shaderProgramGenerator;
-    Qt3DRender::QShaderProgram *m_depthPrePassShader = nullptr;
-    Qt3DRender::QShaderProgram *m_orthoDepthShader = nullptr;
-    Qt3DRender::QShaderProgram *m_cubeDepthShader = nullptr;
-    Qt3DRender::QShaderProgram *m_orthoShadowBlurXShader = nullptr;
-    Qt3DRender::QShaderProgram *m_orthoShadowBlurYShader = nullptr;
-    Qt3DRender::QShaderProgram *m_cubeShadowBlurXShader = nullptr;
-    Qt3DRender::QShaderProgram *m_cubeShadowBlurYShader = nullptr;
-    Qt3DRender::QShaderProgram *m_ssaoTextureShader = nullptr;
-    Qt3DRender::QShaderProgram *m_bsdfMipPreFilterShader = nullptr;
-    Qt3DRender::QShaderProgram *m_progAABlendShader = nullptr;
-    QMap<int, Qt3DRender::QShaderProgram *> m_blendOverlayShader;
-    QMap<int, Qt3DRender::QShaderProgram *> m_blendColorBurnShader;
-    QMap<int, Qt3DRender::QShaderProgram *> m_blendColorDodgeShader;
+    Q3DSAbstractShaderProgramGenerator *programGenerator(Q3DSShaderProgramCache *programs);
+    QByteArray variantKey(const MaterialVariant &variant);
+    Q3DSShaderProgramSources generateSources(const MaterialVariant &variant);
+    bool hasPregeneratedSources() const;
+    bool pregeneratedSources(const QByteArray &key, Q3DSShaderProgramSources *sources) const;
+
+    mutable QMutex m_sourcesMutex;
+    QHash<QString, QDateTime> m_loadedBundles;
+    QHash<QByteArray, Q3DSShaderProgramSources> m_bundledSources;
+    // from pregenerateShaderPrograms(), keyed by variant key, cost is in bytes
+    QCache<QByteArray, Q3DSShaderProgramSources> m_generatedSources { 32 * 1024 * 1024 };
 };
 
 QT_END_NAMESPACE
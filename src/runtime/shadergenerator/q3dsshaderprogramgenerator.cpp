@@ -28,13 +28,17 @@
 ****************************************************************************/
 
 #include "q3dsshaderprogramgenerator_p.h"
+#include "q3dsshadermanager_p.h"
 #include "q3dsutils_p.h"
-#include "q3dsprofiler_p.h"
 #include "q3dsgraphicslimits_p.h"
 
 #include <QtCore/QFile>
 #include <QtCore/QTextStream>
 #include <QtCore/QCache>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QCryptographicHash>
 #include <QtCore/QDebug>
 
 QT_BEGIN_NAMESPACE
@@ -563,9 +567,66 @@ QStringList generateShaderLocationPrefixes(const QString &includeName, const QSt
     };
 }
 
+QString resolveShaderIncludes(const QString &shaderCode, const QString &shaderLibraryVersion);
+
+// The .glsllib files are read-only resources, so once an include has been
+// resolved (header stripped, nested includes expanded) the result can be
+// reused for every stage of every program generated afterwards.
+struct ShaderIncludeCache
+{
+    QMutex mutex;
+    QHash<QPair<QString, QString>, QString> resolved; // (name, library version) -> body
+};
+
+Q_GLOBAL_STATIC(ShaderIncludeCache, shaderIncludeCache)
+
+QString loadShaderInclude(const QString &includeName, const QString &shaderLibraryVersion)
+{
+    const QStringList fileNames = generateShaderLocationPrefixes(includeName, shaderLibraryVersion);
+    for (const QString &fileName : fileNames) {
+        QFile file(fileName);
+        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            // strip copyright header
+            QString content = QString::fromUtf8(file.readAll());
+            if (content.startsWith(CopyrightHeaderStart)) {
+                int clipPos = content.indexOf(CopyrightHeaderEnd) ;
+                if (clipPos >= 0)
+                    content.remove(0, clipPos + CopyrightHeaderEnd.count());
+            }
+            return QStringLiteral("\n// begin \"") + includeName + QStringLiteral("\"\n")
+                    + resolveShaderIncludes(content, shaderLibraryVersion)
+                    + QStringLiteral("\n// end \"" ) + includeName + QStringLiteral("\"\n");
+        }
+    }
+    qWarning() << QStringLiteral("Could not find any glsllib includes for: ") << fileNames;
+    return QString();
+}
+
+QString resolvedShaderInclude(const QString &includeName, const QString &shaderLibraryVersion)
+{
+    ShaderIncludeCache *cache = shaderIncludeCache();
+    const QPair<QString, QString> key(includeName, shaderLibraryVersion);
+    {
+        QMutexLocker lock(&cache->mutex);
+        auto it = cache->resolved.constFind(key);
+        if (it != cache->resolved.constEnd())
+            return *it;
+    }
+
+    // Load without holding the lock since this recurses for nested
+    // includes. Failures are cached too (as an empty body) so that the
+    // warning is not repeated for every program.
+    const QString body = loadShaderInclude(includeName, shaderLibraryVersion);
+
+    QMutexLocker lock(&cache->mutex);
+    cache->resolved.insert(key, body);
+    return body;
+}
+
 QString resolveShaderIncludes(const QString &shaderCode, const QString &shaderLibraryVersion)
 {
     QString output;
+    output.reserve(shaderCode.size());
     QTextStream inputStream(const_cast<QString*>(&shaderCode), QIODevice::ReadOnly);
     QString currentLine;
     while (inputStream.readLineInto(&currentLine)) {
@@ -573,28 +634,7 @@ QString resolveShaderIncludes(const QString &shaderCode, const QString &shaderLi
         auto trimmedLine = currentLine.trimmed();
         if (trimmedLine.startsWith(QStringLiteral("#include"))) {
             QString includeName = currentLine.split('"', QString::SkipEmptyParts).last();
-            QStringList fileNames = generateShaderLocationPrefixes(includeName, shaderLibraryVersion);
-            bool isResolved = false;
-            for (QString fileName : fileNames) {
-                QFile file(fileName);
-                if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                    // strip copyright header
-                    QString content = QString::fromUtf8(file.readAll());
-                    if (content.startsWith(CopyrightHeaderStart)) {
-                        int clipPos = content.indexOf(CopyrightHeaderEnd) ;
-                        if (clipPos >= 0)
-                            content.remove(0, clipPos + CopyrightHeaderEnd.count());
-                    }
-                    output.append(QStringLiteral("\n// begin \"") + includeName + QStringLiteral("\"\n"));
-                    output.append(resolveShaderIncludes(content, shaderLibraryVersion));
-                    output.append(QStringLiteral("\n// end \"" ) + includeName + QStringLiteral("\"\n"));
-                    isResolved = true;
-                    file.close();
-                    break;
-                }
-            }
-            if (!isResolved)
-                qWarning() << QStringLiteral("Could not find any glsllib includes for: ") << fileNames;
+            output.append(resolvedShaderInclude(includeName, shaderLibraryVersion));
             output.append(QLatin1String("\n"));
         } else {
             output.append(currentLine);
@@ -605,13 +645,21 @@ QString resolveShaderIncludes(const QString &shaderCode, const QString &shaderLi
 }
 
 
+// Final GLSL for every program generated so far, keyed by a hash of the
+// generated stage sources. This is plain data, independent of any Qt 3D aspect
+// engine, and therefore survives engine resets (e.g. when opening another
+// presentation) so that only the QShaderProgram nodes need to be recreated.
+struct GeneratedSourceCache
+{
+    QMutex mutex;
+    QCache<QByteArray, Q3DSShaderProgramSources> sources { 64 * 1024 * 1024 }; // cost is in bytes
+};
+
+Q_GLOBAL_STATIC(GeneratedSourceCache, generatedSourceCache)
+
 class ShaderProgramGenerator : public Q3DSAbstractShaderProgramGenerator
 {
 public:
-    ShaderProgramGenerator()
-        : m_cache(1000)
-    {
-    }
 
     void beginProgram(Q3DSShaderGeneratorStageFlags inEnabledStages) override
     {
@@ -663,58 +711,95 @@ public:
         if (m_shaderContextLibraryVersion.isEmpty())
             resolveShaderLibraryVersion();
 
-        QByteArray vertexShaderSource = resolveShaderIncludes(m_vs.m_finalBuilder, m_shaderContextLibraryVersion).toLocal8Bit();
-        QByteArray tcShaderSource = resolveShaderIncludes(m_tc.m_finalBuilder, m_shaderContextLibraryVersion).toLocal8Bit();
-        QByteArray teShaderSource = resolveShaderIncludes(m_te.m_finalBuilder, m_shaderContextLibraryVersion).toLocal8Bit();
-        QByteArray geometryShaderSource = resolveShaderIncludes(m_gs.m_finalBuilder, m_shaderContextLibraryVersion).toLocal8Bit();
-        QByteArray fragmentShaderSource = resolveShaderIncludes(m_fs.m_finalBuilder, m_shaderContextLibraryVersion).toLocal8Bit();
+        // The generated (unresolved) stage sources identify the program.
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(m_shaderContextLibraryVersion.toUtf8());
+        const StageGeneratorBase *stages[] = { &m_vs, &m_tc, &m_te, &m_gs, &m_fs };
+        for (const StageGeneratorBase *stage : stages) {
+            hash.addData("\0", 1);
+            hash.addData(reinterpret_cast<const char *>(stage->m_finalBuilder.constData()),
+                         stage->m_finalBuilder.size() * int(sizeof(QChar)));
+        }
+        const QByteArray cacheKey = hash.result();
 
-        // Debug
-        static bool debug = qEnvironmentVariableIntValue("Q3DS_DEBUG") != 0;
-        if (debug) {
-            static int counter = 0;
-            saveShaderFile(vertexShaderSource, QLatin1String("vertex") + QString::number(counter) + QLatin1String(".txt"));
-            if (!tcShaderSource.isEmpty())
-                saveShaderFile(tcShaderSource, QLatin1String("tc") + QString::number(counter) + QLatin1String(".txt"));
-            if (!teShaderSource.isEmpty())
-                saveShaderFile(teShaderSource, QLatin1String("te") + QString::number(counter) + QLatin1String(".txt"));
-            if (!geometryShaderSource.isEmpty())
-                saveShaderFile(geometryShaderSource, QLatin1String("geometry") + QString::number(counter) + QLatin1String(".txt"));
-            saveShaderFile(fragmentShaderSource, QLatin1String("fragment") + QString::number(counter) + QLatin1String(".txt"));
-            counter++;
+        if (m_sourcesOutput) {
+            *m_sourcesOutput = resolvedSources(cacheKey);
+            return nullptr;
         }
 
-        // ### very naive caching, but even this gives huge memory savings
-        // maybe replace with something else later on
-        const QByteArray cacheKey = vertexShaderSource + tcShaderSource + teShaderSource + geometryShaderSource + fragmentShaderSource;
-        if (m_cache.contains(cacheKey))
-            return m_cache[cacheKey];
+        if (m_programCache) {
+            if (Qt3DRender::QShaderProgram *shaderProgram = m_programCache->program(cacheKey))
+                return shaderProgram;
+        }
 
-        auto shaderProgram = new Qt3DRender::QShaderProgram();
-        shaderProgram->setVertexShaderCode(vertexShaderSource);
-        shaderProgram->setTessellationControlShaderCode(tcShaderSource);
-        shaderProgram->setTessellationEvaluationShaderCode(teShaderSource);
-        shaderProgram->setGeometryShaderCode(geometryShaderSource);
-        shaderProgram->setFragmentShaderCode(fragmentShaderSource);
+        return createProgram(cacheKey, resolvedSources(cacheKey), inShaderName);
+    }
 
-        m_cache.insert(cacheKey, shaderProgram);
+    Qt3DRender::QShaderProgram *programForSources(const QByteArray &key,
+                                                  const Q3DSShaderProgramSources &sources,
+                                                  const QString &inShaderName) override
+    {
+        if (m_programCache) {
+            if (Qt3DRender::QShaderProgram *shaderProgram = m_programCache->program(key))
+                return shaderProgram;
+        }
 
-        if (m_profiler)
-            m_profiler->trackNewObject(shaderProgram, Q3DSProfiler::ShaderProgramObject, "Shader program %s", qPrintable(inShaderName));
+        return createProgram(key, sources, inShaderName);
+    }
 
+private:
+    Qt3DRender::QShaderProgram *createProgram(const QByteArray &key,
+                                              const Q3DSShaderProgramSources &sources,
+                                              const QString &inShaderName)
+    {
+        if (m_programCache)
+            return m_programCache->createProgram(key, sources, inShaderName);
+
+        auto shaderProgram = new Qt3DRender::QShaderProgram();
+        shaderProgram->setVertexShaderCode(sources.vertex);
+        shaderProgram->setTessellationControlShaderCode(sources.tessControl);
+        shaderProgram->setTessellationEvaluationShaderCode(sources.tessEval);
+        shaderProgram->setGeometryShaderCode(sources.geometry);
+        shaderProgram->setFragmentShaderCode(sources.fragment);
         return shaderProgram;
     }
 
-    void invalidate() override
+    Q3DSShaderProgramSources resolvedSources(const QByteArray &cacheKey)
     {
-        // clear() would also delete the objects in the cache - that is not
-        // wanted since with Qt3D everything gets parented somewhere, and by
-        // this stage the shader programs may have been already deleted.
-        for (auto k : m_cache.keys())
-            m_cache.take(k);
+        GeneratedSourceCache *cache = generatedSourceCache();
+        {
+            QMutexLocker lock(&cache->mutex);
+            if (Q3DSShaderProgramSources *sources = cache->sources.object(cacheKey))
+                return *sources;
+        }
+
+        Q3DSShaderProgramSources sources;
+        sources.vertex = resolveShaderIncludes(m_vs.m_finalBuilder, m_shaderContextLibraryVersion).toLocal8Bit();
+        sources.tessControl = resolveShaderIncludes(m_tc.m_finalBuilder, m_shaderContextLibraryVersion).toLocal8Bit();
+        sources.tessEval = resolveShaderIncludes(m_te.m_finalBuilder, m_shaderContextLibraryVersion).toLocal8Bit();
+        sources.geometry = resolveShaderIncludes(m_gs.m_finalBuilder, m_shaderContextLibraryVersion).toLocal8Bit();
+        sources.fragment = resolveShaderIncludes(m_fs.m_finalBuilder, m_shaderContextLibraryVersion).toLocal8Bit();
+
+        // Debug
+        static bool debug = qEnvironmentVariableIntValue("Q3DS_DEBUG") != 0;
+        if (debug) {
+            static QAtomicInt nextCounter;
+            const int counter = nextCounter.fetchAndAddRelaxed(1);
+            saveShaderFile(sources.vertex, QLatin1String("vertex") + QString::number(counter) + QLatin1String(".txt"));
+            if (!sources.tessControl.isEmpty())
+                saveShaderFile(sources.tessControl, QLatin1String("tc") + QString::number(counter) + QLatin1String(".txt"));
+            if (!sources.tessEval.isEmpty())
+                saveShaderFile(sources.tessEval, QLatin1String("te") + QString::number(counter) + QLatin1String(".txt"));
+            if (!sources.geometry.isEmpty())
+                saveShaderFile(sources.geometry, QLatin1String("geometry") + QString::number(counter) + QLatin1String(".txt"));
+            saveShaderFile(sources.fragment, QLatin1String("fragment") + QString::number(counter) + QLatin1String(".txt"));
+        }
+
+        QMutexLocker lock(&cache->mutex);
+        cache->sources.insert(cacheKey, new Q3DSShaderProgramSources(sources), sources.size());
+        return sources;
     }
 
-private:
     void linkStages()
     {
         // link stages incming to outgoing variables
@@ -771,7 +856,6 @@ private:
 
     Q3DSShaderGeneratorStageFlags m_enabledStages;
 
-    QCache<QByteArray, Qt3DRender::QShaderProgram> m_cache;
     QString m_shaderContextLibraryVersion;
 };
 
@@ -46,7 +46,7 @@
 
 QT_BEGIN_NAMESPACE
 
-class Q3DSProfiler;
+class Q3DSShaderProgramCache;
 
 // So far the generator is only useful for graphics stages,
 // it doesn't seem useful for compute stages.
@@ -105,6 +105,26 @@ struct Q3DSShaderPreprocessorFeature
 
 typedef QVector<Q3DSShaderPreprocessorFeature> Q3DSShaderFeatureSet;
 
+// The final GLSL of a program, with all includes resolved.
+struct Q3DSShaderProgramSources
+{
+    QByteArray vertex;
+    QByteArray tessControl;
+    QByteArray tessEval;
+    QByteArray geometry;
+    QByteArray fragment;
+
+    int size() const
+    {
+        return vertex.size() + tessControl.size() + tessEval.size() + geometry.size() + fragment.size();
+    }
+    bool operator==(const Q3DSShaderProgramSources &other) const
+    {
+        return vertex == other.vertex && tessControl == other.tessControl && tessEval == other.tessEval
+                && geometry == other.geometry && fragment == other.fragment;
+    }
+};
+
 class Q3DSAbstractShaderProgramGenerator
 {
 public:
@@ -132,10 +152,19 @@ public:
         return compileGeneratedShader(inShaderName, Q3DSShaderFeatureSet(), separableProgram);
     }
 
-    virtual void invalidate() = 0;
+    // Returns the program for already generated sources (e.g. from a shader
+    // bundle), without running any of the generator stages.
+    virtual Qt3DRender::QShaderProgram *programForSources(const QByteArray &key,
+                                                          const Q3DSShaderProgramSources &sources,
+                                                          const QString &inShaderName) = 0;
 
     static Q3DSAbstractShaderProgramGenerator *createProgramGenerator();
-    void setProfiler(Q3DSProfiler *profiler) { m_profiler = profiler; }
+    // Where the compiled programs go. When null, every compile creates a new
+    // program owned by the caller.
+    void setProgramCache(Q3DSShaderProgramCache *programs) { m_programCache = programs; }
+    // When set, compiling only stores the final sources there and returns
+    // null. Used when generating on threads other than the engine's.
+    void setSourcesOutput(Q3DSShaderProgramSources *sources) { m_sourcesOutput = sources; }
 
 #if 0
     static void outputParaboloidDepthVertex(Q3DSAbstractShaderStageGenerator &vertexShader);
@@ -151,7 +180,8 @@ public:
 #endif
 
 protected:
-    Q3DSProfiler *m_profiler = nullptr;
+    Q3DSShaderProgramCache *m_programCache = nullptr;
+    Q3DSShaderProgramSources *m_sourcesOutput = nullptr;
 };
 
 QT_END_NAMESPACE
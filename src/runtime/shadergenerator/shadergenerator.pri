@@ -4,11 +4,13 @@ HEADERS += \
     $$PWD/q3dsdefaultvertexpipeline_p.h \
     $$PWD/q3dsshadergenerators_p.h \
     $$PWD/q3dsshadermanager_p.h \
-    $$PWD/q3dscustommaterialvertexpipeline_p.h
+    $$PWD/q3dscustommaterialvertexpipeline_p.h \
+    $$PWD/q3dsshaderbundle_p.h
 
 SOURCES += \
     $$PWD/q3dsshaderprogramgenerator.cpp \
     $$PWD/q3dsdefaultvertexpipeline.cpp \
     $$PWD/q3dsshadergenerators.cpp \
     $$PWD/q3dsshadermanager.cpp \
-    $$PWD/q3dscustommaterialvertexpipeline.cpp
+    $$PWD/q3dscustommaterialvertexpipeline.cpp \
+    $$PWD/q3dsshaderbundle.cpp
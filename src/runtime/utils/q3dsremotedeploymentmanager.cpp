@@ -58,6 +58,10 @@ Q3DSRemoteDeploymentManager::Q3DSRemoteDeploymentManager(Q3DSEngine *engine, int
             this, &Q3DSRemoteDeploymentManager::remoteProjectChanging);
     connect(m_server, &Q3DSRemoteDeploymentServer::projectChanged, [this] {
         m_isRemoteProjectLoaded = true;
+        // delta updates to the project on screen do not go through the
+        // connection scene
+        if (m_server->isDeltaDeployment() && m_state == RemoteProject)
+            m_isReadyToShow = true;
         loadRemoteProject();
     });
     connect(m_server, &Q3DSRemoteDeploymentServer::updateProgress,
@@ -146,6 +150,11 @@ void Q3DSRemoteDeploymentManager::remoteProjectChanging()
     if (m_state == RemoteLoading)
         return;
 
+    // Keep showing the current project while a delta is received, the
+    // engine reloads only what changed afterwards.
+    if (m_server->isDeltaDeployment() && m_state == RemoteProject)
+        return;
+
     if (m_state == LocalProject || m_state == RemoteProject)
         showConnectionSetup();
     setState(RemoteLoading);
@@ -186,7 +195,10 @@ void Q3DSRemoteDeploymentManager::loadFile(const QString &filename)
         return;
     }
 
-    m_engine->setSource(fileInfo.absoluteFilePath());
+    if (m_server->isDeltaDeployment() && m_engine->source() == fileInfo.absoluteFilePath())
+        m_engine->reload(m_server->changedFiles());
+    else
+        m_engine->setSource(fileInfo.absoluteFilePath());
 }
 
 void Q3DSRemoteDeploymentManager::setupConnectionScene()
@@ -37,6 +37,7 @@ Q3DSRemoteDeploymentServer::Q3DSRemoteDeploymentServer(int serverPort, QObject *
     : QObject(parent)
     , m_projectDeployed(false)
     , m_serverPort(serverPort)
+    , m_incomingFileHash(QCryptographicHash::Sha1)
 {
     m_incoming.setVersion(QDataStream::Qt_5_8);
 }
@@ -47,6 +48,11 @@ Q3DSRemoteDeploymentServer::~Q3DSRemoteDeploymentServer()
     delete m_temporaryDir;
 }
 
+QByteArray Q3DSRemoteDeploymentServer::fileHash(const QByteArray &contents)
+{
+    return QCryptographicHash::hash(contents, QCryptographicHash::Sha1);
+}
+
 void Q3DSRemoteDeploymentServer::setPort(int value)
 {
     m_serverPort = value;
@@ -118,13 +124,224 @@ void Q3DSRemoteDeploymentServer::acceptRemoteDisconnection()
     m_connection = nullptr;
 
     m_incoming.setDevice(nullptr);
+    abortFile();
 
     Q_EMIT(remoteDisconnected());
 }
 
 void Q3DSRemoteDeploymentServer::readProject()
+{
+    while (m_connection && m_connection->bytesAvailable() > 0) {
+        if (m_incomingFile) {
+            if (!readFileData()) {
+                disconnectRemote();
+                return;
+            }
+            continue;
+        }
+
+        m_incoming.startTransaction();
+        qint32 message = 0;
+        m_incoming >> message;
+
+        if (message >= 0) {
+            // the single payload protocol, message is the total size
+            m_incoming.rollbackTransaction();
+            readPayload();
+            return;
+        }
+
+        switch (message) {
+        case ManifestMessage:
+        {
+            QString projectFile;
+            Manifest manifest;
+            m_incoming >> projectFile >> manifest;
+            if (!m_incoming.commitTransaction())
+                return;
+            readManifest(projectFile, manifest);
+        }
+            break;
+        case FileMessage:
+        {
+            QString fileName;
+            qint64 size = 0;
+            m_incoming >> fileName >> size;
+            if (!m_incoming.commitTransaction())
+                return;
+            if (!beginFile(fileName, size)) {
+                disconnectRemote();
+                return;
+            }
+        }
+            break;
+        case CommitMessage:
+            if (!m_incoming.commitTransaction())
+                return;
+            m_projectDeployed = true;
+            Q_EMIT(projectChanged());
+            break;
+        default:
+            m_incoming.abortTransaction();
+            qWarning() << "Unknown remote deployment message" << message;
+            disconnectRemote();
+            return;
+        }
+    }
+}
+
+void Q3DSRemoteDeploymentServer::readManifest(const QString &projectFile, const Manifest &manifest)
 {
     m_projectDeployed = false;
+    m_deltaDeployment = true;
+    m_changedFiles.clear();
+
+    if (projectFile != m_projectName)
+        resetTemporaryDir();
+
+    if (!m_temporaryDir)
+        m_temporaryDir = new QTemporaryDir;
+
+    Q_ASSERT(m_temporaryDir->isValid());
+
+    m_projectName = projectFile;
+    m_projectFile = localFilePath(projectFile);
+
+    Q_EMIT(projectChanging());
+
+    // Files that are gone from the project.
+    for (auto it = m_fileHashes.begin(); it != m_fileHashes.end(); ) {
+        if (!manifest.contains(it.key())) {
+            const QString filePath = localFilePath(it.key());
+            QFile::remove(filePath);
+            m_changedFiles.append(filePath);
+            it = m_fileHashes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    QStringList neededFiles;
+    m_expectedBytes = 0;
+    m_receivedBytes = 0;
+    m_manifestHashes.clear();
+    for (auto it = manifest.cbegin(), itEnd = manifest.cend(); it != itEnd; ++it) {
+        const QString filePath = localFilePath(it.key());
+        if (filePath.isEmpty()) {
+            qWarning() << "Ignoring remote project file outside the project:" << it.key();
+            continue;
+        }
+        m_manifestHashes.insert(it.key(), it->first);
+        if (m_fileHashes.value(it.key()) != it->first || !QFile::exists(filePath)) {
+            neededFiles.append(it.key());
+            m_expectedBytes += it->second;
+        }
+    }
+
+    QDataStream reply(m_connection);
+    reply.setVersion(m_incoming.version());
+    reply << qint32(ManifestMessage) << neededFiles;
+}
+
+bool Q3DSRemoteDeploymentServer::beginFile(const QString &fileName, qint64 size)
+{
+    const QString filePath = localFilePath(fileName);
+    if (filePath.isEmpty() || size < 0 || !m_manifestHashes.contains(fileName)) {
+        qWarning() << "Invalid remote project file:" << fileName;
+        return false;
+    }
+
+    QDir dir = QFileInfo(filePath).absoluteDir();
+    if (!dir.exists())
+        dir.mkpath(QStringLiteral("."));
+
+    // Until the contents are complete the file is not known to be up to date.
+    m_fileHashes.remove(fileName);
+
+    m_incomingFile.reset(new QFile(filePath));
+    if (!m_incomingFile->open(QIODevice::WriteOnly)) {
+        qWarning() << "Error opening temporary file for remote project:" << filePath;
+        m_incomingFile.reset();
+        return false;
+    }
+
+    m_incomingFileName = fileName;
+    m_incomingFileRemaining = size;
+    m_incomingFileHash.reset();
+
+    if (size == 0)
+        return endFile();
+
+    return true;
+}
+
+bool Q3DSRemoteDeploymentServer::readFileData()
+{
+    const QByteArray data = m_connection->read(qMin(m_incomingFileRemaining, m_connection->bytesAvailable()));
+    m_incomingFile->write(data);
+    m_incomingFileHash.addData(data);
+    m_incomingFileRemaining -= data.size();
+
+    m_receivedBytes += data.size();
+    if (m_expectedBytes > 0)
+        emit updateProgress(int(100 * m_receivedBytes / m_expectedBytes));
+
+    return m_incomingFileRemaining > 0 || endFile();
+}
+
+// Returns false, after removing the file, when the contents do not match the
+// manifest.
+bool Q3DSRemoteDeploymentServer::endFile()
+{
+    m_incomingFile->close();
+    const QByteArray hash = m_incomingFileHash.result();
+    if (hash != m_manifestHashes.value(m_incomingFileName)) {
+        qWarning() << "Remote project file does not match the manifest:" << m_incomingFileName;
+        m_incomingFile->remove();
+        m_incomingFile.reset();
+        return false;
+    }
+    m_fileHashes.insert(m_incomingFileName, hash);
+    m_changedFiles.append(QFileInfo(*m_incomingFile).absoluteFilePath());
+    m_incomingFile.reset();
+    return true;
+}
+
+void Q3DSRemoteDeploymentServer::abortFile()
+{
+    // the partial file stays, it is not in m_fileHashes so it will be asked
+    // for again
+    m_incomingFile.reset();
+    m_incomingFileRemaining = 0;
+}
+
+// Returns an empty string for names pointing outside the project.
+QString Q3DSRemoteDeploymentServer::localFilePath(const QString &fileName) const
+{
+    if (!m_temporaryDir)
+        return QString();
+
+    const QString cleanName = QDir::cleanPath(fileName);
+    if (cleanName.isEmpty() || QDir::isAbsolutePath(cleanName)
+            || cleanName == QLatin1String("..") || cleanName.startsWith(QLatin1String("../")))
+    {
+        return QString();
+    }
+
+    return m_temporaryDir->path() + QLatin1Char('/') + cleanName;
+}
+
+void Q3DSRemoteDeploymentServer::resetTemporaryDir()
+{
+    delete m_temporaryDir;
+    m_temporaryDir = nullptr;
+    m_fileHashes.clear();
+}
+
+void Q3DSRemoteDeploymentServer::readPayload()
+{
+    m_projectDeployed = false;
+    m_deltaDeployment = false;
     Q_EMIT(projectChanging());
 
     m_incoming.startTransaction();
@@ -161,25 +378,36 @@ void Q3DSRemoteDeploymentServer::readProject()
     }
 
     QFileInfo currentProject(m_projectFile);
-    if (projectFile != currentProject.fileName()) {
-        delete m_temporaryDir;
-        m_temporaryDir = nullptr;
-    }
+    if (projectFile != currentProject.fileName())
+        resetTemporaryDir();
 
     if (!m_temporaryDir)
         m_temporaryDir = new QTemporaryDir;
 
     Q_ASSERT(m_temporaryDir->isValid());
 
+    // same rules as for the delta protocol, and nothing gets written when
+    // any of the names is bad
+    for (const auto &file : qAsConst(files)) {
+        if (localFilePath(file.first).isEmpty()) {
+            resetTemporaryDir();
+            qWarning() << "Rejecting remote project with a file outside the project:" << file.first;
+            return;
+        }
+    }
+
+    m_projectName = projectFile;
+    m_changedFiles.clear();
+    m_manifestHashes.clear();
+
     for (const auto &file : qAsConst(files)) {
-        QString filePath = m_temporaryDir->path() + QDir::separator() + file.first;
+        const QString filePath = localFilePath(file.first);
         QFile tmpFile(filePath);
         QDir tmpFileDir = QFileInfo(tmpFile).absoluteDir();
         if (!tmpFileDir.exists())
             tmpFileDir.mkpath(QStringLiteral("."));
         if (!tmpFile.open(QIODevice::WriteOnly)) {
-            delete m_temporaryDir;
-            m_temporaryDir = 0;
+            resetTemporaryDir();
             qWarning() << "Error opening temporary file for remote project:"
                        << filePath;
             return;
@@ -190,6 +418,10 @@ void Q3DSRemoteDeploymentServer::readProject()
 
         tmpFile.write(file.second);
         tmpFile.close();
+
+        // remembered so that a later delta deployment can skip the file
+        m_fileHashes.insert(file.first, fileHash(file.second));
+        m_changedFiles.append(QFileInfo(filePath).absoluteFilePath());
     }
 
     m_projectDeployed = true;
@@ -46,16 +46,47 @@
 #include <QtCore/QObject>
 #include <QtCore/QDataStream>
 #include <QtCore/QTemporaryDir>
+#include <QtCore/QHash>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QStringList>
 #include <QtNetwork/QTcpServer>
 
 QT_BEGIN_NAMESPACE
 
 class Q3DSEngine;
+class QFile;
 
+// Besides the original protocol, where a sender transfers the whole project
+// in one payload (int totalBytes, int numberOfFiles, QString projectFile,
+// followed by QString fileName, QByteArray contents pairs), the server
+// understands a delta protocol. Its messages start with a negative qint32 so
+// that they cannot be mistaken for a payload size:
+//
+// ManifestMessage, QString projectFile, Manifest manifest
+//     The complete list of project files with the SHA-1 of their contents and
+//     their size. Files not listed are removed. The server replies with
+//     ManifestMessage, QStringList neededFiles.
+// FileMessage, QString fileName, qint64 size
+//     Followed by size bytes of raw file contents, which are streamed to disk
+//     as they arrive. A file not in the manifest, or not matching its hash
+//     there, is removed and the connection dropped.
+// CommitMessage
+//     All needed files were sent, the project can be (re)loaded.
 class Q3DSV_PRIVATE_EXPORT Q3DSRemoteDeploymentServer : public QObject
 {
     Q_OBJECT
 public:
+    enum Message {
+        ManifestMessage = -1,
+        FileMessage = -2,
+        CommitMessage = -3
+    };
+
+    // file name relative to the project root - (SHA-1 of contents, size)
+    typedef QHash<QString, QPair<QByteArray, qint64> > Manifest;
+
+    static QByteArray fileHash(const QByteArray &contents);
     explicit Q3DSRemoteDeploymentServer(int serverPort, QObject *parent = nullptr);
     ~Q3DSRemoteDeploymentServer();
 
@@ -68,6 +99,10 @@ public:
     bool isConnected() const { return m_connection; }
     bool isProjectDeployed() const { return m_connection && m_projectDeployed; }
     QString fileName() const { return m_projectFile; }
+    // true when the last deployment used the delta protocol
+    bool isDeltaDeployment() const { return m_deltaDeployment; }
+    // absolute paths of the files written or removed by the last deployment
+    QStringList changedFiles() const { return m_changedFiles; }
 
 Q_SIGNALS:
     void projectChanged();
@@ -83,6 +118,15 @@ private Q_SLOTS:
     void setPort(int value);
 
 private:
+    void readPayload();
+    void readManifest(const QString &projectFile, const Manifest &manifest);
+    bool beginFile(const QString &fileName, qint64 size);
+    bool readFileData();
+    bool endFile();
+    void abortFile();
+    QString localFilePath(const QString &fileName) const;
+    void resetTemporaryDir();
+
     Q3DSEngine *m_engine = nullptr;
     QTcpServer *m_tcpServer = nullptr;
     QTcpSocket *m_connection = nullptr;
@@ -92,6 +136,17 @@ private:
     QString m_projectFile;
     bool m_projectDeployed;
     int m_serverPort;
+    bool m_deltaDeployment = false;
+    QString m_projectName; // as sent by the remote, relative to the project root
+    QHash<QString, QByteArray> m_fileHashes; // of the files in m_temporaryDir
+    QHash<QString, QByteArray> m_manifestHashes; // what the files of the last manifest must hash to
+    QStringList m_changedFiles;
+    QScopedPointer<QFile> m_incomingFile;
+    QString m_incomingFileName;
+    qint64 m_incomingFileRemaining = 0;
+    QCryptographicHash m_incomingFileHash;
+    qint64 m_expectedBytes = 0;
+    qint64 m_receivedBytes = 0;
 };
 
 QT_END_NAMESPACE
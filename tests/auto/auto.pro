@@ -4,6 +4,9 @@ SUBDIRS += \
     uipparser \
     uiaparser \
     meshloader \
+    texturepool \
+    imagemanager \
+    qualitygovernor \
     materialparser \
     effectparser \
     uippresentation \
@@ -12,7 +15,13 @@ SUBDIRS += \
     documents \
     slides \
     slideplayer \
+    idlerendering \
+    subpresentations \
+    reload \
+    remotedeployment \
     surfaceviewer \
+    shaderbundle \
+    shadermanager \
     q3dslancelot
 
 qtHaveModule(quick): SUBDIRS += studio3d
@@ -49,6 +49,9 @@ private Q_SLOTS:
     void behaviorUnload();
     void behaviorReload();
     void events();
+    void propertyUpdates();
+    void updatePropertiesCost_data();
+    void updatePropertiesCost();
 
 private:
     Q3DSEngine *m_engine = nullptr;
@@ -202,6 +205,107 @@ void tst_Q3DSBehaviors::events()
     QCOMPARE(h.object->property("eventCount").toInt(), 2); // must not have changed
 }
 
+// custom property values are pushed to the QML object only when they change
+void tst_Q3DSBehaviors::propertyUpdates()
+{
+    auto bi = m_presentation->objectByName<Q3DSBehaviorInstance>(QLatin1String("Behavior instance 1"));
+    QVERIFY(bi);
+    QVERIFY(m_engine->behaviorHandles().contains(bi));
+    Q3DSBehaviorHandle h = m_engine->behaviorHandles().value(bi);
+    QVERIFY(h.object);
+
+    QSignalSpy targetSpy(h.object, SIGNAL(targetChanged()));
+    QSignalSpy startSpy(h.object, SIGNAL(startImmediatelyChanged()));
+    QSignalSpy frameSpy(m_engine, SIGNAL(nextFrameStarting()));
+    QTRY_VERIFY(frameSpy.count() >= 5);
+    QCOMPARE(targetSpy.count(), 0);
+    QCOMPARE(startSpy.count(), 0);
+
+    bi->applyDynamicProperties({ { QLatin1String("target"), QStringLiteral("Scene.Layer.Sphere") } });
+    QTRY_COMPARE(h.object->property("target").toString(), QStringLiteral("Scene.Layer.Sphere"));
+    frameSpy.clear();
+    QTRY_VERIFY(frameSpy.count() >= 5);
+    QCOMPARE(targetSpy.count(), 1);
+    QCOMPARE(startSpy.count(), 0);
+
+    bi->applyDynamicProperties({ { QLatin1String("target"), QStringLiteral("Scene.Layer.Camera") } });
+    QTRY_COMPARE(h.object->property("target").toString(), QStringLiteral("Scene.Layer.Camera"));
+    QCOMPARE(targetSpy.count(), 2);
+    QCOMPARE(startSpy.count(), 0);
+
+    // A value the behavior writes to its own property is replaced by the
+    // instance's value on the next frame. After that nothing is written.
+    h.object->setProperty("startImmediately", false);
+    QCOMPARE(startSpy.count(), 1);
+    QTRY_COMPARE(h.object->property("startImmediately").toBool(), true);
+    QCOMPARE(startSpy.count(), 2);
+    frameSpy.clear();
+    QTRY_VERIFY(frameSpy.count() >= 5);
+    QCOMPARE(startSpy.count(), 2);
+
+    // also when the instance is reset to the value it had already
+    h.object->setProperty("startImmediately", false);
+    bi->applyDynamicProperties({ { QLatin1String("startImmediately"), true } });
+    QTRY_COMPARE(h.object->property("startImmediately").toBool(), true);
+    QCOMPARE(startSpy.count(), 4);
+
+    bi->applyDynamicProperties({ { QLatin1String("startImmediately"), false } });
+    QTRY_COMPARE(h.object->property("startImmediately").toBool(), false);
+    QCOMPARE(startSpy.count(), 5);
+    frameSpy.clear();
+    QTRY_VERIFY(frameSpy.count() >= 5);
+    QCOMPARE(startSpy.count(), 5);
+    QCOMPARE(targetSpy.count(), 2);
+
+    bi->applyDynamicProperties({ { QLatin1String("startImmediately"), true } });
+    QTRY_COMPARE(h.object->property("startImmediately").toBool(), true);
+    QCOMPARE(startSpy.count(), 6);
+}
+
+void tst_Q3DSBehaviors::updatePropertiesCost_data()
+{
+    QTest::addColumn<int>("behaviorCount");
+    QTest::addColumn<bool>("changing");
+
+    QTest::newRow("10 idle") << 10 << false;
+    QTest::newRow("100 idle") << 100 << false;
+    QTest::newRow("10 changing") << 10 << true;
+    QTest::newRow("100 changing") << 100 << true;
+}
+
+// what behaviorFrameUpdate() spends on properties per frame for a number of
+// behaviors, either all idle or all having a property changed every frame
+void tst_Q3DSBehaviors::updatePropertiesCost()
+{
+    if (!qEnvironmentVariableIsSet("Q3DS_BENCHMARK"))
+        QSKIP("Set Q3DS_BENCHMARK to run benchmarks");
+
+    QFETCH(int, behaviorCount);
+    QFETCH(bool, changing);
+
+    auto bi = m_presentation->objectByName<Q3DSBehaviorInstance>(QLatin1String("Behavior instance 1"));
+    QVERIFY(bi);
+    QVERIFY(m_engine->behaviorHandles().contains(bi));
+
+    // Copies of the same handle each track their own pushed state and so
+    // behave like separate behaviors.
+    QVector<Q3DSBehaviorHandle> handles(behaviorCount, m_engine->behaviorHandles().value(bi));
+    for (Q3DSBehaviorHandle &h : handles)
+        h.updateProperties();
+
+    bool start = true;
+    QBENCHMARK {
+        if (changing) {
+            start = !start;
+            bi->applyDynamicProperties({ { QLatin1String("startImmediately"), start } });
+        }
+        for (Q3DSBehaviorHandle &h : handles)
+            h.updateProperties();
+    }
+
+    bi->applyDynamicProperties({ { QLatin1String("startImmediately"), true } });
+}
+
 QTEST_MAIN(tst_Q3DSBehaviors);
 
 #include "tst_q3dsbehaviors.moc"
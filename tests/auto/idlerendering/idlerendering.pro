@@ -0,0 +1,8 @@
+TARGET = tst_q3dsidlerendering
+CONFIG += testcase
+
+QT += testlib 3drender 3dstudioruntime2-private
+
+SOURCES += tst_q3dsidlerendering.cpp
+
+RESOURCES += idlerendering.qrc
@@ -0,0 +1,204 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtTest>
+
+#include <private/q3dsutils_p.h>
+#include <private/q3dswindow_p.h>
+#include <private/q3dsengine_p.h>
+#include <private/q3dsscenemanager_p.h>
+#include <private/q3dsslideplayer_p.h>
+
+#include <Qt3DCore/QEntity>
+#include <Qt3DRender/QRenderSettings>
+
+#include "../shared/shared.h"
+
+class tst_Q3DSIdleRendering : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~tst_Q3DSIdleRendering();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void suspendAndResume();
+    void playingSlideIsNotIdle();
+    void autoIdleDisabled();
+    void qualityGovernor();
+
+private:
+    Qt3DRender::QRenderSettings::RenderPolicy renderPolicy() const;
+
+    Q3DSEngine *m_engine = nullptr;
+    Q3DSWindow *m_view = nullptr;
+};
+
+tst_Q3DSIdleRendering::~tst_Q3DSIdleRendering()
+{
+    delete m_engine;
+    delete m_view;
+}
+
+void tst_Q3DSIdleRendering::initTestCase()
+{
+    if (!isOpenGLGoodEnough())
+        QSKIP("This platform does not support OpenGL proper");
+
+    QSurfaceFormat::setDefaultFormat(Q3DS::surfaceFormat());
+    m_engine = new Q3DSEngine;
+    m_view = new Q3DSWindow;
+    m_view->setEngine(m_engine);
+    m_view->forceResize(640, 480);
+
+    Q3DSUtils::setDialogsEnabled(false);
+    QVERIFY(m_engine->setSource(QLatin1String(":/primitives.uip")));
+    QVERIFY(m_engine->sceneManager());
+    QVERIFY(m_engine->sceneManager()->slidePlayer());
+
+    // The slide would otherwise play for its default 10 seconds.
+    m_engine->sceneManager()->slidePlayer()->stop();
+    m_engine->setAutoIdleRendering(true);
+
+    m_view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(m_view));
+}
+
+void tst_Q3DSIdleRendering::cleanupTestCase()
+{
+    if (m_view)
+        m_view->close();
+}
+
+Qt3DRender::QRenderSettings::RenderPolicy tst_Q3DSIdleRendering::renderPolicy() const
+{
+    const auto settings = m_engine->rootEntity()->componentsOfType<Qt3DRender::QRenderSettings>();
+    return settings.isEmpty() ? Qt3DRender::QRenderSettings::Always : settings.first()->renderPolicy();
+}
+
+void tst_Q3DSIdleRendering::suspendAndResume()
+{
+    QSignalSpy idleSpy(m_engine, &Q3DSEngine::idleChanged);
+
+    QTRY_VERIFY(m_engine->isIdle());
+    QCOMPARE(renderPolicy(), Qt3DRender::QRenderSettings::OnDemand);
+    QVERIFY(idleSpy.count() >= 1);
+    QCOMPARE(idleSpy.last().first().toBool(), true);
+
+    // Input resumes immediately, without waiting for the next frame.
+    idleSpy.clear();
+    QMouseEvent ev(QEvent::MouseMove, QPointF(10, 10), Qt::NoButton, Qt::NoButton, Qt::NoModifier);
+    m_engine->handleMouseMoveEvent(&ev);
+    QVERIFY(!m_engine->isIdle());
+    QCOMPARE(renderPolicy(), Qt3DRender::QRenderSettings::Always);
+    QCOMPARE(idleSpy.count(), 1);
+    QCOMPARE(idleSpy.first().first().toBool(), false);
+
+    // Nothing changed in the scene so it goes back to idle.
+    QTRY_VERIFY(m_engine->isIdle());
+    QCOMPARE(renderPolicy(), Qt3DRender::QRenderSettings::OnDemand);
+    QCOMPARE(idleSpy.count(), 2);
+}
+
+void tst_Q3DSIdleRendering::playingSlideIsNotIdle()
+{
+    Q3DSSlidePlayer *player = m_engine->sceneManager()->slidePlayer();
+    QTRY_VERIFY(m_engine->isIdle());
+
+    player->play();
+    QTRY_VERIFY(!m_engine->isIdle());
+    QCOMPARE(renderPolicy(), Qt3DRender::QRenderSettings::Always);
+
+    // stays active while playing
+    QTest::qWait(200);
+    QVERIFY(!m_engine->isIdle());
+
+    player->stop();
+    QTRY_VERIFY(m_engine->isIdle());
+    QCOMPARE(renderPolicy(), Qt3DRender::QRenderSettings::OnDemand);
+}
+
+void tst_Q3DSIdleRendering::autoIdleDisabled()
+{
+    QTRY_VERIFY(m_engine->isIdle());
+
+    // The state is still tracked but the render policy is left alone.
+    m_engine->setAutoIdleRendering(false);
+    QCOMPARE(renderPolicy(), Qt3DRender::QRenderSettings::Always);
+    QVERIFY(m_engine->isIdle());
+
+    m_engine->setOnDemandRendering(true);
+    QCOMPARE(renderPolicy(), Qt3DRender::QRenderSettings::OnDemand);
+    m_engine->setOnDemandRendering(false);
+    QCOMPARE(renderPolicy(), Qt3DRender::QRenderSettings::Always);
+
+    m_engine->setAutoIdleRendering(true);
+    QCOMPARE(renderPolicy(), Qt3DRender::QRenderSettings::OnDemand);
+}
+
+void tst_Q3DSIdleRendering::qualityGovernor()
+{
+    // The governor averages windows of 30 frames and lowers the level after
+    // two consecutive windows over budget.
+    static const int WINDOW = 30;
+
+    QTRY_VERIFY(m_engine->isIdle());
+    QSignalSpy levelSpy(m_engine, &Q3DSEngine::qualityLevelChanged);
+    m_engine->setTargetFrameTime(16.0f);
+    m_engine->setQualityGovernorEnabled(true);
+
+    for (int i = 0; i < WINDOW * 2; ++i)
+        m_engine->injectFrameTime(50.0f);
+    QCOMPARE(levelSpy.count(), 1);
+    QCOMPARE(levelSpy.first().first().toInt(), 1);
+    QCOMPARE(m_engine->qualityLevel(), 1);
+
+    // Leaving the idle state throws away what was collected before, so one
+    // and a half windows on each side of it are not enough to go lower.
+    for (int i = 0; i < WINDOW * 3 / 2; ++i)
+        m_engine->injectFrameTime(50.0f);
+    QMouseEvent ev(QEvent::MouseMove, QPointF(10, 10), Qt::NoButton, Qt::NoButton, Qt::NoModifier);
+    m_engine->handleMouseMoveEvent(&ev);
+    QVERIFY(!m_engine->isIdle());
+    for (int i = 0; i < WINDOW * 3 / 2; ++i)
+        m_engine->injectFrameTime(50.0f);
+    QCOMPARE(levelSpy.count(), 1);
+    QCOMPARE(m_engine->qualityLevel(), 1);
+
+    m_engine->setQualityGovernorEnabled(false);
+    QCOMPARE(levelSpy.count(), 2);
+    QCOMPARE(m_engine->qualityLevel(), 0);
+}
+
+QTEST_MAIN(tst_Q3DSIdleRendering)
+
+#include "tst_q3dsidlerendering.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_q3dsimagemanager
+CONFIG += testcase
+
+QT += testlib 3drender 3dstudioruntime2-private
+
+SOURCES += tst_q3dsimagemanager.cpp
@@ -0,0 +1,582 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QImage>
+#include <QTemporaryDir>
+#include <QBuffer>
+#include <Qt3DCore/QEntity>
+#include <private/q3dsimagemanager_p.h>
+#include <private/q3dsimageloaders_p.h>
+#include <limits>
+
+class tst_Q3DSImageManager : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void newImageSurvivesEviction();
+    void defaultCacheLimit();
+    void textureMemoryBudget();
+    void textureMemoryBudgetDownscales();
+    void textureMemoryBudgetSkipsMipLevels();
+    void invalidateKeepsDataWithinLimit();
+    void reloadModifiedImages();
+    void releaseTexturesOfOneEngine();
+    void floatToHalf_data();
+    void floatToHalf();
+    void floatToHalfArray();
+    void floatToRgb9e5();
+    void hdrStorageFormatPerImage();
+    void hdrHalfFloatSaturates();
+
+private:
+    QUrl writeImage(const QString &name, const QSize &size, const QColor &color);
+    static QByteArray hdrData();
+    QUrl writeKtx(const QString &name, int size, QVector<int> *levelBytes);
+
+    QTemporaryDir m_dir;
+    qint64 m_defaultCacheLimit = 0;
+    Q3DSImageManager::HdrStorageFormat m_defaultHdrFormat = Q3DSImageManager::HdrStorageFloat32;
+};
+
+void tst_Q3DSImageManager::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    m_defaultCacheLimit = Q3DSImageManager::instance().imageCacheLimit();
+    m_defaultHdrFormat = Q3DSImageManager::instance().hdrStorageFormat();
+}
+
+void tst_Q3DSImageManager::init()
+{
+    Q3DSImageManager::instance().invalidate();
+}
+
+void tst_Q3DSImageManager::cleanup()
+{
+    Q3DSImageManager &mgr(Q3DSImageManager::instance());
+    mgr.setImageCacheLimit(m_defaultCacheLimit);
+    mgr.setTextureMemoryBudget(-1);
+    mgr.setHdrStorageFormat(m_defaultHdrFormat);
+    mgr.invalidate();
+}
+
+QUrl tst_Q3DSImageManager::writeImage(const QString &name, const QSize &size, const QColor &color)
+{
+    QImage img(size, QImage::Format_ARGB32);
+    img.fill(color);
+    const QString fn = m_dir.filePath(name);
+    if (!img.save(fn))
+        return QUrl();
+    return QUrl::fromLocalFile(fn);
+}
+
+// ETC2 RGB8 with the full mip chain, 8 bytes per 4x4 block
+QUrl tst_Q3DSImageManager::writeKtx(const QString &name, int size, QVector<int> *levelBytes)
+{
+    int levels = 1;
+    while ((size >> levels) > 0)
+        ++levels;
+
+    const char identifier[] = { '\xAB', 'K', 'T', 'X', ' ', '1', '1', '\xBB', '\r', '\n', '\x1A', '\n' };
+    const quint32 header[] = {
+        0x04030201, // endianness
+        0, 1, 0, // glType, glTypeSize, glFormat: compressed
+        0x9274, 0x1907, // GL_COMPRESSED_RGB8_ETC2, GL_RGB
+        quint32(size), quint32(size), 0, // width, height, depth
+        0, 1, quint32(levels), // array elements, faces, mip levels
+        0 // key-value data
+    };
+    QByteArray data(identifier, sizeof(identifier));
+    data.append(reinterpret_cast<const char *>(header), sizeof(header));
+    levelBytes->clear();
+    for (int level = 0; level < levels; ++level) {
+        const int blocks = qMax(1, ((size >> level) + 3) / 4);
+        const quint32 bytes = blocks * blocks * 8;
+        data.append(reinterpret_cast<const char *>(&bytes), 4);
+        data.append(QByteArray(int(bytes), char(0x55)));
+        levelBytes->append(int(bytes));
+    }
+
+    const QString fn = m_dir.filePath(name);
+    QFile f(fn);
+    if (!f.open(QIODevice::WriteOnly) || f.write(data) != data.size())
+        return QUrl();
+    return QUrl::fromLocalFile(fn);
+}
+
+// 2x1 RGBE image in the new RLE encoding: 1.0 grey and a red way beyond the
+// half float range (255 / 256 * 2^20).
+QByteArray tst_Q3DSImageManager::hdrData()
+{
+    QByteArray data("#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y 1 +X 2\n");
+    const char scanline[] = { 2, 2, 0, 2,
+                              2, char(128), char(255), // r
+                              2, char(128), 0, // g
+                              2, char(128), 0, // b
+                              2, char(129), char(148) }; // e
+    data.append(scanline, sizeof(scanline));
+    return data;
+}
+
+void tst_Q3DSImageManager::newImageSurvivesEviction()
+{
+    const QUrl a = writeImage(QLatin1String("evict_a.png"), QSize(64, 64), Qt::red);
+    const QUrl b = writeImage(QLatin1String("evict_b.png"), QSize(64, 64), Qt::green);
+    QVERIFY(!a.isEmpty() && !b.isEmpty());
+
+    Q3DSImageManager &mgr(Q3DSImageManager::instance());
+    // anything beyond the first image exceeds the limit
+    mgr.setImageCacheLimit(1);
+
+    Qt3DCore::QEntity root;
+    Qt3DRender::QAbstractTexture *texA = mgr.newTextureForImage(&root, {});
+    mgr.setSource(texA, a);
+    QVERIFY(!mgr.wasCached(texA));
+    QCOMPARE(mgr.imageCacheEntryCount(), 1);
+
+    // the referenced entries alone are over the limit already, yet the data
+    // just decoded for texB must not be thrown away
+    Qt3DRender::QAbstractTexture *texB = mgr.newTextureForImage(&root, {});
+    mgr.setSource(texB, b);
+    QVERIFY(!mgr.wasCached(texB));
+    QCOMPARE(mgr.imageCacheEntryCount(), 2);
+
+    Qt3DRender::QAbstractTexture *texB2 = mgr.newTextureForImage(&root, {});
+    mgr.setSource(texB2, b);
+    QVERIFY(mgr.wasCached(texB2));
+    QCOMPARE(mgr.imageCacheMisses(), 2);
+    QCOMPARE(mgr.imageCacheHits(), 1);
+
+    // once unused, both go
+    delete texA;
+    delete texB;
+    delete texB2;
+    QCOMPARE(mgr.imageCacheEntryCount(), 0);
+    QCOMPARE(mgr.imageCacheBytes(), 0);
+}
+
+void tst_Q3DSImageManager::defaultCacheLimit()
+{
+    if (qEnvironmentVariableIsSet("Q3DS_IMAGE_CACHE_LIMIT_MB"))
+        QSKIP("Q3DS_IMAGE_CACHE_LIMIT_MB overrides the default");
+
+    // the data outlives the engines, so there must be a limit by default
+    QCOMPARE(m_defaultCacheLimit, qint64(256) * 1024 * 1024);
+}
+
+void tst_Q3DSImageManager::textureMemoryBudget()
+{
+    Q3DSImageManager &mgr(Q3DSImageManager::instance());
+    const qint64 defaultBudget = qint64(qEnvironmentVariableIntValue("Q3DS_TEXTURE_BUDGET_MB")) * 1024 * 1024;
+    QCOMPARE(mgr.textureMemoryBudget(), defaultBudget);
+
+    mgr.setTextureMemoryBudget(1024 * 1024);
+    QCOMPARE(mgr.textureMemoryBudget(), qint64(1024 * 1024));
+
+    // 0 turns the budget off, even when the environment provides one
+    mgr.setTextureMemoryBudget(0);
+    QCOMPARE(mgr.textureMemoryBudget(), qint64(0));
+    const QUrl a = writeImage(QLatin1String("budget_a.png"), QSize(256, 256), Qt::red);
+    QVERIFY(!a.isEmpty());
+    Qt3DCore::QEntity root;
+    Qt3DRender::QAbstractTexture *tex = mgr.newTextureForImage(&root, {});
+    mgr.setSource(tex, a);
+    QCOMPARE(mgr.size(tex), QSize(256, 256));
+
+    mgr.setTextureMemoryBudget(-1);
+    QCOMPARE(mgr.textureMemoryBudget(), defaultBudget);
+}
+
+void tst_Q3DSImageManager::textureMemoryBudgetDownscales()
+{
+    // 256 KB each when uploaded in full
+    const QUrl a = writeImage(QLatin1String("downscale_a.png"), QSize(256, 256), Qt::red);
+    const QUrl b = writeImage(QLatin1String("downscale_b.png"), QSize(256, 256), Qt::green);
+    const QUrl c = writeImage(QLatin1String("downscale_c.png"), QSize(256, 256), Qt::blue);
+    QVERIFY(!a.isEmpty() && !b.isEmpty() && !c.isEmpty());
+
+    Q3DSImageManager &mgr(Q3DSImageManager::instance());
+    mgr.setTextureMemoryBudget(100 * 1024);
+    Qt3DCore::QEntity root;
+
+    // one level down is 64 KB, fits
+    Qt3DRender::QAbstractTexture *texA = mgr.newTextureForImage(&root, {});
+    mgr.setSource(texA, a);
+    QCOMPARE(mgr.skippedMipLevels(texA), 1);
+    QCOMPARE(mgr.size(texA), QSize(128, 128));
+    QCOMPARE(mgr.residentBytes(texA), qint64(128 * 128 * 4));
+    QCOMPARE(mgr.residentTextureBytes(), qint64(128 * 128 * 4));
+
+    // 36 KB left, needs 16 KB at 64x64
+    Qt3DRender::QAbstractTexture *texB = mgr.newTextureForImage(&root, {});
+    mgr.setSource(texB, b);
+    QCOMPARE(mgr.skippedMipLevels(texB), 2);
+    QCOMPARE(mgr.size(texB), QSize(64, 64));
+    QCOMPARE(mgr.residentTextureBytes(), qint64(128 * 128 * 4 + 64 * 64 * 4));
+
+    // 20 KB left, still fits at 64x64
+    Qt3DRender::QAbstractTexture *texC = mgr.newTextureForImage(&root, {});
+    mgr.setSource(texC, c);
+    QCOMPARE(mgr.size(texC), QSize(64, 64));
+    QCOMPARE(mgr.residentTextureBytes(), qint64(128 * 128 * 4 + 2 * 64 * 64 * 4));
+
+    // nothing left, but textures do not go below 64x64, so this one goes
+    // over the budget
+    Qt3DRender::QAbstractTexture *texA2 = mgr.newTextureForImage(&root, {});
+    mgr.setSource(texA2, a);
+    QCOMPARE(mgr.size(texA2), QSize(64, 64));
+    QCOMPARE(mgr.residentTextureBytes(), qint64(128 * 128 * 4 + 3 * 64 * 64 * 4));
+    QVERIFY(mgr.residentTextureBytes() > mgr.textureMemoryBudget());
+
+    // the cache keeps the full data, a texture without a budget gets all of it
+    mgr.setTextureMemoryBudget(0);
+    Qt3DRender::QAbstractTexture *texFull = mgr.newTextureForImage(&root, {});
+    mgr.setSource(texFull, a);
+    QVERIFY(mgr.wasCached(texFull));
+    QCOMPARE(mgr.skippedMipLevels(texFull), 0);
+    QCOMPARE(mgr.size(texFull), QSize(256, 256));
+
+    delete texFull;
+    delete texA2;
+    delete texC;
+    delete texB;
+    delete texA;
+    QCOMPARE(mgr.residentTextureBytes(), qint64(0));
+}
+
+void tst_Q3DSImageManager::textureMemoryBudgetSkipsMipLevels()
+{
+    QVector<int> levelBytes;
+    const QUrl url = writeKtx(QLatin1String("mips.ktx"), 256, &levelBytes);
+    QVERIFY(!url.isEmpty());
+    QCOMPARE(levelBytes.count(), 9);
+    qint64 fullBytes = 0;
+    for (int bytes : levelBytes)
+        fullBytes += bytes;
+
+    Q3DSImageManager &mgr(Q3DSImageManager::instance());
+    mgr.setTextureMemoryBudget(0);
+    Qt3DCore::QEntity root;
+
+    Qt3DRender::QAbstractTexture *texFull = mgr.newTextureForImage(&root, {});
+    mgr.setSource(texFull, url);
+    QCOMPARE(mgr.skippedMipLevels(texFull), 0);
+    QCOMPARE(mgr.size(texFull), QSize(256, 256));
+    QCOMPARE(mgr.residentTextureBytes(), fullBytes);
+    delete texFull;
+    QCOMPARE(mgr.residentTextureBytes(), qint64(0));
+
+    // the top level alone is 32 KB, the rest is about 11 KB
+    mgr.setTextureMemoryBudget(16 * 1024);
+    Qt3DRender::QAbstractTexture *tex = mgr.newTextureForImage(&root, {});
+    mgr.setSource(tex, url);
+    QCOMPARE(mgr.skippedMipLevels(tex), 1);
+    QCOMPARE(mgr.size(tex), QSize(128, 128));
+    QCOMPARE(mgr.residentBytes(tex), fullBytes - levelBytes[0]);
+    QCOMPARE(mgr.residentTextureBytes(), fullBytes - levelBytes[0]);
+
+    // with less room, more levels go but never below 64x64
+    mgr.setTextureMemoryBudget(1024);
+    Qt3DRender::QAbstractTexture *tex2 = mgr.newTextureForImage(&root, {});
+    mgr.setSource(tex2, url);
+    QCOMPARE(mgr.skippedMipLevels(tex2), 2);
+    QCOMPARE(mgr.size(tex2), QSize(64, 64));
+    QCOMPARE(mgr.residentTextureBytes(), 2 * (fullBytes - levelBytes[0]) - levelBytes[1]);
+}
+
+void tst_Q3DSImageManager::invalidateKeepsDataWithinLimit()
+{
+    const QUrl a = writeImage(QLatin1String("invalidate_a.png"), QSize(64, 64), Qt::red);
+    const QUrl b = writeImage(QLatin1String("invalidate_b.png"), QSize(64, 64), Qt::blue);
+    QVERIFY(!a.isEmpty() && !b.isEmpty());
+
+    Q3DSImageManager &mgr(Q3DSImageManager::instance());
+    mgr.setImageCacheLimit(qint64(1024) * 1024);
+
+    {
+        Qt3DCore::QEntity root;
+        mgr.setSource(mgr.newTextureForImage(&root, {}), a);
+        mgr.setSource(mgr.newTextureForImage(&root, {}), b);
+        mgr.invalidate();
+    }
+    QCOMPARE(mgr.imageCacheEntryCount(), 2);
+
+    {
+        // a new engine finds the data decoded by the previous one
+        Qt3DCore::QEntity root;
+        Qt3DRender::QAbstractTexture *tex = mgr.newTextureForImage(&root, {});
+        mgr.setSource(tex, a);
+        QVERIFY(mgr.wasCached(tex));
+        QCOMPARE(mgr.size(tex), QSize(64, 64));
+
+        // but only as much as the limit allows once it is unused
+        mgr.setImageCacheLimit(1);
+        QCOMPARE(mgr.imageCacheEntryCount(), 1);
+        mgr.invalidate();
+    }
+    QCOMPARE(mgr.imageCacheEntryCount(), 0);
+    QCOMPARE(mgr.imageCacheBytes(), 0);
+}
+
+void tst_Q3DSImageManager::reloadModifiedImages()
+{
+    const QUrl a = writeImage(QLatin1String("reload_a.png"), QSize(64, 64), Qt::red);
+    const QUrl b = writeImage(QLatin1String("reload_b.png"), QSize(32, 32), Qt::green);
+    QVERIFY(!a.isEmpty() && !b.isEmpty());
+
+    Q3DSImageManager &mgr(Q3DSImageManager::instance());
+    Qt3DCore::QEntity root;
+    Qt3DRender::QAbstractTexture *texA = mgr.newTextureForImage(&root, {});
+    mgr.setSource(texA, a);
+    Qt3DRender::QAbstractTexture *texA2 = mgr.newTextureForImage(&root, {});
+    mgr.setSource(texA2, a);
+    Qt3DRender::QAbstractTexture *texB = mgr.newTextureForImage(&root, {});
+    mgr.setSource(texB, b);
+    QCOMPARE(mgr.imageCacheEntryCount(), 2);
+    QCOMPARE(mgr.reloadModifiedImages(QStringList()), 0);
+
+    // Rewritten within the timestamp resolution, hence passed explicitly.
+    writeImage(QLatin1String("reload_a.png"), QSize(128, 16), Qt::blue);
+    const int missesBefore = mgr.imageCacheMisses();
+    QCOMPARE(mgr.reloadModifiedImages({ QFileInfo(a.toLocalFile()).absoluteFilePath() }), 2);
+
+    // Both textures using the file get the new data, decoded once.
+    QCOMPARE(mgr.size(texA), QSize(128, 16));
+    QCOMPARE(mgr.size(texA2), QSize(128, 16));
+    QCOMPARE(mgr.imageCacheMisses(), missesBefore + 1);
+    QCOMPARE(mgr.size(texB), QSize(32, 32));
+    QCOMPARE(mgr.imageCacheEntryCount(), 2);
+}
+
+void tst_Q3DSImageManager::releaseTexturesOfOneEngine()
+{
+    const QUrl a = writeImage(QLatin1String("release_a.png"), QSize(64, 64), Qt::red);
+    QVERIFY(!a.isEmpty());
+
+    // two engines using the same image
+    Q3DSImageManager &mgr(Q3DSImageManager::instance());
+    Qt3DCore::QEntity root1;
+    Qt3DCore::QEntity root2;
+    Qt3DRender::QAbstractTexture *tex1 = mgr.newTextureForImage(&root1, {});
+    mgr.setSource(tex1, a);
+    Qt3DRender::QAbstractTexture *tex2 = mgr.newTextureForImage(&root2, {});
+    mgr.setSource(tex2, a);
+    QVERIFY(mgr.wasCached(tex2));
+    const qint64 bytes = mgr.residentBytes(tex2);
+    QVERIFY(bytes > 0);
+    QCOMPARE(mgr.residentTextureBytes(), 2 * bytes);
+
+    // the first one goes away, the second keeps its metadata and reference
+    mgr.releaseTextures(&root1);
+    QCOMPARE(mgr.residentTextureBytes(), bytes);
+    QCOMPARE(mgr.residentBytes(tex1), qint64(0));
+    QCOMPARE(mgr.residentBytes(tex2), bytes);
+    QVERIFY(mgr.wasCached(tex2));
+    QCOMPARE(mgr.size(tex2), QSize(64, 64));
+
+    // still referenced, so not evicted even with the smallest cache limit
+    mgr.setImageCacheLimit(1);
+    QCOMPARE(mgr.imageCacheEntryCount(), 1);
+
+    // destroying the released texture later must not release anything twice
+    delete tex1;
+    QCOMPARE(mgr.imageCacheEntryCount(), 1);
+    QCOMPARE(mgr.residentTextureBytes(), bytes);
+
+    delete tex2;
+    QCOMPARE(mgr.imageCacheEntryCount(), 0);
+    QCOMPARE(mgr.residentTextureBytes(), qint64(0));
+}
+
+void tst_Q3DSImageManager::floatToHalf_data()
+{
+    QTest::addColumn<float>("value");
+    QTest::addColumn<quint16>("half");
+
+    const float inf = std::numeric_limits<float>::infinity();
+    QTest::newRow("zero") << 0.0f << quint16(0x0000);
+    QTest::newRow("negative zero") << -0.0f << quint16(0x8000);
+    QTest::newRow("one") << 1.0f << quint16(0x3c00);
+    QTest::newRow("minus two") << -2.0f << quint16(0xc000);
+    QTest::newRow("largest") << 65504.0f << quint16(0x7bff);
+    QTest::newRow("rounds to inf") << 65520.0f << quint16(0x7c00);
+    QTest::newRow("too large") << 1.0e6f << quint16(0x7c00);
+    QTest::newRow("inf") << inf << quint16(0x7c00);
+    QTest::newRow("negative inf") << -inf << quint16(0xfc00);
+    QTest::newRow("nan") << std::numeric_limits<float>::quiet_NaN() << quint16(0x7e00);
+    QTest::newRow("smallest normal") << ldexpf(1.0f, -14) << quint16(0x0400);
+    QTest::newRow("denormal") << ldexpf(1.0f, -15) << quint16(0x0200);
+    QTest::newRow("smallest denormal") << ldexpf(1.0f, -24) << quint16(0x0001);
+    QTest::newRow("denormal tie to even") << ldexpf(1.0f, -25) << quint16(0x0000);
+    QTest::newRow("denormal round up") << ldexpf(1.5f, -25) << quint16(0x0001);
+    QTest::newRow("underflow") << 1.0e-10f << quint16(0x0000);
+}
+
+void tst_Q3DSImageManager::floatToHalf()
+{
+    QFETCH(float, value);
+    QFETCH(quint16, half);
+
+    QCOMPARE(q3ds_floatToHalf(value), half);
+}
+
+void tst_Q3DSImageManager::floatToHalfArray()
+{
+    // The bulk conversion may take the F16C path, it must agree with the
+    // scalar one, including for the tail that does not fill a vector.
+    const float inf = std::numeric_limits<float>::infinity();
+    const float src[] = { 0.0f, -0.0f, 1.0f, 0.1f, 65504.0f, 1.0e6f, -inf, ldexpf(1.0f, -24),
+                          ldexpf(1.5f, -25), 3.14159f, -123.456f };
+    const int count = int(sizeof(src) / sizeof(src[0]));
+    quint16 dst[count];
+    q3ds_floatToHalf(src, dst, count);
+    for (int i = 0; i < count; ++i)
+        QCOMPARE(dst[i], q3ds_floatToHalf(src[i]));
+}
+
+void tst_Q3DSImageManager::floatToRgb9e5()
+{
+    const float inf = std::numeric_limits<float>::infinity();
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float maxValue = 65408.0f; // 511 / 512 * 2^16
+    float rgb[3];
+
+    QCOMPARE(q3ds_floatToRgb9e5(0.0f, 0.0f, 0.0f), quint32(0));
+    QCOMPARE(q3ds_floatToRgb9e5(-1.0f, -inf, nan), quint32(0));
+
+    // Exactly representable values survive a round trip.
+    q3ds_rgb9e5ToFloat(q3ds_floatToRgb9e5(1.0f, 0.5f, 0.25f), rgb);
+    QCOMPARE(rgb[0], 1.0f);
+    QCOMPARE(rgb[1], 0.5f);
+    QCOMPARE(rgb[2], 0.25f);
+
+    // Negative and NaN components are clamped to 0, the others are kept.
+    q3ds_rgb9e5ToFloat(q3ds_floatToRgb9e5(-1.0f, 2.0f, nan), rgb);
+    QCOMPARE(rgb[0], 0.0f);
+    QCOMPARE(rgb[1], 2.0f);
+    QCOMPARE(rgb[2], 0.0f);
+
+    // Infinities and values out of range are clamped to the largest value.
+    q3ds_rgb9e5ToFloat(q3ds_floatToRgb9e5(inf, 1.0e9f, maxValue), rgb);
+    QCOMPARE(rgb[0], maxValue);
+    QCOMPARE(rgb[1], maxValue);
+    QCOMPARE(rgb[2], maxValue);
+
+    // The smallest exponent, where values map to denormals.
+    q3ds_rgb9e5ToFloat(q3ds_floatToRgb9e5(ldexpf(1.0f, -20), 0.0f, 0.0f), rgb);
+    QCOMPARE(rgb[0], ldexpf(1.0f, -20));
+
+    // Components much smaller than the largest one are lost to the shared
+    // exponent.
+    q3ds_rgb9e5ToFloat(q3ds_floatToRgb9e5(1.0e-10f, 1.0f, 0.0f), rgb);
+    QCOMPARE(rgb[0], 0.0f);
+    QCOMPARE(rgb[1], 1.0f);
+
+    // Rounding up the largest component bumps the shared exponent.
+    q3ds_rgb9e5ToFloat(q3ds_floatToRgb9e5(1023.9f, 0.0f, 0.0f), rgb);
+    QCOMPARE(rgb[0], 1024.0f);
+
+    // Otherwise within half a step of the shared exponent.
+    const float v[3] = { 3.14159f, 0.1f, 2.71828f };
+    q3ds_rgb9e5ToFloat(q3ds_floatToRgb9e5(v[0], v[1], v[2]), rgb);
+    const float step = ldexpf(1.0f, 2 - 9); // max component in [2, 4)
+    for (int i = 0; i < 3; ++i)
+        QVERIFY(qAbs(rgb[i] - v[i]) <= step / 2);
+}
+
+void tst_Q3DSImageManager::hdrStorageFormatPerImage()
+{
+    const QString fn = m_dir.filePath(QLatin1String("probe.hdr"));
+    QFile f(fn);
+    QVERIFY(f.open(QIODevice::WriteOnly));
+    f.write(hdrData());
+    f.close();
+    const QUrl url = QUrl::fromLocalFile(fn);
+
+    Q3DSImageManager &mgr(Q3DSImageManager::instance());
+    mgr.setHdrStorageFormat(Q3DSImageManager::HdrStorageFloat32);
+    QCOMPARE(mgr.hdrStorageFormat(Q3DSImageManager::HdrFloat16), Q3DSImageManager::HdrStorageFloat16);
+    QCOMPARE(mgr.hdrStorageFormat(Q3DSImageManager::GenerateMipMapsForIBL), Q3DSImageManager::HdrStorageFloat32);
+
+    Qt3DCore::QEntity root;
+    Qt3DRender::QAbstractTexture *texDefault = mgr.newTextureForImage(&root, {});
+    mgr.setSource(texDefault, url);
+    QCOMPARE(mgr.format(texDefault), Qt3DRender::QAbstractTexture::RGBA32F);
+    QCOMPARE(mgr.residentBytes(texDefault), qint64(2 * 16));
+
+    // the per-image flag wins over the global format, and the data in the
+    // other format is a separate cache entry
+    Qt3DRender::QAbstractTexture *texHalf = mgr.newTextureForImage(&root, Q3DSImageManager::HdrFloat16);
+    mgr.setSource(texHalf, url);
+    QVERIFY(!mgr.wasCached(texHalf));
+    QCOMPARE(mgr.format(texHalf), Qt3DRender::QAbstractTexture::RGBA16F);
+    QCOMPARE(mgr.residentBytes(texHalf), qint64(2 * 8));
+    QCOMPARE(mgr.imageCacheEntryCount(), 2);
+
+    // and the other way around
+    mgr.setHdrStorageFormat(Q3DSImageManager::HdrStorageRGB9E5);
+    Qt3DRender::QAbstractTexture *texFull = mgr.newTextureForImage(&root, Q3DSImageManager::HdrFloat32);
+    mgr.setSource(texFull, url);
+    QVERIFY(mgr.wasCached(texFull));
+    QCOMPARE(mgr.format(texFull), Qt3DRender::QAbstractTexture::RGBA32F);
+
+    // light probes carry the override in their flags
+    mgr.setLightProbeHdrStorageFormat(Q3DSImageManager::HdrStorageFloat16);
+    QCOMPARE(mgr.lightProbeImageFlags(), Q3DSImageManager::GenerateMipMapsForIBL | Q3DSImageManager::HdrFloat16);
+    mgr.resetLightProbeHdrStorageFormat();
+    QCOMPARE(mgr.lightProbeImageFlags(), Q3DSImageManager::ImageFlags(Q3DSImageManager::GenerateMipMapsForIBL));
+}
+
+void tst_Q3DSImageManager::hdrHalfFloatSaturates()
+{
+    QByteArray data = hdrData();
+    QBuffer buf(&data);
+    QVERIFY(buf.open(QIODevice::ReadOnly));
+    Qt3DRender::QTextureImageDataPtr image = q3ds_loadHdr(&buf, QOpenGLTexture::RGBA16F);
+    QVERIFY(image);
+    QCOMPARE(image->format(), QOpenGLTexture::RGBA16F);
+    const QByteArray pixels = image->data();
+    QCOMPARE(pixels.size(), 2 * 4 * int(sizeof(quint16)));
+    const quint16 *h = reinterpret_cast<const quint16 *>(pixels.constData());
+
+    // the second pixel is red beyond 65504, it becomes the largest finite
+    // half, not infinity
+    QCOMPARE(h[4], quint16(0x7bff));
+    QCOMPARE(h[5], quint16(0));
+    QCOMPARE(h[6], quint16(0));
+    QCOMPARE(h[7], q3ds_floatToHalf(1.0f));
+}
+
+QTEST_MAIN(tst_Q3DSImageManager)
+
+#include "tst_q3dsimagemanager.moc"
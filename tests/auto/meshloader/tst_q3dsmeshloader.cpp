@@ -31,7 +31,9 @@
 
 #include <Qt3DRender/QGeometry>
 #include <Qt3DRender/QAttribute>
+#include <Qt3DRender/QBuffer>
 #include <private/q3dsmeshloader_p.h>
+#include <private/q3dsassetcache_p.h>
 
 class tst_Q3DSMeshLoader : public QObject
 {
@@ -46,6 +48,7 @@ private Q_SLOTS:
     void testEmpty();
     void loadingPrimitiveMeshes();
     void testConsitencyAfterCleanup();
+    void sharedMeshData();
 private:
     void validatePrimitive(MeshList list);
 };
@@ -97,6 +100,44 @@ void tst_Q3DSMeshLoader::testConsitencyAfterCleanup()
     qDeleteAll(meshList);
 }
 
+void tst_Q3DSMeshLoader::sharedMeshData()
+{
+    Q3DSAssetCache &cache(Q3DSAssetCache::instance());
+    const int entriesBefore = cache.stats().entries;
+
+    QString key1, key2;
+    MeshList list1 = Q3DSMeshLoader::loadMesh("#Sphere", 1, false, &key1);
+    QCOMPARE(list1.count(), 1);
+    QVERIFY(!key1.isEmpty());
+    QCOMPARE(cache.stats().entries, entriesBefore + 1);
+
+    const int hitsBefore = cache.stats().hits;
+    MeshList list2 = Q3DSMeshLoader::loadMesh("#Sphere", 1, true, &key2);
+    QCOMPARE(list2.count(), 1);
+    QCOMPARE(key2, key1);
+    QCOMPARE(cache.stats().hits, hitsBefore + 1);
+    QCOMPARE(cache.stats().entries, entriesBefore + 1);
+
+    // The Qt 3D nodes are separate, the vertex data is not.
+    QVERIFY(list1.first() != list2.first());
+    auto bufferData = [](Q3DSMesh *mesh) {
+        return mesh->geometry()->attributes().first()->buffer()->data().constData();
+    };
+    QCOMPARE(bufferData(list1.first()), bufferData(list2.first()));
+
+    // Vertices and indices come from the same, single copy of the data.
+    for (Qt3DRender::QAttribute *attribute : list1.first()->geometry()->attributes())
+        QCOMPARE(attribute->buffer()->data().constData(), bufferData(list1.first()));
+
+    cache.release(key1);
+    QCOMPARE(cache.stats().entries, entriesBefore + 1);
+    cache.release(key2);
+    QCOMPARE(cache.stats().entries, entriesBefore);
+
+    qDeleteAll(list1);
+    qDeleteAll(list2);
+}
+
 void tst_Q3DSMeshLoader::validatePrimitive(MeshList list)
 {
     // Primitives only have 1 sub-mesh
@@ -0,0 +1,6 @@
+TARGET = tst_q3dsqualitygovernor
+CONFIG += testcase
+
+QT += testlib 3dstudioruntime2-private
+
+SOURCES += tst_q3dsqualitygovernor.cpp
@@ -0,0 +1,199 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtTest>
+#include <private/q3dsqualitygovernor_p.h>
+
+class tst_Q3DSQualityGovernor : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void qualityLevels();
+    void lowerWhenOverBudget();
+    void hysteresis();
+    void raiseWhenWithinBudget();
+    void failedRaiseBacksOff();
+    void levelBounds();
+    void restartWindow();
+};
+
+static const float TARGET = 16.0f;
+static const int WINDOW = 10;
+
+// Feeds whole windows of the given frame time, returns the number of level changes.
+static int feedWindows(Q3DSQualityGovernor *g, float ms, int windowCount)
+{
+    int changes = 0;
+    for (int i = 0; i < windowCount * WINDOW; ++i) {
+        if (g->addFrameTime(ms))
+            ++changes;
+    }
+    return changes;
+}
+
+static Q3DSQualityGovernor *newGovernor()
+{
+    Q3DSQualityGovernor *g = new Q3DSQualityGovernor;
+    g->setTargetFrameTime(TARGET);
+    g->setWindowSize(WINDOW);
+    return g;
+}
+
+void tst_Q3DSQualityGovernor::qualityLevels()
+{
+    // each level must be at most as expensive as the previous one
+    Q3DSQualityGovernor::Quality prev = Q3DSQualityGovernor::qualityForLevel(0);
+    QCOMPARE(prev.layerRenderScale, 1.0f);
+    QCOMPARE(prev.shadowMapResolutionShift, 0);
+    for (int level = 1; level < Q3DSQualityGovernor::LEVEL_COUNT; ++level) {
+        const Q3DSQualityGovernor::Quality q = Q3DSQualityGovernor::qualityForLevel(level);
+        QVERIFY(q.layerRenderScale <= prev.layerRenderScale);
+        QVERIFY(q.maxProgressiveAAPasses <= prev.maxProgressiveAAPasses);
+        QVERIFY(q.maxProgressiveAAPasses >= 1);
+        QVERIFY(q.shadowMapResolutionShift >= prev.shadowMapResolutionShift);
+        prev = q;
+    }
+}
+
+void tst_Q3DSQualityGovernor::lowerWhenOverBudget()
+{
+    QScopedPointer<Q3DSQualityGovernor> g(newGovernor());
+    QCOMPARE(g->level(), 0);
+
+    QCOMPARE(feedWindows(g.data(), 30.0f, 2), 1);
+    QCOMPARE(g->level(), 1);
+    QCOMPARE(feedWindows(g.data(), 30.0f, 2), 1);
+    QCOMPARE(g->level(), 2);
+    QCOMPARE(g->quality().shadowMapResolutionShift, 1);
+}
+
+void tst_Q3DSQualityGovernor::hysteresis()
+{
+    QScopedPointer<Q3DSQualityGovernor> g(newGovernor());
+
+    // a single window over budget is not enough
+    QCOMPARE(feedWindows(g.data(), 30.0f, 1), 0);
+    QCOMPARE(feedWindows(g.data(), 16.0f, 1), 0);
+    QCOMPARE(feedWindows(g.data(), 30.0f, 1), 0);
+    QCOMPARE(g->level(), 0);
+
+    // slightly over the target is neither over nor within budget
+    QCOMPARE(feedWindows(g.data(), 30.0f, 1), 1);
+    QCOMPARE(g->level(), 1);
+    QCOMPARE(feedWindows(g.data(), TARGET * 1.1f, 20), 0);
+    QCOMPARE(g->level(), 1);
+
+    // spikes within a window are averaged out
+    for (int i = 0; i < 4 * WINDOW; ++i)
+        QVERIFY(!g->addFrameTime(i % WINDOW == 0 ? 40.0f : TARGET));
+    QCOMPARE(g->level(), 1);
+}
+
+void tst_Q3DSQualityGovernor::raiseWhenWithinBudget()
+{
+    QScopedPointer<Q3DSQualityGovernor> g(newGovernor());
+    feedWindows(g.data(), 30.0f, 4);
+    QCOMPARE(g->level(), 2);
+
+    QCOMPARE(feedWindows(g.data(), TARGET, 3), 0);
+    QCOMPARE(g->level(), 2);
+    QCOMPARE(feedWindows(g.data(), TARGET, 1), 1);
+    QCOMPARE(g->level(), 1);
+    QCOMPARE(feedWindows(g.data(), TARGET, 4), 1);
+    QCOMPARE(g->level(), 0);
+
+    // nothing above level 0
+    QCOMPARE(feedWindows(g.data(), TARGET, 20), 0);
+    QCOMPARE(g->level(), 0);
+}
+
+void tst_Q3DSQualityGovernor::failedRaiseBacksOff()
+{
+    QScopedPointer<Q3DSQualityGovernor> g(newGovernor());
+    feedWindows(g.data(), 30.0f, 2);
+    QCOMPARE(g->level(), 1);
+
+    feedWindows(g.data(), TARGET, 4);
+    QCOMPARE(g->level(), 0);
+
+    // going over budget right after raising the level
+    feedWindows(g.data(), 30.0f, 2);
+    QCOMPARE(g->level(), 1);
+
+    // the next raise takes twice as long
+    QCOMPARE(feedWindows(g.data(), TARGET, 7), 0);
+    QCOMPARE(g->level(), 1);
+    QCOMPARE(feedWindows(g.data(), TARGET, 1), 1);
+    QCOMPARE(g->level(), 0);
+
+    // reset() goes back to the defaults
+    feedWindows(g.data(), 30.0f, 2);
+    QCOMPARE(g->level(), 1);
+    g->reset();
+    QCOMPARE(g->level(), 0);
+    feedWindows(g.data(), 30.0f, 2);
+    QCOMPARE(feedWindows(g.data(), TARGET, 4), 1);
+    QCOMPARE(g->level(), 0);
+}
+
+void tst_Q3DSQualityGovernor::levelBounds()
+{
+    QScopedPointer<Q3DSQualityGovernor> g(newGovernor());
+    feedWindows(g.data(), 100.0f, 100);
+    QCOMPARE(g->level(), Q3DSQualityGovernor::LEVEL_COUNT - 1);
+
+    g->setLevel(100);
+    QCOMPARE(g->level(), Q3DSQualityGovernor::LEVEL_COUNT - 1);
+    g->setLevel(-1);
+    QCOMPARE(g->level(), 0);
+}
+
+void tst_Q3DSQualityGovernor::restartWindow()
+{
+    QScopedPointer<Q3DSQualityGovernor> g(newGovernor());
+    feedWindows(g.data(), 30.0f, 2);
+    QCOMPARE(g->level(), 1);
+
+    // one and a half windows over budget, then a pause
+    feedWindows(g.data(), 30.0f, 1);
+    for (int i = 0; i < WINDOW / 2; ++i)
+        QVERIFY(!g->addFrameTime(30.0f));
+    g->restartWindow();
+    QCOMPARE(g->level(), 1);
+
+    // the earlier frames do not count towards lowering the level anymore
+    QCOMPARE(feedWindows(g.data(), 30.0f, 1), 0);
+    QCOMPARE(feedWindows(g.data(), 30.0f, 1), 1);
+    QCOMPARE(g->level(), 2);
+}
+
+QTEST_APPLESS_MAIN(tst_Q3DSQualityGovernor)
+
+#include "tst_q3dsqualitygovernor.moc"
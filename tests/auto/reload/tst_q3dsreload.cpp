@@ -0,0 +1,171 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include <private/q3dsutils_p.h>
+#include <private/q3dswindow_p.h>
+#include <private/q3dsengine_p.h>
+#include <private/q3dsuippresentation_p.h>
+
+#include "../shared/shared.h"
+
+class tst_Q3DSReload : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~tst_Q3DSReload();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void propertyChange();
+    void customMaterial();
+    void slideChange();
+
+private:
+    bool replaceInFile(const QString &fileName, const QByteArray &before, const QByteArray &after);
+
+    QTemporaryDir m_dir;
+    QString m_uip;
+    QString m_material;
+    Q3DSEngine *m_engine = nullptr;
+    Q3DSWindow *m_view = nullptr;
+};
+
+tst_Q3DSReload::~tst_Q3DSReload()
+{
+    delete m_engine;
+    delete m_view;
+}
+
+void tst_Q3DSReload::initTestCase()
+{
+    if (!isOpenGLGoodEnough())
+        QSKIP("This platform does not support OpenGL proper");
+
+    // The files get modified, work on copies.
+    QVERIFY(m_dir.isValid());
+    m_uip = m_dir.filePath(QLatin1String("cube_with_custom_material.uip"));
+    m_material = m_dir.filePath(QLatin1String("aluminum.material"));
+    for (const QString &fn : { m_uip, m_material }) {
+        QVERIFY(QFile::copy(QLatin1String(":/") + QFileInfo(fn).fileName(), fn));
+        QVERIFY(QFile::setPermissions(fn, QFile::ReadOwner | QFile::WriteOwner));
+    }
+
+    QSurfaceFormat::setDefaultFormat(Q3DS::surfaceFormat());
+    m_engine = new Q3DSEngine;
+    m_view = new Q3DSWindow;
+    m_view->setEngine(m_engine);
+    m_view->forceResize(640, 480);
+
+    Q3DSUtils::setDialogsEnabled(false);
+    QVERIFY(m_engine->setSource(m_uip));
+    QVERIFY(m_engine->presentation());
+
+    m_view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(m_view));
+}
+
+void tst_Q3DSReload::cleanupTestCase()
+{
+    if (m_view)
+        m_view->close();
+}
+
+bool tst_Q3DSReload::replaceInFile(const QString &fileName, const QByteArray &before, const QByteArray &after)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadWrite))
+        return false;
+    QByteArray data = f.readAll();
+    if (!data.contains(before))
+        return false;
+    data.replace(before, after);
+    f.resize(0);
+    return f.write(data) == data.size();
+}
+
+void tst_Q3DSReload::propertyChange()
+{
+    QSignalSpy loadSpy(m_engine, &Q3DSEngine::presentationLoaded);
+    Q3DSUipPresentation *presentation = m_engine->presentation();
+    Q3DSModelNode *cube = presentation->object<Q3DSModelNode>("Cube");
+    QVERIFY(cube);
+    QCOMPARE(cube->scale(), QVector3D(2, 2, 2));
+
+    QVERIFY(replaceInFile(m_uip, "scale=\"2 2 2\"", "scale=\"3 3 3\""));
+    QVERIFY(m_engine->reload({ m_uip }));
+
+    // applied to the live presentation, no new scene
+    QCOMPARE(loadSpy.count(), 0);
+    QCOMPARE(m_engine->presentation(), presentation);
+    QCOMPARE(presentation->object<Q3DSModelNode>("Cube"), cube);
+    QCOMPARE(cube->scale(), QVector3D(3, 3, 3));
+}
+
+void tst_Q3DSReload::customMaterial()
+{
+    QSignalSpy loadSpy(m_engine, &Q3DSEngine::presentationLoaded);
+    Q3DSUipPresentation *presentation = m_engine->presentation();
+    Q3DSCustomMaterialInstance *material = presentation->object<Q3DSCustomMaterialInstance>("Material");
+    QVERIFY(material);
+    QCOMPARE(material->property("bump_amount").toFloat(), 0.5f);
+
+    // a value set at runtime survives the reload, the defaults follow the file
+    material->applyDynamicProperties({ { QLatin1String("reflection_map_scale"), 0.75f } });
+    QVERIFY(replaceInFile(m_material, "max=\"2\" default=\"0.500000\"", "max=\"2\" default=\"1.500000\""));
+    QVERIFY(m_engine->reload({ m_material }));
+
+    QCOMPARE(loadSpy.count(), 0);
+    QCOMPARE(m_engine->presentation(), presentation);
+    QCOMPARE(presentation->object<Q3DSCustomMaterialInstance>("Material"), material);
+    QTRY_COMPARE(material->property("bump_amount").toFloat(), 1.5f);
+    QCOMPARE(material->material()->properties().value(QLatin1String("bump_amount")).defaultValue,
+             QLatin1String("1.500000"));
+    QCOMPARE(material->property("reflection_map_scale").toFloat(), 0.75f);
+}
+
+void tst_Q3DSReload::slideChange()
+{
+    // Slides cannot be changed incrementally, this is a full reload.
+    QSignalSpy loadSpy(m_engine, &Q3DSEngine::presentationLoaded);
+    QVERIFY(replaceInFile(m_uip, "name=\"Slide1\"", "name=\"First\""));
+    QVERIFY(m_engine->reload({ m_uip }));
+
+    QCOMPARE(loadSpy.count(), 1);
+    QVERIFY(m_engine->presentation());
+    QCOMPARE(m_engine->presentation()->object<Q3DSModelNode>("Cube")->scale(), QVector3D(3, 3, 3));
+}
+
+QTEST_MAIN(tst_Q3DSReload)
+
+#include "tst_q3dsreload.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_q3dsremotedeployment
+CONFIG += testcase
+
+QT += testlib network 3dstudioruntime2-private
+
+SOURCES += tst_q3dsremotedeployment.cpp
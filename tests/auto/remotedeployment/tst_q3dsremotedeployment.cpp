@@ -0,0 +1,282 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtTest>
+#include <QtNetwork/QTcpSocket>
+#include <private/q3dsremotedeploymentserver_p.h>
+
+class tst_Q3DSRemoteDeployment : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void deltaDeployment();
+    void singlePayloadDeployment();
+    void rejectFilesOutsideProject();
+    void rejectPayloadOutsideProject();
+    void rejectHashMismatch();
+};
+
+// The sending side of the delta protocol, as the editor would do it.
+class DeltaSender
+{
+public:
+    DeltaSender()
+    {
+        m_stream.setDevice(&m_socket);
+        m_stream.setVersion(QDataStream::Qt_5_8);
+    }
+
+    bool connectToServer(int port)
+    {
+        m_socket.connectToHost(QHostAddress::LocalHost, quint16(port));
+        return m_socket.waitForConnected(5000);
+    }
+
+    QStringList sendManifest(const QString &projectFile, const QHash<QString, QByteArray> &files)
+    {
+        Q3DSRemoteDeploymentServer::Manifest manifest;
+        for (auto it = files.cbegin(), itEnd = files.cend(); it != itEnd; ++it)
+            manifest.insert(it.key(), qMakePair(Q3DSRemoteDeploymentServer::fileHash(it.value()), qint64(it.value().size())));
+
+        m_stream << qint32(Q3DSRemoteDeploymentServer::ManifestMessage) << projectFile << manifest;
+
+        for (int i = 0; i < 500; ++i) {
+            QTest::qWait(10);
+            m_stream.startTransaction();
+            qint32 message = 0;
+            QStringList neededFiles;
+            m_stream >> message >> neededFiles;
+            if (m_stream.commitTransaction()) {
+                if (message != Q3DSRemoteDeploymentServer::ManifestMessage)
+                    break;
+                neededFiles.sort();
+                return neededFiles;
+            }
+        }
+        return QStringList() << QLatin1String("<no reply>");
+    }
+
+    // Sent in two parts to exercise streaming on the receiving side.
+    void sendFile(const QString &fileName, const QByteArray &contents)
+    {
+        m_stream << qint32(Q3DSRemoteDeploymentServer::FileMessage) << fileName << qint64(contents.size());
+        const int half = contents.size() / 2;
+        m_socket.write(contents.left(half));
+        QTest::qWait(10);
+        m_socket.write(contents.mid(half));
+    }
+
+    void commit()
+    {
+        m_stream << qint32(Q3DSRemoteDeploymentServer::CommitMessage);
+    }
+
+    void sendPayload(const QString &projectFile, const QHash<QString, QByteArray> &files)
+    {
+        QByteArray payload;
+        QDataStream payloadStream(&payload, QIODevice::WriteOnly);
+        payloadStream.setVersion(QDataStream::Qt_5_8);
+        payloadStream << files.count() << projectFile;
+        for (auto it = files.cbegin(), itEnd = files.cend(); it != itEnd; ++it)
+            payloadStream << it.key() << it.value();
+
+        m_stream << payload.size();
+        m_socket.write(payload);
+    }
+
+private:
+    QTcpSocket m_socket;
+    QDataStream m_stream;
+};
+
+static QByteArray readFile(const QString &fileName)
+{
+    QFile f(fileName);
+    return f.open(QIODevice::ReadOnly) ? f.readAll() : QByteArray();
+}
+
+void tst_Q3DSRemoteDeployment::deltaDeployment()
+{
+    Q3DSRemoteDeploymentServer server(0);
+    QVERIFY(server.startServer().isEmpty());
+    QSignalSpy changedSpy(&server, &Q3DSRemoteDeploymentServer::projectChanged);
+
+    DeltaSender sender;
+    QVERIFY(sender.connectToServer(server.serverPort()));
+    QTRY_VERIFY(server.isConnected());
+
+    QHash<QString, QByteArray> files;
+    files.insert(QLatin1String("test.uip"), QByteArray("<UIP version=\"4\"/>"));
+    files.insert(QLatin1String("maps/texture.png"), QByteArray(100000, 't'));
+    files.insert(QLatin1String("meshes/model.mesh"), QByteArray(5000, 'm'));
+
+    // first deployment, everything is needed
+    QStringList needed = sender.sendManifest(QLatin1String("test.uip"), files);
+    QCOMPARE(needed, QStringList() << QLatin1String("maps/texture.png")
+                                   << QLatin1String("meshes/model.mesh")
+                                   << QLatin1String("test.uip"));
+    for (const QString &fn : needed)
+        sender.sendFile(fn, files.value(fn));
+    sender.commit();
+
+    QTRY_COMPARE(changedSpy.count(), 1);
+    QVERIFY(server.isProjectDeployed());
+    QVERIFY(server.isDeltaDeployment());
+    QCOMPARE(server.changedFiles().count(), 3);
+    const QString projectFile = server.fileName();
+    QVERIFY(projectFile.endsWith(QLatin1String("/test.uip")));
+    const QString root = QFileInfo(projectFile).absolutePath();
+    for (auto it = files.cbegin(), itEnd = files.cend(); it != itEnd; ++it)
+        QCOMPARE(readFile(root + QLatin1Char('/') + it.key()), it.value());
+
+    // change the mesh, drop the texture
+    files.insert(QLatin1String("meshes/model.mesh"), QByteArray(6000, 'n'));
+    files.remove(QLatin1String("maps/texture.png"));
+
+    needed = sender.sendManifest(QLatin1String("test.uip"), files);
+    QCOMPARE(needed, QStringList() << QLatin1String("meshes/model.mesh"));
+    sender.sendFile(needed.first(), files.value(needed.first()));
+    sender.commit();
+
+    QTRY_COMPARE(changedSpy.count(), 2);
+    QCOMPARE(server.fileName(), projectFile);
+    QStringList changed = server.changedFiles();
+    changed.sort();
+    QCOMPARE(changed, QStringList() << QFileInfo(root + QLatin1String("/maps/texture.png")).absoluteFilePath()
+                                    << QFileInfo(root + QLatin1String("/meshes/model.mesh")).absoluteFilePath());
+    QVERIFY(!QFile::exists(root + QLatin1String("/maps/texture.png")));
+    QCOMPARE(readFile(root + QLatin1String("/meshes/model.mesh")), QByteArray(6000, 'n'));
+    QCOMPARE(readFile(root + QLatin1String("/test.uip")), files.value(QLatin1String("test.uip")));
+
+    // nothing changed
+    QVERIFY(sender.sendManifest(QLatin1String("test.uip"), files).isEmpty());
+    sender.commit();
+    QTRY_COMPARE(changedSpy.count(), 3);
+    QVERIFY(server.changedFiles().isEmpty());
+}
+
+void tst_Q3DSRemoteDeployment::singlePayloadDeployment()
+{
+    Q3DSRemoteDeploymentServer server(0);
+    QVERIFY(server.startServer().isEmpty());
+    QSignalSpy changedSpy(&server, &Q3DSRemoteDeploymentServer::projectChanged);
+
+    DeltaSender sender;
+    QVERIFY(sender.connectToServer(server.serverPort()));
+    QTRY_VERIFY(server.isConnected());
+
+    QHash<QString, QByteArray> files;
+    files.insert(QLatin1String("test.uip"), QByteArray("<UIP version=\"4\"/>"));
+    files.insert(QLatin1String("maps/texture.png"), QByteArray(1000, 't'));
+
+    sender.sendPayload(QLatin1String("test.uip"), files);
+    QTRY_COMPARE(changedSpy.count(), 1);
+    QVERIFY(!server.isDeltaDeployment());
+    QCOMPARE(readFile(server.fileName()), files.value(QLatin1String("test.uip")));
+
+    // the files received in one payload are known to a later delta
+    QVERIFY(sender.sendManifest(QLatin1String("test.uip"), files).isEmpty());
+}
+
+void tst_Q3DSRemoteDeployment::rejectFilesOutsideProject()
+{
+    Q3DSRemoteDeploymentServer server(0);
+    QVERIFY(server.startServer().isEmpty());
+
+    DeltaSender sender;
+    QVERIFY(sender.connectToServer(server.serverPort()));
+    QTRY_VERIFY(server.isConnected());
+
+    QHash<QString, QByteArray> files;
+    files.insert(QLatin1String("test.uip"), QByteArray("<UIP version=\"4\"/>"));
+    files.insert(QLatin1String("../outside.txt"), QByteArray("x"));
+    QCOMPARE(sender.sendManifest(QLatin1String("test.uip"), files), QStringList() << QLatin1String("test.uip"));
+
+    sender.sendFile(QLatin1String("../outside.txt"), QByteArray("x"));
+    QTRY_VERIFY(!server.isConnected());
+}
+
+void tst_Q3DSRemoteDeployment::rejectPayloadOutsideProject()
+{
+    Q3DSRemoteDeploymentServer server(0);
+    QVERIFY(server.startServer().isEmpty());
+    QSignalSpy changedSpy(&server, &Q3DSRemoteDeploymentServer::projectChanged);
+
+    DeltaSender sender;
+    QVERIFY(sender.connectToServer(server.serverPort()));
+    QTRY_VERIFY(server.isConnected());
+
+    // would end up next to the server's temporary directory
+    const QString outsideName = QLatin1String("q3ds_remotedeployment_outside_")
+            + QString::number(QCoreApplication::applicationPid()) + QLatin1String(".txt");
+    const QString outsidePath = QDir::tempPath() + QLatin1Char('/') + outsideName;
+    QFile::remove(outsidePath);
+
+    QHash<QString, QByteArray> files;
+    files.insert(QLatin1String("test.uip"), QByteArray("<UIP version=\"4\"/>"));
+    files.insert(QLatin1String("../") + outsideName, QByteArray("x"));
+    sender.sendPayload(QLatin1String("test.uip"), files);
+
+    QTest::qWait(500);
+    QCOMPARE(changedSpy.count(), 0);
+    QVERIFY(!server.isProjectDeployed());
+    QVERIFY(!QFile::exists(outsidePath));
+}
+
+void tst_Q3DSRemoteDeployment::rejectHashMismatch()
+{
+    Q3DSRemoteDeploymentServer server(0);
+    QVERIFY(server.startServer().isEmpty());
+    QSignalSpy changedSpy(&server, &Q3DSRemoteDeploymentServer::projectChanged);
+
+    DeltaSender sender;
+    QVERIFY(sender.connectToServer(server.serverPort()));
+    QTRY_VERIFY(server.isConnected());
+
+    QHash<QString, QByteArray> files;
+    files.insert(QLatin1String("test.uip"), QByteArray("<UIP version=\"4\"/>"));
+    files.insert(QLatin1String("maps/texture.png"), QByteArray(1000, 't'));
+    QCOMPARE(sender.sendManifest(QLatin1String("test.uip"), files).count(), 2);
+
+    const QString root = QFileInfo(server.fileName()).absolutePath();
+    sender.sendFile(QLatin1String("test.uip"), files.value(QLatin1String("test.uip")));
+    QTRY_VERIFY(QFile::exists(root + QLatin1String("/test.uip")));
+
+    // same size, different contents
+    sender.sendFile(QLatin1String("maps/texture.png"), QByteArray(1000, 'u'));
+    sender.commit();
+    QTRY_VERIFY(!server.isConnected());
+    QCOMPARE(changedSpy.count(), 0);
+    QVERIFY(!QFile::exists(root + QLatin1String("/maps/texture.png")));
+}
+
+QTEST_GUILESS_MAIN(tst_Q3DSRemoteDeployment)
+
+#include "tst_q3dsremotedeployment.moc"
@@ -0,0 +1,8 @@
+TARGET = tst_q3dsshaderbundle
+CONFIG += testcase
+
+QT += testlib 3drender 3dstudioruntime2-private
+
+SOURCES += tst_q3dsshaderbundle.cpp
+
+RESOURCES += shaderbundle.qrc
@@ -0,0 +1,245 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+
+#include <private/q3dsuipparser_p.h>
+#include <private/q3dsuippresentation_p.h>
+#include <private/q3dsgraphicslimits_p.h>
+#include <private/q3dsdefaultmaterialgenerator_p.h>
+#include <private/q3dsshadermanager_p.h>
+#include <private/q3dsshaderbundle_p.h>
+
+class tst_Q3DSShaderBundle : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void generate();
+    void matchesRuntime();
+    void keyInputs();
+    void saveAndLoad();
+    void targetMismatch();
+    void contextVersion();
+    void useBundle();
+
+private:
+    QByteArray defaultKey(Q3DSDefaultMaterial *material, const QVector<Q3DSLightNode *> &lights,
+                          bool shadows, bool ssao);
+
+    QScopedPointer<Q3DSUipPresentation> m_presentation;
+    Q3DSShaderBundle m_bundle;
+    QTemporaryDir m_tempDir;
+};
+
+void tst_Q3DSShaderBundle::initTestCase()
+{
+    // No OpenGL context needed, the shaders are only generated.
+    Q3DSGraphicsLimits limits;
+    limits.format.setRenderableType(QSurfaceFormat::OpenGL);
+    limits.format.setProfile(QSurfaceFormat::CoreProfile);
+    limits.format.setVersion(3, 3);
+    limits.shaderTextureLodSupported = true;
+    Q3DS::setGraphicsLimits(limits);
+
+    Q3DSUipParser parser;
+    m_presentation.reset(parser.parse(QLatin1String(":/data/variants.uip"), QLatin1String("variants")));
+    QVERIFY(m_presentation);
+    QVERIFY(m_tempDir.isValid());
+}
+
+QByteArray tst_Q3DSShaderBundle::defaultKey(Q3DSDefaultMaterial *material, const QVector<Q3DSLightNode *> &lights,
+                                            bool shadows, bool ssao)
+{
+    Q3DSShaderFeatureSet features;
+    Q3DSDefaultMaterialGenerator::fillFeatureSet(&features, m_presentation->object<Q3DSLayerNode>("Layer"),
+                                                 false, shadows, ssao);
+    return Q3DSShaderManager::instance().variantKey(*material, nullptr, lights, false, features);
+}
+
+void tst_Q3DSShaderBundle::generate()
+{
+    QCOMPARE(m_bundle.target(), Q3DSShaderBundle::currentTarget());
+
+    // Two models, each in (Slide1, Slide2) x (di_light off, on), plus
+    // Slide1 after Slide2 where the layer still has shadow maps.
+    const int count = m_bundle.addPresentation(m_presentation.data());
+    QCOMPARE(count, 12);
+    QCOMPARE(m_bundle.count(), count);
+
+    // Nothing new the second time.
+    QCOMPARE(m_bundle.addPresentation(m_presentation.data()), 0);
+
+    // The presentation is left on the first slide.
+    QVERIFY(!m_presentation->object<Q3DSLightNode>("Light")->castShadow());
+    QVERIFY(!m_presentation->object<Q3DSLightNode>("Light2")->eyeballEnabled());
+    QCOMPARE(m_presentation->object<Q3DSLayerNode>("Layer")->aoStrength(), 0.0f);
+}
+
+void tst_Q3DSShaderBundle::matchesRuntime()
+{
+    auto material = m_presentation->object<Q3DSDefaultMaterial>("Material");
+    auto light = m_presentation->object<Q3DSLightNode>("Light");
+    auto light2 = m_presentation->object<Q3DSLightNode>("Light2");
+
+    const QByteArray key = defaultKey(material, { light, light2 }, false, false);
+    const Q3DSShaderBundle::Entry *entry = m_bundle.find(key);
+    QVERIFY(entry);
+
+    Q3DSShaderFeatureSet features;
+    Q3DSDefaultMaterialGenerator::fillFeatureSet(&features, m_presentation->object<Q3DSLayerNode>("Layer"),
+                                                 false, false, false);
+    QScopedPointer<Qt3DRender::QShaderProgram> program(
+                Q3DSShaderManager::instance().generateShaderProgram(nullptr, *material, nullptr, { light, light2 }, false, features));
+    QVERIFY(program);
+    QCOMPARE(entry->sources.vertex, program->vertexShaderCode());
+    QCOMPARE(entry->sources.fragment, program->fragmentShaderCode());
+}
+
+void tst_Q3DSShaderBundle::keyInputs()
+{
+    auto material = m_presentation->object<Q3DSDefaultMaterial>("Material");
+    auto light = m_presentation->object<Q3DSLightNode>("Light");
+    auto light2 = m_presentation->object<Q3DSLightNode>("Light2");
+
+    const QByteArray key = defaultKey(material, { light }, false, false);
+    QCOMPARE(defaultKey(material, { light }, false, false), key);
+    QVERIFY(m_bundle.find(key));
+
+    QVERIFY(defaultKey(material, { light, light2 }, false, false) != key);
+    QVERIFY(defaultKey(material, { light }, true, false) != key);
+    QVERIFY(defaultKey(material, { light }, false, true) != key);
+
+    light->applyPropertyChanges({ Q3DSPropertyChange::fromVariant(QLatin1String("castshadow"), true) });
+    QVERIFY(defaultKey(material, { light }, false, false) != key);
+    light->applyPropertyChanges({ Q3DSPropertyChange::fromVariant(QLatin1String("castshadow"), false) });
+    QCOMPARE(defaultKey(material, { light }, false, false), key);
+
+    // Slide2 has shadows and SSAO.
+    light->applyPropertyChanges({ Q3DSPropertyChange::fromVariant(QLatin1String("castshadow"), true) });
+    QVERIFY(m_bundle.find(defaultKey(material, { light }, true, true)));
+    light->applyPropertyChanges({ Q3DSPropertyChange::fromVariant(QLatin1String("castshadow"), false) });
+    // and back in Slide1 the shadow maps are still there
+    QVERIFY(m_bundle.find(defaultKey(material, { light }, true, false)));
+}
+
+void tst_Q3DSShaderBundle::saveAndLoad()
+{
+    const QString fn = m_tempDir.filePath(QLatin1String("variants.shaderbundle"));
+    QVERIFY(m_bundle.save(fn));
+
+    Q3DSShaderBundle loaded;
+    QString error;
+    QVERIFY(loaded.load(fn, &error));
+    QVERIFY(error.isEmpty());
+    QCOMPARE(loaded.target(), m_bundle.target());
+    QCOMPARE(loaded.glslVersion(), 330);
+    QCOMPARE(loaded.count(), m_bundle.count());
+    for (const QByteArray &key : m_bundle.keys()) {
+        const Q3DSShaderBundle::Entry *entry = loaded.find(key);
+        QVERIFY(entry);
+        QCOMPARE(entry->description, m_bundle.find(key)->description);
+        QVERIFY(entry->sources == m_bundle.find(key)->sources);
+    }
+
+    QVERIFY(!loaded.load(m_tempDir.filePath(QLatin1String("nonexistent")), &error));
+    QVERIFY(!error.isEmpty());
+}
+
+void tst_Q3DSShaderBundle::targetMismatch()
+{
+    Q3DSShaderBundle bundle = m_bundle;
+    bundle.setTarget(QByteArrayLiteral("gles2 lights=8 gles2path"));
+    const QString fn = m_tempDir.filePath(QLatin1String("gles2.shaderbundle"));
+    QVERIFY(bundle.save(fn));
+
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QLatin1String("^Ignoring shader bundle")));
+    QVERIFY(!Q3DSShaderManager::instance().loadShaderBundle(fn));
+    QCOMPARE(Q3DSShaderManager::instance().bundledProgramCount(), 0);
+}
+
+void tst_Q3DSShaderBundle::contextVersion()
+{
+    const Q3DSGraphicsLimits limits = Q3DS::graphicsLimits();
+    const QByteArray target = Q3DSShaderBundle::currentTarget();
+
+    // A bundle for a newer GLSL version than the context supports is no good.
+    Q3DSShaderBundle bundle = m_bundle;
+    bundle.setGlslVersion(430);
+    QVERIFY(!bundle.isUsable());
+    const QString newerFn = m_tempDir.filePath(QLatin1String("gl43.shaderbundle"));
+    QVERIFY(bundle.save(newerFn));
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QLatin1String("^Ignoring shader bundle")));
+    QVERIFY(!Q3DSShaderManager::instance().loadShaderBundle(newerFn));
+    QCOMPARE(Q3DSShaderManager::instance().bundledProgramCount(), 0);
+
+    // Drivers tend to give 4.5 or 4.6 for a 3.3 or 4.3 core profile request.
+    Q3DSGraphicsLimits newer = limits;
+    newer.format.setVersion(4, 6);
+    Q3DS::setGraphicsLimits(newer);
+    QCOMPARE(Q3DSShaderBundle::currentTarget(), target);
+    QCOMPARE(Q3DSShaderBundle::currentGlslVersion(), 460);
+    QVERIFY(bundle.isUsable());
+    QVERIFY(m_bundle.isUsable());
+    Q3DS::setGraphicsLimits(limits);
+}
+
+void tst_Q3DSShaderBundle::useBundle()
+{
+    const QString fn = m_tempDir.filePath(QLatin1String("variants.shaderbundle"));
+    QVERIFY(Q3DSShaderManager::instance().loadShaderBundle(fn));
+    QCOMPARE(Q3DSShaderManager::instance().bundledProgramCount(), m_bundle.count());
+
+    auto material = m_presentation->object<Q3DSDefaultMaterial>("Material");
+    auto light = m_presentation->object<Q3DSLightNode>("Light");
+    const Q3DSShaderBundle::Entry *entry = m_bundle.find(defaultKey(material, { light }, false, false));
+    QVERIFY(entry);
+
+    // Change the bundled source to see that it is what the runtime uses.
+    Q3DSShaderBundle bundle = m_bundle;
+    Q3DSShaderBundle::Entry modified = *entry;
+    modified.sources.fragment += QByteArrayLiteral("\n// bundled\n");
+    bundle.insert(defaultKey(material, { light }, false, false), modified);
+    const QString modifiedFn = m_tempDir.filePath(QLatin1String("modified.shaderbundle"));
+    QVERIFY(bundle.save(modifiedFn));
+    QVERIFY(Q3DSShaderManager::instance().loadShaderBundle(modifiedFn));
+
+    Q3DSShaderFeatureSet features;
+    Q3DSDefaultMaterialGenerator::fillFeatureSet(&features, m_presentation->object<Q3DSLayerNode>("Layer"),
+                                                 false, false, false);
+    Qt3DRender::QShaderProgram *program = Q3DSShaderManager::instance().generateShaderProgram(nullptr, *material, nullptr, { light }, false, features);
+    QVERIFY(program);
+    QCOMPARE(program->fragmentShaderCode(), modified.sources.fragment);
+    QCOMPARE(program->vertexShaderCode(), entry->sources.vertex);
+    delete program;
+}
+
+QTEST_MAIN(tst_Q3DSShaderBundle)
+
+#include "tst_q3dsshaderbundle.moc"
@@ -0,0 +1,8 @@
+TARGET = tst_q3dsshadermanager
+CONFIG += testcase
+
+QT += testlib concurrent 3drender 3dstudioruntime2-private
+
+SOURCES += tst_q3dsshadermanager.cpp
+
+RESOURCES += shadermanager.qrc
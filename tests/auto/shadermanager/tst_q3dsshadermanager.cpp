@@ -0,0 +1,585 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QtConcurrent>
+
+#include <private/q3dsuipparser_p.h>
+#include <private/q3dsuippresentation_p.h>
+#include <private/q3dsgraphicslimits_p.h>
+#include <private/q3dsdefaultmaterialgenerator_p.h>
+#include <private/q3dsshadermanager_p.h>
+#include <private/q3dsutils_p.h>
+#include <private/q3dswindow_p.h>
+#include <private/q3dsengine_p.h>
+#include <private/q3dsslideplayer_p.h>
+
+#include <private/q3dsscenemanager_p.h>
+
+#include <Qt3DCore/QEntity>
+#include <Qt3DRender/QMaterial>
+#include <Qt3DRender/QEffect>
+#include <Qt3DRender/QGeometryRenderer>
+#include <Qt3DRender/QLayer>
+
+#include "../shared/shared.h"
+
+class tst_Q3DSShaderManager : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void nodesPerCache();
+    void cacheOwnerDestroyed();
+    void cacheBounded();
+    void generateFromThreads();
+    void pregenerate();
+
+    void engineDestructionOrder_data();
+    void engineDestructionOrder();
+    void engineReload();
+    void sharedMaterialEffects();
+    void instancedSources();
+    void modelInstancing();
+
+private:
+    struct View {
+        Q3DSEngine *engine = nullptr;
+        Q3DSWindow *window = nullptr;
+        ~View() { delete engine; delete window; }
+    };
+    View *createView(const QString &source = QLatin1String(":/primitives.uip"));
+    static bool allParented(Q3DSShaderProgramCache *programs, const QVector<QByteArray> &names);
+
+    bool m_openGL = false;
+};
+
+void tst_Q3DSShaderManager::initTestCase()
+{
+    m_openGL = isOpenGLGoodEnough();
+    if (m_openGL) {
+        QSurfaceFormat::setDefaultFormat(Q3DS::surfaceFormat());
+        Q3DSUtils::setDialogsEnabled(false);
+    } else {
+        // Generating needs no context, only the limits.
+        Q3DSGraphicsLimits limits;
+        limits.format.setRenderableType(QSurfaceFormat::OpenGL);
+        limits.format.setProfile(QSurfaceFormat::CoreProfile);
+        limits.format.setVersion(3, 3);
+        Q3DS::setGraphicsLimits(limits);
+    }
+}
+
+void tst_Q3DSShaderManager::nodesPerCache()
+{
+    Q3DSShaderManager &sm(Q3DSShaderManager::instance());
+    Q3DSShaderProgramCache programsA;
+    Q3DSShaderProgramCache programsB;
+    QScopedPointer<Qt3DCore::QEntity> rootA(new Qt3DCore::QEntity);
+    QScopedPointer<Qt3DCore::QEntity> rootB(new Qt3DCore::QEntity);
+
+    Qt3DRender::QShaderProgram *a = sm.getDepthPrepassShader(&programsA, rootA.data(), false);
+    Qt3DRender::QShaderProgram *b = sm.getDepthPrepassShader(&programsB, rootB.data(), false);
+    QVERIFY(a);
+    QVERIFY(b);
+    QVERIFY(a != b);
+    QCOMPARE(a->parent(), rootA.data());
+    QCOMPARE(b->parent(), rootB.data());
+    QCOMPARE(a->vertexShaderCode(), b->vertexShaderCode());
+    QCOMPARE(a->fragmentShaderCode(), b->fragmentShaderCode());
+
+    // cached within the same set
+    QCOMPARE(sm.getDepthPrepassShader(&programsA, rootA.data(), false), a);
+    QCOMPARE(programsA.count(), 1);
+
+    // the displaced variant is a program of its own
+    Qt3DRender::QShaderProgram *displaced = sm.getDepthPrepassShader(&programsA, rootA.data(), true);
+    QVERIFY(displaced != a);
+    QVERIFY(displaced->vertexShaderCode() != a->vertexShaderCode());
+    QCOMPARE(programsA.count(), 2);
+
+    Qt3DRender::QShaderProgram *blend2 = sm.getBlendOverlayShader(&programsA, rootA.data(), 2);
+    Qt3DRender::QShaderProgram *blend4 = sm.getBlendOverlayShader(&programsA, rootA.data(), 4);
+    QVERIFY(blend2 != blend4);
+    QCOMPARE(sm.getBlendOverlayShader(&programsA, rootA.data(), 2), blend2);
+    QVERIFY(sm.getBlendOverlayShader(&programsB, rootB.data(), 2) != blend2);
+}
+
+void tst_Q3DSShaderManager::cacheOwnerDestroyed()
+{
+    Q3DSShaderManager &sm(Q3DSShaderManager::instance());
+    Q3DSShaderProgramCache programsA;
+    Q3DSShaderProgramCache programsB;
+    QScopedPointer<Qt3DCore::QEntity> rootA(new Qt3DCore::QEntity);
+    QScopedPointer<Qt3DCore::QEntity> rootB(new Qt3DCore::QEntity);
+
+    sm.getSsaoTextureShader(&programsA, rootA.data());
+    Qt3DRender::QShaderProgram *b = sm.getSsaoTextureShader(&programsB, rootB.data());
+    QCOMPARE(programsA.count(), 1);
+
+    rootA.reset();
+    QCOMPARE(programsA.count(), 0);
+    QVERIFY(!programsA.builtinProgram(QByteArrayLiteral("ssaoTexture")));
+    QCOMPARE(programsB.count(), 1);
+    QCOMPARE(programsB.builtinProgram(QByteArrayLiteral("ssaoTexture")), b);
+
+    // recreated from the shared sources
+    rootA.reset(new Qt3DCore::QEntity);
+    Qt3DRender::QShaderProgram *a = sm.getSsaoTextureShader(&programsA, rootA.data());
+    QVERIFY(a);
+    QCOMPARE(a->parent(), rootA.data());
+    QCOMPARE(a->fragmentShaderCode(), b->fragmentShaderCode());
+    QCOMPARE(sm.getSsaoTextureShader(&programsB, rootB.data()), b);
+}
+
+void tst_Q3DSShaderManager::cacheBounded()
+{
+    Q3DSShaderProgramCache programs;
+    QScopedPointer<Qt3DCore::QEntity> root(new Qt3DCore::QEntity);
+    Q3DSShaderProgramSources sources;
+    sources.vertex = QByteArrayLiteral("void main() { }");
+    sources.fragment = sources.vertex;
+
+    const int max = Q3DSShaderProgramCache::MAX_PROGRAMS;
+    const auto key = [](int i) { return QByteArrayLiteral("program") + QByteArray::number(i); };
+    for (int i = 0; i < max; ++i)
+        programs.createProgram(key(i), sources, QString())->setParent(root.data());
+    QCOMPARE(programs.count(), max);
+
+    // programs gone with their scene make room first
+    Qt3DRender::QShaderProgram *first = programs.program(key(0));
+    for (int i = 1; i <= max / 2; ++i)
+        delete programs.program(key(i));
+    programs.createProgram(key(max), sources, QString())->setParent(root.data());
+    QCOMPARE(programs.count(), max / 2 + 1);
+    QCOMPARE(programs.program(key(0)), first);
+
+    // then the least recently used ones, which stay alive but are no longer shared
+    for (int i = max + 1; i < 3 * max; ++i) {
+        programs.createProgram(key(i), sources, QString())->setParent(root.data());
+        QCOMPARE(programs.program(key(0)), first);
+        QVERIFY(programs.count() <= max);
+    }
+    QVERIFY(!programs.program(key(max)));
+    QCOMPARE(first->parent(), root.data());
+    QVERIFY(programs.program(key(3 * max - 1)));
+}
+
+void tst_Q3DSShaderManager::generateFromThreads()
+{
+    Q3DSUipParser parser;
+    QScopedPointer<Q3DSUipPresentation> presentation(parser.parse(QLatin1String(":/variants.uip"), QLatin1String("variants")));
+    QVERIFY(presentation);
+    auto material = presentation->object<Q3DSDefaultMaterial>("Material");
+    const QVector<Q3DSLightNode *> lights { presentation->object<Q3DSLightNode>("Light") };
+    Q3DSShaderFeatureSet features;
+    Q3DSDefaultMaterialGenerator::fillFeatureSet(&features, presentation->object<Q3DSLayerNode>("Layer"),
+                                                 false, false, false);
+
+    auto generate = [material, lights, features]() {
+        QScopedPointer<Qt3DRender::QShaderProgram> program(
+                    Q3DSShaderManager::instance().generateShaderProgram(nullptr, *material, nullptr, lights, false, features));
+        return program ? program->vertexShaderCode() + program->fragmentShaderCode() : QByteArray();
+    };
+    const QByteArray expected = generate();
+    QVERIFY(!expected.isEmpty());
+
+    QVector<QFuture<QByteArray>> futures;
+    for (int i = 0; i < 8; ++i)
+        futures.append(QtConcurrent::run(generate));
+    for (QFuture<QByteArray> &f : futures)
+        QCOMPARE(f.result(), expected);
+}
+
+void tst_Q3DSShaderManager::pregenerate()
+{
+    Q3DSShaderManager &sm(Q3DSShaderManager::instance());
+    Q3DSUipParser parser;
+    QScopedPointer<Q3DSUipPresentation> presentation(parser.parse(QLatin1String(":/variants.uip"), QLatin1String("variants")));
+    QVERIFY(presentation);
+    auto layer = presentation->object<Q3DSLayerNode>("Layer");
+    auto material = presentation->object<Q3DSDefaultMaterial>("Material");
+    auto customMaterial = presentation->object<Q3DSCustomMaterialInstance>("Aluminum");
+    QVERIFY(!customMaterial->material()->passes().isEmpty());
+    const QString shaderName = customMaterial->material()->passes().first().shaderName;
+
+    QVector<Q3DSShaderManager::MaterialVariant> variants;
+    for (bool shadows : { false, true }) {
+        for (Q3DSLightNode *light : { presentation->object<Q3DSLightNode>("Light"), presentation->object<Q3DSLightNode>("Light2") }) {
+            Q3DSShaderManager::MaterialVariant variant;
+            variant.material = material;
+            variant.lights = { light };
+            Q3DSDefaultMaterialGenerator::fillFeatureSet(&variant.featureSet, layer, false, shadows, false);
+            variants.append(variant);
+            variant.material = customMaterial;
+            variant.shaderName = shaderName;
+            variants.append(variant);
+        }
+    }
+    // duplicates are generated once
+    variants += variants;
+
+    QVector<QByteArray> expected;
+    for (const Q3DSShaderManager::MaterialVariant &variant : variants) {
+        QScopedPointer<Qt3DRender::QShaderProgram> program(variant.material == material
+            ? sm.generateShaderProgram(nullptr, *material, nullptr, variant.lights, false, variant.featureSet)
+            : sm.generateShaderProgram(nullptr, *customMaterial, nullptr, variant.lights, false, variant.featureSet, shaderName));
+        expected.append(program->vertexShaderCode() + program->fragmentShaderCode());
+    }
+
+    const int generated = sm.pregenerateShaderPrograms(variants);
+    QVERIFY(generated > 0);
+    QVERIFY(generated <= variants.count() / 2);
+    QCOMPARE(sm.pregenerateShaderPrograms(variants), 0);
+
+    // Now it is only creating the nodes, with the same code as before.
+    Q3DSShaderProgramCache programs;
+    QScopedPointer<Qt3DCore::QEntity> root(new Qt3DCore::QEntity);
+    for (int i = 0; i < variants.count(); ++i) {
+        const Q3DSShaderManager::MaterialVariant &variant(variants[i]);
+        Qt3DRender::QShaderProgram *program = variant.material == material
+                ? sm.generateShaderProgram(&programs, *material, nullptr, variant.lights, false, variant.featureSet)
+                : sm.generateShaderProgram(&programs, *customMaterial, nullptr, variant.lights, false, variant.featureSet, shaderName);
+        QVERIFY(program);
+        program->setParent(root.data());
+        QCOMPARE(program->vertexShaderCode() + program->fragmentShaderCode(), expected[i]);
+    }
+    QCOMPARE(programs.count(), generated);
+}
+
+tst_Q3DSShaderManager::View *tst_Q3DSShaderManager::createView(const QString &source)
+{
+    View *v = new View;
+    v->engine = new Q3DSEngine;
+    v->window = new Q3DSWindow;
+    v->window->setEngine(v->engine);
+    v->window->forceResize(320, 240);
+    if (!v->engine->setSource(source)) {
+        delete v;
+        return nullptr;
+    }
+    v->window->show();
+    return v;
+}
+
+bool tst_Q3DSShaderManager::allParented(Q3DSShaderProgramCache *programs, const QVector<QByteArray> &names)
+{
+    for (const QByteArray &name : names) {
+        Qt3DRender::QShaderProgram *program = programs->builtinProgram(name);
+        if (!program || !program->parentNode())
+            return false;
+    }
+    return true;
+}
+
+void tst_Q3DSShaderManager::engineDestructionOrder_data()
+{
+    QTest::addColumn<bool>("firstCreatedFirst");
+    QTest::newRow("first created destroyed first") << true;
+    QTest::newRow("last created destroyed first") << false;
+}
+
+void tst_Q3DSShaderManager::engineDestructionOrder()
+{
+    if (!m_openGL)
+        QSKIP("This platform does not support OpenGL proper");
+
+    QFETCH(bool, firstCreatedFirst);
+
+    QScopedPointer<View> first(createView());
+    QVERIFY(first);
+    QScopedPointer<View> second(createView());
+    QVERIFY(second);
+    QVERIFY(QTest::qWaitForWindowExposed(first->window));
+    QVERIFY(QTest::qWaitForWindowExposed(second->window));
+    QTest::qWait(100);
+
+    Q3DSShaderProgramCache *firstPrograms = first->engine->shaderProgramCache();
+    Q3DSShaderProgramCache *secondPrograms = second->engine->shaderProgramCache();
+    QVERIFY(firstPrograms != secondPrograms);
+    const QVector<QByteArray> builtins { QByteArrayLiteral("orthoShadowBlurX"), QByteArrayLiteral("orthoShadowBlurY") };
+    QVERIFY(allParented(firstPrograms, builtins));
+    QVERIFY(allParented(secondPrograms, builtins));
+    for (const QByteArray &name : builtins)
+        QVERIFY(firstPrograms->builtinProgram(name) != secondPrograms->builtinProgram(name));
+
+    QScopedPointer<View> &destroyed(firstCreatedFirst ? first : second);
+    QScopedPointer<View> &remaining(firstCreatedFirst ? second : first);
+    Q3DSShaderProgramCache *remainingPrograms = remaining->engine->shaderProgramCache();
+    const int remainingCount = remainingPrograms->count();
+    QVERIFY(remainingCount > 0);
+
+    destroyed.reset();
+    QCOMPARE(remainingPrograms->count(), remainingCount);
+    QVERIFY(allParented(remainingPrograms, builtins));
+
+    // keeps rendering with its own programs
+    remaining->engine->sceneManager()->slidePlayer()->play();
+    QTest::qWait(100);
+    QCOMPARE(remainingPrograms->count(), remainingCount);
+
+    // and a new engine next to it gets programs of its own again
+    QScopedPointer<View> third(createView());
+    QVERIFY(third);
+    QVERIFY(QTest::qWaitForWindowExposed(third->window));
+    QVERIFY(allParented(third->engine->shaderProgramCache(), builtins));
+    for (const QByteArray &name : builtins)
+        QVERIFY(third->engine->shaderProgramCache()->builtinProgram(name) != remainingPrograms->builtinProgram(name));
+
+    remaining.reset();
+    QVERIFY(allParented(third->engine->shaderProgramCache(), builtins));
+}
+
+void tst_Q3DSShaderManager::engineReload()
+{
+    if (!m_openGL)
+        QSKIP("This platform does not support OpenGL proper");
+
+    QScopedPointer<View> first(createView());
+    QVERIFY(first);
+    QScopedPointer<View> second(createView());
+    QVERIFY(second);
+    QVERIFY(QTest::qWaitForWindowExposed(second->window));
+
+    Q3DSShaderProgramCache *secondPrograms = second->engine->shaderProgramCache();
+    const int secondCount = secondPrograms->count();
+    Qt3DRender::QShaderProgram *blurX = secondPrograms->builtinProgram(QByteArrayLiteral("orthoShadowBlurX"));
+    QVERIFY(blurX);
+
+    // Loading again tears down the first engine's scene (and aspect engine).
+    // The other engine is not affected.
+    QVERIFY(first->engine->setSource(QLatin1String(":/primitives.uip")));
+    QTest::qWait(100);
+    QCOMPARE(secondPrograms->count(), secondCount);
+    QCOMPARE(secondPrograms->builtinProgram(QByteArrayLiteral("orthoShadowBlurX")), blurX);
+    QVERIFY(first->engine->shaderProgramCache()->builtinProgram(QByteArrayLiteral("orthoShadowBlurX")) != blurX);
+}
+
+void tst_Q3DSShaderManager::sharedMaterialEffects()
+{
+    if (!m_openGL)
+        QSKIP("This platform does not support OpenGL proper");
+
+    QScopedPointer<View> view(createView());
+    QVERIFY(view);
+    QVERIFY(QTest::qWaitForWindowExposed(view->window));
+
+    Q3DSUipPresentation *presentation = view->engine->presentation();
+    const auto materialFor = [presentation](const char *modelId) -> Qt3DRender::QMaterial * {
+        Q3DSModelNode *model3DS = presentation->object<Q3DSModelNode>(QByteArray(modelId));
+        Q3DSModelAttached *data = model3DS ? model3DS->attached<Q3DSModelAttached>() : nullptr;
+        return data && !data->subMeshes.isEmpty() ? data->subMeshes[0].materialComponent : nullptr;
+    };
+
+    // The default materials in Layer differ only in uniform values, so they
+    // end up with the same program and share the effect, including its
+    // technique and render passes. The materials stay per model.
+    const QVector<Qt3DRender::QMaterial *> materials {
+        materialFor("Rectangle"), materialFor("Sphere"), materialFor("Cylinder"), materialFor("Cone")
+    };
+    Qt3DRender::QEffect *effect = materials[0] ? materials[0]->effect() : nullptr;
+    QVERIFY(effect);
+    QVERIFY(effect->parameters().isEmpty());
+    QVERIFY(!effect->techniques().isEmpty());
+    for (int i = 0; i < materials.count(); ++i) {
+        QVERIFY(materials[i]);
+        QCOMPARE(materials[i]->effect(), effect);
+        QVERIFY(!materials[i]->parameters().isEmpty());
+        for (int j = i + 1; j < materials.count(); ++j)
+            QVERIFY(materials[i] != materials[j]);
+    }
+
+    // the effects are per layer
+    Qt3DRender::QMaterial *otherLayerMaterial = materialFor("Cube");
+    QVERIFY(otherLayerMaterial);
+    QVERIFY(otherLayerMaterial->effect());
+    QVERIFY(otherLayerMaterial->effect() != effect);
+}
+
+void tst_Q3DSShaderManager::instancedSources()
+{
+    Q3DSShaderManager &sm(Q3DSShaderManager::instance());
+    Q3DSShaderProgramCache programs;
+    QScopedPointer<Qt3DCore::QEntity> root(new Qt3DCore::QEntity);
+
+    // the builtin programs used in the depth and shadow passes
+    const QVector<Qt3DRender::QShaderProgram *> builtins {
+        sm.getDepthPrepassShader(&programs, root.data(), false),
+        sm.getOrthographicDepthNoTessShader(&programs, root.data()),
+        sm.getCubeDepthNoTessShader(&programs, root.data())
+    };
+    for (Qt3DRender::QShaderProgram *program : builtins) {
+        Q3DSShaderProgramSources sources;
+        sources.vertex = program->vertexShaderCode();
+        sources.fragment = program->fragmentShaderCode();
+        Q3DSShaderProgramSources instanced;
+        QVERIFY(Q3DSShaderManager::instancedSources(sources, &instanced));
+        QVERIFY(!instanced.vertex.contains("uniform mat4 modelViewProjection;"));
+        QVERIFY(!instanced.vertex.contains("uniform mat4 modelMatrix;"));
+        QVERIFY(instanced.vertex.contains("#define modelViewProjection (viewProjectionMatrix * modelMatrix)"));
+        for (const char *name : Q3DSShaderManager::instanceModelAttributeNames)
+            QVERIFY(instanced.vertex.contains(QByteArray("attribute vec4 ") + name + ';'));
+        QVERIFY(instanced.vertex.contains("varInstanceOpacity = attr_instanceOpacity;"));
+        // the declarations come before they are used
+        QVERIFY(instanced.vertex.indexOf("#define modelMatrix") < instanced.vertex.indexOf("void main"));
+        QCOMPARE(instanced.fragment, sources.fragment);
+
+        QVERIFY(sm.getInstancedShader(&programs, root.data(), program));
+        QCOMPARE(sm.getInstancedShader(&programs, root.data(), program), sm.getInstancedShader(&programs, root.data(), program));
+    }
+
+    // the object opacity of the default material becomes per instance
+    Q3DSShaderProgramSources sources;
+    sources.vertex = QByteArrayLiteral("attribute vec3 attr_pos;\n"
+                                       "uniform mat4 modelMatrix;\n"
+                                       "uniform mat4 modelViewProjection;\n"
+                                       "uniform mat3 modelNormalMatrix;\n"
+                                       "void main() {\n"
+                                       "    gl_Position = modelViewProjection * vec4(attr_pos, 1.0);\n"
+                                       "}\n");
+    sources.fragment = QByteArrayLiteral("uniform vec4 material_diffuse;\n"
+                                         "void main() {\n"
+                                         "\tfloat object_opacity = material_diffuse.a;\n"
+                                         "    fragOutput = vec4(object_opacity);\n"
+                                         "}\n");
+    Q3DSShaderProgramSources instanced;
+    QVERIFY(Q3DSShaderManager::instancedSources(sources, &instanced));
+    QVERIFY(instanced.vertex.contains("#define modelNormalMatrix mat3(attr_instanceNormal0, attr_instanceNormal1, attr_instanceNormal2)"));
+    QVERIFY(instanced.fragment.contains("float object_opacity = material_diffuse.a * varInstanceOpacity;"));
+    QVERIFY(instanced.fragment.indexOf("varying float varInstanceOpacity;") < instanced.fragment.indexOf("void main"));
+
+    // per-model values that cannot come from the instance
+    Q3DSShaderProgramSources modelView = sources;
+    modelView.vertex.replace("uniform mat3 modelNormalMatrix;", "uniform mat4 modelView;");
+    QVERIFY(!Q3DSShaderManager::instancedSources(modelView, &instanced));
+    Q3DSShaderProgramSources fragmentModelMatrix = sources;
+    fragmentModelMatrix.fragment.prepend("uniform mat4 modelMatrix;\n");
+    QVERIFY(!Q3DSShaderManager::instancedSources(fragmentModelMatrix, &instanced));
+    Q3DSShaderProgramSources tessellated = sources;
+    tessellated.tessControl = QByteArrayLiteral("void main() { }");
+    QVERIFY(!Q3DSShaderManager::instancedSources(tessellated, &instanced));
+}
+
+void tst_Q3DSShaderManager::modelInstancing()
+{
+    if (!m_openGL)
+        QSKIP("This platform does not support OpenGL proper");
+
+    QScopedPointer<View> view(createView(QLatin1String(":/instancing.uip")));
+    QVERIFY(view);
+    QVERIFY(QTest::qWaitForWindowExposed(view->window));
+    QTest::qWait(100);
+
+    const QSurfaceFormat format = Q3DS::graphicsLimits().format;
+    if (Q3DS::graphicsLimits().useGles2Path
+            || format.version() < (format.renderableType() == QSurfaceFormat::OpenGLES ? qMakePair(3, 0) : qMakePair(3, 3)))
+    {
+        QSKIP("Instanced drawing needs OpenGL 3.3 or OpenGL ES 3.0");
+    }
+
+    Q3DSUipPresentation *presentation = view->engine->presentation();
+    Q3DSLayerNode *layer3DS = presentation->object<Q3DSLayerNode>(QByteArrayLiteral("Layer"));
+    QVERIFY(layer3DS);
+    Q3DSLayerAttached *layerData = layer3DS->attached<Q3DSLayerAttached>();
+    const auto modelData = [presentation](const char *id) {
+        Q3DSModelNode *model3DS = presentation->object<Q3DSModelNode>(QByteArray(id));
+        return model3DS ? model3DS->attached<Q3DSModelAttached>() : nullptr;
+    };
+    Q3DSModelAttached *cube = modelData("Cube");
+    Q3DSModelAttached *cube2 = modelData("Cube2");
+    Q3DSModelAttached *cube3 = modelData("Cube3");
+    Q3DSModelAttached *redCube = modelData("RedCube");
+    Q3DSModelAttached *sphere = modelData("Sphere");
+    QVERIFY(cube && cube2 && cube3 && redCube && sphere);
+
+    // The three identical cubes are drawn by one instanced draw call. The
+    // others have a different color or mesh and draw on their own.
+    Q3DSLayerAttached::InstanceGroup *group = cube->instanceGroup;
+    QVERIFY(group);
+    QCOMPARE(cube2->instanceGroup, group);
+    QCOMPARE(cube3->instanceGroup, group);
+    QVERIFY(redCube->instanceGroup != group);
+    QVERIFY(sphere->instanceGroup != group);
+    QVERIFY(group->entity);
+    QCOMPARE(group->renderer->instanceCount(), 3);
+    QVERIFY(group->entity->components().contains(layerData->instancedOpaqueTag));
+    QVERIFY(!group->entity->components().contains(layerData->opaqueTag));
+
+    // the members stay pickable, only their material is gone
+    for (Q3DSModelAttached *data : { cube, cube2, cube3 }) {
+        const Q3DSModelAttached::SubMesh &sm(data->subMeshes.first());
+        QVERIFY(!sm.entity->components().contains(sm.materialComponent));
+        QVERIFY(sm.entity->components().contains(sm.mesh));
+        QVERIFY(sm.entity->components().contains(layerData->opaqueTag));
+    }
+    const Q3DSModelAttached::SubMesh &redSm(redCube->subMeshes.first());
+    QVERIFY(redSm.entity->components().contains(redSm.materialComponent));
+
+    // hiding a member keeps the group
+    Q3DSModelNode *cube2Node = presentation->object<Q3DSModelNode>(QByteArrayLiteral("Cube2"));
+    cube2Node->notifyPropertyChanges({ cube2Node->setEyeballEnabled(false) });
+    QTest::qWait(100);
+    QCOMPARE(cube2->instanceGroup, group);
+    QCOMPARE(group->renderer->instanceCount(), 3);
+
+    // moving one updates the instance data, not the grouping
+    Q3DSModelNode *cube3Node = presentation->object<Q3DSModelNode>(QByteArrayLiteral("Cube3"));
+    cube3Node->notifyPropertyChanges({ cube3Node->setPosition(QVector3D(150, 0, 0)) });
+    QTest::qWait(100);
+    QCOMPARE(cube3->instanceGroup, group);
+
+    // a different color takes it out of the group, which is then down to two
+    Q3DSDefaultMaterial *mat = presentation->object<Q3DSDefaultMaterial>(QByteArrayLiteral("Material_002"));
+    QVERIFY(mat);
+    mat->notifyPropertyChanges({ mat->setDiffuse(Qt::green) });
+    QTest::qWait(100);
+    QVERIFY(cube3->instanceGroup != group);
+    QCOMPARE(cube->instanceGroup, group);
+    QCOMPARE(group->renderer->instanceCount(), 2);
+    const Q3DSModelAttached::SubMesh &cube3Sm(cube3->subMeshes.first());
+    QVERIFY(cube3Sm.entity->components().contains(cube3Sm.materialComponent));
+
+    // and with one member left it draws on its own again
+    Q3DSDefaultMaterial *mat2 = presentation->object<Q3DSDefaultMaterial>(QByteArrayLiteral("Material_001"));
+    mat2->notifyPropertyChanges({ mat2->setDiffuse(Qt::green) });
+    QTest::qWait(100);
+    QVERIFY(!cube->instanceGroup || !cube->instanceGroup->entity);
+    const Q3DSModelAttached::SubMesh &cubeSm(cube->subMeshes.first());
+    QVERIFY(cubeSm.entity->components().contains(cubeSm.materialComponent));
+
+    // Cube2 and Cube3 are now the same again
+    QVERIFY(cube2->instanceGroup);
+    QCOMPARE(cube2->instanceGroup, cube3->instanceGroup);
+    QVERIFY(cube2->instanceGroup->entity);
+}
+
+QTEST_MAIN(tst_Q3DSShaderManager)
+
+#include "tst_q3dsshadermanager.moc"
@@ -64,6 +64,9 @@ private Q_SLOTS:
 
     void tst_slideDeck();
     void tst_playModes();
+    void tst_objectSchedule();
+    void tst_intervalVisibility();
+    void tst_nestedComponents();
 
 private:
     Q3DSEngine *m_engine = nullptr;
@@ -352,6 +355,179 @@ void tst_Q3DSSlidePlayer::tst_playModes()
     QCOMPARE(player->slideDeck()->currentSlide(), m_dummy);
 }
 
+void tst_Q3DSSlidePlayer::tst_objectSchedule()
+{
+    // The objects visited when moving from one time to another must include
+    // every object for which a full evaluation gives a different result, for
+    // forward and reverse playback as well as for seeks.
+    struct Interval {
+        float start;
+        float end;
+    };
+    const auto inInterval = [](const Interval &i, float t) { return t >= i.start && t <= i.end; };
+
+    QVector<Q3DSGroupNode *> objects;
+    QVector<Interval> intervals;
+    Q3DSSlideObjectSchedule schedule;
+    for (int i = 0; i < 200; ++i) {
+        const float start = float((i * 37) % 1000);
+        const float end = (i % 10 == 0) ? start : qMin(1000.0f, start + float((i * 53) % 700));
+        objects.append(new Q3DSGroupNode);
+        intervals.append({ start, end });
+        schedule.addObject(objects.last(), start, end);
+    }
+    schedule.sort();
+    QCOMPARE(schedule.count(), objects.count());
+
+    QVector<float> times;
+    // forward playback at 60 fps
+    for (float t = 0.0f; t <= 1000.0f; t += 16.667f)
+        times.append(t);
+    // reverse, as in ping-pong
+    for (float t = 1000.0f; t >= 0.0f; t -= 16.667f)
+        times.append(t);
+    // seeks, including landing exactly on boundaries
+    times << 500.0f << 37.0f << 999.0f << 1000.0f << 0.0f << 740.0f << 740.0f << 123.0f << 901.0f;
+
+    float previous = times.first();
+    for (float t : qAsConst(times)) {
+        QHash<Q3DSGraphObject *, int> visited;
+        schedule.forCrossedObjects(previous, t, [&visited](Q3DSGraphObject *obj) { ++visited[obj]; });
+        for (int i = 0; i < objects.count(); ++i) {
+            const bool changed = inInterval(intervals[i], previous) != inInterval(intervals[i], t);
+            if (changed)
+                QVERIFY(visited.contains(objects[i]));
+            QVERIFY(visited.value(objects[i]) <= 1);
+        }
+        previous = t;
+    }
+
+    qDeleteAll(objects);
+}
+
+void tst_Q3DSSlidePlayer::tst_intervalVisibility()
+{
+    Q3DSSlidePlayer *player = m_sceneManager->slidePlayer();
+    player->stop();
+    QTRY_COMPARE(player->state(), Q3DSSlidePlayer::PlayerState::Stopped);
+
+    player->slideDeck()->setCurrentSlide(int(Slide::PingPong));
+    player->stop();
+    QTRY_COMPARE(player->state(), Q3DSSlidePlayer::PlayerState::Stopped);
+    QCOMPARE(player->slideDeck()->currentSlide(), m_pingPong);
+
+    Q3DSNode *cylinder = m_presentation->object<Q3DSNode>("Cylinder_001");
+    QVERIFY(cylinder);
+    QVERIFY(cylinder->attached());
+
+    // Visible in the middle of the slide only. While ping-ponging the
+    // boundaries get crossed in both directions, only the schedule can notice.
+    const qint32 startTime = cylinder->startTime();
+    const qint32 endTime = cylinder->endTime();
+    cylinder->notifyPropertyChanges({ cylinder->setStartTime(300), cylinder->setEndTime(700) });
+
+    const auto isVisible = [cylinder] {
+        return cylinder->attached()->visibilityTag == Q3DSGraphObjectAttached::Visible;
+    };
+
+    player->play();
+    QTRY_COMPARE(player->state(), Q3DSSlidePlayer::PlayerState::Playing);
+    for (int i = 0; i < 3; ++i) {
+        QTRY_VERIFY(isVisible());
+        QTRY_VERIFY(!isVisible());
+    }
+    player->stop();
+    QTRY_COMPARE(player->state(), Q3DSSlidePlayer::PlayerState::Stopped);
+
+    // the presentation is shared with the other tests
+    cylinder->notifyPropertyChanges({ cylinder->setStartTime(startTime), cylinder->setEndTime(endTime) });
+}
+
+void tst_Q3DSSlidePlayer::tst_nestedComponents()
+{
+    // Eight levels of paused components, with a looping slide on the top
+    // and an object blinking on and off in it.
+    QScopedPointer<Q3DSEngine> engine(new Q3DSEngine);
+    QScopedPointer<Q3DSWindow> view(new Q3DSWindow);
+    view->setEngine(engine.data());
+    view->forceResize(640, 480);
+    QVERIFY(engine->setSource(QLatin1String(":/nestedcomponents.uip")));
+    view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(view.data()));
+
+    Q3DSUipPresentation *presentation = engine->presentation();
+    Q3DSSceneManager *sceneManager = engine->sceneManager();
+
+    const int depth = 8;
+    QVector<Q3DSComponentNode *> components;
+    QVector<Q3DSNode *> cubes;
+    QVector<Q3DSSlidePlayer *> players;
+    for (int i = 1; i <= depth; ++i) {
+        components.append(presentation->object<Q3DSComponentNode>(QByteArrayLiteral("Comp") + QByteArray::number(i)));
+        QVERIFY(components.last());
+        cubes.append(presentation->object<Q3DSNode>(QByteArrayLiteral("Cube") + QByteArray::number(i)));
+        QVERIFY(cubes.last());
+        players.append(components.last()->masterSlide()->attached<Q3DSSlideAttached>()->slidePlayer);
+        QVERIFY(players.last());
+    }
+    Q3DSNode *blinker = presentation->object<Q3DSNode>("Blinker");
+    QVERIFY(blinker);
+
+    const auto isVisible = [](Q3DSGraphObject *obj) {
+        return obj->attached() && obj->attached()->visibilityTag == Q3DSGraphObjectAttached::Visible;
+    };
+    const auto visibleCubes = [&cubes, isVisible] {
+        return int(std::count_if(cubes.cbegin(), cubes.cend(), isVisible));
+    };
+
+    Q3DSSlidePlayer *player = sceneManager->slidePlayer();
+    player->play();
+    QTRY_COMPARE(player->state(), Q3DSSlidePlayer::PlayerState::Playing);
+    for (Q3DSSlidePlayer *componentPlayer : players)
+        QCOMPARE(componentPlayer->state(), Q3DSSlidePlayer::PlayerState::Paused);
+    QTRY_COMPARE(visibleCubes(), depth);
+
+    // Once settled, the blinker going on and off makes the scene's player
+    // look at all its objects, but none of the components has to.
+    QTRY_VERIFY(isVisible(blinker));
+    QTRY_VERIFY(!isVisible(blinker));
+    const int sceneUpdates = player->fullVisibilityUpdateCount();
+    QVector<int> componentUpdates;
+    for (Q3DSSlidePlayer *componentPlayer : players)
+        componentUpdates.append(componentPlayer->fullVisibilityUpdateCount());
+    for (int i = 0; i < 3; ++i) {
+        QTRY_VERIFY(isVisible(blinker));
+        QTRY_VERIFY(!isVisible(blinker));
+    }
+    QVERIFY(player->fullVisibilityUpdateCount() > sceneUpdates);
+    for (int i = 0; i < depth; ++i)
+        QCOMPARE(players[i]->fullVisibilityUpdateCount(), componentUpdates[i]);
+    QCOMPARE(visibleCubes(), depth);
+
+    // Still, what the components show follows the changes above them.
+    sceneManager->changeSlideByName(components[3], QLatin1String("Empty"));
+    QTRY_COMPARE(visibleCubes(), 3);
+    QTRY_VERIFY(isVisible(blinker));
+    QCOMPARE(visibleCubes(), 3);
+    sceneManager->changeSlideByName(components[3], QLatin1String("Shown"));
+    QTRY_COMPARE(visibleCubes(), depth);
+
+    components[1]->notifyPropertyChanges({ components[1]->setEyeballEnabled(false) });
+    QTRY_COMPARE(visibleCubes(), 1);
+    QVERIFY(isVisible(cubes.first()));
+    components[1]->notifyPropertyChanges({ components[1]->setEyeballEnabled(true) });
+    QTRY_COMPARE(visibleCubes(), depth);
+
+    sceneManager->changeSlideByName(components[depth - 1], QLatin1String("Empty"));
+    QTRY_COMPARE(visibleCubes(), depth - 1);
+    QVERIFY(!isVisible(cubes.last()));
+    sceneManager->changeSlideByName(components[depth - 1], QLatin1String("Shown"));
+    QTRY_COMPARE(visibleCubes(), depth);
+
+    player->stop();
+    QTRY_COMPARE(player->state(), Q3DSSlidePlayer::PlayerState::Stopped);
+}
+
 QTEST_MAIN(tst_Q3DSSlidePlayer);
 
 #include "tst_q3dsslideplayer.moc"
@@ -57,6 +57,7 @@ private Q_SLOTS:
     void deepComponentRollback();
     void setNonVisibleComponentSlides();
     void testTimeLineVisibility();
+    void slideActions();
 
 private:
     Q3DSModelNode *getModelWithName(const QString &name, Q3DSGraphObject *parent);
@@ -761,6 +762,77 @@ void tst_Q3DSSlides::testTimeLineVisibility()
     QVERIFY(!isNodeVisible(m_componentMasterCubeSlide5));
 }
 
+void tst_Q3DSSlides::slideActions()
+{
+    m_sceneManager->setCurrentSlide(m_presentationSlide1, true);
+
+    // The action from the uip: pressing Slide1Rect goes to Slide2. An event
+    // nobody reacts to must not do anything.
+    m_slide1Rect->processEvent(Q3DSGraphObject::Event(m_slide1Rect, Q3DSGraphObjectEvents::tapEvent()));
+    QCOMPARE(m_sceneManager->currentSlide(), m_presentationSlide1);
+    m_slide1Rect->processEvent(Q3DSGraphObject::Event(m_slide1Rect, Q3DSGraphObjectEvents::pressureDownEvent()));
+    QCOMPARE(m_sceneManager->currentSlide(), m_presentationSlide2);
+
+    m_sceneManager->setCurrentSlide(m_presentationSlide1, true);
+
+    const auto setPropertyAction = [this](const QByteArray &id, const QString &property,
+                                          Q3DS::PropertyType type, const QString &value) {
+        Q3DSAction action;
+        action.owner = m_slide1Rect;
+        action.id = id;
+        action.triggerObject = m_slide1Rect;
+        action.event = QLatin1String("onCustom");
+        action.targetObject = m_slide1Rect;
+        action.handler = Q3DSAction::SetProperty;
+        Q3DSAction::HandlerArgument name;
+        name.name = QLatin1String("Property Name");
+        name.type = Q3DS::String;
+        name.argType = Q3DSAction::HandlerArgument::Property;
+        name.value = property;
+        Q3DSAction::HandlerArgument newValue;
+        newValue.name = QLatin1String("Property Value");
+        newValue.type = type;
+        newValue.argType = Q3DSAction::HandlerArgument::Dependent;
+        newValue.value = value;
+        action.handlerArgs = { name, newValue };
+        return action;
+    };
+
+    // opacity has its value converted when the action is compiled, name goes
+    // through the generic property change path
+    const Q3DSAction opacityAction = setPropertyAction(QByteArrayLiteral("Slide1Rect-Opacity"),
+                                                       QLatin1String("opacity"), Q3DS::Float, QLatin1String("25"));
+    const Q3DSAction nameAction = setPropertyAction(QByteArrayLiteral("Slide1Rect-Name"),
+                                                    QLatin1String("name"), Q3DS::String, QLatin1String("RenamedRect"));
+    const QString oldName = m_slide1Rect->name();
+    const float oldOpacity = m_slide1Rect->localOpacity();
+
+    QSet<QString> changedKeys;
+    const int observerIndex = m_slide1Rect->addPropertyChangeObserver(
+                [&changedKeys](Q3DSGraphObject *, const QSet<QString> &keys, int) { changedKeys += keys; });
+
+    m_presentationSlide1->addAction(opacityAction);
+    m_presentationSlide1->addAction(nameAction);
+    m_slide1Rect->processEvent(Q3DSGraphObject::Event(m_slide1Rect, QLatin1String("onCustom")));
+    QCOMPARE(m_slide1Rect->localOpacity(), 25.0f);
+    QCOMPARE(m_slide1Rect->name(), QLatin1String("RenamedRect"));
+    QVERIFY(changedKeys.contains(QLatin1String("opacity")));
+    QVERIFY(changedKeys.contains(QLatin1String("name")));
+
+    // Removed actions must not fire anymore.
+    m_presentationSlide1->removeAction(opacityAction);
+    m_presentationSlide1->removeAction(nameAction);
+    m_slide1Rect->applyPropertyChanges({ Q3DSPropertyChange(QLatin1String("opacity"), QString::number(oldOpacity)),
+                                         Q3DSPropertyChange(QLatin1String("name"), oldName) });
+    changedKeys.clear();
+    m_slide1Rect->processEvent(Q3DSGraphObject::Event(m_slide1Rect, QLatin1String("onCustom")));
+    QCOMPARE(m_slide1Rect->localOpacity(), oldOpacity);
+    QCOMPARE(m_slide1Rect->name(), oldName);
+    QVERIFY(changedKeys.isEmpty());
+
+    m_slide1Rect->removePropertyChangeObserver(observerIndex);
+}
+
 Q3DSModelNode *tst_Q3DSSlides::getModelWithName(const QString &name, Q3DSGraphObject *parent)
 {
     Q3DSGraphObject *n = parent->firstChild();
@@ -0,0 +1,245 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+
+#include <private/q3dsutils_p.h>
+#include <private/q3dswindow_p.h>
+#include <private/q3dsengine_p.h>
+#include <private/q3dsscenemanager_p.h>
+#include <private/q3dsslideplayer_p.h>
+
+#include "../shared/shared.h"
+
+class tst_Q3DSSubPresentations : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~tst_Q3DSSubPresentations();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void suspendHiddenImageSubPresentation();
+    void subPresentationScale();
+
+private:
+    Q3DSSceneManager *subPresentationSceneManager(const QString &id) const;
+    void removeObject(Q3DSGraphObject *obj);
+
+    Q3DSEngine *m_engine = nullptr;
+    Q3DSWindow *m_view = nullptr;
+    bool m_hasOpenGL = false;
+};
+
+tst_Q3DSSubPresentations::~tst_Q3DSSubPresentations()
+{
+    delete m_engine;
+    delete m_view;
+}
+
+void tst_Q3DSSubPresentations::initTestCase()
+{
+    m_hasOpenGL = isOpenGLGoodEnough();
+    if (!m_hasOpenGL)
+        return;
+
+    QSurfaceFormat::setDefaultFormat(Q3DS::surfaceFormat());
+    m_engine = new Q3DSEngine;
+    m_view = new Q3DSWindow;
+    m_view->setEngine(m_engine);
+    m_view->forceResize(640, 480);
+
+    Q3DSUtils::setDialogsEnabled(false);
+    QVERIFY(m_engine->setSource(QLatin1String(":/main_bottom_withimage.uia")));
+    QVERIFY(m_engine->sceneManager());
+
+    m_view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(m_view));
+}
+
+void tst_Q3DSSubPresentations::cleanupTestCase()
+{
+    if (m_view)
+        m_view->close();
+}
+
+Q3DSSceneManager *tst_Q3DSSubPresentations::subPresentationSceneManager(const QString &id) const
+{
+    for (int i = 0; i < m_engine->presentationCount(); ++i) {
+        if (m_engine->presentation(i)->name() == id)
+            return m_engine->sceneManager(i);
+    }
+    return nullptr;
+}
+
+static void removeFromSlide(Q3DSGraphObject *obj, Q3DSSlide *slide)
+{
+    while (slide) {
+        if (slide->objects().contains(obj)) {
+            slide->removeObject(obj);
+            return;
+        }
+        removeFromSlide(obj, static_cast<Q3DSSlide *>(slide->firstChild()));
+        slide = static_cast<Q3DSSlide *>(slide->nextSibling());
+    }
+}
+
+void tst_Q3DSSubPresentations::removeObject(Q3DSGraphObject *obj)
+{
+    Q3DSUipPresentation *presentation = m_engine->presentation();
+    Q3DSUipPresentation::forAllObjectsInSubTree(obj, [presentation](Q3DSGraphObject *objOrChild) {
+        removeFromSlide(objOrChild, presentation->masterSlide());
+    });
+    presentation->unlinkObject(obj);
+    delete obj;
+}
+
+// subpres2 is only used as the texture map of two models. Hiding both
+// suspends its rendering and pauses its slides, showing one of them again
+// continues from the same time.
+// Removing the models must not leave anything behind that still looks at
+// the images.
+void tst_Q3DSSubPresentations::suspendHiddenImageSubPresentation()
+{
+    if (!m_hasOpenGL)
+        QSKIP("This platform does not support OpenGL proper");
+
+    const QString subPresId = QStringLiteral("subpres2");
+    Q3DSSceneManager *sceneManager = m_engine->sceneManager();
+    Q3DSUipPresentation *presentation = m_engine->presentation();
+    Q3DSSceneManager *subSceneManager = subPresentationSceneManager(subPresId);
+    QVERIFY(subSceneManager);
+    QVERIFY(subSceneManager->slidePlayer());
+
+    QSignalSpy frameSpy(m_engine, SIGNAL(nextFrameStarting()));
+    QTRY_VERIFY(frameSpy.count() >= 5);
+    QVERIFY(sceneManager->isSubPresentationActive(subPresId));
+
+    Q3DSModelNode *cylinder = presentation->object<Q3DSModelNode>(QByteArrayLiteral("Cylinder"));
+    Q3DSModelNode *rect = presentation->object<Q3DSModelNode>(QByteArrayLiteral("Rect"));
+    QVERIFY(cylinder);
+    QVERIFY(rect);
+
+    const auto setVisible = [](Q3DSModelNode *model, bool visible) {
+        const Q3DSPropertyChangeList cl { model->setEyeballEnabled(visible) };
+        model->notifyPropertyChanges(cl);
+    };
+
+    setVisible(cylinder, false);
+    frameSpy.clear();
+    QTRY_VERIFY(frameSpy.count() >= 5);
+    QVERIFY(sceneManager->isSubPresentationActive(subPresId));
+
+    Q3DSSlidePlayer *subPlayer = subSceneManager->slidePlayer();
+    QCOMPARE(subPlayer->state(), Q3DSSlidePlayer::PlayerState::Playing);
+    QVERIFY(!subSceneManager->isSuspended());
+
+    setVisible(rect, false);
+    QTRY_VERIFY(!sceneManager->isSubPresentationActive(subPresId));
+    QVERIFY(subSceneManager->isSuspended());
+    QCOMPARE(subPlayer->state(), Q3DSSlidePlayer::PlayerState::Paused);
+
+    // the slide time stands still while suspended
+    const float position = subPlayer->position();
+    frameSpy.clear();
+    QTRY_VERIFY(frameSpy.count() >= 5);
+    QCOMPARE(subPlayer->position(), position);
+
+    // and continues from there
+    setVisible(cylinder, true);
+    QTRY_VERIFY(sceneManager->isSubPresentationActive(subPresId));
+    QVERIFY(!subSceneManager->isSuspended());
+    QCOMPARE(subPlayer->state(), Q3DSSlidePlayer::PlayerState::Playing);
+    QTRY_VERIFY(subPlayer->position() != position);
+
+    // Remove both models, together with their materials and images.
+    removeObject(cylinder);
+    frameSpy.clear();
+    QTRY_VERIFY(frameSpy.count() >= 5);
+    QVERIFY(!sceneManager->isSubPresentationActive(subPresId));
+
+    setVisible(rect, true);
+    QTRY_VERIFY(sceneManager->isSubPresentationActive(subPresId));
+    removeObject(rect);
+    QTRY_VERIFY(!sceneManager->isSubPresentationActive(subPresId));
+    frameSpy.clear();
+    QTRY_VERIFY(frameSpy.count() >= 5);
+}
+
+void tst_Q3DSSubPresentations::subPresentationScale()
+{
+    int shrinkFrames = 0;
+
+    // quantized to the power of two covering the wanted scale
+    QCOMPARE(Q3DSSceneManager::nextSubPresentationScale(1.0f, 1.3f, 2.0f, &shrinkFrames), 2.0f);
+    QCOMPARE(Q3DSSceneManager::nextSubPresentationScale(0.125f, 0.3f, 2.0f, &shrinkFrames), 0.5f);
+    QCOMPARE(Q3DSSceneManager::nextSubPresentationScale(0.125f, 0.01f, 2.0f, &shrinkFrames), 0.125f);
+    // but never above the maximum
+    QCOMPARE(Q3DSSceneManager::nextSubPresentationScale(1.0f, 10.0f, 2.0f, &shrinkFrames), 2.0f);
+    QCOMPARE(Q3DSSceneManager::nextSubPresentationScale(0.25f, 10.0f, 0.5f, &shrinkFrames), 0.5f);
+    QCOMPARE(shrinkFrames, 0);
+
+    // slightly below the next smaller step is within the margin: no change
+    float scale = 2.0f;
+    for (int i = 0; i < 100; ++i)
+        scale = Q3DSSceneManager::nextSubPresentationScale(scale, 0.9f, 2.0f, &shrinkFrames);
+    QCOMPARE(scale, 2.0f);
+    QCOMPARE(shrinkFrames, 0);
+
+    // well below it, shrinking happens only after 30 frames
+    for (int i = 0; i < 29; ++i) {
+        scale = Q3DSSceneManager::nextSubPresentationScale(scale, 0.3f, 2.0f, &shrinkFrames);
+        QCOMPARE(scale, 2.0f);
+    }
+    QCOMPARE(shrinkFrames, 29);
+    scale = Q3DSSceneManager::nextSubPresentationScale(scale, 0.3f, 2.0f, &shrinkFrames);
+    QCOMPARE(scale, 0.5f);
+    QCOMPARE(shrinkFrames, 0);
+
+    // a frame back within the margin restarts the countdown
+    for (int i = 0; i < 20; ++i)
+        scale = Q3DSSceneManager::nextSubPresentationScale(scale, 0.1f, 2.0f, &shrinkFrames);
+    QCOMPARE(shrinkFrames, 20);
+    scale = Q3DSSceneManager::nextSubPresentationScale(scale, 0.5f, 2.0f, &shrinkFrames);
+    QCOMPARE(scale, 0.5f);
+    QCOMPARE(shrinkFrames, 0);
+
+    // growing happens right away, also in the middle of a countdown
+    for (int i = 0; i < 20; ++i)
+        scale = Q3DSSceneManager::nextSubPresentationScale(scale, 0.1f, 2.0f, &shrinkFrames);
+    scale = Q3DSSceneManager::nextSubPresentationScale(scale, 0.6f, 2.0f, &shrinkFrames);
+    QCOMPARE(scale, 1.0f);
+    QCOMPARE(shrinkFrames, 0);
+}
+
+QTEST_MAIN(tst_Q3DSSubPresentations)
+
+#include "tst_q3dssubpresentations.moc"
@@ -0,0 +1,214 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtTest>
+#include <Qt3DCore/QEntity>
+#include <Qt3DRender/QTexture>
+#include <private/q3dstexturepool_p.h>
+
+class tst_Q3DSTexturePool : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void createAndReuse();
+    void keyMismatch();
+    void samplerStateReset();
+    void idleTexturesAreDestroyed();
+    void parentDestroyed();
+};
+
+void tst_Q3DSTexturePool::createAndReuse()
+{
+    Qt3DCore::QEntity root;
+    Q3DSTexturePool pool;
+    pool.setParentNode(&root);
+
+    const Q3DSTexturePool::Key key(Qt3DRender::QAbstractTexture::Target2D,
+                                   Qt3DRender::QAbstractTexture::RGBA8_UNorm,
+                                   QSize(640, 480));
+    bool reused = true;
+    Qt3DRender::QAbstractTexture *t1 = pool.acquire(key, &reused);
+    QVERIFY(t1);
+    QVERIFY(!reused);
+    QCOMPARE(t1->parent(), &root);
+    QCOMPARE(t1->target(), Qt3DRender::QAbstractTexture::Target2D);
+    QCOMPARE(t1->format(), Qt3DRender::QAbstractTexture::RGBA8_UNorm);
+    QCOMPARE(t1->width(), 640);
+    QCOMPARE(t1->height(), 480);
+    // Qt 3D reports 1 sample for non-multisample textures
+    QCOMPARE(Q3DSTexturePool::Key::fromTexture(t1), key);
+
+    // a second user while the first one is still alive gets its own texture
+    Qt3DRender::QAbstractTexture *t2 = pool.acquire(key, &reused);
+    QVERIFY(!reused);
+    QVERIFY(t1 != t2);
+
+    pool.release(t1);
+    pool.newFrame();
+    QCOMPARE(pool.stats().freeCount, 1);
+
+    Qt3DRender::QAbstractTexture *t3 = pool.acquire(key, &reused);
+    QVERIFY(reused);
+    QCOMPARE(t3, t1);
+    QCOMPARE(pool.stats().freeCount, 0);
+    QCOMPARE(pool.stats().created, 2);
+    QCOMPARE(pool.stats().reused, 1);
+
+    // the key is taken from the texture at release time, so textures resized
+    // by their previous user are matched by their current size
+    t2->setWidth(800);
+    t2->setHeight(600);
+    pool.release(t2);
+    const Q3DSTexturePool::Key resizedKey(Qt3DRender::QAbstractTexture::Target2D,
+                                          Qt3DRender::QAbstractTexture::RGBA8_UNorm,
+                                          QSize(800, 600));
+    QCOMPARE(pool.acquire(resizedKey, &reused), t2);
+    QVERIFY(reused);
+}
+
+void tst_Q3DSTexturePool::keyMismatch()
+{
+    Qt3DCore::QEntity root;
+    Q3DSTexturePool pool;
+    pool.setParentNode(&root);
+
+    const QSize sz(256, 256);
+    Qt3DRender::QAbstractTexture *t = pool.acquire(Q3DSTexturePool::Key(Qt3DRender::QAbstractTexture::Target2D,
+                                                                        Qt3DRender::QAbstractTexture::RGBA8_UNorm, sz));
+    pool.release(t);
+
+    bool reused = true;
+    Qt3DRender::QAbstractTexture *other = pool.acquire(Q3DSTexturePool::Key(Qt3DRender::QAbstractTexture::Target2D,
+                                                                            Qt3DRender::QAbstractTexture::RGBA16F, sz), &reused);
+    QVERIFY(!reused);
+    QVERIFY(other != t);
+
+    other = pool.acquire(Q3DSTexturePool::Key(Qt3DRender::QAbstractTexture::Target2D,
+                                              Qt3DRender::QAbstractTexture::RGBA8_UNorm, QSize(128, 128)), &reused);
+    QVERIFY(!reused);
+
+    other = pool.acquire(Q3DSTexturePool::Key(Qt3DRender::QAbstractTexture::TargetCubeMap,
+                                              Qt3DRender::QAbstractTexture::RGBA8_UNorm, sz), &reused);
+    QVERIFY(!reused);
+    QVERIFY(qobject_cast<Qt3DRender::QTextureCubeMap *>(other));
+
+    other = pool.acquire(Q3DSTexturePool::Key(Qt3DRender::QAbstractTexture::Target2DMultisample,
+                                              Qt3DRender::QAbstractTexture::RGBA8_UNorm, sz, 4), &reused);
+    QVERIFY(!reused);
+    QCOMPARE(other->samples(), 4);
+    QCOMPARE(Q3DSTexturePool::Key::fromTexture(other).samples, 4);
+
+    QCOMPARE(pool.stats().freeCount, 1);
+}
+
+void tst_Q3DSTexturePool::samplerStateReset()
+{
+    Qt3DCore::QEntity root;
+    Q3DSTexturePool pool;
+    pool.setParentNode(&root);
+
+    const Q3DSTexturePool::Key key(Qt3DRender::QAbstractTexture::Target2D,
+                                   Qt3DRender::QAbstractTexture::RGBA8_UNorm,
+                                   QSize(64, 64));
+    Qt3DRender::QAbstractTexture *t = pool.acquire(key);
+    t->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
+    t->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
+    t->setWrapMode(Qt3DRender::QTextureWrapMode(Qt3DRender::QTextureWrapMode::Repeat));
+    t->setGenerateMipMaps(true);
+
+    Qt3DCore::QEntity otherParent;
+    t->setParent(&otherParent);
+    pool.release(t);
+    QCOMPARE(t->parent(), &root);
+
+    QCOMPARE(pool.acquire(key), t);
+    QCOMPARE(t->minificationFilter(), Qt3DRender::QAbstractTexture::Nearest);
+    QCOMPARE(t->magnificationFilter(), Qt3DRender::QAbstractTexture::Nearest);
+    QCOMPARE(t->wrapMode()->x(), Qt3DRender::QTextureWrapMode::ClampToEdge);
+    QVERIFY(!t->generateMipMaps());
+}
+
+void tst_Q3DSTexturePool::idleTexturesAreDestroyed()
+{
+    Qt3DCore::QEntity root;
+    Q3DSTexturePool pool;
+    pool.setParentNode(&root);
+    pool.setMaxIdleFrames(3);
+
+    const Q3DSTexturePool::Key key(Qt3DRender::QAbstractTexture::Target2D,
+                                   Qt3DRender::QAbstractTexture::RGBA8_UNorm,
+                                   QSize(64, 64));
+    QPointer<Qt3DRender::QAbstractTexture> t = pool.acquire(key);
+    pool.release(t);
+
+    for (int i = 0; i < 3; ++i) {
+        pool.newFrame();
+        QVERIFY(t);
+    }
+    pool.newFrame();
+    QVERIFY(!t);
+    QCOMPARE(pool.stats().freeCount, 0);
+    QCOMPARE(pool.stats().destroyed, 1);
+
+    t = pool.acquire(key);
+    pool.release(t);
+    pool.clear();
+    QVERIFY(!t);
+}
+
+void tst_Q3DSTexturePool::parentDestroyed()
+{
+    Q3DSTexturePool pool;
+    Qt3DCore::QEntity *root = new Qt3DCore::QEntity;
+    pool.setParentNode(root);
+
+    const Q3DSTexturePool::Key key(Qt3DRender::QAbstractTexture::Target2D,
+                                   Qt3DRender::QAbstractTexture::RGBA8_UNorm,
+                                   QSize(64, 64));
+    pool.release(pool.acquire(key));
+    QCOMPARE(pool.stats().freeCount, 1);
+
+    // the textures go away together with the scene, the pool must not
+    // hand out or delete dangling pointers afterwards
+    delete root;
+    pool.newFrame();
+    QCOMPARE(pool.stats().freeCount, 0);
+
+    Qt3DCore::QEntity newRoot;
+    pool.setParentNode(&newRoot);
+    bool reused = true;
+    Qt3DRender::QAbstractTexture *t = pool.acquire(key, &reused);
+    QVERIFY(!reused);
+    QCOMPARE(t->parent(), &newRoot);
+}
+
+QTEST_APPLESS_MAIN(tst_Q3DSTexturePool)
+
+#include "tst_q3dstexturepool.moc"
@@ -28,6 +28,7 @@
 
 #include <QtTest/QtTest>
 #include <private/q3dsuippresentation_p.h>
+#include <private/q3dspresentationdiff_p.h>
 #include <private/q3dsutils_p.h>
 
 class tst_Q3DSUipPresentation : public QObject
@@ -44,6 +45,7 @@ private slots:
     void slideConstruct();
     void events();
     void eventsCatchAll();
+    void diff();
 
 private:
     void makePresentation(Q3DSUipPresentation &presentation);
@@ -569,5 +571,70 @@ void tst_Q3DSUipPresentation::eventsCatchAll()
     QCOMPARE(triggerCount[1], 1);
 }
 
+void tst_Q3DSUipPresentation::diff()
+{
+    Q3DSUipPresentation live;
+    makePresentation(live);
+    Q3DSUipPresentation before;
+    makePresentation(before);
+    Q3DSUipPresentation after;
+    makePresentation(after);
+
+    Q3DSPresentationDiff diff;
+    QVERIFY(diff.compute(&before, &after));
+    QVERIFY(diff.isEmpty());
+
+    // change a property, add a model to slide2, remove the light
+    after.object<Q3DSModelNode>("model1")->setRotation(QVector3D(0, 90, 0));
+
+    Q3DSModelNode *model2 = after.newObject<Q3DSModelNode>("model2");
+    model2->setMesh(QLatin1String("#Sphere"));
+    after.object("layer1")->appendChildNode(model2);
+    after.object<Q3DSSlide>("slide2")->addObject(model2);
+
+    Q3DSGraphObject *light1 = after.object("light1");
+    after.masterSlide()->removeObject(light1);
+    after.unlinkObject(light1);
+    delete light1;
+
+    QVERIFY(diff.compute(&before, &after));
+    QVERIFY(!diff.isEmpty());
+    QCOMPARE(diff.changedProperties().count(), 1);
+    QCOMPARE(diff.changedProperties().value("model1"), QVector<QByteArray>() << QByteArrayLiteral("rotation"));
+    QCOMPARE(diff.addedCount(), 1);
+    QCOMPARE(diff.removedCount(), 1);
+
+    const QSet<QByteArray> touched = diff.apply(&live, &after, live.object<Q3DSSlide>("slide1"));
+    QVERIFY(touched.contains("model1"));
+    QVERIFY(touched.contains("model2"));
+
+    QCOMPARE(live.object<Q3DSModelNode>("model1")->rotation(), QVector3D(0, 90, 0));
+    Q3DSModelNode *liveModel2 = live.object<Q3DSModelNode>("model2");
+    QVERIFY(liveModel2);
+    QVERIFY(!after.object("model2"));
+    QCOMPARE(liveModel2->parent(), live.object("layer1"));
+    QCOMPARE(liveModel2->previousSibling(), live.object("model1"));
+    QVERIFY(!liveModel2->mesh().isEmpty());
+    QVERIFY(live.object<Q3DSSlide>("slide2")->objects().contains(liveModel2));
+    QVERIFY(!live.object("light1"));
+    QCOMPARE(live.masterSlide()->objects().count(), 2);
+
+    // reordering cannot be applied incrementally
+    Q3DSUipPresentation reordered;
+    makePresentation(reordered);
+    Q3DSGraphObject *camera1 = reordered.object("camera1");
+    Q3DSGraphObject *layer1 = camera1->parent();
+    layer1->removeChildNode(camera1);
+    layer1->appendChildNode(camera1);
+    QVERIFY(!diff.compute(&before, &reordered));
+    QVERIFY(!diff.failureReason().isEmpty());
+
+    // neither can slide changes
+    Q3DSUipPresentation slideChanged;
+    makePresentation(slideChanged);
+    slideChanged.object<Q3DSSlide>("slide2")->setPlayMode(Q3DSSlide::Looping);
+    QVERIFY(!diff.compute(&before, &slideChanged));
+}
+
 #include <tst_q3dsuippresentation.moc>
 QTEST_MAIN(tst_Q3DSUipPresentation)
@@ -0,0 +1,149 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of Qt 3D Studio.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
+
+#include <private/q3dsuiaparser_p.h>
+#include <private/q3dsuipparser_p.h>
+#include <private/q3dsgraphicslimits_p.h>
+#include <private/q3dsshaderbundle_p.h>
+
+// Generates the material shaders of a set of presentations for a given
+// OpenGL target, to be picked up by the runtime instead of generating them
+// while loading (see Q3DSEngine::setSource()).
+
+static bool limitsForTarget(const QString &target, Q3DSGraphicsLimits *limits)
+{
+    QSurfaceFormat format;
+    if (target == QLatin1String("gl33") || target == QLatin1String("gl43")) {
+        format.setRenderableType(QSurfaceFormat::OpenGL);
+        format.setProfile(QSurfaceFormat::CoreProfile);
+        format.setVersion(target == QLatin1String("gl33") ? 3 : 4, 3);
+    } else if (target == QLatin1String("gles20") || target == QLatin1String("gles30") || target == QLatin1String("gles31")) {
+        format.setRenderableType(QSurfaceFormat::OpenGLES);
+        format.setVersion(target.at(4).digitValue(), target.at(5).digitValue());
+    } else {
+        return false;
+    }
+
+    limits->format = format;
+    limits->useGles2Path = format.renderableType() == QSurfaceFormat::OpenGLES && format.majorVersion() < 3;
+    limits->shaderTextureLodSupported = !limits->useGles2Path;
+    limits->maxLightsPerLayer = limits->useGles2Path ? 8 : 16;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser cmdLineParser;
+    cmdLineParser.addHelpOption();
+    cmdLineParser.addPositionalArgument(QLatin1String("filename"), QObject::tr("UIP or UIA file(s) to generate shaders for"));
+    QCommandLineOption outputOption({ "o", "output" },
+                                    QObject::tr("Writes the bundle to <file>.\n"
+                                    "The default is the first input with the .shaderbundle suffix."),
+                                    QObject::tr("file"));
+    cmdLineParser.addOption(outputOption);
+    QCommandLineOption targetOption({ "t", "target" },
+                                    QObject::tr("Generates for the given OpenGL target.\n"
+                                    "The default value is 'gl33'."),
+                                    QObject::tr("gl33|gl43|gles20|gles30|gles31"),
+                                    QStringLiteral("gl33"));
+    cmdLineParser.addOption(targetOption);
+    QCommandLineOption textureLodOption("texturelod", QObject::tr("Assumes GL_EXT_shader_texture_lod with gles20"));
+    cmdLineParser.addOption(textureLodOption);
+    QCommandLineOption maxLightsOption("maxlights", QObject::tr("Overrides the maximum number of lights per layer"), QObject::tr("n"));
+    cmdLineParser.addOption(maxLightsOption);
+    cmdLineParser.process(app);
+
+    const QStringList inputs = cmdLineParser.positionalArguments();
+    if (inputs.isEmpty())
+        cmdLineParser.showHelp(1);
+
+    Q3DSGraphicsLimits limits;
+    if (!limitsForTarget(cmdLineParser.value(targetOption), &limits)) {
+        qWarning("Unknown target %s", qPrintable(cmdLineParser.value(targetOption)));
+        return 1;
+    }
+    if (cmdLineParser.isSet(textureLodOption))
+        limits.shaderTextureLodSupported = true;
+    if (cmdLineParser.isSet(maxLightsOption))
+        limits.maxLightsPerLayer = cmdLineParser.value(maxLightsOption).toInt();
+    Q3DS::setGraphicsLimits(limits);
+
+    QStringList uipFiles;
+    for (const QString &input : inputs) {
+        QFileInfo fi(input);
+        if (fi.suffix() == QStringLiteral("uia")) {
+            Q3DSUiaParser uiaParser;
+            const Q3DSUiaParser::Uia uiaDoc = uiaParser.parse(input);
+            if (!uiaDoc.isValid()) {
+                qWarning("Failed to parse %s", qPrintable(input));
+                return 1;
+            }
+            const QString sourcePrefix = fi.canonicalPath() + QLatin1Char('/');
+            for (const Q3DSUiaParser::Uia::Presentation &p : uiaDoc.presentations) {
+                if (p.type == Q3DSUiaParser::Uia::Presentation::Uip)
+                    uipFiles.append(sourcePrefix + p.source);
+            }
+        } else {
+            uipFiles.append(input);
+        }
+    }
+
+    Q3DSShaderBundle bundle;
+    for (const QString &uipFile : qAsConst(uipFiles)) {
+        Q3DSUipParser uipParser;
+        QScopedPointer<Q3DSUipPresentation> presentation(uipParser.parse(uipFile, QFileInfo(uipFile).completeBaseName()));
+        if (!presentation) {
+            qWarning("Failed to parse %s", qPrintable(uipFile));
+            return 1;
+        }
+        const int count = bundle.addPresentation(presentation.data());
+        qDebug("%s: %d programs", qPrintable(uipFile), count);
+    }
+
+    QString output = cmdLineParser.value(outputOption);
+    if (output.isEmpty()) {
+        const QFileInfo fi(inputs.first());
+        output = fi.path() + QLatin1Char('/') + fi.completeBaseName() + QLatin1String(".shaderbundle");
+    }
+
+    QString error;
+    if (!bundle.save(output, &error)) {
+        qWarning("Failed to write %s: %s", qPrintable(output), qPrintable(error));
+        return 1;
+    }
+    qDebug("Wrote %d programs for %s to %s", bundle.count(), bundle.target().constData(), qPrintable(output));
+
+    return 0;
+}
@@ -0,0 +1,9 @@
+QT += 3dstudioruntime2-private
+
+CONFIG += console
+
+SOURCES += main.cpp
+
+QMAKE_TARGET_DESCRIPTION = Qt 3D Studio Shader Bundler
+
+load(qt_app)
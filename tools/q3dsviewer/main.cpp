@@ -91,6 +91,11 @@ int main(int argc, char *argv[])
                                         "For example, white matte: #ffffff"),
                                         QObject::tr("color"), QStringLiteral("#333333"));
     cmdLineParser.addOption(matteColorOption);
+    QCommandLineOption frameBudgetOption("framebudget",
+                                         QObject::tr("Enables dynamic quality scaling\n"
+                                         "to keep frame times within <ms> milliseconds."),
+                                         QObject::tr("ms"), QStringLiteral("16.7"));
+    cmdLineParser.addOption(frameBudgetOption);
     cmdLineParser.process(app);
 
     QSurfaceFormat::setDefaultFormat(Q3DS::surfaceFormat());
@@ -122,6 +127,10 @@ int main(int argc, char *argv[])
     QScopedPointer<Q3DSWindow> view(new Q3DSWindow);
     view->setEngine(engine.data());
     engine->setFlags(flags);
+    if (cmdLineParser.isSet(frameBudgetOption)) {
+        engine->setTargetFrameTime(cmdLineParser.value(frameBudgetOption).toFloat());
+        engine->setQualityGovernorEnabled(true);
+    }
 
     // Setup Remote Viewer
     int port = 36000;
@@ -106,7 +106,7 @@ Q3DStudioMainWindow::Q3DStudioMainWindow(Q3DSWindow *view, Q3DSRemoteDeploymentM
             remote->state() != Q3DSRemoteDeploymentManager::RemoteProject)
             return;
         if (m_okToReload) {
-            view->engine()->setSource(view->engine()->source());
+            view->engine()->reload();
             m_refreshTimer.start();
             m_okToReload = false;
         }
@@ -319,6 +319,12 @@ Q3DStudioMainWindow::Q3DStudioMainWindow(Q3DSWindow *view, Q3DSRemoteDeploymentM
         connect(renderOnDemand, &QAction::toggled, [=]() {
             view->engine()->setOnDemandRendering(renderOnDemand->isChecked());
         });
+        QAction *autoIdle = debugMenu->addAction(tr("Suspend rendering when &idle"));
+        autoIdle->setCheckable(true);
+        autoIdle->setChecked(view->engine()->autoIdleRendering());
+        connect(autoIdle, &QAction::toggled, [=]() {
+            view->engine()->setAutoIdleRendering(autoIdle->isChecked());
+        });
     }
 
     QMenu *helpMenu = menuBar()->addMenu(tr("&Help"));
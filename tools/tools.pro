@@ -1,2 +1,3 @@
 TEMPLATE = subdirs
 SUBDIRS += q3dsviewer
+!android:!ios:!boot2qt: SUBDIRS += q3dsshaderbundler